@@ -116,12 +116,24 @@ void U64_CleanupLibrary (void);
 
 void U64_SetVerboseMode (BOOL verbose);
 
-/* Connection management */
+/* Connection management. host may end in ":port" for a port other
+   than 80. */
 U64Connection *U64_Connect (CONST_STRPTR host, CONST_STRPTR password);
 void U64_Disconnect (U64Connection *conn);
 LONG U64_GetLastError (U64Connection *conn);
 CONST_STRPTR U64_GetErrorString (LONG error);
 
+/* Bound the connect and each send/receive wait of conn's HTTP requests, in
+   seconds; 0 restores the default (10 and 30). */
+void U64_SetTimeouts (U64Connection *conn, ULONG connect_s, ULONG io_s);
+
+/* GET any API path, e.g. "/v1/version", without copying the reply: *data
+   points at the NUL-terminated body in conn's own memory and stays valid
+   until the next request on conn. Do not free it. On an HTTP error the
+   device's body is still lent out, for its error text. */
+LONG U64_GetBorrowed (U64Connection *conn, CONST_STRPTR path,
+                      CONST UBYTE **data, ULONG *size);
+
 /* Device information */
 LONG U64_GetDeviceInfo (U64Connection *conn, U64DeviceInfo *info);
 void U64_FreeDeviceInfo (U64DeviceInfo *info);
@@ -313,6 +325,142 @@ void U64_FreeConfigJSON(STRPTR json);
 
 
 
+/* Request statistics
+ *
+ * Every request a connection makes is counted under its endpoint - the
+ * method and path, with drive ids and config names folded to '*' - and
+ * timed off the E-clock in milliseconds. Downloads that don't go through
+ * a connection (U64_DownloadToFile*, U64_HttpGetURL) are kept library-wide
+ * under the host they went to; pass conn = NULL for those.
+ */
+#define U64_STATS_MAX_ENDPOINTS 32 /* the last slot collects the rest */
+#define U64_STATS_NAME_LEN 48
+#define U64_STATS_BUCKETS 10
+#define U64_STATS_ERRORS 10 /* errors[-U64_ERR_x]; [0] is unused */
+
+typedef struct
+{
+  ULONG count;
+  ULONG total_ms;
+  ULONG max_ms;
+  ULONG buckets[U64_STATS_BUCKETS]; /* upper bounds: U64_StatsBucketLimit */
+} U64Histogram;
+
+typedef struct
+{
+  char name[U64_STATS_NAME_LEN]; /* "PUT /v1/machine:writemem" */
+  ULONG requests;
+  ULONG bytes_sent;
+  ULONG bytes_received;
+  U64Histogram connect;    /* until the TCP connection is up */
+  U64Histogram first_byte; /* until the first byte of the response */
+  U64Histogram total;      /* the whole request, failures included */
+  ULONG errors[U64_STATS_ERRORS];
+} U64EndpointStats;
+
+typedef struct
+{
+  ULONG endpoint_count;
+  U64EndpointStats endpoints[U64_STATS_MAX_ENDPOINTS];
+} U64Stats;
+
+/* Statistics gathered so far, or NULL if nothing has been recorded. The
+   pointer stays valid until U64_Disconnect (or U64_CleanupLibrary for
+   conn = NULL); U64_ResetStats clears it in place. */
+CONST U64Stats *U64_GetStats (U64Connection *conn);
+void U64_ResetStats (U64Connection *conn);
+/* Upper bound in ms of histogram bucket i; the last one is ~0UL */
+ULONG U64_StatsBucketLimit (ULONG bucket);
+/* Bucket bound below which percent (1-100) of the samples fall, capped
+   at the slowest sample */
+ULONG U64_StatsPercentile (CONST U64Histogram *hist, ULONG percent);
+
+/* HTTP traces
+ *
+ * U64_TraceRecord writes every request the connection makes - method,
+ * path, request headers and body, the raw reply and its timings - to a
+ * trace file. U64_TraceReplay serves requests from such a file instead of
+ * the network, so a recorded session can be rerun without the device:
+ * each request takes the next recorded exchange with the same method and
+ * path. time_percent scales the recorded durations, 100 for the original
+ * pace down to 0 for no waiting at all.
+ */
+LONG U64_TraceRecord (U64Connection *conn, CONST_STRPTR filename);
+LONG U64_TraceReplay (U64Connection *conn, CONST_STRPTR filename,
+                      ULONG time_percent);
+void U64_TraceStop (U64Connection *conn);
+
+/* Fleets
+ *
+ * A fleet sends the same command to several devices at once: every
+ * device's request goes out over its own socket and all of them are
+ * served from a single wait, so a command costs about as long as the
+ * slowest device rather than the sum of them all. Sockets are kept open
+ * between U64_FleetExec calls and reopened when a device has dropped one.
+ *
+ * hosts is a NULL-terminated array, as ReadArgs returns for /M; a host
+ * may carry its port as "10.0.0.64:8080". Every device shares password.
+ */
+#define U64_FLEET_MAX_HOSTS 32
+
+typedef struct U64Fleet U64Fleet;
+
+typedef enum
+{
+  U64_FLEET_RESET = 0,
+  U64_FLEET_REBOOT,
+  U64_FLEET_RUN_PRG,
+  U64_FLEET_RUN_CRT,
+  U64_FLEET_MOUNT,
+  U64_FLEET_PLAY_SID,
+  U64_FLEET_SET_CONFIG
+} U64FleetCommand;
+
+/* What a command needs; fields a command doesn't use are ignored */
+typedef struct
+{
+  CONST UBYTE *data;     /* PRG, CRT, disk image or SID file */
+  ULONG size;
+  CONST_STRPTR filename; /* mount: image name, its extension gives the type */
+  CONST_STRPTR drive;    /* mount: "a" to "d" */
+  U64MountMode mode;     /* mount */
+  UBYTE song;            /* play SID: 0 for the default song */
+  CONST_STRPTR category; /* set config */
+  CONST_STRPTR item;
+  CONST_STRPTR value;
+} U64FleetPayload;
+
+/* Outcome on one device */
+typedef struct
+{
+  CONST_STRPTR host; /* as given in hosts, port included */
+  LONG result;      /* U64_OK or U64_ERR_x */
+  UWORD status_code; /* 0 if no reply arrived */
+  ULONG time_ms;
+  char message[128]; /* the device's first error message, or empty */
+} U64FleetResult;
+
+U64Fleet *U64_FleetCreate (CONST_STRPTR *hosts, CONST_STRPTR password);
+void U64_FleetFree (U64Fleet *fleet);
+ULONG U64_FleetCount (U64Fleet *fleet);
+/* Run command on every device, waiting at most timeout_s seconds in all.
+   Returns U64_OK if it succeeded everywhere, else U64_ERR_GENERAL (or
+   U64_ERR_INVALID / U64_ERR_MEMORY when nothing was sent); see
+   U64_FleetResults for each device. */
+LONG U64_FleetExec (U64Fleet *fleet, U64FleetCommand command,
+                    CONST U64FleetPayload *payload, ULONG timeout_s);
+/* U64_FleetCount results of the last U64_FleetExec, in host order */
+CONST U64FleetResult *U64_FleetResults (U64Fleet *fleet);
+/* The connection behind device index, for its statistics */
+U64Connection *U64_FleetConnection (U64Fleet *fleet, ULONG index);
+/* Traces for a whole fleet: every device records into one file, and on
+   replay each device is answered from the records of its own host, so
+   the fleet must name the same hosts it was recorded with. */
+LONG U64_FleetTraceRecord (U64Fleet *fleet, CONST_STRPTR filename);
+LONG U64_FleetTraceReplay (U64Fleet *fleet, CONST_STRPTR filename,
+                           ULONG time_percent);
+void U64_FleetTraceStop (U64Fleet *fleet);
+
 /* VIC Stream functions (if supported) */
 #ifdef U64_VICSTREAM_SUPPORT
 typedef struct
@@ -6,6 +6,30 @@
 #include <exec/ports.h>
 #include <exec/types.h>
 
+/* Per-connection scratch arena (ultimate64_arena.c) */
+#define U64_ARENA_BLOCK_SIZE 8192
+
+typedef struct U64ArenaBlock
+{
+  struct U64ArenaBlock *next;
+  ULONG size; /* usable bytes after this header */
+  ULONG used;
+} U64ArenaBlock;
+
+typedef struct
+{
+  APTR pool;              /* exec pool, created on first use */
+  U64ArenaBlock *first;
+  U64ArenaBlock *current; /* block allocations come from; NULL = none yet */
+  APTR last;              /* newest allocation, for U64_ArenaGrow */
+} U64Arena;
+
+typedef struct
+{
+  U64ArenaBlock *block;
+  ULONG used;
+} U64ArenaMark;
+
 /* Connection structure (internal) */
 struct U64Connection
 {
@@ -14,12 +38,25 @@ struct U64Connection
   UWORD port;
   LONG last_error;
 
+  /* HTTP timeouts in seconds, 0 = default (U64_SetTimeouts) */
+  ULONG connect_timeout;
+  ULONG io_timeout;
+
   /* For HTTP communication */
   STRPTR url_prefix;
 
   /* Network connection */
   APTR net_connection;
 
+  /* Scratch memory for requests */
+  U64Arena arena;
+
+  /* Per-endpoint statistics, allocated on the first request */
+  U64Stats *stats;
+
+  /* HTTP trace being recorded or replayed, NULL if none */
+  struct U64Trace *trace;
+
 /* Async support */
 #ifdef U64_ASYNC_SUPPORT
   struct MsgPort *reply_port;
@@ -66,8 +103,15 @@ typedef struct
   STRPTR response;
   ULONG response_size;
   UWORD status_code;
+  UBYTE flags;
 } HttpRequest;
 
+/* HttpRequest.flags */
+#define HTTP_BORROW_RESPONSE 0x01 /* response points into the connection
+                                     arena, valid until its next reset;
+                                     the caller must not FreeMem it */
+#define HTTP_KEEP_ALIVE 0x02      /* ask for the connection to stay open */
+
 /* Internal functions */
 LONG U64_HttpRequest (U64Connection *conn, HttpRequest *req);
 /* Post multipart/form-data.
@@ -84,10 +128,118 @@ LONG U64_HttpPostMultipart (U64Connection *conn, CONST_STRPTR path,
                             CONST_STRPTR *extra_fields,
                             CONST_STRPTR *extra_values, ULONG num_extras,
                             HttpRequest *result_req);
+void U64_GenerateBoundary (STRPTR boundary, ULONG size);
+UBYTE *U64_BuildMultipartForm (CONST_STRPTR boundary, CONST_STRPTR field_name,
+                               CONST_STRPTR filename,
+                               CONST_STRPTR content_type, CONST UBYTE *data,
+                               ULONG data_size, CONST_STRPTR *extra_fields,
+                               CONST_STRPTR *extra_values, ULONG num_extras,
+                               ULONG *total_size);
+ULONG U64_HttpFormatHeader (U64Connection *conn, HttpRequest *req,
+                            char *header, ULONG size);
+BOOL U64_HttpReplyComplete (char *buffer, ULONG total_size,
+                            ULONG *headers_end, LONG *content_length);
 LONG U64_ParseJSON (CONST_STRPTR json, CONST_STRPTR key, STRPTR value,
                     ULONG value_size);
 STRPTR U64_BuildURL (U64Connection *conn, CONST_STRPTR path);
+STRPTR U64_URLEncode (U64Connection *conn, CONST_STRPTR input);
 void U64_FreeURL (STRPTR url);
+ULONG U64_HexEncode (CONST UBYTE *data, ULONG length, STRPTR out);
+
+/* Scratch arena */
+APTR U64_ArenaAlloc (U64Connection *conn, ULONG size);
+APTR U64_ArenaGrow (U64Connection *conn, APTR ptr, ULONG old_size,
+                    ULONG new_size);
+U64ArenaMark U64_ArenaGetMark (U64Connection *conn);
+void U64_ArenaRelease (U64Connection *conn, U64ArenaMark mark);
+void U64_ArenaReset (U64Connection *conn);
+void U64_ArenaFree (U64Connection *conn);
+
+/* Request statistics */
+#define U64_STATS_NONE 0xFFFFFFFFUL
+
+typedef struct
+{
+  ULONG start;         /* U64_StatsNow () when the request began */
+  ULONG connect_ms;    /* U64_STATS_NONE until connected */
+  ULONG first_byte_ms; /* U64_STATS_NONE until data arrives */
+  ULONG bytes_sent;
+  ULONG bytes_received;
+} U64StatsSample;
+
+void U64_StatsInit (void);
+void U64_StatsCleanup (void);
+void U64_StatsBegin (U64StatsSample *sample);
+ULONG U64_StatsSince (CONST U64StatsSample *sample);
+void U64_StatsRecord (U64Connection *conn, CONST_STRPTR method,
+                      CONST_STRPTR path, CONST U64StatsSample *sample,
+                      LONG result);
+void U64_StatsFree (U64Connection *conn);
+
+/* HTTP traces (ultimate64_trace.c) */
+#define U64_TRACE_RECORD 1
+#define U64_TRACE_REPLAY 2
+
+#define U64_TRACE_HOST_LEN 80
+
+typedef struct U64Trace
+{
+  BPTR file;
+  UBYTE mode;          /* U64_TRACE_RECORD or U64_TRACE_REPLAY, 0 once
+                          a shared recording has failed */
+  UBYTE version;       /* of the file being replayed */
+  ULONG time_percent;  /* replay: share of the recorded time to wait */
+  ULONG records;
+  ULONG users;         /* connections recording into this file */
+  char host[U64_TRACE_HOST_LEN]; /* replay only this host's, "" for any */
+} U64Trace;
+
+void U64_TraceShare (U64Connection *from, U64Connection *to);
+void U64_TraceSetHost (U64Connection *conn);
+
+void U64_TraceWrite (U64Connection *conn, HttpRequest *req,
+                     CONST char *header, ULONG header_len,
+                     CONST char *response, ULONG response_len,
+                     CONST U64StatsSample *sample, LONG result);
+LONG U64_TraceReplayRequest (U64Connection *conn, HttpRequest *req);
+/* "host", or "host:port" for a port other than 80 */
+void U64_ConnName (U64Connection *conn, char *buffer, ULONG size);
+LONG U64_HttpParseResponse (HttpRequest *req, char *response_buffer,
+                            ULONG total_size, BOOL *borrowed);
+
+/* Socket transport (ultimate64_socket.c): bsdsocket.library with
+   USE_BSDSOCKET, host BSD sockets with USE_POSIX_SOCKETS */
+#define U64_SOCK_READ 0x01
+#define U64_SOCK_WRITE 0x02
+
+BOOL U64_SockReady (void);
+LONG U64_SockError (void);
+LONG U64_SockConnect (CONST_STRPTR host, UWORD port, ULONG connect_s,
+                      ULONG io_s);
+LONG U64_SockWait (LONG sock, ULONG events, ULONG timeout_s);
+LONG U64_SockSendAll (LONG sock, CONST void *data, ULONG length,
+                      ULONG timeout_s, ULONG *sent);
+LONG U64_SockRecv (LONG sock, void *buffer, ULONG size);
+void U64_SockClose (LONG sock);
+
+/* Non-blocking use, for driving several sockets from one wait:
+   U64_SockStart begins a connect and returns the socket at once,
+   U64_SockFinish checks how it went once the socket turns writable.
+   U64_SockSend sends what fits and returns 0 when nothing does. */
+typedef struct
+{
+  LONG sock;
+  UBYTE events; /* U64_SOCK_READ / U64_SOCK_WRITE to wait for */
+  UBYTE ready;  /* set by U64_SockWaitMany */
+} U64SockPoll;
+
+#define U64_SOCK_WAIT_MAX 64 /* sockets per U64_SockWaitMany */
+
+LONG U64_SockStart (CONST_STRPTR host, UWORD port);
+LONG U64_SockFinish (LONG sock);
+LONG U64_SockSend (LONG sock, CONST void *data, ULONG length);
+BOOL U64_SockWouldBlock (void);
+LONG U64_SockWaitMany (U64SockPoll *polls, ULONG count, ULONG timeout_ms);
 
 /* Network abstraction layer */
 LONG U64_NetInit (void);
@@ -122,6 +274,15 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
                           CONST_STRPTR extra_headers,
                           void (*progress_callback)(ULONG bytes, APTR userdata),
                           APTR userdata);
+/* As _Ex, also handing each body chunk to data_callback as it is written,
+ * so the caller can parse while downloading. data_callback returning FALSE
+ * aborts the transfer (U64_ERR_GENERAL). */
+LONG U64_DownloadToFileTee(CONST_STRPTR url, CONST_STRPTR local_filename,
+                           CONST_STRPTR extra_headers,
+                           BOOL (*data_callback)(const UBYTE *data, ULONG length,
+                                                 APTR userdata),
+                           void (*progress_callback)(ULONG bytes, APTR userdata),
+                           APTR userdata);
 /* GET an arbitrary URL into an AllocVec'd buffer; caller FreeVec's on success
  * OR whenever *out_buffer is non-NULL after the call (body is preserved even
  * on non-2xx so the caller can read any error payload the server returned).
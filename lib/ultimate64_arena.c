@@ -0,0 +1,208 @@
+/* Ultimate64/Ultimate-II Control Library for Amiga OS 3.x
+ * Per-connection scratch arena
+ *
+ * The buffers a library call needs only while it runs - the HTTP response
+ * as it arrives, WriteMem's hex payload and path, URL-encoded arguments -
+ * are carved from a bump allocator over blocks taken from an exec memory
+ * pool. Nothing is freed piecemeal: U64_ArenaRelease rewinds to a mark and
+ * U64_ArenaReset to empty, keeping the blocks for the next call, so a
+ * steady stream of requests stops going through AllocMem/FreeMem and
+ * stops fragmenting the free lists.
+ *
+ * Calls that borrow a response (HTTP_BORROW_RESPONSE) reset the arena on
+ * entry; what they borrowed stays valid until the next such call on the
+ * same connection. Everything else leaves it as it found it. Applications
+ * borrow through U64_GetBorrowed.
+ */
+
+#include <exec/memory.h>
+#include <exec/types.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#include "ultimate64_amiga.h"
+#include "ultimate64_private.h"
+
+#define ARENA_ALIGN(n) (((n) + 3) & ~3UL)
+
+/* Blocks larger than this hold a single big response; they go back to the
+   pool on reset rather than pinning the memory for the next call. */
+#define ARENA_KEEP_SIZE U64_ARENA_BLOCK_SIZE
+
+static U64ArenaBlock *
+ArenaNewBlock (U64Arena *arena, ULONG size)
+{
+  U64ArenaBlock *block;
+
+  if (!arena->pool)
+    {
+      arena->pool = CreatePool (MEMF_PUBLIC, U64_ARENA_BLOCK_SIZE
+                                                 + sizeof (U64ArenaBlock),
+                                U64_ARENA_BLOCK_SIZE + sizeof (U64ArenaBlock));
+      if (!arena->pool)
+        {
+          return NULL;
+        }
+    }
+
+  if (size < U64_ARENA_BLOCK_SIZE)
+    {
+      size = U64_ARENA_BLOCK_SIZE;
+    }
+  block = AllocPooled (arena->pool, sizeof (U64ArenaBlock) + size);
+  if (!block)
+    {
+      return NULL;
+    }
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+/* Allocate size bytes (longword aligned, not cleared) that stay valid
+   until the arena is released past them. NULL if out of memory. */
+APTR
+U64_ArenaAlloc (U64Connection *conn, ULONG size)
+{
+  U64Arena *arena = &conn->arena;
+  U64ArenaBlock *block = arena->current;
+  APTR p;
+
+  size = ARENA_ALIGN (size);
+
+  if (!block || block->used + size > block->size)
+    {
+      /* Move on to the next kept block if the request fits there,
+         otherwise slot a new one in after the current block */
+      U64ArenaBlock *next = block ? block->next : arena->first;
+
+      if (next && size <= next->size)
+        {
+          next->used = 0;
+          block = next;
+        }
+      else
+        {
+          U64ArenaBlock *fresh = ArenaNewBlock (arena, size);
+          if (!fresh)
+            {
+              return NULL;
+            }
+          fresh->next = next;
+          if (block)
+            {
+              block->next = fresh;
+            }
+          else
+            {
+              arena->first = fresh;
+            }
+          block = fresh;
+        }
+      arena->current = block;
+    }
+
+  p = (UBYTE *)(block + 1) + block->used;
+  block->used += size;
+  arena->last = p;
+  return p;
+}
+
+/* Resize ptr, the arena's newest allocation of old_size bytes, to
+   new_size. It grows in place when its block has room; otherwise the
+   contents move to a new allocation. NULL if out of memory (ptr is
+   still valid then). */
+APTR
+U64_ArenaGrow (U64Connection *conn, APTR ptr, ULONG old_size, ULONG new_size)
+{
+  U64Arena *arena = &conn->arena;
+  U64ArenaBlock *block = arena->current;
+  APTR fresh;
+
+  old_size = ARENA_ALIGN (old_size);
+  new_size = ARENA_ALIGN (new_size);
+
+  if (ptr && ptr == arena->last && block
+      && (UBYTE *)ptr + old_size == (UBYTE *)(block + 1) + block->used
+      && block->used - old_size + new_size <= block->size)
+    {
+      block->used += new_size - old_size;
+      return ptr;
+    }
+
+  fresh = U64_ArenaAlloc (conn, new_size);
+  if (fresh && ptr)
+    {
+      CopyMem (ptr, fresh, old_size);
+    }
+  return fresh;
+}
+
+U64ArenaMark
+U64_ArenaGetMark (U64Connection *conn)
+{
+  U64ArenaMark mark;
+
+  mark.block = conn->arena.current;
+  mark.used = mark.block ? mark.block->used : 0;
+  return mark;
+}
+
+/* Drop oversized blocks from *link onwards, keeping the rest for reuse. */
+static void
+ArenaTrim (U64Arena *arena, U64ArenaBlock **link)
+{
+  while (*link)
+    {
+      U64ArenaBlock *block = *link;
+      if (block->size > ARENA_KEEP_SIZE)
+        {
+          *link = block->next;
+          FreePooled (arena->pool, block, sizeof (U64ArenaBlock) + block->size);
+        }
+      else
+        {
+          block->used = 0;
+          link = &block->next;
+        }
+    }
+}
+
+/* Give back everything allocated since mark was taken. */
+void
+U64_ArenaRelease (U64Connection *conn, U64ArenaMark mark)
+{
+  U64Arena *arena = &conn->arena;
+
+  arena->current = mark.block;
+  if (mark.block)
+    {
+      mark.block->used = mark.used;
+    }
+  arena->last = NULL;
+  ArenaTrim (arena, mark.block ? &mark.block->next : &arena->first);
+}
+
+/* Rewind the arena to empty, returning oversized blocks to the pool. */
+void
+U64_ArenaReset (U64Connection *conn)
+{
+  U64Arena *arena = &conn->arena;
+
+  ArenaTrim (arena, &arena->first);
+  arena->current = NULL;
+  arena->last = NULL;
+}
+
+/* Release the pool and every block (U64_Disconnect). */
+void
+U64_ArenaFree (U64Connection *conn)
+{
+  if (conn->arena.pool)
+    {
+      DeletePool (conn->arena.pool);
+    }
+  memset (&conn->arena, 0, sizeof (conn->arena));
+}
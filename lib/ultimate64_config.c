@@ -104,9 +104,10 @@ JsonSkipWhitespace(JsonParser *parser)
     }
 }
 
-/* URL encode a string for use in HTTP requests */
-static STRPTR
-U64_URLEncode(CONST_STRPTR input)
+/* URL encode a string for use in HTTP requests. The result lives in the
+ * connection arena; callers release it once the path is built. */
+STRPTR
+U64_URLEncode(U64Connection *conn, CONST_STRPTR input)
 {
     STRPTR output;
     ULONG input_len, output_len;
@@ -118,7 +119,7 @@ U64_URLEncode(CONST_STRPTR input)
     /* Worst case: every character needs encoding (3 chars each) */
     output_len = input_len * 3 + 1;
     
-    output = AllocMem(output_len, MEMF_PUBLIC | MEMF_CLEAR);
+    output = U64_ArenaAlloc(conn, output_len);
     if (!output) return NULL;
     
     for (i = 0, j = 0; i < input_len && j < output_len - 3; i++)
@@ -367,6 +368,7 @@ U64_GetConfigCategory(U64Connection *conn, CONST_STRPTR category,
     LONG result;
     char path[512];
     STRPTR encoded_category;
+    U64ArenaMark mark;
     U64ConfigItem *temp_items = NULL;
     ULONG temp_count = 0;
     
@@ -380,14 +382,15 @@ U64_GetConfigCategory(U64Connection *conn, CONST_STRPTR category,
     U64_DEBUG("Getting configuration category: %s", category);
     
     /* URL encode category name */
-    encoded_category = U64_URLEncode(category);
+    mark = U64_ArenaGetMark(conn);
+    encoded_category = U64_URLEncode(conn, category);
     if (!encoded_category) {
         return U64_ERR_MEMORY;
     }
     
     /* Build request path */
     snprintf(path, sizeof(path), "/v1/configs/%s", encoded_category);
-    FreeMem(encoded_category, strlen(encoded_category) + 1);
+    U64_ArenaRelease(conn, mark);
     
     U64_DEBUG("Config category request path: %s", path);
     
@@ -511,6 +514,7 @@ U64_GetConfigItem(U64Connection *conn, CONST_STRPTR category, CONST_STRPTR item,
     LONG result;
     char path[512];
     STRPTR encoded_category, encoded_item;
+    U64ArenaMark mark;
     JsonParser parser;
     char buffer[256];
     LONG value;
@@ -525,21 +529,20 @@ U64_GetConfigItem(U64Connection *conn, CONST_STRPTR category, CONST_STRPTR item,
     U64_DEBUG("Getting configuration item: %s / %s", category, item);
     
     /* URL encode category and item names */
-    encoded_category = U64_URLEncode(category);
-    encoded_item = U64_URLEncode(item);
+    mark = U64_ArenaGetMark(conn);
+    encoded_category = U64_URLEncode(conn, category);
+    encoded_item = U64_URLEncode(conn, item);
     
     if (!encoded_category || !encoded_item)
     {
-        if (encoded_category) FreeMem(encoded_category, strlen(encoded_category) + 1);
-        if (encoded_item) FreeMem(encoded_item, strlen(encoded_item) + 1);
+        U64_ArenaRelease(conn, mark);
         return U64_ERR_MEMORY;
     }
     
     /* Build request path */
     snprintf(path, sizeof(path), "/v1/configs/%s/%s", encoded_category, encoded_item);
     
-    FreeMem(encoded_category, strlen(encoded_category) + 1);
-    FreeMem(encoded_item, strlen(encoded_item) + 1);
+    U64_ArenaRelease(conn, mark);
     
     U64_DEBUG("Config item request path: %s", path);
     
@@ -688,6 +691,7 @@ U64_SetConfigItem(U64Connection *conn, CONST_STRPTR category, CONST_STRPTR item,
     LONG result;
     char path[1024];
     STRPTR encoded_category, encoded_item, encoded_value;
+    U64ArenaMark mark;
     
     if (!conn || !category || !item || !value)
     {
@@ -697,15 +701,14 @@ U64_SetConfigItem(U64Connection *conn, CONST_STRPTR category, CONST_STRPTR item,
     U64_DEBUG("Setting configuration item: %s / %s = %s", category, item, value);
     
     /* URL encode all components */
-    encoded_category = U64_URLEncode(category);
-    encoded_item = U64_URLEncode(item);
-    encoded_value = U64_URLEncode(value);
+    mark = U64_ArenaGetMark(conn);
+    encoded_category = U64_URLEncode(conn, category);
+    encoded_item = U64_URLEncode(conn, item);
+    encoded_value = U64_URLEncode(conn, value);
     
     if (!encoded_category || !encoded_item || !encoded_value)
     {
-        if (encoded_category) FreeMem(encoded_category, strlen(encoded_category) + 1);
-        if (encoded_item) FreeMem(encoded_item, strlen(encoded_item) + 1);
-        if (encoded_value) FreeMem(encoded_value, strlen(encoded_value) + 1);
+        U64_ArenaRelease(conn, mark);
         return U64_ERR_MEMORY;
     }
     
@@ -713,9 +716,7 @@ U64_SetConfigItem(U64Connection *conn, CONST_STRPTR category, CONST_STRPTR item,
     snprintf(path, sizeof(path), "/v1/configs/%s/%s?value=%s", 
              encoded_category, encoded_item, encoded_value);
     
-    FreeMem(encoded_category, strlen(encoded_category) + 1);
-    FreeMem(encoded_item, strlen(encoded_item) + 1);
-    FreeMem(encoded_value, strlen(encoded_value) + 1);
+    U64_ArenaRelease(conn, mark);
     
     U64_DEBUG("Config set request path: %s", path);
     
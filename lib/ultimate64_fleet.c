@@ -0,0 +1,784 @@
+/* Ultimate64/Ultimate-II Control Library for Amiga OS 3.x
+ * Fleets: one command on many devices at once
+ *
+ * U64_FleetExec builds the request once - path, headers, body - and then
+ * runs every device through the same small state machine: connect, send
+ * the header and body, receive until Content-Length is satisfied. All
+ * sockets are non-blocking and served from one U64_SockWaitMany loop, so
+ * a slow or dead device holds up nobody but itself, and the whole command
+ * is bounded by a single timeout.
+ *
+ * The Ultimate keeps its HTTP socket open after replying, so each device's
+ * socket is kept for the next command. A kept socket the device has
+ * meanwhile closed shows up as a reset or an empty read before any reply;
+ * the device is then reconnected once and the request sent again.
+ *
+ * U64_FleetTraceRecord has every device write its exchanges to one trace
+ * file; U64_FleetTraceReplay answers each device from its own host's
+ * records instead of the network, one device after another.
+ */
+
+#include <exec/memory.h>
+#include <exec/types.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ultimate64_amiga.h"
+#include "ultimate64_private.h"
+
+#define FLEET_READ_CHUNK 1024
+#define FLEET_REPLY_SIZE 1024       /* first reply buffer, grown as needed */
+#define FLEET_REPLY_MAX (64 * 1024) /* command replies are short JSON */
+#define FLEET_NAME_LEN 80           /* a host as given, port included */
+
+/* FleetDevice.state */
+#define FLEET_DONE 0
+#define FLEET_CONNECTING 1
+#define FLEET_SENDING 2
+#define FLEET_RECEIVING 3
+
+typedef struct
+{
+  U64Connection *conn;
+  LONG sock;        /* kept open between commands, -1 if none */
+  UBYTE state;
+  BOOL reused;      /* sock was left open by an earlier command */
+  char *header;     /* request header, from the connection arena */
+  ULONG header_len;
+  ULONG sent;       /* bytes of header and body sent so far */
+  char *reply;      /* raw reply, from the connection arena */
+  ULONG reply_size;
+  ULONG received;
+  ULONG headers_end;
+  LONG content_length;
+  U64ArenaMark mark;
+  U64StatsSample sample;
+  HttpRequest req;
+} FleetDevice;
+
+struct U64Fleet
+{
+  ULONG count;
+  FleetDevice devices[U64_FLEET_MAX_HOSTS];
+  U64FleetResult results[U64_FLEET_MAX_HOSTS];
+  char names[U64_FLEET_MAX_HOSTS][FLEET_NAME_LEN];
+};
+
+static const char *fleet_methods[] = { "GET", "POST", "PUT", "DELETE" };
+static const char *fleet_mount_modes[]
+    = { "readwrite", "readonly", "unlinked" };
+
+/* Create a fleet of connections, one per host */
+U64Fleet *
+U64_FleetCreate (CONST_STRPTR *hosts, CONST_STRPTR password)
+{
+  U64Fleet *fleet;
+  ULONG i;
+
+  if (!hosts)
+    {
+      return NULL;
+    }
+
+  fleet = AllocMem (sizeof (U64Fleet), MEMF_PUBLIC | MEMF_CLEAR);
+  if (!fleet)
+    {
+      return NULL;
+    }
+
+  for (i = 0; hosts[i]; i++)
+    {
+      FleetDevice *dev = &fleet->devices[fleet->count];
+
+      if (fleet->count == U64_FLEET_MAX_HOSTS)
+        {
+          U64_DEBUG ("Fleet full, ignoring %s and the rest", hosts[i]);
+          break;
+        }
+
+      dev->conn = U64_Connect (hosts[i], password);
+      if (!dev->conn)
+        {
+          U64_FleetFree (fleet);
+          return NULL;
+        }
+      dev->sock = -1;
+
+      /* Label results with the host as given, so two devices on one
+         address with different ports can be told apart */
+      strncpy (fleet->names[fleet->count], (char *)hosts[i],
+               FLEET_NAME_LEN - 1);
+      fleet->results[fleet->count].host
+          = (CONST_STRPTR)fleet->names[fleet->count];
+      fleet->count++;
+    }
+
+  if (fleet->count == 0)
+    {
+      U64_FleetFree (fleet);
+      return NULL;
+    }
+
+  U64_DEBUG ("Created fleet of %lu devices", (unsigned long)fleet->count);
+  return fleet;
+}
+
+/* Close the fleet's sockets and connections */
+void
+U64_FleetFree (U64Fleet *fleet)
+{
+  ULONG i;
+
+  if (!fleet)
+    {
+      return;
+    }
+
+  for (i = 0; i < fleet->count; i++)
+    {
+      U64_SockClose (fleet->devices[i].sock);
+      U64_Disconnect (fleet->devices[i].conn);
+    }
+  FreeMem (fleet, sizeof (U64Fleet));
+}
+
+ULONG
+U64_FleetCount (U64Fleet *fleet)
+{
+  return fleet ? fleet->count : 0;
+}
+
+CONST U64FleetResult *
+U64_FleetResults (U64Fleet *fleet)
+{
+  return fleet ? fleet->results : NULL;
+}
+
+U64Connection *
+U64_FleetConnection (U64Fleet *fleet, ULONG index)
+{
+  return fleet && index < fleet->count ? fleet->devices[index].conn : NULL;
+}
+
+/* Record every device's requests into filename (replacing it) */
+LONG
+U64_FleetTraceRecord (U64Fleet *fleet, CONST_STRPTR filename)
+{
+  LONG result;
+  ULONG i;
+
+  if (!fleet)
+    {
+      return U64_ERR_INVALID;
+    }
+  result = U64_TraceRecord (fleet->devices[0].conn, filename);
+  if (result == U64_OK)
+    {
+      for (i = 1; i < fleet->count; i++)
+        {
+          U64_TraceShare (fleet->devices[0].conn, fleet->devices[i].conn);
+        }
+    }
+  return result;
+}
+
+/* Answer every device from filename, each from its own host's records */
+LONG
+U64_FleetTraceReplay (U64Fleet *fleet, CONST_STRPTR filename,
+                      ULONG time_percent)
+{
+  LONG result;
+  ULONG i;
+
+  if (!fleet)
+    {
+      return U64_ERR_INVALID;
+    }
+  for (i = 0; i < fleet->count; i++)
+    {
+      result = U64_TraceReplay (fleet->devices[i].conn, filename,
+                                time_percent);
+      if (result != U64_OK)
+        {
+          U64_FleetTraceStop (fleet);
+          return result;
+        }
+      U64_TraceSetHost (fleet->devices[i].conn);
+    }
+  return U64_OK;
+}
+
+void
+U64_FleetTraceStop (U64Fleet *fleet)
+{
+  ULONG i;
+
+  if (!fleet)
+    {
+      return;
+    }
+  for (i = 0; i < fleet->count; i++)
+    {
+      U64_TraceStop (fleet->devices[i].conn);
+    }
+}
+
+static BOOL
+FleetReplaying (CONST FleetDevice *dev)
+{
+  return dev->conn->trace && dev->conn->trace->mode == U64_TRACE_REPLAY;
+}
+
+/* Fill in the request every device sends for command. path (512 bytes)
+   and content_type (128) hold strings req points at; a mount's multipart
+   body is returned in *form for the caller to free. */
+static LONG
+FleetBuildRequest (U64Fleet *fleet, U64FleetCommand command,
+                   CONST U64FleetPayload *payload, HttpRequest *req,
+                   char *path, char *content_type, UBYTE **form,
+                   ULONG *form_size)
+{
+  memset (req, 0, sizeof (*req));
+  req->path = path;
+
+  switch (command)
+    {
+    case U64_FLEET_RESET:
+    case U64_FLEET_REBOOT:
+      req->method = HTTP_PUT;
+      strcpy (path, command == U64_FLEET_RESET ? "/v1/machine:reset"
+                                               : "/v1/machine:reboot");
+      return U64_OK;
+
+    case U64_FLEET_RUN_PRG:
+    case U64_FLEET_RUN_CRT:
+    case U64_FLEET_PLAY_SID:
+      if (!payload || !payload->data || payload->size < 2)
+        {
+          return U64_ERR_INVALID;
+        }
+      if (command == U64_FLEET_RUN_PRG)
+        {
+          strcpy (path, "/v1/runners:run_prg");
+        }
+      else if (command == U64_FLEET_RUN_CRT)
+        {
+          strcpy (path, "/v1/runners:run_crt");
+        }
+      else if (payload->song > 0)
+        {
+          sprintf (path, "/v1/runners:sidplay?songnr=%ld",
+                   (long)payload->song);
+        }
+      else
+        {
+          strcpy (path, "/v1/runners:sidplay");
+        }
+      req->method = HTTP_POST;
+      req->content_type = "application/octet-stream";
+      req->body = (UBYTE *)payload->data;
+      req->body_size = payload->size;
+      return U64_OK;
+
+    case U64_FLEET_MOUNT:
+      {
+        CONST_STRPTR extra_fields[2];
+        CONST_STRPTR extra_values[2];
+        char boundary[64];
+
+        if (!payload || !payload->data || !payload->filename
+            || !payload->drive || strlen ((char *)payload->drive) != 1
+            || payload->drive[0] < 'a' || payload->drive[0] > 'd'
+            || payload->mode > U64_MOUNT_UL)
+          {
+            return U64_ERR_INVALID;
+          }
+
+        /* Same form as U64_MountDisk, built once for every device */
+        extra_fields[0] = (CONST_STRPTR) "mode";
+        extra_values[0] = (CONST_STRPTR)fleet_mount_modes[payload->mode];
+        extra_fields[1] = (CONST_STRPTR) "type";
+        extra_values[1] = U64_GetDiskTypeString (
+            U64_GetDiskTypeFromExt (payload->filename));
+
+        U64_GenerateBoundary ((STRPTR)boundary, sizeof (boundary));
+        *form = U64_BuildMultipartForm (
+            (CONST_STRPTR)boundary, (CONST_STRPTR) "file",
+            (CONST_STRPTR)FilePart ((STRPTR)payload->filename),
+            (CONST_STRPTR) "application/octet-stream", payload->data,
+            payload->size, extra_fields, extra_values, 2, form_size);
+        if (!*form)
+          {
+            return U64_ERR_MEMORY;
+          }
+
+        sprintf (path, "/v1/drives/%s:mount", (char *)payload->drive);
+        sprintf (content_type, "multipart/form-data; boundary=%s", boundary);
+        req->method = HTTP_POST;
+        req->content_type = content_type;
+        req->body = *form;
+        req->body_size = *form_size;
+        return U64_OK;
+      }
+
+    case U64_FLEET_SET_CONFIG:
+      {
+        U64Connection *conn = fleet->devices[0].conn;
+        U64ArenaMark mark;
+        STRPTR category, item, value;
+
+        if (!payload || !payload->category || !payload->item
+            || !payload->value)
+          {
+            return U64_ERR_INVALID;
+          }
+
+        mark = U64_ArenaGetMark (conn);
+        category = U64_URLEncode (conn, payload->category);
+        item = U64_URLEncode (conn, payload->item);
+        value = U64_URLEncode (conn, payload->value);
+        if (category && item && value)
+          {
+            snprintf (path, 512, "/v1/configs/%s/%s?value=%s", category,
+                      item, value);
+          }
+        U64_ArenaRelease (conn, mark);
+        if (!category || !item || !value)
+          {
+            return U64_ERR_MEMORY;
+          }
+        req->method = HTTP_PUT;
+        return U64_OK;
+      }
+    }
+
+  return U64_ERR_INVALID;
+}
+
+/* Record how the request on dev ended and give back its scratch memory.
+   The socket stays open for the next command only when keep is set. */
+static void
+FleetEnd (FleetDevice *dev, U64FleetResult *res, LONG result, BOOL keep)
+{
+  if (!keep)
+    {
+      U64_SockClose (dev->sock);
+      dev->sock = -1;
+    }
+
+  res->result = result;
+  res->status_code = dev->req.status_code;
+  res->time_ms = U64_StatsSince (&dev->sample);
+  dev->conn->last_error = result;
+
+  if (dev->conn->trace)
+    {
+      U64_TraceWrite (dev->conn, &dev->req, dev->header, dev->header_len,
+                      dev->reply, dev->received, &dev->sample, result);
+    }
+  /* A replayed exchange was counted by U64_TraceReplayRequest */
+  if (!FleetReplaying (dev))
+    {
+      U64_StatsRecord (dev->conn,
+                       (CONST_STRPTR)fleet_methods[dev->req.method],
+                       dev->req.path, &dev->sample, result);
+    }
+  U64_ArenaRelease (dev->conn, dev->mark);
+  dev->state = FLEET_DONE;
+
+  U64_DEBUG ("Fleet %s: result=%ld, status=%d, %lu ms",
+             (char *)dev->conn->host, result, dev->req.status_code,
+             (unsigned long)res->time_ms);
+}
+
+/* Begin connecting dev from scratch */
+static void
+FleetConnect (FleetDevice *dev, U64FleetResult *res)
+{
+  dev->reused = FALSE;
+  dev->sent = 0;
+  dev->received = 0;
+  dev->headers_end = 0;
+  dev->content_length = -1;
+
+  dev->sock = U64_SockStart (dev->conn->host, dev->conn->port);
+  if (dev->sock < 0)
+    {
+      FleetEnd (dev, res, U64_ERR_NETWORK, FALSE);
+      return;
+    }
+  dev->state = FLEET_CONNECTING;
+}
+
+/* A kept socket failed before any reply: the device closed it since the
+   last command, so connect afresh and send again */
+static void
+FleetRetry (FleetDevice *dev, U64FleetResult *res)
+{
+  U64_DEBUG ("Fleet %s: kept connection was closed, reconnecting",
+             (char *)dev->conn->host);
+  U64_SockClose (dev->sock);
+  FleetConnect (dev, res);
+}
+
+/* Pick up the device's own error message from a parsed reply - runners
+   and mounts report theirs in a 200 reply - and end the request */
+static void
+FleetFinish (FleetDevice *dev, U64FleetResult *res, LONG result, BOOL keep)
+{
+  U64ErrorArray errors;
+
+  if (dev->req.response && strchr ((char *)dev->req.response, '{'))
+    {
+      memset (&errors, 0, sizeof (errors));
+      if (U64_ParseErrorArray (dev->req.response, &errors) == U64_OK
+          && errors.error_count > 0)
+        {
+          if (result == U64_OK)
+            {
+              result = U64_ERR_GENERAL;
+            }
+          if (errors.errors[0])
+            {
+              strncpy (res->message, (char *)errors.errors[0],
+                       sizeof (res->message) - 1);
+              res->message[sizeof (res->message) - 1] = '\0';
+            }
+        }
+      U64_FreeErrorArray (&errors);
+    }
+
+  FleetEnd (dev, res, result, keep);
+}
+
+/* Set up dev's request and start it on the kept socket or a new one */
+static void
+FleetBegin (FleetDevice *dev, U64FleetResult *res, CONST HttpRequest *proto)
+{
+  dev->req = *proto;
+  dev->req.flags = HTTP_BORROW_RESPONSE | HTTP_KEEP_ALIVE;
+  res->result = U64_ERR_NETWORK;
+  res->status_code = 0;
+  res->time_ms = 0;
+  res->message[0] = '\0';
+  dev->header = NULL;
+  dev->header_len = 0;
+  dev->reply = NULL;
+  dev->received = 0;
+
+  U64_StatsBegin (&dev->sample);
+  dev->mark = U64_ArenaGetMark (dev->conn);
+
+  /* A replayed trace answers straight away, without a socket */
+  if (FleetReplaying (dev))
+    {
+      FleetFinish (dev, res, U64_TraceReplayRequest (dev->conn, &dev->req),
+                   FALSE);
+      return;
+    }
+
+  /* The reply buffer is allocated last so U64_ArenaGrow can extend it */
+  dev->header = U64_ArenaAlloc (dev->conn, HTTP_HEADER_SIZE);
+  dev->reply_size = FLEET_REPLY_SIZE;
+  dev->reply = U64_ArenaAlloc (dev->conn, dev->reply_size);
+  if (!dev->header || !dev->reply)
+    {
+      FleetEnd (dev, res, U64_ERR_MEMORY, dev->sock >= 0);
+      return;
+    }
+  dev->header_len = U64_HttpFormatHeader (dev->conn, &dev->req, dev->header,
+                                          HTTP_HEADER_SIZE);
+
+  if (dev->sock >= 0)
+    {
+      dev->reused = TRUE;
+      dev->sent = 0;
+      dev->received = 0;
+      dev->headers_end = 0;
+      dev->content_length = -1;
+      dev->sample.connect_ms = 0;
+      dev->state = FLEET_SENDING;
+    }
+  else
+    {
+      FleetConnect (dev, res);
+    }
+}
+
+/* The whole reply is in: parse it and finish the request */
+static void
+FleetReply (FleetDevice *dev, U64FleetResult *res, BOOL keep)
+{
+  BOOL borrowed = FALSE;
+  LONG result;
+
+  /* A device that says it will close gets a fresh socket next time */
+  if (keep)
+    {
+      char save = dev->reply[dev->headers_end];
+
+      dev->reply[dev->headers_end] = '\0';
+      if (strstr (dev->reply, "Connection: close")
+          || strstr (dev->reply, "connection: close"))
+        {
+          keep = FALSE;
+        }
+      dev->reply[dev->headers_end] = save;
+    }
+
+  result = U64_HttpParseResponse (&dev->req, dev->reply, dev->received,
+                                  &borrowed);
+  FleetFinish (dev, res, result, keep);
+}
+
+/* Send as much of the header and body as the socket takes */
+static void
+FleetSend (FleetDevice *dev, U64FleetResult *res)
+{
+  ULONG total = dev->header_len + dev->req.body_size;
+
+  while (dev->sent < total)
+    {
+      CONST UBYTE *from;
+      ULONG length;
+      LONG chunk;
+
+      if (dev->sent < dev->header_len)
+        {
+          from = (CONST UBYTE *)dev->header + dev->sent;
+          length = dev->header_len - dev->sent;
+        }
+      else
+        {
+          from = dev->req.body + (dev->sent - dev->header_len);
+          length = total - dev->sent;
+        }
+
+      chunk = U64_SockSend (dev->sock, from, length);
+      if (chunk == 0)
+        {
+          return; /* full, wait until there is room */
+        }
+      if (chunk < 0)
+        {
+          U64_DEBUG ("Fleet %s: send failed: errno=%ld",
+                     (char *)dev->conn->host, (long)U64_SockError ());
+          if (dev->reused)
+            {
+              FleetRetry (dev, res);
+            }
+          else
+            {
+              FleetEnd (dev, res, U64_ERR_NETWORK, FALSE);
+            }
+          return;
+        }
+      dev->sent += (ULONG)chunk;
+      dev->sample.bytes_sent += (ULONG)chunk;
+    }
+
+  dev->state = FLEET_RECEIVING;
+}
+
+/* Read what has arrived and finish once the reply is complete */
+static void
+FleetReceive (FleetDevice *dev, U64FleetResult *res)
+{
+  LONG got;
+
+  if (dev->received + FLEET_READ_CHUNK + 1 > dev->reply_size)
+    {
+      char *grown = NULL;
+
+      if (dev->reply_size < FLEET_REPLY_MAX)
+        {
+          grown = U64_ArenaGrow (dev->conn, dev->reply, dev->reply_size,
+                                 dev->reply_size * 2);
+        }
+      if (!grown)
+        {
+          FleetEnd (dev, res, U64_ERR_MEMORY, FALSE);
+          return;
+        }
+      dev->reply = grown;
+      dev->reply_size *= 2;
+    }
+
+  got = U64_SockRecv (dev->sock, dev->reply + dev->received,
+                      dev->reply_size - dev->received - 1);
+  if (got < 0 && U64_SockWouldBlock ())
+    {
+      return;
+    }
+  if (got <= 0)
+    {
+      if (dev->received == 0 && dev->reused)
+        {
+          FleetRetry (dev, res);
+        }
+      else if (got == 0 && dev->received > 0)
+        {
+          /* Closed after a reply without Content-Length */
+          FleetReply (dev, res, FALSE);
+        }
+      else
+        {
+          FleetEnd (dev, res, U64_ERR_NETWORK, FALSE);
+        }
+      return;
+    }
+
+  if (dev->received == 0)
+    {
+      dev->sample.first_byte_ms = U64_StatsSince (&dev->sample);
+    }
+  dev->sample.bytes_received += (ULONG)got;
+  dev->received += (ULONG)got;
+  dev->reply[dev->received] = '\0';
+
+  if (U64_HttpReplyComplete (dev->reply, dev->received, &dev->headers_end,
+                             &dev->content_length))
+    {
+      FleetReply (dev, res, TRUE);
+    }
+}
+
+/* Run one command on every device of the fleet */
+LONG
+U64_FleetExec (U64Fleet *fleet, U64FleetCommand command,
+               CONST U64FleetPayload *payload, ULONG timeout_s)
+{
+  U64SockPoll polls[U64_FLEET_MAX_HOSTS];
+  U64StatsSample clock;
+  HttpRequest proto;
+  char path[512];
+  char content_type[128];
+  UBYTE *form = NULL;
+  ULONG form_size = 0;
+  ULONG limit_ms = timeout_s * 1000;
+  ULONG i, active, elapsed;
+  LONG result;
+
+  if (!fleet)
+    {
+      return U64_ERR_INVALID;
+    }
+  if (!U64_SockReady () && !FleetReplaying (&fleet->devices[0]))
+    {
+      return U64_ERR_NETWORK;
+    }
+
+  result = FleetBuildRequest (fleet, command, payload, &proto, path,
+                              content_type, &form, &form_size);
+  if (result != U64_OK)
+    {
+      return result;
+    }
+
+  U64_DEBUG ("=== Fleet %s %s on %lu devices ===", fleet_methods[proto.method],
+             path, (unsigned long)fleet->count);
+
+  U64_StatsBegin (&clock);
+  for (i = 0; i < fleet->count; i++)
+    {
+      FleetBegin (&fleet->devices[i], &fleet->results[i], &proto);
+    }
+
+  for (;;)
+    {
+      LONG ready;
+
+      active = 0;
+      for (i = 0; i < fleet->count; i++)
+        {
+          FleetDevice *dev = &fleet->devices[i];
+
+          polls[i].sock = dev->sock;
+          polls[i].events = 0;
+          if (dev->state != FLEET_DONE)
+            {
+              polls[i].events = dev->state == FLEET_RECEIVING
+                                    ? U64_SOCK_READ
+                                    : U64_SOCK_WRITE;
+              active++;
+            }
+        }
+      if (active == 0)
+        {
+          break;
+        }
+
+      elapsed = U64_StatsSince (&clock);
+      ready = elapsed < limit_ms
+                  ? U64_SockWaitMany (polls, fleet->count, limit_ms - elapsed)
+                  : 0;
+      if (ready <= 0)
+        {
+          /* Out of time (or the wait itself failed): whoever hasn't
+             answered by now is given up on */
+          for (i = 0; i < fleet->count; i++)
+            {
+              if (fleet->devices[i].state != FLEET_DONE)
+                {
+                  FleetEnd (&fleet->devices[i], &fleet->results[i],
+                            ready == 0 ? U64_ERR_TIMEOUT : U64_ERR_NETWORK,
+                            FALSE);
+                }
+            }
+          break;
+        }
+
+      for (i = 0; i < fleet->count; i++)
+        {
+          FleetDevice *dev = &fleet->devices[i];
+          U64FleetResult *res = &fleet->results[i];
+
+          if (!polls[i].ready || dev->state == FLEET_DONE)
+            {
+              continue;
+            }
+          if (dev->state == FLEET_CONNECTING)
+            {
+              if (U64_SockFinish (dev->sock) != U64_OK)
+                {
+                  U64_DEBUG ("Fleet %s: connect failed",
+                             (char *)dev->conn->host);
+                  FleetEnd (dev, res, U64_ERR_NETWORK, FALSE);
+                  continue;
+                }
+              dev->sample.connect_ms = U64_StatsSince (&dev->sample);
+              dev->state = FLEET_SENDING;
+            }
+          if (dev->state == FLEET_SENDING)
+            {
+              FleetSend (dev, res);
+            }
+          else if (dev->state == FLEET_RECEIVING)
+            {
+              FleetReceive (dev, res);
+            }
+        }
+    }
+
+  if (form)
+    {
+      FreeMem (form, form_size + 1);
+    }
+
+  result = U64_OK;
+  for (i = 0; i < fleet->count; i++)
+    {
+      if (fleet->results[i].result != U64_OK)
+        {
+          result = U64_ERR_GENERAL;
+        }
+    }
+
+  U64_DEBUG ("=== Fleet done in %lu ms: result=%ld ===",
+             (unsigned long)U64_StatsSince (&clock), result);
+  return result;
+}
@@ -7,11 +7,6 @@
 #include <proto/dos.h>
 #include <proto/exec.h>
 
-/* For non-blocking connect: IoctlSocket/FIONBIO live in sys/ioctl.h,
- * and EINPROGRESS/EWOULDBLOCK in sys/errno.h (bsdsocket.library). */
-#include <sys/ioctl.h>
-#include <sys/errno.h>
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -115,24 +110,200 @@ U64_BuildHttpRequest (U64Connection *conn, HttpRequest *req)
   return header;
 }
 
+/* Fill in req's status code and response from a raw reply (status line,
+   headers, body) of total_size bytes followed by a NUL, and map the status
+   to a result. A borrowed response is left pointing into response_buffer
+   and *borrowed set. Shared by the socket path and trace replay. */
+LONG
+U64_HttpParseResponse (HttpRequest *req, char *response_buffer,
+                       ULONG total_size, BOOL *borrowed)
+{
+  char *json_start;
+
+  /* Parse HTTP status line */
+  char *status_line = response_buffer;
+  char *line_end = strstr (status_line, "\r\n");
+  if (line_end)
+    {
+      *line_end = '\0';
+      U64_DEBUG ("Status line: %s", status_line);
+
+      /* Parse status code */
+      if (strncmp (status_line, "HTTP/", 5) == 0)
+        {
+          char *space = strchr (status_line, ' ');
+          if (space)
+            {
+              req->status_code = atoi (space + 1);
+              U64_DEBUG ("HTTP Status: %d", req->status_code);
+            }
+        }
+      *line_end = '\r'; /* Restore for JSON parsing */
+    }
+
+  /* Find start of JSON content */
+  json_start = strstr (response_buffer, "\r\n\r\n");
+  if (json_start)
+    {
+      json_start += 4;
+      U64_DEBUG ("Found JSON content");
+    }
+  else
+    {
+      U64_DEBUG ("Could not find JSON content, using entire response");
+      json_start = response_buffer;
+    }
+
+  /* Hand over the body: in place when the caller borrows it, otherwise
+     as its own copy. Its length is what arrived, so binary bodies (readmem)
+     survive NUL bytes. */
+  size_t json_len = total_size - (size_t)(json_start - response_buffer);
+  if (json_len > 0)
+    {
+      if (req->flags & HTTP_BORROW_RESPONSE)
+        {
+          req->response = json_start;
+          req->response_size = json_len;
+          *borrowed = TRUE;
+        }
+      else
+        {
+          req->response = AllocMem (json_len + 1, MEMF_PUBLIC);
+          if (!req->response)
+            {
+              U64_DEBUG ("Failed to allocate final response buffer");
+              return U64_ERR_MEMORY;
+            }
+          CopyMem (json_start, req->response, json_len + 1);
+          req->response_size = json_len;
+        }
+      U64_DEBUG ("Response prepared: %lu bytes", (unsigned long)json_len);
+    }
+
+  /* Determine result based on status code */
+  if (req->status_code >= 200 && req->status_code < 300)
+    {
+      return U64_OK;
+    }
+  switch (req->status_code)
+    {
+    case 400:
+      return U64_ERR_INVALID;
+    case 403:
+      return U64_ERR_ACCESS;
+    case 404:
+      return U64_ERR_NOTFOUND;
+    case 500:
+    case 501:
+      return U64_ERR_NOTIMPL;
+    case 504:
+      return U64_ERR_TIMEOUT;
+    default:
+      return U64_ERR_GENERAL;
+    }
+}
+
+/* Write req's request line and headers for conn, including the blank line
+   that ends them, into header (size bytes). Returns their length. */
+ULONG
+U64_HttpFormatHeader (U64Connection *conn, HttpRequest *req, char *header,
+                      ULONG size)
+{
+  int len;
+
+  len = snprintf (header, size,
+                  "%s %s HTTP/1.1\r\n"
+                  "Host: %s:%d\r\n"
+                  "User-Agent: Ultimate64-Amiga/1.0\r\n"
+                  "Accept: */*\r\n"
+                  "Connection: %s\r\n",
+                  http_methods[req->method],
+                  req->path ? (char *)req->path : "/", (char *)conn->host,
+                  conn->port,
+                  (req->flags & HTTP_KEEP_ALIVE) ? "keep-alive" : "close");
+
+  /* Add Content-Type if provided */
+  if (req->content_type)
+    {
+      len += snprintf (header + len, size - len, "Content-Type: %s\r\n",
+                       (char *)req->content_type);
+    }
+
+  /* Add Content-Length for POST/PUT */
+  if (req->method == HTTP_POST || req->method == HTTP_PUT)
+    {
+      len += snprintf (header + len, size - len, "Content-Length: %lu\r\n",
+                       (unsigned long)req->body_size);
+    }
+
+  /* Add password header if needed */
+  if (conn->password)
+    {
+      len += snprintf (header + len, size - len, "X-password: %s\r\n",
+                       (char *)conn->password);
+    }
+
+  /* End of headers */
+  len += snprintf (header + len, size - len, "\r\n");
+  return (ULONG)len;
+}
+
+/* TRUE once the NUL-terminated reply in buffer holds the whole body its
+   Content-Length announces. *headers_end and *content_length keep what
+   was found between calls; start them at 0 and -1. */
+BOOL
+U64_HttpReplyComplete (char *buffer, ULONG total_size, ULONG *headers_end,
+                       LONG *content_length)
+{
+  /* Once the headers have fully arrived, pick up Content-Length */
+  if (*headers_end == 0)
+    {
+      char *eoh = strstr (buffer, "\r\n\r\n");
+      if (eoh)
+        {
+          *headers_end = (ULONG)(eoh - buffer) + 4;
+          /* Save and restore the byte at eoh so case-insensitive
+           * strstr on "Content-Length:" stays inside headers. */
+          char save = buffer[*headers_end];
+          buffer[*headers_end] = '\0';
+          char *cl = strstr (buffer, "Content-Length:");
+          if (!cl) cl = strstr (buffer, "content-length:");
+          if (cl)
+            {
+              cl += 15;     /* length of "Content-Length:" */
+              while (*cl == ' ' || *cl == '\t') cl++;
+              *content_length = atol (cl);
+              U64_DEBUG ("Content-Length: %ld", *content_length);
+            }
+          buffer[*headers_end] = save;
+        }
+    }
+  return *headers_end > 0 && *content_length >= 0
+         && total_size >= *headers_end + (ULONG)*content_length;
+}
+
 /* U64_HttpRequest function */
 LONG
 U64_HttpRequest (U64Connection *conn, HttpRequest *req)
 {
-#ifdef USE_BSDSOCKET
-  int sockfd = -1;
+  /* A replayed trace stands in for the network entirely */
+  if (conn && req && conn->trace && conn->trace->mode == U64_TRACE_REPLAY)
+    {
+      return U64_TraceReplayRequest (conn, req);
+    }
+
+  LONG sockfd = -1;
   char *response_buffer = NULL;
-  char *chunk_buffer = NULL;
   char *new_buffer = NULL;
+  U64ArenaMark arena_mark;
+  BOOL keep_arena = FALSE;
+  U64StatsSample sample;
   LONG result = U64_ERR_GENERAL;
-  struct sockaddr_in server_addr;
-  struct hostent *server = NULL;
   char request_header[1024];
-  BOOL dns_ok = FALSE;
+  int header_len = 0;
   size_t buffer_size = INITIAL_BUFFER_SIZE;
   size_t total_size = 0;
   int bytes_received;
-  char *json_start;
   int retry_count = 0;
   /* Ultimate64 keeps its HTTP socket open after responding (keep-alive),
    * so recv() never returns 0. We used to wait MAX_RETRIES * 30s for
@@ -144,8 +315,7 @@ U64_HttpRequest (U64Connection *conn, HttpRequest *req)
   int chunk_count = 0;
   LONG content_length = -1;   /* -1 = unknown, else stop after this many body bytes */
   ULONG headers_end = 0;      /* offset of \r\n\r\n in response_buffer */
-  extern struct Library *SocketBase;
-  extern int errno_storage;
+  ULONG connect_s, io_s;
 
   if (!conn || !req)
     {
@@ -163,195 +333,62 @@ U64_HttpRequest (U64Connection *conn, HttpRequest *req)
   req->response_size = 0;
   req->status_code = 0;
 
-  /* Check if socket library is available */
-  if (!SocketBase)
-    {
-      U64_DEBUG ("Socket library not initialized");
-      return U64_ERR_NETWORK;
-    }
-
-  /* Create socket first */
-  sockfd = socket (AF_INET, SOCK_STREAM, 0);
-  if (sockfd < 0)
-    {
-      U64_DEBUG ("Failed to create socket: errno=%d", errno_storage);
-      return U64_ERR_NETWORK;
-    }
-
-  U64_DEBUG ("Socket created: %d", sockfd);
+  connect_s = conn->connect_timeout ? conn->connect_timeout : 10;
+  io_s = conn->io_timeout ? conn->io_timeout : 30;
 
-  /* Set socket options BEFORE connect - CRITICAL */
-  struct timeval timeout;
-  timeout.tv_sec = 30;
-  timeout.tv_usec = 0;
+  U64_StatsBegin (&sample);
+  arena_mark = U64_ArenaGetMark (conn);
 
-  if (setsockopt (sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout))
-      < 0)
-    {
-      U64_DEBUG ("Failed to set receive timeout");
-    }
-  if (setsockopt (sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout))
-      < 0)
+  /* Check if a socket stack is available */
+  if (!U64_SockReady ())
     {
-      U64_DEBUG ("Failed to set send timeout");
-    }
-
-  /* Allocate buffers */
-  chunk_buffer = AllocMem (READ_CHUNK_SIZE, MEMF_PUBLIC);
-  response_buffer = AllocMem (buffer_size, MEMF_PUBLIC | MEMF_CLEAR);
-
-  if (!chunk_buffer || !response_buffer)
-    {
-      /* Try with smaller buffer if allocation failed */
-      if (!response_buffer && buffer_size > 1024)
-        {
-          if (response_buffer)
-            FreeMem (response_buffer, buffer_size);
-          buffer_size = 1024;
-          response_buffer = AllocMem (buffer_size, MEMF_PUBLIC | MEMF_CLEAR);
-        }
-
-      if (!chunk_buffer || !response_buffer)
-        {
-          U64_DEBUG ("Failed to allocate buffers");
-          result = U64_ERR_MEMORY;
-          goto cleanup;
-        }
+      U64_DEBUG ("Socket library not initialized");
+      result = U64_ERR_NETWORK;
+      goto cleanup;
     }
 
-  U64_DEBUG ("Buffers allocated: chunk=%p (%d), response=%p (%lu)",
-             chunk_buffer, READ_CHUNK_SIZE, response_buffer,
-             (unsigned long)buffer_size);
-
-  /* DNS resolution with protection - PROVEN WORKING METHOD */
-  U64_DEBUG ("Starting DNS resolution for: %s", (char *)conn->host);
-
-  Forbid ();
-  if (conn && conn->host)
+  /* The response is received straight into a buffer from the connection
+     arena; everything taken from it here is given back on the way out
+     unless the caller borrows the response. */
+  response_buffer = U64_ArenaAlloc (conn, buffer_size);
+  if (!response_buffer)
     {
-      server = gethostbyname ((char *)conn->host);
-      if (server && server->h_addr)
-        {
-          dns_ok = TRUE;
-          U64_DEBUG ("DNS resolution successful");
-        }
+      U64_DEBUG ("Failed to allocate response buffer");
+      result = U64_ERR_MEMORY;
+      goto cleanup;
     }
-  Permit ();
+  response_buffer[0] = '\0';
 
-  if (!dns_ok || !server)
+  /* Connect within 10s; a blocking connect() on an unreachable Ultimate
+   * (wrong IP, device off) would stall the GUI for the stack's default
+   * of minutes. Sends and receives time out after 30s. Callers polling
+   * from the GUI shorten both with U64_SetTimeouts. */
+  U64_DEBUG ("Connecting to server...");
+  sockfd = U64_SockConnect (conn->host, conn->port, connect_s, io_s);
+  if (sockfd < 0)
     {
-      U64_DEBUG ("DNS lookup failed for: %s", (char *)conn->host);
       result = U64_ERR_NETWORK;
       goto cleanup;
     }
 
-  /* Setup server address */
-  memset (&server_addr, 0, sizeof (server_addr));
-  server_addr.sin_family = AF_INET;
-  CopyMem (server->h_addr, &server_addr.sin_addr.s_addr, server->h_length);
-  server_addr.sin_port = htons (conn->port);
-
-  U64_DEBUG ("Connecting to server...");
-  /* Non-blocking connect with 10s bound — blocking connect() on an
-   * unreachable Ultimate (wrong IP, device off) stalls the GUI for
-   * the OS-level default minutes. */
-  {
-    LONG nb = 1;
-    IoctlSocket (sockfd, FIONBIO, (char *)&nb);
-    int crc = connect (sockfd,
-                       (struct sockaddr *)&server_addr,
-                       sizeof (server_addr));
-    if (crc < 0 && Errno () != EINPROGRESS && Errno () != EWOULDBLOCK)
-      {
-        U64_DEBUG ("Failed to connect: errno=%d", errno_storage);
-        result = U64_ERR_NETWORK; goto cleanup;
-      }
-    if (crc < 0)
-      {
-        struct timeval ct = { 10, 0 };
-        ULONG wmask = 1L << sockfd;
-        int ready = WaitSelect (sockfd + 1, NULL, &wmask, NULL, &ct, NULL);
-        if (ready <= 0) { result = U64_ERR_NETWORK; goto cleanup; }
-        LONG so_err = 0;
-        LONG slen = sizeof (so_err);
-        if (getsockopt (sockfd, SOL_SOCKET, SO_ERROR, &so_err, &slen) < 0
-            || so_err != 0)
-          { result = U64_ERR_NETWORK; goto cleanup; }
-      }
-    nb = 0;
-    IoctlSocket (sockfd, FIONBIO, (char *)&nb);
-  }
-
   U64_DEBUG ("Connected successfully");
+  sample.connect_ms = U64_StatsSince (&sample);
 
   /* Build HTTP request header */
-  int header_len = snprintf (request_header, sizeof (request_header),
-                             "%s %s HTTP/1.1\r\n"
-                             "Host: %s:%d\r\n"
-                             "User-Agent: Ultimate64-Amiga/1.0\r\n"
-                             "Accept: */*\r\n"
-                             "Connection: close\r\n",
-                             http_methods[req->method],
-                             req->path ? (char *)req->path : "/",
-                             (char *)conn->host, conn->port);
-
-  /* Add Content-Type if provided */
-  if (req->content_type)
-    {
-      header_len += snprintf (
-          request_header + header_len, sizeof (request_header) - header_len,
-          "Content-Type: %s\r\n", (char *)req->content_type);
-    }
+  header_len = U64_HttpFormatHeader (conn, req, request_header,
+                                     sizeof (request_header));
 
-  /* Add Content-Length for POST/PUT */
-  if (req->method == HTTP_POST || req->method == HTTP_PUT)
-    {
-      header_len += snprintf (
-          request_header + header_len, sizeof (request_header) - header_len,
-          "Content-Length: %lu\r\n", (unsigned long)req->body_size);
-    }
+  U64_DEBUG ("Sending HTTP header (%d bytes)...", header_len);
 
-  /* Add password header if needed */
-  if (conn->password)
+  if (U64_SockSendAll (sockfd, request_header, header_len,
+                       io_s < 10 ? io_s : 10, &sample.bytes_sent)
+      != U64_OK)
     {
-      header_len += snprintf (request_header + header_len,
-                              sizeof (request_header) - header_len,
-                              "X-password: %s\r\n", (char *)conn->password);
+      U64_DEBUG ("Failed to send header: errno=%ld", (long)U64_SockError ());
+      result = U64_ERR_NETWORK;
+      goto cleanup;
     }
 
-  /* End of headers */
-  strcat (request_header, "\r\n");
-  header_len += 2;
-
-  U64_DEBUG ("Sending HTTP header (%d bytes)...", header_len);
-
-  /* Send header (loop — headers are small but we use the same pattern
-   * as the body send for safety). */
-  {
-    int hdr_sent = 0;
-    while (hdr_sent < header_len)
-      {
-        int chunk = send (sockfd, request_header + hdr_sent,
-                          header_len - hdr_sent, 0);
-        if (chunk < 0)
-          {
-            if (Errno () == EAGAIN || Errno () == EWOULDBLOCK)
-              {
-                struct timeval wt = { 10, 0 };
-                ULONG wmask = 1L << sockfd;
-                if (WaitSelect (sockfd + 1, NULL, &wmask, NULL, &wt,
-                                NULL) <= 0)
-                  { result = U64_ERR_NETWORK; goto cleanup; }
-                continue;
-              }
-            U64_DEBUG ("Failed to send header: errno=%d", errno_storage);
-            result = U64_ERR_NETWORK; goto cleanup;
-          }
-        if (chunk == 0) { result = U64_ERR_NETWORK; goto cleanup; }
-        hdr_sent += chunk;
-      }
-  }
-
   U64_DEBUG ("Header sent successfully");
 
   /* Send body if present. A single send() on a ~170KB .d64 upload
@@ -360,53 +397,19 @@ U64_HttpRequest (U64Connection *conn, HttpRequest *req)
    * any non-negative return as a complete send — so the Ultimate got
    * a truncated multipart body, waited forever for more bytes, and
    * our recv() then waited forever for a response that never came.
-   * This matched the user's "mount stuck AND Ultimate hangs" report.
-   * Fix: loop until all body bytes are flushed, yielding to
-   * WaitSelect on EAGAIN/EWOULDBLOCK. */
+   * U64_SockSendAll loops until every byte is flushed, waiting up to
+   * 30s for room each time the socket is full. */
   if (req->body && req->body_size > 0)
     {
       U64_DEBUG ("Sending HTTP body (%lu bytes)...",
                  (unsigned long)req->body_size);
 
-      ULONG body_sent = 0;
-      UBYTE *body_ptr = (UBYTE *)req->body;
-      while (body_sent < req->body_size)
+      if (U64_SockSendAll (sockfd, req->body, req->body_size, io_s,
+                           &sample.bytes_sent)
+          != U64_OK)
         {
-          int chunk = send (sockfd, body_ptr + body_sent,
-                            req->body_size - body_sent, 0);
-          if (chunk < 0)
-            {
-              if (Errno () == EAGAIN || Errno () == EWOULDBLOCK)
-                {
-                  /* Socket full; wait up to 30s for room. */
-                  struct timeval wt = { 30, 0 };
-                  ULONG wmask = 1L << sockfd;
-                  if (WaitSelect (sockfd + 1, NULL, &wmask, NULL, &wt,
-                                  NULL) <= 0)
-                    {
-                      U64_DEBUG ("send timeout at %lu / %lu",
-                                 (unsigned long)body_sent,
-                                 (unsigned long)req->body_size);
-                      result = U64_ERR_NETWORK; goto cleanup;
-                    }
-                  continue;
-                }
-              U64_DEBUG ("Failed to send body at %lu/%lu: errno=%d",
-                         (unsigned long)body_sent,
-                         (unsigned long)req->body_size, errno_storage);
-              result = U64_ERR_NETWORK;
-              goto cleanup;
-            }
-          if (chunk == 0)
-            {
-              /* Peer closed the socket mid-upload. */
-              U64_DEBUG ("send returned 0 at %lu/%lu (peer closed)",
-                         (unsigned long)body_sent,
-                         (unsigned long)req->body_size);
-              result = U64_ERR_NETWORK;
-              goto cleanup;
-            }
-          body_sent += (ULONG)chunk;
+          result = U64_ERR_NETWORK;
+          goto cleanup;
         }
       U64_DEBUG ("Body fully sent (%lu bytes)",
                  (unsigned long)req->body_size);
@@ -417,18 +420,10 @@ U64_HttpRequest (U64Connection *conn, HttpRequest *req)
 
   while (chunk_count < 20000) /* Prevent infinite loops */
     {
-      struct timeval select_timeout;
-      ULONG read_mask;
-
-      select_timeout.tv_sec = 30;
-      select_timeout.tv_usec = 0;
-      read_mask = 1L << sockfd;
-
-      int ready = WaitSelect (sockfd + 1, &read_mask, NULL, NULL,
-                              &select_timeout, NULL);
+      LONG ready = U64_SockWait (sockfd, U64_SOCK_READ, io_s);
       if (ready < 0)
         {
-          U64_DEBUG ("WaitSelect error");
+          U64_DEBUG ("Wait error");
           break;
         }
       if (ready == 0)
@@ -443,104 +438,72 @@ U64_HttpRequest (U64Connection *conn, HttpRequest *req)
           continue;
         }
 
-      if (read_mask & (1L << sockfd))
+      /* Make room for a full chunk plus the terminator first */
+      if (total_size + READ_CHUNK_SIZE + 1 > buffer_size)
         {
-          bytes_received = recv (sockfd, chunk_buffer, READ_CHUNK_SIZE - 1, 0);
-          if (bytes_received < 0)
+          size_t new_size = buffer_size * 2;
+          if (new_size > MAX_BUFFER_SIZE)
             {
-              U64_DEBUG ("Error receiving data: errno=%d", errno_storage);
-              break;
-            }
-          if (bytes_received == 0)
-            {
-              U64_DEBUG ("Connection closed by server");
-              break;
+              U64_DEBUG ("Response too large, truncating at %lu bytes",
+                         (unsigned long)buffer_size);
+              if (total_size + 1 >= buffer_size)
+                break;
             }
-
-          chunk_count++;
-        U64_DEBUG("Chunk %d: received %d bytes, total now %lu, buffer size %lu", 
-                  chunk_count, bytes_received, 
-                  (unsigned long)(total_size + bytes_received), 
-                  (unsigned long)buffer_size);
-
-
-          /* Check if buffer needs to grow */
-          if (total_size + bytes_received + 1 > buffer_size)
+          else
             {
-              size_t new_size = buffer_size * 2;
-              if (new_size > MAX_BUFFER_SIZE)
+              new_buffer = U64_ArenaGrow (conn, response_buffer,
+                                          buffer_size, new_size);
+              if (!new_buffer)
                 {
-                  U64_DEBUG ("Response too large, truncating at %lu bytes",
-                             (unsigned long)buffer_size);
-                  bytes_received = buffer_size - total_size - 1;
-                  if (bytes_received <= 0)
-                    break;
-                }
-              else
-                {
-                  U64_DEBUG ("Growing buffer from %lu to %lu bytes",
-                             (unsigned long)buffer_size,
-                             (unsigned long)new_size);
-
-                  new_buffer = AllocMem (new_size, MEMF_PUBLIC | MEMF_CLEAR);
-                  if (!new_buffer)
-                    {
-                      U64_DEBUG ("Failed to grow response buffer");
-                      break;
-                    }
-
-                  /* Copy existing data */
-                  if (total_size > 0)
-                    {
-                      CopyMem (response_buffer, new_buffer, total_size);
-                    }
-
-                  /* Free old buffer and use new one */
-                  FreeMem (response_buffer, buffer_size);
-                  response_buffer = new_buffer;
-                  buffer_size = new_size;
+                  U64_DEBUG ("Failed to grow response buffer");
+                  break;
                 }
+              response_buffer = new_buffer;
+              buffer_size = new_size;
             }
+        }
 
-          CopyMem (chunk_buffer, response_buffer + total_size, bytes_received);
-          total_size += bytes_received;
-          response_buffer[total_size] = '\0';
-
-          retry_count = 0; /* Reset retry count on successful receive */
+      size_t room = buffer_size - total_size - 1;
+      bytes_received = U64_SockRecv (sockfd, response_buffer + total_size,
+                                     room < READ_CHUNK_SIZE
+                                         ? room
+                                         : READ_CHUNK_SIZE);
+      if (bytes_received < 0)
+        {
+          U64_DEBUG ("Error receiving data: errno=%ld",
+                     (long)U64_SockError ());
+          break;
+        }
+      if (bytes_received == 0)
+        {
+          U64_DEBUG ("Connection closed by server");
+          break;
+        }
 
-          /* Once the headers have fully arrived, pick up Content-Length
-           * so we can stop reading exactly when the body is complete.
-           * Ultimate64 keeps the TCP connection open (keep-alive), so
-           * without this we'd WaitSelect until timeout. */
-          if (headers_end == 0)
-            {
-              char *eoh = strstr (response_buffer, "\r\n\r\n");
-              if (eoh)
-                {
-                  headers_end = (ULONG)(eoh - response_buffer) + 4;
-                  /* Save and restore the byte at eoh so case-insensitive
-                   * strstr on "Content-Length:" stays inside headers. */
-                  char save = response_buffer[headers_end];
-                  response_buffer[headers_end] = '\0';
-                  char *cl = strstr (response_buffer, "Content-Length:");
-                  if (!cl) cl = strstr (response_buffer, "content-length:");
-                  if (cl)
-                    {
-                      cl += 15;     /* length of "Content-Length:" */
-                      while (*cl == ' ' || *cl == '\t') cl++;
-                      content_length = atol (cl);
-                      U64_DEBUG ("Content-Length: %ld", content_length);
-                    }
-                  response_buffer[headers_end] = save;
-                }
-            }
-          /* Early exit: body is complete per Content-Length. */
-          if (headers_end > 0 && content_length >= 0
-              && total_size >= headers_end + (ULONG)content_length)
-            {
-              U64_DEBUG ("Body complete (CL=%ld), breaking", content_length);
-              break;
-            }
+      if (chunk_count++ == 0)
+        {
+          sample.first_byte_ms = U64_StatsSince (&sample);
+        }
+      sample.bytes_received += bytes_received;
+      U64_DEBUG ("Chunk %d: received %d bytes, total now %lu, buffer size "
+                 "%lu",
+                 chunk_count, bytes_received,
+                 (unsigned long)(total_size + bytes_received),
+                 (unsigned long)buffer_size);
+
+      total_size += bytes_received;
+      response_buffer[total_size] = '\0';
+
+      retry_count = 0; /* Reset retry count on successful receive */
+
+      /* Stop as soon as the body is complete per Content-Length.
+       * Ultimate64 keeps the TCP connection open (keep-alive), so
+       * without this we'd wait until timeout. */
+      if (U64_HttpReplyComplete (response_buffer, total_size, &headers_end,
+                                 &content_length))
+        {
+          U64_DEBUG ("Body complete (CL=%ld), breaking", content_length);
+          break;
         }
     }
 
@@ -553,117 +516,36 @@ U64_HttpRequest (U64Connection *conn, HttpRequest *req)
 
   U64_DEBUG ("Total received: %lu bytes", (unsigned long)total_size);
 
-  /* Parse HTTP status line */
-  char *status_line = response_buffer;
-  char *line_end = strstr (status_line, "\r\n");
-  if (line_end)
-    {
-      *line_end = '\0';
-      U64_DEBUG ("Status line: %s", status_line);
-
-      /* Parse status code */
-      if (strncmp (status_line, "HTTP/", 5) == 0)
-        {
-          char *space = strchr (status_line, ' ');
-          if (space)
-            {
-              req->status_code = atoi (space + 1);
-              U64_DEBUG ("HTTP Status: %d", req->status_code);
-            }
-        }
-      *line_end = '\r'; /* Restore for JSON parsing */
-    }
-
-  /* Find start of JSON content */
-  json_start = strstr (response_buffer, "\r\n\r\n");
-  if (json_start)
-    {
-      json_start += 4;
-      U64_DEBUG ("Found JSON content");
-    }
-  else
-    {
-      U64_DEBUG ("Could not find JSON content, using entire response");
-      json_start = response_buffer;
-    }
-
-  /* Create final response */
-  size_t json_len = strlen (json_start);
-  if (json_len > 0)
-    {
-      req->response = AllocMem (json_len + 1, MEMF_PUBLIC);
-      if (req->response)
-        {
-          strcpy (req->response, json_start);
-          req->response_size = json_len;
-          U64_DEBUG ("Response prepared: %lu bytes", (unsigned long)json_len);
-        }
-      else
-        {
-          U64_DEBUG ("Failed to allocate final response buffer");
-          result = U64_ERR_MEMORY;
-          goto cleanup;
-        }
-    }
-
-  /* Determine result based on status code */
-  if (req->status_code >= 200 && req->status_code < 300)
-    {
-      result = U64_OK;
-    }
-  else
-    {
-      switch (req->status_code)
-        {
-        case 400:
-          result = U64_ERR_INVALID;
-          break;
-        case 403:
-          result = U64_ERR_ACCESS;
-          break;
-        case 404:
-          result = U64_ERR_NOTFOUND;
-          break;
-        case 500:
-        case 501:
-          result = U64_ERR_NOTIMPL;
-          break;
-        case 504:
-          result = U64_ERR_TIMEOUT;
-          break;
-        default:
-          result = U64_ERR_GENERAL;
-          break;
-        }
-    }
+  result = U64_HttpParseResponse (req, response_buffer, total_size,
+                                  &keep_arena);
 
 cleanup:
   /* Close socket */
   if (sockfd >= 0)
     {
       U64_DEBUG ("Closing socket");
-      CloseSocket (sockfd);
+      U64_SockClose (sockfd);
     }
 
-  /* Free buffers */
-  if (response_buffer)
+  if (conn->trace)
     {
-      FreeMem (response_buffer, buffer_size);
+      U64_TraceWrite (conn, req, request_header, header_len, response_buffer,
+                      total_size, &sample, result);
     }
-  if (chunk_buffer)
+
+  /* Give back the scratch buffers */
+  if (!keep_arena)
     {
-      FreeMem (chunk_buffer, READ_CHUNK_SIZE);
+      U64_ArenaRelease (conn, arena_mark);
     }
 
+  U64_StatsRecord (conn, (CONST_STRPTR)http_methods[req->method], req->path,
+                   &sample, result);
+
   U64_DEBUG ("=== HTTP Request Complete: result=%ld, status=%d ===", result,
              req->status_code);
 
   return result;
-
-#else /* !USE_BSDSOCKET */
-  U64_DEBUG ("Network not supported (USE_BSDSOCKET not defined)");
-  return U64_ERR_NOTIMPL;
-#endif
 }
 
 /* Also add this debug function to verify the request before sending */
@@ -731,7 +613,7 @@ U64_FreeURL (STRPTR url)
 }
 
 /* Generate random boundary for multipart form data */
-static void
+void
 U64_GenerateBoundary (STRPTR boundary, ULONG size)
 {
   static const char chars[]
@@ -753,8 +635,9 @@ U64_GenerateBoundary (STRPTR boundary, ULONG size)
   boundary[i] = '\0';
 }
 
-/* Build multipart form data */
-static UBYTE *
+/* Build multipart form data. The buffer is form_size + 1 bytes for
+   FreeMem. */
+UBYTE *
 U64_BuildMultipartForm (CONST_STRPTR boundary, CONST_STRPTR field_name,
                         CONST_STRPTR filename, CONST_STRPTR content_type,
                         CONST UBYTE *data, ULONG data_size,
@@ -937,11 +820,21 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
                           CONST_STRPTR extra_headers,
                           void (*progress_callback)(ULONG bytes, APTR userdata),
                           APTR userdata)
+{
+    return U64_DownloadToFileTee(url, local_filename, extra_headers, NULL,
+                                 progress_callback, userdata);
+}
+
+LONG U64_DownloadToFileTee(CONST_STRPTR url, CONST_STRPTR local_filename,
+                           CONST_STRPTR extra_headers,
+                           BOOL (*data_callback)(const UBYTE *data, ULONG length,
+                                                 APTR userdata),
+                           void (*progress_callback)(ULONG bytes, APTR userdata),
+                           APTR userdata)
 {
     /* Same defensive check as U64_HttpGetURL — no TCP stack, fail fast
      * rather than hanging on the first socket() call. */
-    extern struct Library *SocketBase;
-    if (!SocketBase) return U64_ERR_NETWORK;
+    if (!U64_SockReady()) return U64_ERR_NETWORK;
 
     LONG result = U64_ERR_GENERAL;
     BPTR file = 0;
@@ -953,7 +846,7 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
     char current_url[1024];
     
     /* Socket variables for manual streaming */
-    int sockfd = -1;
+    LONG sockfd = -1;
     char *chunk_buffer = NULL;
     char *header_buffer = NULL;
     BOOL headers_parsed = FALSE;
@@ -961,9 +854,12 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
     int status_code = 0;
     ULONG header_pos = 0;
     LONG content_length = -1;   /* -1 unknown; else stop reading after this many body bytes */
+    U64StatsSample sample;
 
     strncpy(current_url, url, sizeof(current_url) - 1);
     current_url[sizeof(current_url) - 1] = '\0';
+    hostname[0] = '\0';
+    U64_StatsBegin(&sample);
 
     U64_DEBUG("=== STREAMING DOWNLOAD START ===");
     
@@ -1000,67 +896,17 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
             strcpy(path, path_start);
         }
 
-        /* Manual socket connection for streaming */
-        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        /* Manual socket connection for streaming. The connect is
+         * bounded (see U64_HttpGetURL for the rationale — blocking
+         * connect() can hang the UI for minutes on AmigaOS emulation
+         * when the host is unreachable). */
+        sockfd = U64_SockConnect((CONST_STRPTR)hostname, 80, 10, 30);
         if (sockfd < 0) {
             result = U64_ERR_NETWORK;
             goto cleanup;
         }
-
-        /* Set timeouts */
-        struct timeval timeout;
-        timeout.tv_sec = 30;
-        timeout.tv_usec = 0;
-        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-        setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-
-        /* DNS and connect - using your proven method */
-        struct sockaddr_in server_addr;
-        struct hostent *server;
-        
-        Forbid();
-        server = gethostbyname(hostname);
-        Permit();
-        
-        if (!server) {
-            result = U64_ERR_NETWORK;
-            goto cleanup;
-        }
-
-        memset(&server_addr, 0, sizeof(server_addr));
-        server_addr.sin_family = AF_INET;
-        CopyMem(server->h_addr, &server_addr.sin_addr.s_addr, server->h_length);
-        server_addr.sin_port = htons(80);
-
-        /* Non-blocking connect with bounded wait (see U64_HttpGetURL
-         * for the rationale — blocking connect() can hang the UI for
-         * minutes on AmigaOS emulation when the host is unreachable). */
-        {
-            LONG nb = 1;
-            IoctlSocket(sockfd, FIONBIO, (char *)&nb);
-            int crc = connect(sockfd,
-                              (struct sockaddr *)&server_addr,
-                              sizeof(server_addr));
-            if (crc < 0 && Errno() != EINPROGRESS
-                        && Errno() != EWOULDBLOCK) {
-                result = U64_ERR_NETWORK; goto cleanup;
-            }
-            if (crc < 0) {
-                struct timeval ct = { 10, 0 };
-                ULONG wmask = 1L << sockfd;
-                int ready = WaitSelect(sockfd + 1, NULL, &wmask, NULL,
-                                       &ct, NULL);
-                if (ready <= 0) { result = U64_ERR_NETWORK; goto cleanup; }
-                LONG so_err = 0;
-                LONG slen = sizeof(so_err);
-                if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR,
-                               &so_err, &slen) < 0 || so_err != 0) {
-                    result = U64_ERR_NETWORK; goto cleanup;
-                }
-            }
-            nb = 0;
-            IoctlSocket(sockfd, FIONBIO, (char *)&nb);
-        }
+        if (sample.connect_ms == U64_STATS_NONE)
+            sample.connect_ms = U64_StatsSince(&sample);
 
         /* Send HTTP request. extra_headers, if present, is an already-formed
          * raw CRLF-terminated header block (e.g. "client-id: u64manager\r\n")
@@ -1077,7 +923,8 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
                           path, hostname,
                           extra_headers ? (char *)extra_headers : "");
 
-        if (send(sockfd, request, len, 0) < 0) {
+        if (U64_SockSendAll(sockfd, request, len, 30, &sample.bytes_sent)
+            != U64_OK) {
             result = U64_ERR_NETWORK;
             goto cleanup;
         }
@@ -1090,20 +937,13 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
 
         int chunk_count = 0;
         while (chunk_count < 10000) { 
-            struct timeval select_timeout;
-            ULONG read_mask;
-
-            select_timeout.tv_sec = 30; /* Longer timeout */
-            select_timeout.tv_usec = 0;
-            read_mask = 1L << sockfd;
-
-            int ready = WaitSelect(sockfd + 1, &read_mask, NULL, NULL, &select_timeout, NULL);
+            LONG ready = U64_SockWait(sockfd, U64_SOCK_READ, 30);
             if (ready <= 0) {
                 U64_DEBUG("Select timeout or error after %d chunks", chunk_count);
                 break;
             }
 
-            int bytes_received = recv(sockfd, chunk_buffer, READ_CHUNK_SIZE - 1, 0);
+            int bytes_received = U64_SockRecv(sockfd, chunk_buffer, READ_CHUNK_SIZE - 1);
             if (bytes_received <= 0) {
                 U64_DEBUG("Connection closed after receiving %lu bytes", (unsigned long)total_downloaded);
                 break;
@@ -1111,6 +951,9 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
 
             chunk_count++;
             chunk_buffer[bytes_received] = '\0';
+            if (sample.first_byte_ms == U64_STATS_NONE)
+                sample.first_byte_ms = U64_StatsSince(&sample);
+            sample.bytes_received += bytes_received;
 
             if (!headers_parsed) {
                 /* Still reading headers */
@@ -1144,7 +987,7 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
                                 if (end && ((size_t)(end - loc)) < sizeof(current_url) - 1) {
                                     CopyMem(loc, current_url, end - loc);
                                     current_url[end - loc] = '\0';
-                                    CloseSocket(sockfd);
+                                    U64_SockClose(sockfd);
                                     sockfd = -1;
                                     redirect_count++;
                                     U64_DEBUG("Redirecting to: %s", current_url);
@@ -1192,6 +1035,14 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
                         if (body_bytes > 0) {
                             Write(file, body_start, body_bytes);
                             total_downloaded += body_bytes;
+
+                            if (data_callback
+                                && !data_callback((const UBYTE *)body_start,
+                                                  (ULONG)body_bytes, userdata)) {
+                                U64_DEBUG("Download aborted by data callback");
+                                result = U64_ERR_GENERAL;
+                                goto cleanup;
+                            }
                             
                             /* Call progress callback for header body data */
                             if (progress_callback) {
@@ -1214,6 +1065,14 @@ LONG U64_DownloadToFileEx(CONST_STRPTR url, CONST_STRPTR local_filename,
                 }
 
                 total_downloaded += bytes_received;
+
+                if (data_callback
+                    && !data_callback((const UBYTE *)chunk_buffer,
+                                      (ULONG)bytes_received, userdata)) {
+                    U64_DEBUG("Download aborted by data callback");
+                    result = U64_ERR_GENERAL;
+                    goto cleanup;
+                }
                 
                 /* Call progress callback more frequently - every 10 chunks (~10KB) */
                 if (progress_callback && (chunk_count % 10 == 0)) {
@@ -1251,9 +1110,11 @@ next_redirect:
 
 cleanup:
     if (file) Close(file);
-    if (sockfd >= 0) CloseSocket(sockfd);
+    if (sockfd >= 0) U64_SockClose(sockfd);
     if (chunk_buffer) FreeMem(chunk_buffer, READ_CHUNK_SIZE);
     if (header_buffer) FreeMem(header_buffer, 4096);
+    U64_StatsRecord(NULL, (CONST_STRPTR)"GET", (CONST_STRPTR)hostname,
+                    &sample, result);
 
     U64_DEBUG("=== STREAMING DOWNLOAD END: %ld ===", result);
     return result;
@@ -1273,8 +1134,7 @@ LONG U64_HttpGetURL(CONST_STRPTR url, CONST_STRPTR extra_headers,
      * U64_ERR_NETWORK instead of a frozen UI. This is the single most
      * common failure mode on AmigaOS where the TCP stack (Roadshow /
      * AmiTCP / Miami) hasn't been started yet. */
-    extern struct Library *SocketBase;
-    if (!SocketBase) {
+    if (!U64_SockReady()) {
         if (out_buffer) *out_buffer = NULL;
         if (out_size)   *out_size = 0;
         if (out_status) *out_status = 0;
@@ -1289,7 +1149,7 @@ LONG U64_HttpGetURL(CONST_STRPTR url, CONST_STRPTR extra_headers,
     const int MAX_REDIRECTS = 5;
     char current_url[1024];
 
-    int sockfd = -1;
+    LONG sockfd = -1;
     char *chunk_buffer = NULL;
     char *header_buffer = NULL;
     BOOL headers_parsed = FALSE;
@@ -1300,11 +1160,14 @@ LONG U64_HttpGetURL(CONST_STRPTR url, CONST_STRPTR extra_headers,
     UBYTE *body = NULL;
     ULONG body_cap = 0;
     ULONG body_len = 0;
+    U64StatsSample sample;
 
     if (!url || !out_buffer || !out_size) return U64_ERR_INVALID;
     *out_buffer = NULL;
     *out_size = 0;
     if (out_status) *out_status = 0;
+    hostname[0] = '\0';
+    U64_StatsBegin(&sample);
 
     strncpy(current_url, (char *)url, sizeof(current_url) - 1);
     current_url[sizeof(current_url) - 1] = '\0';
@@ -1327,64 +1190,18 @@ LONG U64_HttpGetURL(CONST_STRPTR url, CONST_STRPTR extra_headers,
             strcpy(path, path_start);
         }
 
-        sockfd = socket(AF_INET, SOCK_STREAM, 0);
-        if (sockfd < 0) { result = U64_ERR_NETWORK; goto cleanup; }
-
         /* 8s is plenty for a small JSON response; keeps the GUI responsive
          * when Assembly64 is slow or the /search/entries endpoint returns
-         * 500 with a stuck keep-alive. */
-        struct timeval tv = { 8, 0 };
-        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-        setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-
-        struct sockaddr_in server_addr;
-        struct hostent *server;
-        Forbid(); server = gethostbyname(hostname); Permit();
-        if (!server) { result = U64_ERR_NETWORK; goto cleanup; }
-        memset(&server_addr, 0, sizeof(server_addr));
-        server_addr.sin_family = AF_INET;
-        CopyMem(server->h_addr, &server_addr.sin_addr.s_addr, server->h_length);
-        server_addr.sin_port = htons(80);
-
-        /* Non-blocking connect with bounded wait. A blocking connect() on
-         * an unreachable host can stall the whole process for minutes on
-         * AmigaOS emulation (Roadshow/AmiTCP) — SO_SNDTIMEO/SO_RCVTIMEO
-         * only affect send/recv, not the TCP handshake. We flip the
-         * socket to non-blocking, kick connect(), then WaitSelect() on
-         * the write mask for at most 8s. That's how the user sees a
-         * quick "Search failed" instead of a frozen GUI. */
-        {
-            LONG nb = 1;
-            IoctlSocket(sockfd, FIONBIO, (char *)&nb);
-            int crc = connect(sockfd,
-                              (struct sockaddr *)&server_addr,
-                              sizeof(server_addr));
-            if (crc < 0 && Errno() != EINPROGRESS
-                        && Errno() != EWOULDBLOCK) {
-                result = U64_ERR_NETWORK; goto cleanup;
-            }
-            if (crc < 0) {
-                struct timeval ct = { 8, 0 };
-                ULONG wmask = 1L << sockfd;
-                int ready = WaitSelect(sockfd + 1, NULL, &wmask, NULL,
-                                       &ct, NULL);
-                if (ready <= 0) {   /* 0=timeout, -1=error */
-                    result = U64_ERR_NETWORK; goto cleanup;
-                }
-                /* Check SO_ERROR to see if the connect() itself
-                 * succeeded — WaitSelect wakes on connect refused too. */
-                LONG so_err = 0;
-                LONG len = sizeof(so_err);
-                if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR,
-                               &so_err, &len) < 0 || so_err != 0) {
-                    result = U64_ERR_NETWORK; goto cleanup;
-                }
-            }
-            /* Back to blocking for send()/recv() — the subsequent
-             * read loop already uses its own WaitSelect timeout. */
-            nb = 0;
-            IoctlSocket(sockfd, FIONBIO, (char *)&nb);
-        }
+         * 500 with a stuck keep-alive. The connect is bounded too: a
+         * blocking connect() on an unreachable host can stall the whole
+         * process for minutes on AmigaOS emulation (Roadshow/AmiTCP), and
+         * SO_SNDTIMEO/SO_RCVTIMEO only affect send/recv, not the TCP
+         * handshake. That's how the user sees a quick "Search failed"
+         * instead of a frozen GUI. */
+        sockfd = U64_SockConnect((CONST_STRPTR)hostname, 80, 8, 8);
+        if (sockfd < 0) { result = U64_ERR_NETWORK; goto cleanup; }
+        if (sample.connect_ms == U64_STATS_NONE)
+            sample.connect_ms = U64_StatsSince(&sample);
 
         char request[1536];
         int len = snprintf(request, sizeof(request),
@@ -1397,7 +1214,9 @@ LONG U64_HttpGetURL(CONST_STRPTR url, CONST_STRPTR extra_headers,
                           "\r\n",
                           path, hostname,
                           extra_headers ? (char *)extra_headers : "");
-        if (send(sockfd, request, len, 0) < 0) { result = U64_ERR_NETWORK; goto cleanup; }
+        if (U64_SockSendAll(sockfd, request, len, 8, &sample.bytes_sent) != U64_OK) {
+            result = U64_ERR_NETWORK; goto cleanup;
+        }
 
         headers_parsed = FALSE;
         header_pos = 0;
@@ -1406,14 +1225,15 @@ LONG U64_HttpGetURL(CONST_STRPTR url, CONST_STRPTR extra_headers,
 
         int chunks = 0;
         while (chunks < 10000) {
-            struct timeval st = { 8, 0 };  /* per-chunk read timeout */
-            ULONG mask = 1L << sockfd;
-            int ready = WaitSelect(sockfd + 1, &mask, NULL, NULL, &st, NULL);
-            if (ready <= 0) break;
+            /* per-chunk read timeout */
+            if (U64_SockWait(sockfd, U64_SOCK_READ, 8) <= 0) break;
 
-            int got = recv(sockfd, chunk_buffer, READ_CHUNK_SIZE - 1, 0);
+            int got = U64_SockRecv(sockfd, chunk_buffer, READ_CHUNK_SIZE - 1);
             if (got <= 0) break;
             chunks++;
+            if (sample.first_byte_ms == U64_STATS_NONE)
+                sample.first_byte_ms = U64_StatsSince(&sample);
+            sample.bytes_received += got;
             chunk_buffer[got] = '\0';
 
             if (!headers_parsed) {
@@ -1439,7 +1259,7 @@ LONG U64_HttpGetURL(CONST_STRPTR url, CONST_STRPTR extra_headers,
                                 if (e && (size_t)(e - loc) < sizeof(current_url) - 1) {
                                     CopyMem(loc, current_url, e - loc);
                                     current_url[e - loc] = '\0';
-                                    CloseSocket(sockfd); sockfd = -1;
+                                    U64_SockClose(sockfd); sockfd = -1;
                                     redirect_count++;
                                     goto next_redirect;
                                 }
@@ -1524,9 +1344,11 @@ next_redirect:
     }
 
 cleanup:
-    if (sockfd >= 0) CloseSocket(sockfd);
+    if (sockfd >= 0) U64_SockClose(sockfd);
     if (chunk_buffer) FreeMem(chunk_buffer, READ_CHUNK_SIZE);
     if (header_buffer) FreeMem(header_buffer, 4096);
     if (body) FreeVec(body);  /* only reached when we never got a headers-parsed response */
+    U64_StatsRecord(NULL, (CONST_STRPTR)"GET", (CONST_STRPTR)hostname,
+                    &sample, result);
     return result;
 }
\ No newline at end of file
@@ -90,7 +90,9 @@ static const char *error_strings[] = {
 BOOL
 U64_InitLibrary (void)
 {
+#ifndef U64_HOST
   SysBase = *((struct ExecBase **)4);
+#endif
 
   if (!(DOSBase = (struct DosLibrary *)OpenLibrary ("dos.library", 36L)))
     {
@@ -105,6 +107,8 @@ U64_InitLibrary (void)
       U64_DEBUG ("Network initialization failed, continuing without network");
     }
 
+  U64_StatsInit ();
+
   return TRUE;
 }
 
@@ -120,6 +124,7 @@ U64_CleanupLibrary (void)
   /* Only cleanup network, leave DOS library open */
   U64_DEBUG ("Cleaning up network only");
   U64_NetCleanup ();
+  U64_StatsCleanup ();
 
   /* DON'T close DOS library - let system handle it on exit */
   if (DOSBase)
@@ -137,13 +142,23 @@ U64_Connect (CONST_STRPTR host, CONST_STRPTR password)
 {
   U64Connection *conn;
   ULONG host_len, pw_len = 0;
+  UWORD port = 80;
+  const char *colon;
 
   if (!host)
     {
       return NULL;
     }
 
+  /* "host:port" picks a port other than 80 */
   host_len = strlen ((char *)host);
+  colon = strrchr ((char *)host, ':');
+  if (colon && colon[1]
+      && strspn (colon + 1, "0123456789") == strlen (colon + 1))
+    {
+      port = (UWORD)atoi (colon + 1);
+      host_len = colon - (const char *)host;
+    }
   if (password)
     {
       pw_len = strlen ((char *)password);
@@ -163,7 +178,8 @@ U64_Connect (CONST_STRPTR host, CONST_STRPTR password)
       FreeMem (conn, sizeof (U64Connection));
       return NULL;
     }
-  strcpy ((char *)conn->host, (char *)host);
+  CopyMem ((APTR)host, conn->host, host_len);
+  conn->host[host_len] = '\0';
 
   /* Allocate and copy password if provided */
   if (password)
@@ -178,8 +194,7 @@ U64_Connect (CONST_STRPTR host, CONST_STRPTR password)
       strcpy ((char *)conn->password, (char *)password);
     }
 
-  /* Set default port */
-  conn->port = 80;
+  conn->port = port;
 
   /* Build URL prefix */
   conn->url_prefix = AllocMem (256, MEMF_PUBLIC);
@@ -200,6 +215,65 @@ U64_Connect (CONST_STRPTR host, CONST_STRPTR password)
   return conn;
 }
 
+/* Name conn's device the way U64_Connect was given it */
+void
+U64_ConnName (U64Connection *conn, char *buffer, ULONG size)
+{
+  if (conn->port != 80)
+    {
+      snprintf (buffer, size, "%s:%u", (char *)conn->host,
+                (unsigned)conn->port);
+    }
+  else
+    {
+      snprintf (buffer, size, "%s", (char *)conn->host);
+    }
+}
+
+/* Set the HTTP connect and send/receive timeouts */
+void
+U64_SetTimeouts (U64Connection *conn, ULONG connect_s, ULONG io_s)
+{
+  if (!conn)
+    {
+      return;
+    }
+  conn->connect_timeout = connect_s;
+  conn->io_timeout = io_s;
+}
+
+/* GET path and lend the reply body straight from the connection arena */
+LONG
+U64_GetBorrowed (U64Connection *conn, CONST_STRPTR path, CONST UBYTE **data,
+                 ULONG *size)
+{
+  HttpRequest req;
+  LONG result;
+
+  if (!conn || !path || !data || !size)
+    {
+      return U64_ERR_INVALID;
+    }
+  *data = NULL;
+  *size = 0;
+
+  U64_ArenaReset (conn);
+  memset (&req, 0, sizeof (req));
+  req.method = HTTP_GET;
+  req.path = (STRPTR)path;
+  req.flags = HTTP_BORROW_RESPONSE;
+
+  result = U64_HttpRequest (conn, &req);
+  if (req.response)
+    {
+      *data = (CONST UBYTE *)req.response;
+      *size = req.response_size;
+    }
+
+  conn->last_error = result;
+  return result;
+}
+
 /* Disconnect from Ultimate device */
 void
 U64_Disconnect (U64Connection *conn)
@@ -258,6 +332,10 @@ U64_Disconnect (U64Connection *conn)
       conn->url_prefix = NULL; /* Prevent double-free */
     }
 
+  U64_TraceStop (conn);
+  U64_ArenaFree (conn);
+  U64_StatsFree (conn);
+
   /* Clear the connection structure before freeing */
   U64_DEBUG ("Clearing connection structure");
   memset (conn, 0, sizeof (U64Connection));
@@ -578,7 +656,6 @@ U64_WriteMem (U64Connection *conn, UWORD address, CONST UBYTE *data,
   char *path_buffer;
   char *hex_buffer;
   char address_str[8];
-  UWORD i;
   ULONG path_len;
 
   if (!conn || !data || length == 0)
@@ -606,40 +683,18 @@ U64_WriteMem (U64Connection *conn, UWORD address, CONST UBYTE *data,
   U64_DEBUG ("Writing %d bytes to $%04X", length, address);
   U64_DEBUG ("Input data[0] = 0x%02X", data[0]);
 
-  /* Allocate separate buffers to avoid corruption */
-  hex_buffer = AllocMem (512, MEMF_PUBLIC | MEMF_CLEAR);
-  if (!hex_buffer)
-    {
-      U64_DEBUG ("Failed to allocate hex buffer");
-      return U64_ERR_MEMORY;
-    }
-
-  path_buffer = AllocMem (1024, MEMF_PUBLIC | MEMF_CLEAR);
-  if (!path_buffer)
+  /* Scratch buffers and the response come from the connection arena,
+     rewound here; nothing below is freed by hand */
+  U64_ArenaReset (conn);
+  hex_buffer = U64_ArenaAlloc (conn, 2 * 128 + 1);
+  path_buffer = U64_ArenaAlloc (conn, 1024);
+  if (!hex_buffer || !path_buffer)
     {
-      U64_DEBUG ("Failed to allocate path buffer");
-      FreeMem (hex_buffer, 512);
+      U64_DEBUG ("Failed to allocate WriteMem buffers");
       return U64_ERR_MEMORY;
     }
 
-  /* Build hex string character by character */
-  hex_buffer[0] = '\0';
-  for (i = 0; i < length; i++)
-    {
-      char byte_str[4];
-      UBYTE byte_val = data[i];
-
-      U64_DEBUG ("Processing byte %d: 0x%02X", i, byte_val);
-
-      /* Convert byte to hex manually to avoid sprintf issues */
-      byte_str[0] = "0123456789ABCDEF"[(byte_val >> 4) & 0x0F];
-      byte_str[1] = "0123456789ABCDEF"[byte_val & 0x0F];
-      byte_str[2] = '\0';
-
-      strcat (hex_buffer, byte_str);
-
-      U64_DEBUG ("After byte %d, hex_buffer = '%s'", i, hex_buffer);
-    }
+  U64_HexEncode (data, length, hex_buffer);
 
   U64_DEBUG ("Complete hex string: '%s' (length: %lu)", hex_buffer,
              (unsigned long)strlen (hex_buffer));
@@ -666,16 +721,12 @@ U64_WriteMem (U64Connection *conn, UWORD address, CONST UBYTE *data,
   if (!strstr (path_buffer, "address="))
     {
       U64_DEBUG ("ERROR: No address parameter in path!");
-      FreeMem (hex_buffer, 512);
-      FreeMem (path_buffer, 1024);
       return U64_ERR_GENERAL;
     }
 
   if (!strstr (path_buffer, "data="))
     {
       U64_DEBUG ("ERROR: No data parameter in path!");
-      FreeMem (hex_buffer, 512);
-      FreeMem (path_buffer, 1024);
       return U64_ERR_GENERAL;
     }
 
@@ -686,8 +737,6 @@ U64_WriteMem (U64Connection *conn, UWORD address, CONST UBYTE *data,
       if (strlen (data_pos) <= 5)
         { /* "data=" is 5 chars */
           U64_DEBUG ("ERROR: Data parameter is empty!");
-          FreeMem (hex_buffer, 512);
-          FreeMem (path_buffer, 1024);
           return U64_ERR_GENERAL;
         }
     }
@@ -699,6 +748,7 @@ U64_WriteMem (U64Connection *conn, UWORD address, CONST UBYTE *data,
   req.content_type = NULL;
   req.body = NULL;
   req.body_size = 0;
+  req.flags = HTTP_BORROW_RESPONSE;
 
   /* Execute request */
   U64_DEBUG ("Executing HTTP request with safe path...");
@@ -716,9 +766,6 @@ U64_WriteMem (U64Connection *conn, UWORD address, CONST UBYTE *data,
       if (strstr (req.response, "\"errors\"") && strstr (req.response, "[]"))
         {
           U64_DEBUG ("SUCCESS: Empty errors array detected");
-          FreeMem (req.response, req.response_size + 1);
-          FreeMem (hex_buffer, 512);
-          FreeMem (path_buffer, 1024);
           conn->last_error = U64_OK;
           return U64_OK;
         }
@@ -730,24 +777,16 @@ U64_WriteMem (U64Connection *conn, UWORD address, CONST UBYTE *data,
           U64_DEBUG (
               "This means our data parameter is not reaching the server");
         }
-
-      FreeMem (req.response, req.response_size + 1);
     }
 
   /* Check HTTP status code */
   if (result == U64_OK && req.status_code == 200)
     {
       U64_DEBUG ("HTTP 200 OK - treating as success despite response issues");
-      FreeMem (hex_buffer, 512);
-      FreeMem (path_buffer, 1024);
       conn->last_error = U64_OK;
       return U64_OK;
     }
 
-  /* Cleanup and return error */
-  FreeMem (hex_buffer, 512);
-  FreeMem (path_buffer, 1024);
-
   U64_DEBUG ("Request failed - result: %ld, status: %d", result,
              req.status_code);
   conn->last_error = (result != U64_OK) ? result : U64_ERR_GENERAL;
@@ -782,10 +821,12 @@ U64_ReadMem (U64Connection *conn, UWORD address, UBYTE *buffer, UWORD length)
 
   U64_DEBUG ("Memory read path: %s", path);
 
-  /* Setup HTTP request */
+  /* Setup HTTP request; the response is only copied out of the arena */
+  U64_ArenaReset (conn);
   memset (&req, 0, sizeof (req));
   req.method = HTTP_GET;
   req.path = path;
+  req.flags = HTTP_BORROW_RESPONSE;
 
   /* Execute request */
   result = U64_HttpRequest (conn, &req);
@@ -821,12 +862,6 @@ U64_ReadMem (U64Connection *conn, UWORD address, UBYTE *buffer, UWORD length)
         }
     }
 
-  /* Free response */
-  if (req.response)
-    {
-      FreeMem (req.response, req.response_size + 1);
-    }
-
   conn->last_error = result;
   return result;
 }
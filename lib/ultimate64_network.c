@@ -8,14 +8,11 @@
 #include <proto/exec.h>
 
 #ifdef USE_BSDSOCKET
-#include <errno.h>
-#include <netdb.h>
-#include <netinet/in.h>
 #include <proto/socket.h>
-#include <sys/ioctl.h>
-#include <sys/socket.h>
 #endif
 
+#include <errno.h>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,10 +29,7 @@ int errno_storage = 0;
 /* Network connection structure */
 struct NetConnection
 {
-#ifdef USE_BSDSOCKET
   LONG socket;
-  struct sockaddr_in server_addr;
-#endif
   BOOL connected;
   UBYTE *recv_buffer;
   ULONG recv_buffer_size;
@@ -80,8 +74,10 @@ U64_NetInit (void)
     {
       U64_DEBUG ("SocketBase already initialized");
     }
+#elif defined(USE_POSIX_SOCKETS)
+  U64_DEBUG ("Using host POSIX sockets");
 #else
-  U64_DEBUG ("USE_BSDSOCKET not defined - network not available");
+  U64_DEBUG ("No socket backend built in - network not available");
   return U64_ERR_NOTIMPL;
 #endif
 
@@ -106,6 +102,8 @@ U64_NetCleanup (void)
     {
       U64_DEBUG ("SocketBase was already NULL");
     }
+#elif defined(USE_POSIX_SOCKETS)
+  U64_DEBUG ("Nothing to close for POSIX sockets");
 #else
   U64_DEBUG ("Network not supported");
 #endif
@@ -117,14 +115,10 @@ U64_NetCleanup (void)
 LONG
 U64_NetConnect (U64Connection *conn)
 {
-#ifdef USE_BSDSOCKET
   struct NetConnection *net;
-  struct hostent *host;
   LONG sock;
-  struct timeval tv;
-  ULONG addr;
 
-  if (!conn || !SocketBase)
+  if (!conn || !U64_SockReady ())
     {
       return U64_ERR_INVALID;
     }
@@ -155,70 +149,14 @@ U64_NetConnect (U64Connection *conn)
       return U64_ERR_MEMORY;
     }
 
-  /* Create socket */
-  sock = socket (AF_INET, SOCK_STREAM, 0);
-  if (sock < 0)
-    {
-      U64_DEBUG ("Failed to create socket: errno=%d", errno_storage);
-      FreeMem (net->recv_buffer, net->recv_buffer_size);
-      FreeMem (net, sizeof (struct NetConnection));
-      return U64_ERR_NETWORK;
-    }
-
-  /* Set socket timeouts */
-  tv.tv_sec = 30; /* 30 second timeout */
-  tv.tv_usec = 0;
-  if (setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv)) < 0)
-    {
-      U64_DEBUG ("Failed to set receive timeout");
-    }
-  if (setsockopt (sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv)) < 0)
-    {
-      U64_DEBUG ("Failed to set send timeout");
-    }
-
-  /* Setup server address structure */
-  memset (&net->server_addr, 0, sizeof (net->server_addr));
-  net->server_addr.sin_family = AF_INET;
-  net->server_addr.sin_port = htons (conn->port);
+  U64_DEBUG ("Connecting to %s:%u", (char *)conn->host,
+             (unsigned)conn->port);
 
-  /* DNS resolution with protection */
-  U64_DEBUG ("Resolving hostname: %s", (char *)conn->host);
-
-  Forbid ();
-  host = gethostbyname ((char *)conn->host);
-  if (host && host->h_addr)
-    {
-      /* Copy resolved address */
-      memcpy (&net->server_addr.sin_addr, host->h_addr, host->h_length);
-      addr = net->server_addr.sin_addr.s_addr;
-    }
-  else
-    {
-      /* Try as IP address */
-      addr = inet_addr ((char *)conn->host);
-      if (addr == INADDR_NONE)
-        {
-          Permit ();
-          U64_DEBUG ("Failed to resolve hostname: %s", (char *)conn->host);
-          CloseSocket (sock);
-          FreeMem (net->recv_buffer, net->recv_buffer_size);
-          FreeMem (net, sizeof (struct NetConnection));
-          return U64_ERR_NETWORK;
-        }
-      net->server_addr.sin_addr.s_addr = addr;
-    }
-  Permit ();
-
-  U64_DEBUG ("Connecting to server...");
-
-  /* Connect to server */
-  if (connect (sock, (struct sockaddr *)&net->server_addr,
-               sizeof (net->server_addr))
-      < 0)
+  /* Resolve, connect within 10 seconds, 30 second send/receive timeouts */
+  sock = U64_SockConnect (conn->host, conn->port, 10, 30);
+  if (sock < 0)
     {
-      U64_DEBUG ("Failed to connect: errno=%d", errno_storage);
-      CloseSocket (sock);
+      U64_DEBUG ("Failed to connect: errno=%ld", (long)U64_SockError ());
       FreeMem (net->recv_buffer, net->recv_buffer_size);
       FreeMem (net, sizeof (struct NetConnection));
       return U64_ERR_NETWORK;
@@ -234,16 +172,12 @@ U64_NetConnect (U64Connection *conn)
 
   U64_DEBUG ("Connected successfully");
   return U64_OK;
-#else
-  return U64_ERR_NOTIMPL;
-#endif
 }
 
 /* Disconnect from Ultimate device - SAFE VERSION */
 void
 U64_NetDisconnect (U64Connection *conn)
 {
-#ifdef USE_BSDSOCKET
   struct NetConnection *net;
 
   if (!conn)
@@ -265,7 +199,7 @@ U64_NetDisconnect (U64Connection *conn)
   if (net->socket >= 0)
     {
       U64_DEBUG ("Closing socket %ld", net->socket);
-      CloseSocket (net->socket);
+      U64_SockClose (net->socket);
       net->socket = -1; /* Mark as closed */
     }
 
@@ -290,22 +224,15 @@ U64_NetDisconnect (U64Connection *conn)
   conn->net_connection = NULL;
 
   U64_DEBUG ("Disconnect complete");
-#else
-  U64_DEBUG ("Network not supported");
-#endif
 }
 
 /* Send data over network */
 LONG
 U64_NetSend (U64Connection *conn, CONST UBYTE *data, ULONG size)
 {
-#ifdef USE_BSDSOCKET
   struct NetConnection *net;
-  LONG sent;
-  LONG total_sent = 0;
-  ULONG write_mask;
-  struct timeval timeout;
-  int ready;
+  ULONG total_sent = 0;
+  LONG ready;
   int retry_count = 0;
   const int MAX_RETRIES = 5;
 
@@ -323,18 +250,13 @@ U64_NetSend (U64Connection *conn, CONST UBYTE *data, ULONG size)
   U64_DEBUG ("Sending %lu bytes", (unsigned long)size);
 
   /* Send data in chunks if necessary */
-  while (total_sent < (LONG)size && retry_count < MAX_RETRIES)
+  while (total_sent < size && retry_count < MAX_RETRIES)
     {
-      /* Use WaitSelect to check if socket is ready for writing */
-      timeout.tv_sec = 5; /* Shorter timeout */
-      timeout.tv_usec = 0;
-      write_mask = 1L << net->socket;
-
-      ready = WaitSelect (net->socket + 1, NULL, &write_mask, NULL, &timeout,
-                          NULL);
+      /* Wait until the socket is ready for writing */
+      ready = U64_SockWait (net->socket, U64_SOCK_WRITE, 5);
       if (ready < 0)
         {
-          U64_DEBUG ("WaitSelect error during send");
+          U64_DEBUG ("Wait error during send");
           net->connected = FALSE;
           return U64_ERR_NETWORK;
         }
@@ -351,56 +273,36 @@ U64_NetSend (U64Connection *conn, CONST UBYTE *data, ULONG size)
           continue;
         }
 
-      if (write_mask & (1L << net->socket))
+      if (U64_SockSendAll (net->socket, data + total_sent, size - total_sent,
+                           5, &total_sent)
+          != U64_OK)
         {
-          sent = send (net->socket, data + total_sent, size - total_sent, 0);
-          if (sent < 0)
-            {
-              if (errno_storage == EINTR)
-                {
-                  continue; /* Retry on interrupt */
-                }
-              U64_DEBUG ("Send error: errno=%d", errno_storage);
-              net->connected = FALSE;
-              return U64_ERR_NETWORK;
-            }
-          if (sent == 0)
-            {
-              U64_DEBUG ("Send returned 0 - connection closed");
-              net->connected = FALSE;
-              return U64_ERR_NETWORK;
-            }
-          total_sent += sent;
-          retry_count = 0; /* Reset retry count on successful send */
-          U64_DEBUG ("Sent %ld bytes (total: %ld/%lu)", sent, total_sent,
-                     (unsigned long)size);
+          U64_DEBUG ("Send error: errno=%ld", (long)U64_SockError ());
+          net->connected = FALSE;
+          return U64_ERR_NETWORK;
         }
+      retry_count = 0;
+      U64_DEBUG ("Sent %lu bytes", (unsigned long)total_sent);
     }
 
-  if (total_sent < (LONG)size)
+  if (total_sent < size)
     {
-      U64_DEBUG ("Incomplete send: %ld/%lu bytes", total_sent,
+      U64_DEBUG ("Incomplete send: %lu/%lu bytes", (unsigned long)total_sent,
                  (unsigned long)size);
       return U64_ERR_NETWORK;
     }
 
   return U64_OK;
-#else
-  return U64_ERR_NOTIMPL;
-#endif
 }
 
 /* Receive data from network */
 LONG
 U64_NetReceive (U64Connection *conn, UBYTE *buffer, ULONG size)
 {
-#ifdef USE_BSDSOCKET
   struct NetConnection *net;
   LONG received;
   LONG total_received = 0;
-  ULONG read_mask;
-  struct timeval timeout;
-  int ready;
+  LONG ready;
   int retry_count = 0;
   const int MAX_RETRIES = 5;
 
@@ -420,16 +322,11 @@ U64_NetReceive (U64Connection *conn, UBYTE *buffer, ULONG size)
   /* Receive data with timeout */
   while (total_received < (LONG)size && retry_count < MAX_RETRIES)
     {
-      /* Use WaitSelect to check if data is available */
-      timeout.tv_sec = 5; /* Shorter timeout */
-      timeout.tv_usec = 0;
-      read_mask = 1L << net->socket;
-
-      ready = WaitSelect (net->socket + 1, &read_mask, NULL, NULL, &timeout,
-                          NULL);
+      /* Wait until data is available */
+      ready = U64_SockWait (net->socket, U64_SOCK_READ, 5);
       if (ready < 0)
         {
-          U64_DEBUG ("WaitSelect error during receive");
+          U64_DEBUG ("Wait error during receive");
           net->connected = FALSE;
           return total_received > 0 ? total_received : U64_ERR_NETWORK;
         }
@@ -445,56 +342,47 @@ U64_NetReceive (U64Connection *conn, UBYTE *buffer, ULONG size)
           continue;
         }
 
-      if (read_mask & (1L << net->socket))
+      received = U64_SockRecv (net->socket, buffer + total_received,
+                               size - total_received);
+      if (received < 0)
         {
-          received = recv (net->socket, buffer + total_received,
-                           size - total_received, 0);
-          if (received < 0)
+          if (U64_SockError () == EINTR)
             {
-              if (errno_storage == EINTR)
-                {
-                  continue; /* Retry on interrupt */
-                }
-              U64_DEBUG ("Receive error: errno=%d", errno_storage);
-              net->connected = FALSE;
-              return total_received > 0 ? total_received : U64_ERR_NETWORK;
+              continue; /* Retry on interrupt */
             }
-          if (received == 0)
-            {
-              /* Connection closed */
-              net->connected = FALSE;
-              U64_DEBUG ("Connection closed by peer");
-              return total_received > 0 ? total_received : U64_ERR_NETWORK;
-            }
-          total_received += received;
-          retry_count = 0; /* Reset retry count on successful receive */
-          U64_DEBUG ("Received %ld bytes (total: %ld/%lu)", received,
-                     total_received, (unsigned long)size);
-
-          /* For HTTP, we might get the full response in smaller chunks */
-          /* Don't wait for the full size if we got some data */
-          break;
+          U64_DEBUG ("Receive error: errno=%ld", (long)U64_SockError ());
+          net->connected = FALSE;
+          return total_received > 0 ? total_received : U64_ERR_NETWORK;
+        }
+      if (received == 0)
+        {
+          /* Connection closed */
+          net->connected = FALSE;
+          U64_DEBUG ("Connection closed by peer");
+          return total_received > 0 ? total_received : U64_ERR_NETWORK;
         }
+      total_received += received;
+      retry_count = 0; /* Reset retry count on successful receive */
+      U64_DEBUG ("Received %ld bytes (total: %ld/%lu)", received,
+                 total_received, (unsigned long)size);
+
+      /* For HTTP, we might get the full response in smaller chunks */
+      /* Don't wait for the full size if we got some data */
+      break;
     }
 
   return total_received;
-#else
-  return U64_ERR_NOTIMPL;
-#endif
 }
 
 /* Receive line from network (for HTTP headers) */
 LONG
 U64_NetReceiveLine (U64Connection *conn, STRPTR buffer, ULONG max_size)
 {
-#ifdef USE_BSDSOCKET
   struct NetConnection *net;
   ULONG pos = 0;
   UBYTE c;
   LONG result;
-  ULONG read_mask;
-  struct timeval timeout;
-  int ready;
+  LONG ready;
   int retry_count = 0;
   const int MAX_RETRIES = 10;
 
@@ -520,15 +408,10 @@ U64_NetReceiveLine (U64Connection *conn, STRPTR buffer, ULONG max_size)
       else
         {
           /* Need to read more data */
-          timeout.tv_sec = 3; /* Shorter timeout for line reading */
-          timeout.tv_usec = 0;
-          read_mask = 1L << net->socket;
-
-          ready = WaitSelect (net->socket + 1, &read_mask, NULL, NULL,
-                              &timeout, NULL);
+          ready = U64_SockWait (net->socket, U64_SOCK_READ, 3);
           if (ready < 0)
             {
-              U64_DEBUG ("WaitSelect error during line receive");
+              U64_DEBUG ("Wait error during line receive");
               net->connected = FALSE;
               break;
             }
@@ -544,37 +427,31 @@ U64_NetReceiveLine (U64Connection *conn, STRPTR buffer, ULONG max_size)
               continue;
             }
 
-          if (read_mask & (1L << net->socket))
+          result = U64_SockRecv (net->socket, net->recv_buffer,
+                                 net->recv_buffer_size);
+          if (result < 0)
             {
-              result = recv (net->socket, net->recv_buffer,
-                             net->recv_buffer_size, 0);
-              if (result < 0)
-                {
-                  if (errno_storage == EINTR)
-                    {
-                      continue;
-                    }
-                  U64_DEBUG ("Line receive error: errno=%d", errno_storage);
-                  net->connected = FALSE;
-                  break;
-                }
-              if (result == 0)
+              if (U64_SockError () == EINTR)
                 {
-                  /* Connection closed */
-                  net->connected = FALSE;
-                  U64_DEBUG ("Connection closed during line receive");
-                  break;
+                  continue;
                 }
-
-              net->recv_buffer_len = result;
-              net->recv_buffer_pos = 0;
-              retry_count = 0; /* Reset retry count on successful receive */
-              c = net->recv_buffer[net->recv_buffer_pos++];
+              U64_DEBUG ("Line receive error: errno=%ld",
+                         (long)U64_SockError ());
+              net->connected = FALSE;
+              break;
             }
-          else
+          if (result == 0)
             {
-              continue;
+              /* Connection closed */
+              net->connected = FALSE;
+              U64_DEBUG ("Connection closed during line receive");
+              break;
             }
+
+          net->recv_buffer_len = result;
+          net->recv_buffer_pos = 0;
+          retry_count = 0; /* Reset retry count on successful receive */
+          c = net->recv_buffer[net->recv_buffer_pos++];
         }
 
       if (c == '\r')
@@ -594,7 +471,4 @@ U64_NetReceiveLine (U64Connection *conn, STRPTR buffer, ULONG max_size)
   buffer[pos] = '\0';
   U64_DEBUG ("Received line (%lu chars): %s", (unsigned long)pos, buffer);
   return pos;
-#else
-  return U64_ERR_NOTIMPL;
-#endif
-}
\ No newline at end of file
+}
@@ -0,0 +1,713 @@
+/* Ultimate64/Ultimate-II Control Library for Amiga OS 3.x
+ * Socket transport
+ *
+ * The HTTP code talks to the network only through the U64_Sock calls
+ * below. Built with USE_BSDSOCKET they go to bsdsocket.library (Roadshow,
+ * AmiTCP, Miami); built with USE_POSIX_SOCKETS they use the host's BSD
+ * sockets and poll(), for running the library on Linux and other POSIX
+ * systems. With neither, every call fails and requests return
+ * U64_ERR_NETWORK.
+ *
+ * Sockets come back from U64_SockConnect connected and blocking, with
+ * send and receive timeouts set; callers bound each wait with
+ * U64_SockWait. U64_SockStart instead returns a non-blocking socket with
+ * the connect under way, for callers that drive many sockets through
+ * U64_SockWaitMany and finish each connect with U64_SockFinish.
+ */
+
+#include <exec/types.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#include "ultimate64_amiga.h"
+#include "ultimate64_private.h"
+
+#if defined(USE_BSDSOCKET)
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <proto/socket.h>
+#include <sys/errno.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+BOOL
+U64_SockReady (void)
+{
+  return SocketBase != NULL;
+}
+
+LONG
+U64_SockError (void)
+{
+  return SocketBase ? Errno () : 0;
+}
+
+/* Fill in addr for host:port. Returns FALSE if the name doesn't resolve. */
+static BOOL
+SockResolve (CONST_STRPTR host, UWORD port, struct sockaddr_in *addr)
+{
+  struct hostent *server;
+  BOOL resolved = FALSE;
+
+  memset (addr, 0, sizeof (*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons (port);
+
+  /* gethostbyname's result is shared; keep other tasks off it */
+  Forbid ();
+  server = gethostbyname ((char *)host);
+  if (server && server->h_addr)
+    {
+      CopyMem (server->h_addr, &addr->sin_addr.s_addr, server->h_length);
+      resolved = TRUE;
+    }
+  Permit ();
+
+  if (!resolved)
+    {
+      U64_DEBUG ("DNS lookup failed for: %s", (char *)host);
+    }
+  return resolved;
+}
+
+/* Resolve host, connect within connect_s seconds and set io_s second
+   send/receive timeouts. Returns the socket or U64_ERR_NETWORK. */
+LONG
+U64_SockConnect (CONST_STRPTR host, UWORD port, ULONG connect_s, ULONG io_s)
+{
+  struct sockaddr_in server_addr;
+  struct timeval timeout;
+  LONG sock, nb;
+
+  if (!SocketBase || !host || !SockResolve (host, port, &server_addr))
+    {
+      return U64_ERR_NETWORK;
+    }
+
+  sock = socket (AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    {
+      U64_DEBUG ("Failed to create socket: errno=%ld", (long)Errno ());
+      return U64_ERR_NETWORK;
+    }
+
+  timeout.tv_sec = io_s;
+  timeout.tv_usec = 0;
+  setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+  setsockopt (sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+  /* Non-blocking connect with a bounded wait. A blocking connect() on an
+   * unreachable host (wrong IP, device off) stalls the caller for the
+   * stack's default of minutes; SO_SNDTIMEO/SO_RCVTIMEO don't cover the
+   * handshake. */
+  nb = 1;
+  IoctlSocket (sock, FIONBIO, (char *)&nb);
+  if (connect (sock, (struct sockaddr *)&server_addr, sizeof (server_addr))
+      < 0)
+    {
+      if ((Errno () != EINPROGRESS && Errno () != EWOULDBLOCK)
+          || U64_SockWait (sock, U64_SOCK_WRITE, connect_s) <= 0
+          /* WaitSelect wakes on a refused connect too */
+          || U64_SockFinish (sock) != U64_OK)
+        {
+          U64_DEBUG ("Failed to connect to %s:%u", (char *)host,
+                     (unsigned)port);
+          CloseSocket (sock);
+          return U64_ERR_NETWORK;
+        }
+    }
+  nb = 0;
+  IoctlSocket (sock, FIONBIO, (char *)&nb);
+
+  return sock;
+}
+
+/* Resolve host and begin connecting. Returns the socket, non-blocking,
+   or U64_ERR_NETWORK. */
+LONG
+U64_SockStart (CONST_STRPTR host, UWORD port)
+{
+  struct sockaddr_in server_addr;
+  LONG sock, nb = 1;
+
+  if (!SocketBase || !host || !SockResolve (host, port, &server_addr))
+    {
+      return U64_ERR_NETWORK;
+    }
+
+  sock = socket (AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    {
+      U64_DEBUG ("Failed to create socket: errno=%ld", (long)Errno ());
+      return U64_ERR_NETWORK;
+    }
+
+  IoctlSocket (sock, FIONBIO, (char *)&nb);
+  if (connect (sock, (struct sockaddr *)&server_addr, sizeof (server_addr))
+          < 0
+      && Errno () != EINPROGRESS && Errno () != EWOULDBLOCK)
+    {
+      U64_DEBUG ("Failed to connect to %s:%u", (char *)host, (unsigned)port);
+      CloseSocket (sock);
+      return U64_ERR_NETWORK;
+    }
+  return sock;
+}
+
+/* Outcome of a connect begun by U64_SockStart, once sock is writable */
+LONG
+U64_SockFinish (LONG sock)
+{
+  LONG so_err = 0;
+  LONG slen = sizeof (so_err);
+
+  if (getsockopt (sock, SOL_SOCKET, SO_ERROR, &so_err, &slen) < 0
+      || so_err != 0)
+    {
+      return U64_ERR_NETWORK;
+    }
+  return U64_OK;
+}
+
+/* Wait up to timeout_s seconds for sock to become readable or writable.
+   Returns > 0 when ready, 0 on timeout, < 0 on error. */
+LONG
+U64_SockWait (LONG sock, ULONG events, ULONG timeout_s)
+{
+  struct timeval timeout;
+  ULONG read_mask = 1L << sock;
+  ULONG write_mask = 1L << sock;
+
+  timeout.tv_sec = timeout_s;
+  timeout.tv_usec = 0;
+  return WaitSelect (sock + 1, (events & U64_SOCK_READ) ? &read_mask : NULL,
+                     (events & U64_SOCK_WRITE) ? &write_mask : NULL, NULL,
+                     &timeout, NULL);
+}
+
+/* Send all of data, waiting up to timeout_s whenever the stack's buffer
+   is full. *sent counts what went out, also on failure. */
+LONG
+U64_SockSendAll (LONG sock, CONST void *data, ULONG length, ULONG timeout_s,
+                 ULONG *sent)
+{
+  CONST UBYTE *p = data;
+  ULONG done = 0;
+
+  while (done < length)
+    {
+      LONG chunk = send (sock, (UBYTE *)p + done, length - done, 0);
+
+      if (chunk < 0)
+        {
+          if ((Errno () == EAGAIN || Errno () == EWOULDBLOCK)
+              && U64_SockWait (sock, U64_SOCK_WRITE, timeout_s) > 0)
+            {
+              continue;
+            }
+          U64_DEBUG ("send failed at %lu/%lu: errno=%ld",
+                     (unsigned long)done, (unsigned long)length,
+                     (long)Errno ());
+          break;
+        }
+      if (chunk == 0)
+        {
+          U64_DEBUG ("send returned 0 at %lu/%lu (peer closed)",
+                     (unsigned long)done, (unsigned long)length);
+          break;
+        }
+      done += (ULONG)chunk;
+      if (sent)
+        {
+          *sent += (ULONG)chunk;
+        }
+    }
+  return done == length ? U64_OK : U64_ERR_NETWORK;
+}
+
+LONG
+U64_SockRecv (LONG sock, void *buffer, ULONG size)
+{
+  return recv (sock, buffer, size, 0);
+}
+
+/* One send on a non-blocking socket: bytes taken, 0 if the stack's
+   buffer is full, < 0 on error */
+LONG
+U64_SockSend (LONG sock, CONST void *data, ULONG length)
+{
+  LONG chunk = send (sock, (UBYTE *)data, length, 0);
+
+  if (chunk < 0 && U64_SockWouldBlock ())
+    {
+      return 0;
+    }
+  return chunk;
+}
+
+/* Whether the last failed call only means "not now" on a non-blocking
+   socket */
+BOOL
+U64_SockWouldBlock (void)
+{
+  LONG err = Errno ();
+
+  return err == EAGAIN || err == EWOULDBLOCK || err == EINTR;
+}
+
+/* Wait up to timeout_ms for any of polls[] to become ready, setting each
+   one's ready mask. Entries with sock < 0 or no events are skipped.
+   Returns > 0 when something is ready, 0 on timeout, < 0 on error. */
+LONG
+U64_SockWaitMany (U64SockPoll *polls, ULONG count, ULONG timeout_ms)
+{
+  struct timeval timeout;
+  fd_set read_set, write_set;
+  LONG max_sock = -1, rc;
+  ULONG i;
+
+  FD_ZERO (&read_set);
+  FD_ZERO (&write_set);
+  for (i = 0; i < count; i++)
+    {
+      polls[i].ready = 0;
+      if (polls[i].sock < 0 || !polls[i].events)
+        {
+          continue;
+        }
+      if (polls[i].events & U64_SOCK_READ)
+        {
+          FD_SET (polls[i].sock, &read_set);
+        }
+      if (polls[i].events & U64_SOCK_WRITE)
+        {
+          FD_SET (polls[i].sock, &write_set);
+        }
+      if (polls[i].sock > max_sock)
+        {
+          max_sock = polls[i].sock;
+        }
+    }
+
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_usec = (timeout_ms % 1000) * 1000;
+  rc = WaitSelect (max_sock + 1, &read_set, &write_set, NULL, &timeout, NULL);
+  if (rc <= 0)
+    {
+      return rc;
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      if (polls[i].sock < 0)
+        {
+          continue;
+        }
+      if (FD_ISSET (polls[i].sock, &read_set))
+        {
+          polls[i].ready |= U64_SOCK_READ;
+        }
+      if (FD_ISSET (polls[i].sock, &write_set))
+        {
+          polls[i].ready |= U64_SOCK_WRITE;
+        }
+    }
+  return rc;
+}
+
+void
+U64_SockClose (LONG sock)
+{
+  if (sock >= 0)
+    {
+      CloseSocket (sock);
+    }
+}
+
+#elif defined(USE_POSIX_SOCKETS)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 /* BSDs: SO_NOSIGPIPE is set on the socket */
+#endif
+
+BOOL
+U64_SockReady (void)
+{
+  return TRUE;
+}
+
+LONG
+U64_SockError (void)
+{
+  return errno;
+}
+
+/* Open a non-blocking socket for ai and begin connecting it. Returns the
+   socket or -1 if the connect failed outright. */
+static int
+SockBegin (const struct addrinfo *ai)
+{
+  int sock, one = 1;
+
+  sock = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+  if (sock < 0)
+    {
+      return -1;
+    }
+
+  fcntl (sock, F_SETFL, fcntl (sock, F_GETFL, 0) | O_NONBLOCK);
+  /* Headers and body go out as separate sends; without this Nagle holds
+     the body back until the delayed ACK for the headers, ~40 ms */
+  setsockopt (sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+#ifdef SO_NOSIGPIPE
+  setsockopt (sock, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof (one));
+#endif
+  if (connect (sock, ai->ai_addr, ai->ai_addrlen) < 0 && errno != EINPROGRESS)
+    {
+      close (sock);
+      return -1;
+    }
+  return sock;
+}
+
+static LONG
+SockConnectOne (const struct addrinfo *ai, ULONG connect_s, ULONG io_s)
+{
+  struct timeval timeout;
+  int sock;
+
+  sock = SockBegin (ai);
+  if (sock < 0)
+    {
+      return -1;
+    }
+  if (U64_SockWait (sock, U64_SOCK_WRITE, connect_s) <= 0
+      || U64_SockFinish (sock) != U64_OK)
+    {
+      close (sock);
+      return -1;
+    }
+  fcntl (sock, F_SETFL, fcntl (sock, F_GETFL, 0) & ~O_NONBLOCK);
+
+  timeout.tv_sec = io_s;
+  timeout.tv_usec = 0;
+  setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+  setsockopt (sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+  return sock;
+}
+
+static int
+SockLookup (CONST_STRPTR host, UWORD port, struct addrinfo **list)
+{
+  struct addrinfo hints;
+  char service[8];
+  int rc;
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf (service, sizeof (service), "%u", (unsigned)port);
+  rc = getaddrinfo ((const char *)host, service, &hints, list);
+  if (rc != 0)
+    {
+      U64_DEBUG ("DNS lookup failed for %s: %s", (char *)host,
+                 gai_strerror (rc));
+    }
+  return rc;
+}
+
+LONG
+U64_SockConnect (CONST_STRPTR host, UWORD port, ULONG connect_s, ULONG io_s)
+{
+  struct addrinfo *list, *ai;
+  LONG sock = -1;
+
+  if (!host || SockLookup (host, port, &list) != 0)
+    {
+      return U64_ERR_NETWORK;
+    }
+
+  for (ai = list; ai && sock < 0; ai = ai->ai_next)
+    {
+      sock = SockConnectOne (ai, connect_s, io_s);
+    }
+  freeaddrinfo (list);
+
+  if (sock < 0)
+    {
+      U64_DEBUG ("Failed to connect to %s:%u", (char *)host, (unsigned)port);
+      return U64_ERR_NETWORK;
+    }
+  return sock;
+}
+
+/* Only the first address that takes the connect is tried; the caller
+   sees a refusal later, through U64_SockFinish. */
+LONG
+U64_SockStart (CONST_STRPTR host, UWORD port)
+{
+  struct addrinfo *list, *ai;
+  LONG sock = -1;
+
+  if (!host || SockLookup (host, port, &list) != 0)
+    {
+      return U64_ERR_NETWORK;
+    }
+
+  for (ai = list; ai && sock < 0; ai = ai->ai_next)
+    {
+      sock = SockBegin (ai);
+    }
+  freeaddrinfo (list);
+
+  if (sock < 0)
+    {
+      U64_DEBUG ("Failed to connect to %s:%u", (char *)host, (unsigned)port);
+      return U64_ERR_NETWORK;
+    }
+  return sock;
+}
+
+LONG
+U64_SockFinish (LONG sock)
+{
+  int so_err = 0;
+  socklen_t slen = sizeof (so_err);
+
+  if (getsockopt ((int)sock, SOL_SOCKET, SO_ERROR, &so_err, &slen) < 0
+      || so_err != 0)
+    {
+      return U64_ERR_NETWORK;
+    }
+  return U64_OK;
+}
+
+LONG
+U64_SockWait (LONG sock, ULONG events, ULONG timeout_s)
+{
+  struct pollfd pfd;
+  int rc;
+
+  pfd.fd = (int)sock;
+  pfd.events = ((events & U64_SOCK_READ) ? POLLIN : 0)
+               | ((events & U64_SOCK_WRITE) ? POLLOUT : 0);
+  pfd.revents = 0;
+  do
+    {
+      rc = poll (&pfd, 1, (int)(timeout_s * 1000));
+    }
+  while (rc < 0 && errno == EINTR);
+  return rc;
+}
+
+LONG
+U64_SockSendAll (LONG sock, CONST void *data, ULONG length, ULONG timeout_s,
+                 ULONG *sent)
+{
+  const unsigned char *p = data;
+  ULONG done = 0;
+
+  while (done < length)
+    {
+      ssize_t chunk = send ((int)sock, p + done, length - done, MSG_NOSIGNAL);
+
+      if (chunk < 0)
+        {
+          if (errno == EINTR
+              || ((errno == EAGAIN || errno == EWOULDBLOCK)
+                  && U64_SockWait (sock, U64_SOCK_WRITE, timeout_s) > 0))
+            {
+              continue;
+            }
+          U64_DEBUG ("send failed at %lu/%lu: errno=%d", (unsigned long)done,
+                     (unsigned long)length, errno);
+          break;
+        }
+      if (chunk == 0)
+        {
+          break;
+        }
+      done += (ULONG)chunk;
+      if (sent)
+        {
+          *sent += (ULONG)chunk;
+        }
+    }
+  return done == length ? U64_OK : U64_ERR_NETWORK;
+}
+
+LONG
+U64_SockRecv (LONG sock, void *buffer, ULONG size)
+{
+  ssize_t got;
+
+  do
+    {
+      got = recv ((int)sock, buffer, size, 0);
+    }
+  while (got < 0 && errno == EINTR);
+  return (LONG)got;
+}
+
+LONG
+U64_SockSend (LONG sock, CONST void *data, ULONG length)
+{
+  ssize_t chunk = send ((int)sock, data, length, MSG_NOSIGNAL);
+
+  if (chunk < 0 && U64_SockWouldBlock ())
+    {
+      return 0;
+    }
+  return (LONG)chunk;
+}
+
+BOOL
+U64_SockWouldBlock (void)
+{
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+LONG
+U64_SockWaitMany (U64SockPoll *polls, ULONG count, ULONG timeout_ms)
+{
+  struct pollfd pfds[U64_SOCK_WAIT_MAX];
+  ULONG i;
+  int rc;
+
+  if (count > U64_SOCK_WAIT_MAX)
+    {
+      count = U64_SOCK_WAIT_MAX;
+    }
+  for (i = 0; i < count; i++)
+    {
+      polls[i].ready = 0;
+      /* poll() skips negative descriptors */
+      pfds[i].fd = polls[i].events ? (int)polls[i].sock : -1;
+      pfds[i].events = ((polls[i].events & U64_SOCK_READ) ? POLLIN : 0)
+                       | ((polls[i].events & U64_SOCK_WRITE) ? POLLOUT : 0);
+      pfds[i].revents = 0;
+    }
+
+  do
+    {
+      rc = poll (pfds, count, (int)timeout_ms);
+    }
+  while (rc < 0 && errno == EINTR);
+  if (rc <= 0)
+    {
+      return rc;
+    }
+
+  /* Errors and hangups count as ready, so the caller's next call on the
+     socket reports them */
+  for (i = 0; i < count; i++)
+    {
+      if (pfds[i].revents & (POLLIN | POLLERR | POLLHUP))
+        {
+          polls[i].ready |= polls[i].events & U64_SOCK_READ;
+        }
+      if (pfds[i].revents & (POLLOUT | POLLERR | POLLHUP))
+        {
+          polls[i].ready |= polls[i].events & U64_SOCK_WRITE;
+        }
+    }
+  return rc;
+}
+
+void
+U64_SockClose (LONG sock)
+{
+  if (sock >= 0)
+    {
+      close ((int)sock);
+    }
+}
+
+#else /* no socket stack */
+
+BOOL
+U64_SockReady (void)
+{
+  return FALSE;
+}
+
+LONG
+U64_SockError (void)
+{
+  return 0;
+}
+
+LONG
+U64_SockConnect (CONST_STRPTR host, UWORD port, ULONG connect_s, ULONG io_s)
+{
+  U64_DEBUG ("Network not supported (no socket backend built in)");
+  return U64_ERR_NETWORK;
+}
+
+LONG
+U64_SockWait (LONG sock, ULONG events, ULONG timeout_s)
+{
+  return -1;
+}
+
+LONG
+U64_SockSendAll (LONG sock, CONST void *data, ULONG length, ULONG timeout_s,
+                 ULONG *sent)
+{
+  return U64_ERR_NETWORK;
+}
+
+LONG
+U64_SockRecv (LONG sock, void *buffer, ULONG size)
+{
+  return -1;
+}
+
+LONG
+U64_SockStart (CONST_STRPTR host, UWORD port)
+{
+  return U64_ERR_NETWORK;
+}
+
+LONG
+U64_SockFinish (LONG sock)
+{
+  return U64_ERR_NETWORK;
+}
+
+LONG
+U64_SockSend (LONG sock, CONST void *data, ULONG length)
+{
+  return -1;
+}
+
+BOOL
+U64_SockWouldBlock (void)
+{
+  return FALSE;
+}
+
+LONG
+U64_SockWaitMany (U64SockPoll *polls, ULONG count, ULONG timeout_ms)
+{
+  return -1;
+}
+
+void
+U64_SockClose (LONG sock)
+{
+}
+
+#endif
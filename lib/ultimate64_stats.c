@@ -0,0 +1,293 @@
+/* Ultimate64/Ultimate-II Control Library for Amiga OS 3.x
+ * Per-endpoint request statistics
+ *
+ * U64_HttpRequest and the download helpers fill in a U64StatsSample as a
+ * request goes - connected, first byte in, bytes each way - and hand it
+ * to U64_StatsRecord on the way out, which folds it into the endpoint's
+ * counters and histograms. Timing comes from timer.device's ReadEClock,
+ * which is a register read rather than an I/O request, so this stays on
+ * in every build; without timer.device the times simply read as zero.
+ */
+
+#include <devices/timer.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#include "ultimate64_amiga.h"
+#include "ultimate64_private.h"
+
+/* Kept private so applications that open timer.device themselves don't
+   clash with us over the TimerBase symbol */
+static struct Device *u64_timer_base = NULL;
+#define TimerBase u64_timer_base
+#include <proto/timer.h>
+
+static struct timerequest stats_timer;
+static ULONG eclock_freq = 0;
+
+/* Downloads made without a connection */
+static U64Stats *transfer_stats = NULL;
+
+static const ULONG bucket_limits[U64_STATS_BUCKETS]
+    = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 0xFFFFFFFFUL };
+
+void
+U64_StatsInit (void)
+{
+  struct EClockVal now;
+
+  if (u64_timer_base)
+    {
+      return;
+    }
+  memset (&stats_timer, 0, sizeof (stats_timer));
+  if (OpenDevice ((CONST_STRPTR)TIMERNAME, UNIT_ECLOCK,
+                  (struct IORequest *)&stats_timer, 0)
+      != 0)
+    {
+      U64_DEBUG ("timer.device unavailable, request times will read 0");
+      return;
+    }
+  u64_timer_base = stats_timer.tr_node.io_Device;
+  eclock_freq = ReadEClock (&now);
+}
+
+void
+U64_StatsCleanup (void)
+{
+  if (transfer_stats)
+    {
+      FreeMem (transfer_stats, sizeof (U64Stats));
+      transfer_stats = NULL;
+    }
+  if (u64_timer_base)
+    {
+      CloseDevice ((struct IORequest *)&stats_timer);
+      u64_timer_base = NULL;
+      eclock_freq = 0;
+    }
+}
+
+static ULONG
+StatsNow (void)
+{
+  struct EClockVal now;
+
+  if (!u64_timer_base)
+    {
+      return 0;
+    }
+  ReadEClock (&now);
+  return now.ev_lo;
+}
+
+void
+U64_StatsBegin (U64StatsSample *sample)
+{
+  sample->start = StatsNow ();
+  sample->connect_ms = U64_STATS_NONE;
+  sample->first_byte_ms = U64_STATS_NONE;
+  sample->bytes_sent = 0;
+  sample->bytes_received = 0;
+}
+
+/* Milliseconds since U64_StatsBegin. The low E-clock longword wraps after
+   well over an hour, far longer than any request is allowed to take. */
+ULONG
+U64_StatsSince (CONST U64StatsSample *sample)
+{
+  ULONG ticks;
+
+  if (!eclock_freq)
+    {
+      return 0;
+    }
+  ticks = StatsNow () - sample->start;
+  return (ticks / eclock_freq) * 1000 + (ticks % eclock_freq) * 1000
+                                            / eclock_freq;
+}
+
+/* Fold path into an endpoint name: "/v1/<resource>" is kept and anything
+   deeper collapses to a '*' segment keeping its ":action" suffix, so the
+   mount requests for drives a and b share one entry. Query strings are
+   dropped. A bare host name is used as is. */
+static void
+StatsEndpointName (char *name, CONST_STRPTR method, CONST_STRPTR path)
+{
+  const char *p = path ? (const char *)path : "/";
+  const char *end = p + strcspn (p, "?");
+  const char *deep = p;
+  const char *action;
+  ULONG len, slashes = 0;
+
+  while (deep < end && !(*deep == '/' && ++slashes == 3))
+    {
+      deep++;
+    }
+
+  len = strlen ((const char *)method);
+  CopyMem ((APTR)method, name, len);
+  name[len++] = ' ';
+  while (p < deep && len < U64_STATS_NAME_LEN - 1)
+    {
+      name[len++] = *p++;
+    }
+  if (deep < end && len < U64_STATS_NAME_LEN - 3)
+    {
+      name[len++] = '/';
+      name[len++] = '*';
+      for (action = end; action > deep && action[-1] != ':'; action--)
+        ;
+      if (action > deep)
+        {
+          for (action--; action < end && len < U64_STATS_NAME_LEN - 1;)
+            {
+              name[len++] = *action++;
+            }
+        }
+    }
+  name[len] = '\0';
+}
+
+static void
+StatsAddSample (U64Histogram *hist, ULONG ms)
+{
+  ULONG i = 0;
+
+  while (ms >= bucket_limits[i] && i < U64_STATS_BUCKETS - 1)
+    {
+      i++;
+    }
+  hist->buckets[i]++;
+  hist->count++;
+  hist->total_ms += ms;
+  if (ms > hist->max_ms)
+    {
+      hist->max_ms = ms;
+    }
+}
+
+void
+U64_StatsRecord (U64Connection *conn, CONST_STRPTR method, CONST_STRPTR path,
+                 CONST U64StatsSample *sample, LONG result)
+{
+  U64Stats **slot = conn ? &conn->stats : &transfer_stats;
+  U64Stats *stats = *slot;
+  U64EndpointStats *ep = NULL;
+  char name[U64_STATS_NAME_LEN];
+  ULONG i;
+
+  if (!stats)
+    {
+      stats = AllocMem (sizeof (U64Stats), MEMF_PUBLIC | MEMF_CLEAR);
+      if (!stats)
+        {
+          return;
+        }
+      *slot = stats;
+    }
+
+  StatsEndpointName (name, method, path);
+  for (i = 0; i < stats->endpoint_count; i++)
+    {
+      if (strcmp (stats->endpoints[i].name, name) == 0)
+        {
+          ep = &stats->endpoints[i];
+          break;
+        }
+    }
+  if (!ep)
+    {
+      if (stats->endpoint_count < U64_STATS_MAX_ENDPOINTS - 1)
+        {
+          ep = &stats->endpoints[stats->endpoint_count++];
+          strcpy (ep->name, name);
+        }
+      else
+        {
+          ep = &stats->endpoints[U64_STATS_MAX_ENDPOINTS - 1];
+          if (stats->endpoint_count < U64_STATS_MAX_ENDPOINTS)
+            {
+              stats->endpoint_count = U64_STATS_MAX_ENDPOINTS;
+              strcpy (ep->name, "(other)");
+            }
+        }
+    }
+
+  ep->requests++;
+  ep->bytes_sent += sample->bytes_sent;
+  ep->bytes_received += sample->bytes_received;
+  if (sample->connect_ms != U64_STATS_NONE)
+    {
+      StatsAddSample (&ep->connect, sample->connect_ms);
+    }
+  if (sample->first_byte_ms != U64_STATS_NONE)
+    {
+      StatsAddSample (&ep->first_byte, sample->first_byte_ms);
+    }
+  StatsAddSample (&ep->total, U64_StatsSince (sample));
+  if (result < 0 && -result < U64_STATS_ERRORS)
+    {
+      ep->errors[-result]++;
+    }
+}
+
+/* Release a connection's statistics (U64_Disconnect) */
+void
+U64_StatsFree (U64Connection *conn)
+{
+  if (conn->stats)
+    {
+      FreeMem (conn->stats, sizeof (U64Stats));
+      conn->stats = NULL;
+    }
+}
+
+CONST U64Stats *
+U64_GetStats (U64Connection *conn)
+{
+  return conn ? conn->stats : transfer_stats;
+}
+
+void
+U64_ResetStats (U64Connection *conn)
+{
+  U64Stats *stats = conn ? conn->stats : transfer_stats;
+
+  if (stats)
+    {
+      memset (stats, 0, sizeof (U64Stats));
+    }
+}
+
+ULONG
+U64_StatsBucketLimit (ULONG bucket)
+{
+  return bucket < U64_STATS_BUCKETS ? bucket_limits[bucket] : 0xFFFFFFFFUL;
+}
+
+ULONG
+U64_StatsPercentile (CONST U64Histogram *hist, ULONG percent)
+{
+  ULONG wanted, seen = 0, i;
+
+  if (!hist || !hist->count)
+    {
+      return 0;
+    }
+  wanted = (hist->count * percent + 99) / 100;
+  for (i = 0; i < U64_STATS_BUCKETS - 1; i++)
+    {
+      seen += hist->buckets[i];
+      /* A bucket's bound can lie past every sample in it */
+      if (seen >= wanted)
+        {
+          return bucket_limits[i] < hist->max_ms ? bucket_limits[i]
+                                                 : hist->max_ms;
+        }
+    }
+  return hist->max_ms;
+}
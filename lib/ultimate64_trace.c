@@ -0,0 +1,451 @@
+/* Ultimate64/Ultimate-II Control Library for Amiga OS 3.x
+ * HTTP trace recording and replay
+ *
+ * A trace file starts with the 8 bytes "U64TRACE" and a version longword,
+ * followed by one record per request. All numbers are big-endian.
+ *
+ *     ULONG  length           bytes after this field
+ *     UBYTE  method           HTTP_GET ... HTTP_DELETE
+ *     UBYTE  reserved
+ *     UWORD  status_code      0 if no reply was parsed
+ *     LONG   result           what U64_HttpRequest returned
+ *     ULONG  connect_ms       ~0 if it never connected
+ *     ULONG  first_byte_ms    ~0 if nothing arrived
+ *     ULONG  total_ms
+ *     UWORD  path_length
+ *     UWORD  header_length    request headers as sent
+ *     ULONG  body_length      request body
+ *     ULONG  reply_length     raw reply: status line, headers, body
+ *     UWORD  host_length      device, "host" or "host:port"
+ *     UWORD  reserved
+ *     path, host, headers, body, reply
+ *
+ * Version 1 files lack host_length and the host; they still replay.
+ *
+ * The X-password header is blanked out before it is written. Replay
+ * reads records in order, skipping any whose method and path don't match
+ * the request, and goes back to the start once when it runs off the end,
+ * so a session that repeats itself can run for longer than it was
+ * recorded. Records are fixed-layout and self-sized, so tools on other
+ * machines can read them without this library.
+ *
+ * A fleet records all its devices into one file, each connection sharing
+ * the same U64Trace, and replays it with one reader per device that only
+ * takes records of its own host.
+ */
+
+#include <dos/dos.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#include "ultimate64_amiga.h"
+#include "ultimate64_private.h"
+
+#define TRACE_MAGIC "U64TRACE"
+#define TRACE_VERSION 2
+#define TRACE_FILE_HEADER 12
+#define TRACE_RECORD_FIXED 36
+#define TRACE_RECORD_FIXED_V1 32
+#define TRACE_MAX_PATH 1024
+
+static const char *trace_methods[] = { "GET", "POST", "PUT", "DELETE" };
+
+static void
+PutWord (UBYTE *p, UWORD value)
+{
+  p[0] = (UBYTE)(value >> 8);
+  p[1] = (UBYTE)value;
+}
+
+static void
+PutLong (UBYTE *p, ULONG value)
+{
+  p[0] = (UBYTE)(value >> 24);
+  p[1] = (UBYTE)(value >> 16);
+  p[2] = (UBYTE)(value >> 8);
+  p[3] = (UBYTE)value;
+}
+
+static UWORD
+GetWord (CONST UBYTE *p)
+{
+  return (UWORD)((p[0] << 8) | p[1]);
+}
+
+static ULONG
+GetLong (CONST UBYTE *p)
+{
+  return ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8)
+         | p[3];
+}
+
+static LONG
+TraceOpen (U64Connection *conn, CONST_STRPTR filename, UBYTE mode,
+           ULONG time_percent)
+{
+  U64Trace *trace;
+  UBYTE header[TRACE_FILE_HEADER];
+
+  if (!conn || !filename)
+    {
+      return U64_ERR_INVALID;
+    }
+  U64_TraceStop (conn);
+
+  trace = AllocMem (sizeof (U64Trace), MEMF_PUBLIC | MEMF_CLEAR);
+  if (!trace)
+    {
+      return U64_ERR_MEMORY;
+    }
+  trace->mode = mode;
+  trace->version = TRACE_VERSION;
+  trace->time_percent = time_percent;
+  trace->users = 1;
+
+  if (mode == U64_TRACE_RECORD)
+    {
+      trace->file = Open (filename, MODE_NEWFILE);
+      CopyMem (TRACE_MAGIC, header, 8);
+      PutLong (header + 8, TRACE_VERSION);
+      if (trace->file
+          && Write (trace->file, header, sizeof (header)) != sizeof (header))
+        {
+          Close (trace->file);
+          trace->file = 0;
+        }
+    }
+  else
+    {
+      trace->file = Open (filename, MODE_OLDFILE);
+      if (trace->file
+          && (Read (trace->file, header, sizeof (header)) != sizeof (header)
+              || memcmp (header, TRACE_MAGIC, 8) != 0
+              || GetLong (header + 8) < 1
+              || GetLong (header + 8) > TRACE_VERSION))
+        {
+          U64_DEBUG ("%s is not a trace file", (char *)filename);
+          Close (trace->file);
+          FreeMem (trace, sizeof (U64Trace));
+          return U64_ERR_INVALID;
+        }
+    }
+
+  if (!trace->file)
+    {
+      U64_DEBUG ("Cannot open trace file %s", (char *)filename);
+      FreeMem (trace, sizeof (U64Trace));
+      return U64_ERR_ACCESS;
+    }
+  if (mode == U64_TRACE_REPLAY)
+    {
+      trace->version = (UBYTE)GetLong (header + 8);
+    }
+
+  conn->trace = trace;
+  return U64_OK;
+}
+
+/* Record every request conn makes to filename (replacing it) */
+LONG
+U64_TraceRecord (U64Connection *conn, CONST_STRPTR filename)
+{
+  return TraceOpen (conn, filename, U64_TRACE_RECORD, 0);
+}
+
+/* Serve conn's requests from filename instead of the network */
+LONG
+U64_TraceReplay (U64Connection *conn, CONST_STRPTR filename,
+                 ULONG time_percent)
+{
+  return TraceOpen (conn, filename, U64_TRACE_REPLAY, time_percent);
+}
+
+/* Stop recording or replaying and close the file; also U64_Disconnect.
+   A shared recording is closed by the last connection to let go of it. */
+void
+U64_TraceStop (U64Connection *conn)
+{
+  if (conn && conn->trace)
+    {
+      if (--conn->trace->users == 0)
+        {
+          U64_DEBUG ("Trace closed after %lu records",
+                     (unsigned long)conn->trace->records);
+          Close (conn->trace->file);
+          FreeMem (conn->trace, sizeof (U64Trace));
+        }
+      conn->trace = NULL;
+    }
+}
+
+/* Have to record into the same file as from */
+void
+U64_TraceShare (U64Connection *from, U64Connection *to)
+{
+  if (!from->trace || from->trace->mode != U64_TRACE_RECORD || from == to)
+    {
+      return;
+    }
+  U64_TraceStop (to);
+  to->trace = from->trace;
+  to->trace->users++;
+}
+
+/* Replay only the records conn's own device made */
+void
+U64_TraceSetHost (U64Connection *conn)
+{
+  if (conn->trace && conn->trace->mode == U64_TRACE_REPLAY)
+    {
+      U64_ConnName (conn, conn->trace->host, sizeof (conn->trace->host));
+    }
+}
+
+/* Append one exchange to the trace being recorded. A failed write ends
+   the recording rather than leaving a torn record for replay to trip on. */
+void
+U64_TraceWrite (U64Connection *conn, HttpRequest *req, CONST char *header,
+                ULONG header_len, CONST char *response, ULONG response_len,
+                CONST U64StatsSample *sample, LONG result)
+{
+  U64Trace *trace = conn->trace;
+  UBYTE fixed[4 + TRACE_RECORD_FIXED];
+  CONST char *path = req->path ? (CONST char *)req->path : "/";
+  ULONG path_len = strlen (path);
+  ULONG body_len = req->body ? req->body_size : 0;
+  char host[U64_TRACE_HOST_LEN];
+  ULONG host_len;
+  char *headers = NULL;
+  char *password;
+  U64ArenaMark mark;
+  BOOL ok;
+
+  if (trace->mode != U64_TRACE_RECORD)
+    {
+      return;
+    }
+  if (path_len >= TRACE_MAX_PATH)
+    {
+      path_len = TRACE_MAX_PATH - 1;
+    }
+  if (!response)
+    {
+      response_len = 0;
+    }
+  U64_ConnName (conn, host, sizeof (host));
+  host_len = strlen (host);
+
+  /* Blank the password in a copy of the headers */
+  mark = U64_ArenaGetMark (conn);
+  if (header_len > 0)
+    {
+      headers = U64_ArenaAlloc (conn, header_len + 1);
+      if (!headers)
+        {
+          header_len = 0;
+        }
+      else
+        {
+          CopyMem ((APTR)header, headers, header_len);
+          headers[header_len] = '\0';
+          password = strstr (headers, "X-password: ");
+          if (password)
+            {
+              for (password += 12; *password && *password != '\r';)
+                {
+                  *password++ = '*';
+                }
+            }
+        }
+    }
+
+  PutLong (fixed, TRACE_RECORD_FIXED + path_len + host_len + header_len
+                      + body_len + response_len);
+  fixed[4] = req->method;
+  fixed[5] = 0;
+  PutWord (fixed + 6, req->status_code);
+  PutLong (fixed + 8, (ULONG)result);
+  PutLong (fixed + 12, sample->connect_ms);
+  PutLong (fixed + 16, sample->first_byte_ms);
+  PutLong (fixed + 20, U64_StatsSince (sample));
+  PutWord (fixed + 24, (UWORD)path_len);
+  PutWord (fixed + 26, (UWORD)header_len);
+  PutLong (fixed + 28, body_len);
+  PutLong (fixed + 32, response_len);
+  PutWord (fixed + 36, (UWORD)host_len);
+  PutWord (fixed + 38, 0);
+
+  ok = Write (trace->file, fixed, sizeof (fixed)) == sizeof (fixed)
+       && Write (trace->file, (APTR)path, path_len) == (LONG)path_len
+       && Write (trace->file, host, host_len) == (LONG)host_len
+       && (!header_len
+           || Write (trace->file, headers, header_len) == (LONG)header_len)
+       && (!body_len
+           || Write (trace->file, req->body, body_len) == (LONG)body_len)
+       && (!response_len
+           || Write (trace->file, (APTR)response, response_len)
+                  == (LONG)response_len);
+
+  U64_ArenaRelease (conn, mark);
+
+  if (!ok)
+    {
+      U64_DEBUG ("Trace write failed, recording stopped");
+      trace->mode = 0; /* stops the connections sharing it too */
+      U64_TraceStop (conn);
+      return;
+    }
+  trace->records++;
+}
+
+/* Find the next record for method and path (and the trace's host, if it
+   has one) and leave the file at its request headers; fixed receives the
+   record's fixed part. */
+static BOOL
+TraceFind (U64Trace *trace, UBYTE method, CONST char *path,
+           UBYTE fixed[4 + TRACE_RECORD_FIXED])
+{
+  char record_path[TRACE_MAX_PATH];
+  char record_host[U64_TRACE_HOST_LEN];
+  ULONG fixed_size = trace->version < 2 ? TRACE_RECORD_FIXED_V1
+                                        : TRACE_RECORD_FIXED;
+  ULONG want_len = strlen (path);
+  ULONG want_host = strlen (trace->host);
+  BOOL wrapped = FALSE;
+
+  for (;;)
+    {
+      ULONG length, path_len, host_len, consumed = 0;
+
+      if (Read (trace->file, fixed, 4 + fixed_size) != (LONG)(4 + fixed_size))
+        {
+          /* Off the end: go round once more before giving up */
+          if (wrapped)
+            {
+              return FALSE;
+            }
+          wrapped = TRUE;
+          Seek (trace->file, TRACE_FILE_HEADER, OFFSET_BEGINNING);
+          continue;
+        }
+
+      length = GetLong (fixed);
+      path_len = GetWord (fixed + 24);
+      host_len = trace->version < 2 ? 0 : GetWord (fixed + 36);
+      if (length < fixed_size + path_len + host_len)
+        {
+          U64_DEBUG ("Trace record is corrupt");
+          return FALSE;
+        }
+
+      if (fixed[4] == method && path_len == want_len
+          && path_len < TRACE_MAX_PATH
+          && (!want_host || host_len == want_host))
+        {
+          consumed = path_len;
+          if (Read (trace->file, record_path, path_len) == (LONG)path_len
+              && memcmp (record_path, path, path_len) == 0)
+            {
+              if (!want_host)
+                {
+                  Seek (trace->file, host_len, OFFSET_CURRENT);
+                  return TRUE;
+                }
+              consumed += host_len;
+              if (Read (trace->file, record_host, host_len) == (LONG)host_len
+                  && memcmp (record_host, trace->host, host_len) == 0)
+                {
+                  return TRUE;
+                }
+            }
+        }
+
+      /* Skip the rest of the record */
+      Seek (trace->file, length - fixed_size - consumed, OFFSET_CURRENT);
+    }
+}
+
+/* U64_HttpRequest in replay mode: the recorded reply, after the recorded
+   time scaled by time_percent */
+LONG
+U64_TraceReplayRequest (U64Connection *conn, HttpRequest *req)
+{
+  U64Trace *trace = conn->trace;
+  UBYTE fixed[4 + TRACE_RECORD_FIXED];
+  CONST char *path = req->path ? (CONST char *)req->path : "/";
+  U64StatsSample sample;
+  U64ArenaMark mark;
+  BOOL borrowed = FALSE;
+  ULONG header_len, body_len, response_len, wait_ms;
+  char *response = NULL;
+  LONG result;
+
+  req->response = NULL;
+  req->response_size = 0;
+  req->status_code = 0;
+
+  U64_StatsBegin (&sample);
+  mark = U64_ArenaGetMark (conn);
+
+  if (!TraceFind (trace, req->method, path, fixed))
+    {
+      U64_DEBUG ("Trace has no reply for %s %s", trace_methods[req->method],
+                 path);
+      result = U64_ERR_NOTFOUND;
+      goto done;
+    }
+
+  header_len = GetWord (fixed + 26);
+  body_len = GetLong (fixed + 28);
+  response_len = GetLong (fixed + 32);
+  result = (LONG)GetLong (fixed + 8);
+  sample.bytes_sent = header_len + body_len;
+  sample.bytes_received = response_len;
+
+  Seek (trace->file, header_len + body_len, OFFSET_CURRENT);
+  if (response_len > 0)
+    {
+      response = U64_ArenaAlloc (conn, response_len + 1);
+      if (!response)
+        {
+          Seek (trace->file, response_len, OFFSET_CURRENT);
+          result = U64_ERR_MEMORY;
+          goto done;
+        }
+      if (Read (trace->file, response, response_len) != (LONG)response_len)
+        {
+          result = U64_ERR_NETWORK;
+          goto done;
+        }
+      response[response_len] = '\0';
+    }
+  trace->records++;
+
+  /* Delay counts 50ths of a second */
+  wait_ms = GetLong (fixed + 20) / 100 * trace->time_percent
+            + GetLong (fixed + 20) % 100 * trace->time_percent / 100;
+  if (wait_ms >= 20)
+    {
+      Delay (wait_ms / 20);
+    }
+
+  /* Replies that never arrived replay as the error they ended in */
+  if (response)
+    {
+      result = U64_HttpParseResponse (req, response, response_len,
+                                      &borrowed);
+    }
+
+done:
+  if (!borrowed)
+    {
+      U64_ArenaRelease (conn, mark);
+    }
+  U64_StatsRecord (conn, (CONST_STRPTR)trace_methods[req->method], req->path,
+                   &sample, result);
+  return result;
+}
@@ -34,6 +34,25 @@ U64_DebugPrintf (CONST_STRPTR format, ...)
 }
 #endif
 
+/* Hex-encode length bytes into out (2 * length + 1 bytes, uppercase, NUL
+   terminated) as the REST API takes them; returns the number of digits.
+   Written straight through a pointer so long payloads stay linear. */
+ULONG
+U64_HexEncode (CONST UBYTE *data, ULONG length, STRPTR out)
+{
+  static const char digits[] = "0123456789ABCDEF";
+  STRPTR p = out;
+
+  while (length--)
+    {
+      UBYTE b = *data++;
+      *p++ = digits[b >> 4];
+      *p++ = digits[b & 0x0F];
+    }
+  *p = '\0';
+  return (ULONG)(p - out);
+}
+
 /* Async support functions */
 #ifdef U64_ASYNC_SUPPORT
 
@@ -0,0 +1,656 @@
+/* Ultimate64 Control - host build
+ * Just enough of exec.library, dos.library and timer.device for the
+ * library and u64cli to run on a POSIX host (make host), so they can be
+ * exercised against u64sim without an Amiga.
+ */
+
+#include <dos/dos.h>
+#include <dos/rdargs.h>
+#include <dos/var.h>
+#include <devices/timer.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/timer.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DOSTRUE (-1L)
+
+/* Stand-ins for the things the library only checks are there */
+static struct ExecBase host_exec;
+static ULONG host_dummy;
+
+static int host_argc = 0;
+static char **host_argv = NULL;
+static volatile sig_atomic_t host_break = 0;
+
+static void
+HostBreak (int sig)
+{
+  (void)sig;
+  host_break = 1;
+}
+
+void
+U64Host_Init (int argc, char **argv)
+{
+  host_argc = argc;
+  host_argv = argv;
+  SysBase = &host_exec;
+  host_exec.LastAlert[0] = (ULONG)getpid ();
+  signal (SIGINT, HostBreak);
+}
+
+/* exec.library */
+
+APTR
+AllocMem (ULONG size, ULONG flags)
+{
+  (void)flags;
+  return calloc (1, size);
+}
+
+void
+FreeMem (APTR memory, ULONG size)
+{
+  (void)size;
+  free (memory);
+}
+
+APTR
+AllocVec (ULONG size, ULONG flags)
+{
+  (void)flags;
+  return calloc (1, size);
+}
+
+void
+FreeVec (APTR memory)
+{
+  free (memory);
+}
+
+/* A pool keeps its allocations on a list so DeletePool can free what the
+   caller never handed back, as exec does */
+typedef struct HostPoolNode
+{
+  struct HostPoolNode *next;
+  struct HostPoolNode *prev;
+} HostPoolNode;
+
+APTR
+CreatePool (ULONG flags, ULONG puddle, ULONG threshold)
+{
+  HostPoolNode *pool = calloc (1, sizeof (HostPoolNode));
+
+  (void)flags;
+  (void)puddle;
+  (void)threshold;
+  if (pool)
+    {
+      pool->next = pool->prev = pool;
+    }
+  return pool;
+}
+
+APTR
+AllocPooled (APTR pool, ULONG size)
+{
+  HostPoolNode *head = pool;
+  HostPoolNode *node = calloc (1, sizeof (HostPoolNode) + size);
+
+  if (!node)
+    {
+      return NULL;
+    }
+  node->next = head->next;
+  node->prev = head;
+  head->next->prev = node;
+  head->next = node;
+  return node + 1;
+}
+
+void
+FreePooled (APTR pool, APTR memory, ULONG size)
+{
+  HostPoolNode *node = (HostPoolNode *)memory - 1;
+
+  (void)pool;
+  (void)size;
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  free (node);
+}
+
+void
+DeletePool (APTR pool)
+{
+  HostPoolNode *head = pool;
+
+  if (!head)
+    {
+      return;
+    }
+  while (head->next != head)
+    {
+      FreePooled (pool, head->next + 1, 0);
+    }
+  free (head);
+}
+
+void
+CopyMem (const void *source, APTR dest, ULONG size)
+{
+  memmove (dest, source, size);
+}
+
+struct Library *
+OpenLibrary (CONST_STRPTR name, ULONG version)
+{
+  (void)version;
+  return strcmp (name, "dos.library") == 0 ? (struct Library *)&host_dummy
+                                           : NULL;
+}
+
+void
+CloseLibrary (struct Library *library)
+{
+  (void)library;
+}
+
+LONG
+OpenDevice (CONST_STRPTR name, ULONG unit, struct IORequest *io, ULONG flags)
+{
+  (void)unit;
+  (void)flags;
+  if (strcmp (name, TIMERNAME) != 0)
+    {
+      return -1;
+    }
+  io->io_Device = (struct Device *)&host_dummy;
+  return 0;
+}
+
+void
+CloseDevice (struct IORequest *io)
+{
+  io->io_Device = NULL;
+}
+
+APTR
+FindTask (CONST_STRPTR name)
+{
+  (void)name;
+  return &host_exec;
+}
+
+ULONG
+SetSignal (ULONG new_signals, ULONG mask)
+{
+  ULONG old = host_break ? SIGBREAKF_CTRL_C : 0;
+
+  if (mask & SIGBREAKF_CTRL_C)
+    {
+      host_break = (new_signals & SIGBREAKF_CTRL_C) != 0;
+    }
+  return old;
+}
+
+/* timer.device: microseconds since an arbitrary start */
+
+ULONG
+ReadEClock (struct EClockVal *dest)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  dest->ev_hi = 0;
+  dest->ev_lo = (ULONG)ts.tv_sec * 1000000UL + (ULONG)ts.tv_nsec / 1000;
+  return 1000000UL;
+}
+
+/* dos.library */
+
+/* Where ENV: and ENVARC: live on this host */
+static const char *
+HostEnvDir (void)
+{
+  static char dir[512];
+  const char *env = getenv ("U64_ENV");
+  const char *home;
+
+  if (env && *env)
+    {
+      return env;
+    }
+  if (!dir[0])
+    {
+      home = getenv ("HOME");
+      snprintf (dir, sizeof (dir), "%s/.u64env", home ? home : ".");
+    }
+  return dir;
+}
+
+/* Map an AmigaDOS name onto a host path */
+static const char *
+HostPath (CONST_STRPTR name, char *buffer, size_t size)
+{
+  if (strncasecmp (name, "ENV:", 4) == 0)
+    {
+      snprintf (buffer, size, "%s/%s", HostEnvDir (), name + 4);
+      return buffer;
+    }
+  if (strncasecmp (name, "ENVARC:", 7) == 0)
+    {
+      snprintf (buffer, size, "%s/%s", HostEnvDir (), name + 7);
+      return buffer;
+    }
+  return name;
+}
+
+BPTR
+Open (CONST_STRPTR name, LONG mode)
+{
+  char path[1024];
+  const char *how = mode == MODE_NEWFILE     ? "wb"
+                    : mode == MODE_READWRITE ? "r+b"
+                                             : "rb";
+  FILE *file = fopen (HostPath (name, path, sizeof (path)), how);
+
+  if (!file && mode == MODE_READWRITE)
+    {
+      file = fopen (path, "w+b");
+    }
+  return (BPTR)file;
+}
+
+LONG
+Close (BPTR file)
+{
+  return file && fclose ((FILE *)file) == 0 ? DOSTRUE : 0;
+}
+
+LONG
+Read (BPTR file, APTR buffer, LONG length)
+{
+  size_t got = fread (buffer, 1, length, (FILE *)file);
+
+  return got == 0 && ferror ((FILE *)file) ? -1 : (LONG)got;
+}
+
+LONG
+Write (BPTR file, CONST void *buffer, LONG length)
+{
+  size_t put = fwrite (buffer, 1, length, (FILE *)file);
+
+  return put == 0 && length > 0 ? -1 : (LONG)put;
+}
+
+LONG
+Seek (BPTR file, LONG position, LONG mode)
+{
+  long old = ftell ((FILE *)file);
+  int whence = mode == OFFSET_BEGINNING ? SEEK_SET
+               : mode == OFFSET_END     ? SEEK_END
+                                        : SEEK_CUR;
+
+  if (old < 0 || fseek ((FILE *)file, position, whence) != 0)
+    {
+      return -1;
+    }
+  return old;
+}
+
+LONG
+DeleteFile (CONST_STRPTR name)
+{
+  char path[1024];
+
+  return remove (HostPath (name, path, sizeof (path))) == 0 ? DOSTRUE : 0;
+}
+
+BPTR
+CreateDir (CONST_STRPTR name)
+{
+  char path[1024];
+
+  if (mkdir (HostPath (name, path, sizeof (path)), 0755) != 0
+      && errno != EEXIST)
+    {
+      return 0;
+    }
+  return (BPTR)1;
+}
+
+STRPTR
+FilePart (CONST_STRPTR path)
+{
+  const char *part = path;
+  const char *p;
+
+  for (p = path; *p; p++)
+    {
+      if (*p == '/' || *p == ':')
+        {
+          part = p + 1;
+        }
+    }
+  return (STRPTR)part;
+}
+
+void
+Delay (LONG ticks)
+{
+  struct timespec ts;
+
+  ts.tv_sec = ticks / TICKS_PER_SECOND;
+  ts.tv_nsec = (ticks % TICKS_PER_SECOND) * (1000000000L / TICKS_PER_SECOND);
+  nanosleep (&ts, NULL);
+}
+
+ULONG
+CheckSignal (ULONG mask)
+{
+  return SetSignal (0, mask) & mask;
+}
+
+/* Variables are files in the ENV: directory; there are no local ones */
+
+LONG
+GetVar (CONST_STRPTR name, STRPTR buffer, LONG size, ULONG flags)
+{
+  char path[1024];
+  FILE *file;
+  size_t got;
+
+  (void)flags;
+  if (size <= 0)
+    {
+      return -1;
+    }
+  snprintf (path, sizeof (path), "%s/%s", HostEnvDir (), name);
+  file = fopen (path, "rb");
+  if (!file)
+    {
+      return -1;
+    }
+  got = fread (buffer, 1, size - 1, file);
+  fclose (file);
+  buffer[got] = '\0';
+  return (LONG)got;
+}
+
+BOOL
+SetVar (CONST_STRPTR name, CONST_STRPTR buffer, LONG size, ULONG flags)
+{
+  char path[1024];
+  char *slash;
+  FILE *file;
+
+  (void)flags;
+  if (size < 0)
+    {
+      size = strlen (buffer);
+    }
+  mkdir (HostEnvDir (), 0755);
+  snprintf (path, sizeof (path), "%s/%s", HostEnvDir (), name);
+  slash = strrchr (path, '/');
+  *slash = '\0';
+  mkdir (path, 0755);
+  *slash = '/';
+
+  file = fopen (path, "wb");
+  if (!file)
+    {
+      return FALSE;
+    }
+  fwrite (buffer, 1, size, file);
+  return fclose (file) == 0;
+}
+
+BOOL
+DeleteVar (CONST_STRPTR name, ULONG flags)
+{
+  char path[1024];
+
+  (void)flags;
+  snprintf (path, sizeof (path), "%s/%s", HostEnvDir (), name);
+  return remove (path) == 0;
+}
+
+/* ReadArgs over the argv from U64Host_Init. Handles the /A /K /S /N /M
+   modifiers and KEY=value, the way the CLI templates use them. */
+
+#define HOST_MAX_ITEMS 32
+
+struct RDArgs
+{
+  LONG numbers[HOST_MAX_ITEMS];
+  STRPTR *multi;
+};
+
+typedef struct
+{
+  char name[32];
+  BOOL keyword, sw, number, multi, required;
+} HostArgItem;
+
+static int
+HostParseTemplate (CONST_STRPTR tmpl, HostArgItem *items)
+{
+  const char *p = tmpl;
+  int count = 0;
+
+  while (*p && count < HOST_MAX_ITEMS)
+    {
+      HostArgItem *item = &items[count++];
+      size_t len = strcspn (p, "=/,");
+
+      memset (item, 0, sizeof (*item));
+      if (len >= sizeof (item->name))
+        {
+          len = sizeof (item->name) - 1;
+        }
+      memcpy (item->name, p, len);
+      p += strcspn (p, "/,");
+      while (*p == '/')
+        {
+          switch (p[1] & ~0x20)
+            {
+            case 'K':
+              item->keyword = TRUE;
+              break;
+            case 'S':
+              item->sw = TRUE;
+              break;
+            case 'N':
+              item->number = TRUE;
+              break;
+            case 'M':
+              item->multi = TRUE;
+              break;
+            case 'A':
+              item->required = TRUE;
+              break;
+            }
+          p += 2;
+        }
+      if (*p == ',')
+        {
+          p++;
+        }
+    }
+  return count;
+}
+
+static int
+HostFindItem (const HostArgItem *items, int count, const char *word,
+              size_t len)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      if (strlen (items[i].name) == len
+          && strncasecmp (items[i].name, word, len) == 0)
+        {
+          return i;
+        }
+    }
+  return -1;
+}
+
+static BOOL
+HostSetItem (struct RDArgs *rda, const HostArgItem *item, int index,
+             LONG *array, char *value)
+{
+  char *end;
+
+  if (item->number)
+    {
+      rda->numbers[index] = strtol (value, &end, 0);
+      if (*value == '\0' || *end != '\0')
+        {
+          return FALSE;
+        }
+      array[index] = (LONG)&rda->numbers[index];
+    }
+  else
+    {
+      array[index] = (LONG)value;
+    }
+  return TRUE;
+}
+
+struct RDArgs *
+ReadArgs (CONST_STRPTR tmpl, LONG *array, struct RDArgs *args)
+{
+  HostArgItem items[HOST_MAX_ITEMS];
+  struct RDArgs *rda;
+  int count = HostParseTemplate (tmpl, items);
+  int multi_index = -1, multi_count = 0;
+  int i, a;
+
+  (void)args;
+  rda = calloc (1, sizeof (struct RDArgs));
+  if (!rda)
+    {
+      return NULL;
+    }
+  rda->multi = calloc (host_argc + 1, sizeof (STRPTR));
+  if (!rda->multi)
+    {
+      free (rda);
+      return NULL;
+    }
+  for (i = 0; i < count; i++)
+    {
+      if (items[i].multi)
+        {
+          multi_index = i;
+        }
+    }
+
+  for (a = 1; a < host_argc; a++)
+    {
+      char *word = host_argv[a];
+      char *equals = strchr (word, '=');
+      int index = HostFindItem (items, count, word,
+                                equals ? (size_t)(equals - word)
+                                       : strlen (word));
+
+      if (index >= 0 && items[index].sw && !equals)
+        {
+          array[index] = DOSTRUE;
+          continue;
+        }
+      if (index >= 0 && !items[index].sw)
+        {
+          char *value = equals ? equals + 1 : host_argv[++a];
+
+          if (!value)
+            {
+              goto fail;
+            }
+          if (items[index].multi)
+            {
+              rda->multi[multi_count++] = value;
+              continue;
+            }
+          if (!HostSetItem (rda, &items[index], index, array, value))
+            {
+              goto fail;
+            }
+          continue;
+        }
+
+      /* Positional: the first free item that isn't a keyword or switch,
+         else the /M item */
+      for (i = 0; i < count; i++)
+        {
+          if (!items[i].keyword && !items[i].sw && !items[i].multi
+              && !array[i])
+            {
+              break;
+            }
+        }
+      if (i < count)
+        {
+          if (!HostSetItem (rda, &items[i], i, array, word))
+            {
+              goto fail;
+            }
+        }
+      else if (multi_index >= 0)
+        {
+          rda->multi[multi_count++] = word;
+        }
+      else
+        {
+          goto fail;
+        }
+    }
+
+  /* As dos does, a required item still empty takes the last /M word */
+  for (i = count - 1; i >= 0; i--)
+    {
+      if (items[i].required && !array[i] && !items[i].multi)
+        {
+          if (multi_count == 0
+              || !HostSetItem (rda, &items[i], i, array,
+                               rda->multi[--multi_count]))
+            {
+              goto fail;
+            }
+          rda->multi[multi_count] = NULL;
+        }
+    }
+  if (multi_index >= 0 && multi_count > 0)
+    {
+      array[multi_index] = (LONG)rda->multi;
+    }
+  return rda;
+
+fail:
+  FreeArgs (rda);
+  return NULL;
+}
+
+void
+FreeArgs (struct RDArgs *args)
+{
+  if (args)
+    {
+      free (args->multi);
+      free (args);
+    }
+}
@@ -0,0 +1,22 @@
+/* Host build shim for <devices/timer.h>. The E-clock runs at 1 MHz. */
+
+#ifndef DEVICES_TIMER_H
+#define DEVICES_TIMER_H
+
+#include <exec/io.h>
+
+#define TIMERNAME "timer.device"
+#define UNIT_ECLOCK 2
+
+struct EClockVal
+{
+  ULONG ev_hi;
+  ULONG ev_lo;
+};
+
+struct timerequest
+{
+  struct IORequest tr_node;
+};
+
+#endif /* DEVICES_TIMER_H */
@@ -0,0 +1,22 @@
+/* Host build shim for <dos/dos.h>. A BPTR is a host FILE *. */
+
+#ifndef DOS_DOS_H
+#define DOS_DOS_H
+
+#include <exec/types.h>
+
+typedef long BPTR;
+
+#define MODE_OLDFILE 1005
+#define MODE_NEWFILE 1006
+#define MODE_READWRITE 1004
+
+#define OFFSET_BEGINNING -1
+#define OFFSET_CURRENT 0
+#define OFFSET_END 1
+
+#define TICKS_PER_SECOND 50
+
+#define SIGBREAKF_CTRL_C (1L << 12)
+
+#endif /* DOS_DOS_H */
@@ -0,0 +1,10 @@
+/* Host build shim for <dos/dosextens.h> */
+
+#ifndef DOS_DOSEXTENS_H
+#define DOS_DOSEXTENS_H
+
+#include <dos/dos.h>
+
+struct DosLibrary;
+
+#endif /* DOS_DOSEXTENS_H */
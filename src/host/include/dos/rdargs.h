@@ -0,0 +1,11 @@
+/* Host build shim for <dos/rdargs.h>. ReadArgs() parses the argv handed
+ * to U64Host_Init() rather than a CLI buffer. */
+
+#ifndef DOS_RDARGS_H
+#define DOS_RDARGS_H
+
+#include <dos/dos.h>
+
+struct RDArgs;
+
+#endif /* DOS_RDARGS_H */
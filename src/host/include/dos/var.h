@@ -0,0 +1,11 @@
+/* Host build shim for <dos/var.h> */
+
+#ifndef DOS_VAR_H
+#define DOS_VAR_H
+
+#include <dos/dos.h>
+
+#define GVF_GLOBAL_ONLY (1L << 8)
+#define GVF_LOCAL_ONLY (1L << 9)
+
+#endif /* DOS_VAR_H */
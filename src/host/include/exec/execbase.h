@@ -0,0 +1,13 @@
+/* Host build shim for <exec/execbase.h>: only what the library reads */
+
+#ifndef EXEC_EXECBASE_H
+#define EXEC_EXECBASE_H
+
+#include <exec/types.h>
+
+struct ExecBase
+{
+  ULONG LastAlert[4];
+};
+
+#endif /* EXEC_EXECBASE_H */
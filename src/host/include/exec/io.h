@@ -0,0 +1,16 @@
+/* Host build shim for <exec/io.h> */
+
+#ifndef EXEC_IO_H
+#define EXEC_IO_H
+
+#include <exec/types.h>
+
+struct Device;
+struct Library;
+
+struct IORequest
+{
+  struct Device *io_Device;
+};
+
+#endif /* EXEC_IO_H */
@@ -0,0 +1,10 @@
+/* Host build shim for <exec/ports.h> */
+
+#ifndef EXEC_PORTS_H
+#define EXEC_PORTS_H
+
+#include <exec/types.h>
+
+struct MsgPort;
+
+#endif /* EXEC_PORTS_H */
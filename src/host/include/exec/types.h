@@ -0,0 +1,33 @@
+/* Host build shim for <exec/types.h>.
+ * LONG/ULONG are the host's long so that, as on the Amiga, a LONG can
+ * carry a pointer (ReadArgs results, FindTask() casts).
+ */
+
+#ifndef EXEC_TYPES_H
+#define EXEC_TYPES_H
+
+#include <stddef.h>
+#include <strings.h>
+
+typedef long LONG;
+typedef unsigned long ULONG;
+typedef short WORD;
+typedef unsigned short UWORD;
+typedef signed char BYTE;
+typedef unsigned char UBYTE;
+typedef short BOOL;
+typedef unsigned char TEXT;
+typedef void *APTR;
+typedef char *STRPTR;
+typedef const char *CONST_STRPTR;
+
+#define VOID void
+#define CONST const
+#define TRUE 1
+#define FALSE 0
+
+/* libnix spellings */
+#define stricmp strcasecmp
+#define strnicmp strncasecmp
+
+#endif /* EXEC_TYPES_H */
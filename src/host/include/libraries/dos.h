@@ -0,0 +1,3 @@
+/* Host build shim for <libraries/dos.h> */
+
+#include <dos/dos.h>
@@ -0,0 +1,34 @@
+/* Host build shim for <proto/dos.h>. Files are stdio streams; the ENV:
+ * and ENVARC: assigns both map to $U64_ENV, or ~/.u64env if unset. */
+
+#ifndef PROTO_DOS_H
+#define PROTO_DOS_H
+
+#include <dos/dos.h>
+#include <dos/rdargs.h>
+#include <dos/var.h>
+
+extern struct DosLibrary *DOSBase;
+
+BPTR Open (CONST_STRPTR name, LONG mode);
+LONG Close (BPTR file);
+LONG Read (BPTR file, APTR buffer, LONG length);
+LONG Write (BPTR file, CONST void *buffer, LONG length);
+LONG Seek (BPTR file, LONG position, LONG mode);
+LONG DeleteFile (CONST_STRPTR name);
+BPTR CreateDir (CONST_STRPTR name);
+STRPTR FilePart (CONST_STRPTR path);
+void Delay (LONG ticks);
+ULONG CheckSignal (ULONG mask);
+
+LONG GetVar (CONST_STRPTR name, STRPTR buffer, LONG size, ULONG flags);
+BOOL SetVar (CONST_STRPTR name, CONST_STRPTR buffer, LONG size, ULONG flags);
+BOOL DeleteVar (CONST_STRPTR name, ULONG flags);
+
+struct RDArgs *ReadArgs (CONST_STRPTR tmpl, LONG *array, struct RDArgs *args);
+void FreeArgs (struct RDArgs *args);
+
+/* Host only: hand the shim the command line before ReadArgs() */
+void U64Host_Init (int argc, char **argv);
+
+#endif /* PROTO_DOS_H */
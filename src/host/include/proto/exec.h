@@ -0,0 +1,32 @@
+/* Host build shim for <proto/exec.h>: memory comes from malloc, the rest
+ * is just enough of exec for the library and u64cli. */
+
+#ifndef PROTO_EXEC_H
+#define PROTO_EXEC_H
+
+#include <exec/execbase.h>
+#include <exec/io.h>
+#include <exec/memory.h>
+
+extern struct ExecBase *SysBase;
+
+APTR AllocMem (ULONG size, ULONG flags);
+void FreeMem (APTR memory, ULONG size);
+APTR AllocVec (ULONG size, ULONG flags);
+void FreeVec (APTR memory);
+APTR CreatePool (ULONG flags, ULONG puddle, ULONG threshold);
+void DeletePool (APTR pool);
+APTR AllocPooled (APTR pool, ULONG size);
+void FreePooled (APTR pool, APTR memory, ULONG size);
+void CopyMem (const void *source, APTR dest, ULONG size);
+
+struct Library *OpenLibrary (CONST_STRPTR name, ULONG version);
+void CloseLibrary (struct Library *library);
+LONG OpenDevice (CONST_STRPTR name, ULONG unit, struct IORequest *io,
+                 ULONG flags);
+void CloseDevice (struct IORequest *io);
+
+APTR FindTask (CONST_STRPTR name);
+ULONG SetSignal (ULONG new_signals, ULONG mask);
+
+#endif /* PROTO_EXEC_H */
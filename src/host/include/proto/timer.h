@@ -0,0 +1,10 @@
+/* Host build shim for <proto/timer.h> */
+
+#ifndef PROTO_TIMER_H
+#define PROTO_TIMER_H
+
+#include <devices/timer.h>
+
+ULONG ReadEClock (struct EClockVal *dest);
+
+#endif /* PROTO_TIMER_H */
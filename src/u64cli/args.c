@@ -40,6 +40,7 @@ const Command commands[] = {
     "Set default password (PASSWORD required)", TRUE },
   { "setport", U64CMD_SETPORT, "Set default port (TEXT=port required)", TRUE },
   { "clearconfig", U64CMD_CLEARCONFIG, "Clear all saved configuration", TRUE },
+  { "latency", U64CMD_LATENCY, "Time requests to the device (TEXT=rounds)", TRUE },
 
   { NULL, U64CMD_UNKNOWN, NULL, FALSE }
 };
@@ -13,7 +13,8 @@
 /* Template for ReadArgs */
 #define TEMPLATE                                                              \
   "HOST/K,COMMAND/A,FILE/K,ADDRESS/K,TEXT/K,DRIVE/K,MODE/K,"                  \
-  "PASSWORD/K,SONG/K/N,VERBOSE/S,QUIET/S"
+  "PASSWORD/K,SONG/K/N,VERBOSE/S,QUIET/S,STATS/S,TRACE/K,REPLAY/K,"        \
+  "HOSTS/M"
 
 #define ENV_ULTIMATE64_HOST "Ultimate64/Host"
 #define ENV_ULTIMATE64_PASSWORD "Ultimate64/Password"
@@ -23,6 +24,9 @@
 #define DEFAULT_HOST "192.168.1.64"
 #define DEFAULT_PORT "80"
 
+/* Seconds a HOSTS command may take on the slowest device */
+#define FLEET_TIMEOUT 60
+
 /* Argument indices */
 enum
 {
@@ -37,6 +41,10 @@ enum
   ARG_SONG,
   ARG_VERBOSE,
   ARG_QUIET,
+  ARG_STATS,
+  ARG_TRACE,
+  ARG_REPLAY,
+  ARG_HOSTS,
   ARG_COUNT
 };
 
@@ -73,6 +81,7 @@ typedef enum
   U64CMD_SAVECONFIG,     /* Save current config to flash */
   U64CMD_LOADCONFIG,     /* Load config from flash */
   U64CMD_RESETCONFIG,    /* Reset config to defaults */
+  U64CMD_LATENCY,        /* Probe the device and show request statistics */
 } U64CommandType;
 
 /* Command table entry */
@@ -96,6 +105,7 @@ void PrintError(const char *format, ...);
 void PrintInfo(const char *format, ...);
 void PrintVerbose(const char *format, ...);
 void PrintUsage(void);
+void PrintStats(CONST U64Stats *stats, const char *title);
 
 /* args.c */
 U64CommandType ParseCommand(const char *cmd);
@@ -110,4 +120,8 @@ int ExecuteCommand(U64Connection *conn, U64CommandType cmd, LONG *args,
                    char *env_host, char *env_password, UWORD env_port,
                    char *host_arg, char *password_arg);
 
+/* fleet.c */
+int ExecuteFleetCommand(U64CommandType cmd, LONG *args, CONST_STRPTR *hosts,
+                        char *password);
+
 #endif /* U64_CLI_H */
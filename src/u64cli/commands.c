@@ -1592,6 +1592,37 @@ ExecuteCommand (U64Connection *conn, U64CommandType cmd, LONG *args,
       }
       break;
 
+    case U64CMD_LATENCY:
+      PrintVerbose ("Executing LATENCY command");
+      {
+        /* Each round asks for the version and reads a screen line, a small
+           JSON reply and a small binary one; TEXT overrides the count */
+        LONG rounds = text ? atol (text) : 10;
+        UBYTE line[40];
+        LONG i;
+
+        if (rounds < 1 || rounds > 1000)
+          {
+            PrintError ("Rounds must be between 1 and 1000");
+            return 5;
+          }
+
+        U64_ResetStats (conn);
+        PrintInfo ("Timing %ld rounds of requests...", rounds);
+        for (i = 0; i < rounds; i++)
+          {
+            if (CheckSignal (SIGBREAKF_CTRL_C))
+              {
+                PrintError ("***Break");
+                break;
+              }
+            U64_GetVersion (conn);
+            U64_ReadMem (conn, 0x0400, line, sizeof (line));
+          }
+        PrintStats (U64_GetStats (conn), "Requests");
+      }
+      break;
+
     default:
       PrintVerbose ("Executing unknown command: %d", cmd);
       PrintError ("Unknown command");
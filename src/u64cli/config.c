@@ -10,6 +10,7 @@
 #include <proto/dos.h>
 #include <proto/exec.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -0,0 +1,249 @@
+/* Ultimate64 Control - Command Line Interface
+ * HOSTS: one command on several devices at once.
+ * For Amiga OS 3.x by Marcin Spoczynski
+ */
+
+#include "cli.h"
+
+#include "file_utils.h"
+
+#include <proto/exec.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/* Check data with validate, printing why it was refused */
+static BOOL
+FleetValidate (LONG (*validate) (CONST UBYTE *, ULONG, STRPTR *),
+               CONST UBYTE *data, ULONG size, const char *kind)
+{
+  STRPTR info = NULL;
+  BOOL ok = validate (data, size, &info) == U64_OK;
+
+  if (info)
+    {
+      if (ok)
+        PrintVerbose ("%s validation: %s", kind, info);
+      else
+        PrintError ("%s validation failed: %s", kind, info);
+      FreeMem (info, strlen (info) + 1);
+    }
+  else if (!ok)
+    {
+      PrintError ("%s validation failed", kind);
+    }
+  return ok;
+}
+
+/* Send cmd to every host in hosts and print a line per device. Returns
+   0 if it worked everywhere, 10 if it failed anywhere. */
+int
+ExecuteFleetCommand (U64CommandType cmd, LONG *args, CONST_STRPTR *hosts,
+                     char *password)
+{
+  U64Fleet *fleet;
+  U64FleetCommand command;
+  U64FleetPayload payload;
+  CONST U64FleetResult *results;
+  char *file = (char *)args[ARG_FILE];
+  char *text = (char *)args[ARG_TEXT];
+  char *item = NULL;
+  char *category_copy = NULL;
+  UBYTE *data = NULL;
+  ULONG i, ok = 0, slowest = 0;
+  LONG result;
+  int retval = 10;
+
+  memset (&payload, 0, sizeof (payload));
+
+  switch (cmd)
+    {
+    case U64CMD_RESET:
+      command = U64_FLEET_RESET;
+      break;
+    case U64CMD_REBOOT:
+      command = U64_FLEET_REBOOT;
+      break;
+    case U64CMD_RUN:
+    case U64CMD_MOUNT:
+    case U64CMD_PLAYSID:
+      if (!file)
+        {
+          PrintError ("FILE argument required");
+          return 5;
+        }
+      if (cmd == U64CMD_MOUNT && !args[ARG_DRIVE])
+        {
+          PrintError ("DRIVE argument required for mount command (a, b, c, "
+                      "or d)");
+          return 5;
+        }
+      break;
+    case U64CMD_SETCONFIG:
+      if (!text || !args[ARG_ADDRESS] || !(item = strrchr (text, '/')))
+        {
+          PrintError ("Configuration path and value required");
+          PrintInfo ("Format: TEXT=\"Category/Item\" ADDRESS=\"value\"");
+          return 5;
+        }
+      command = U64_FLEET_SET_CONFIG;
+      break;
+    default:
+      PrintError ("HOSTS works with reset, reboot, run, mount, playsid and "
+                  "setconfig");
+      return 5;
+    }
+
+  /* Read the file once; every device is sent the same buffer */
+  if (file)
+    {
+      const char *ext = strrchr (file, '.');
+
+      data = U64_ReadFile ((CONST_STRPTR)file, &payload.size);
+      if (!data)
+        {
+          PrintError ("Failed to load file: %s", file);
+          return 10;
+        }
+      payload.data = data;
+
+      if (cmd == U64CMD_RUN && ext && stricmp (ext, ".crt") == 0)
+        {
+          command = U64_FLEET_RUN_CRT;
+          if (!FleetValidate (U64_ValidateCRTFile, data, payload.size,
+                              "CRT"))
+            goto cleanup;
+        }
+      else if (cmd == U64CMD_RUN)
+        {
+          command = U64_FLEET_RUN_PRG;
+          if (!FleetValidate (U64_ValidatePRGFile, data, payload.size,
+                              "PRG"))
+            goto cleanup;
+        }
+      else if (cmd == U64CMD_PLAYSID)
+        {
+          command = U64_FLEET_PLAY_SID;
+          payload.song = args[ARG_SONG] ? (UBYTE)*(LONG *)args[ARG_SONG] : 0;
+          if (!FleetValidate (U64_ValidateSIDFile, data, payload.size,
+                              "SID"))
+            goto cleanup;
+        }
+      else
+        {
+          STRPTR info = NULL;
+
+          command = U64_FLEET_MOUNT;
+          payload.filename = (CONST_STRPTR)file;
+          payload.drive = (CONST_STRPTR)args[ARG_DRIVE];
+          payload.mode = ParseMountMode ((char *)args[ARG_MODE]);
+          if (U64_ValidateDiskImage (data, payload.size,
+                                     U64_GetDiskTypeFromExt (file), &info)
+              != U64_OK)
+            {
+              PrintError ("Disk validation failed: %s",
+                          info ? (char *)info : file);
+              if (info)
+                FreeMem (info, strlen (info) + 1);
+              goto cleanup;
+            }
+          if (info)
+            FreeMem (info, strlen (info) + 1);
+        }
+    }
+
+  /* Split "Category/Item" on its last slash */
+  if (command == U64_FLEET_SET_CONFIG)
+    {
+      category_copy = AllocMem (strlen (text) + 1, MEMF_PUBLIC);
+      if (!category_copy)
+        {
+          PrintError ("Out of memory");
+          goto cleanup;
+        }
+      strcpy (category_copy, text);
+      item = strrchr (category_copy, '/');
+      *item++ = '\0';
+      payload.category = (CONST_STRPTR)category_copy;
+      payload.item = (CONST_STRPTR)item;
+      payload.value = (CONST_STRPTR)args[ARG_ADDRESS];
+    }
+
+  fleet = U64_FleetCreate (hosts, (CONST_STRPTR)password);
+  if (!fleet)
+    {
+      PrintError ("Failed to set up connections to HOSTS");
+      goto cleanup;
+    }
+
+  /* REPLAY answers each host from its own records in the trace */
+  if (args[ARG_REPLAY]
+      && U64_FleetTraceReplay (fleet, (CONST_STRPTR)args[ARG_REPLAY], 0)
+             != U64_OK)
+    {
+      PrintError ("Cannot replay %s", (char *)args[ARG_REPLAY]);
+      U64_FleetFree (fleet);
+      goto cleanup;
+    }
+  else if (args[ARG_TRACE]
+           && U64_FleetTraceRecord (fleet, (CONST_STRPTR)args[ARG_TRACE])
+                  != U64_OK)
+    {
+      PrintError ("Cannot create trace file %s", (char *)args[ARG_TRACE]);
+      U64_FleetFree (fleet);
+      goto cleanup;
+    }
+
+  PrintVerbose ("Sending to %lu devices",
+                (unsigned long)U64_FleetCount (fleet));
+  result = U64_FleetExec (fleet, command, &payload, FLEET_TIMEOUT);
+  if (result == U64_ERR_INVALID || result == U64_ERR_MEMORY
+      || result == U64_ERR_NETWORK)
+    {
+      PrintError ("Could not send the command: %s",
+                  U64_GetErrorString (result));
+      U64_FleetFree (fleet);
+      goto cleanup;
+    }
+
+  results = U64_FleetResults (fleet);
+  for (i = 0; i < U64_FleetCount (fleet); i++)
+    {
+      if (results[i].result == U64_OK)
+        {
+          ok++;
+          PrintInfo ("%-24s OK     %5lu ms", (char *)results[i].host,
+                     (unsigned long)results[i].time_ms);
+        }
+      else
+        {
+          PrintInfo ("%-24s FAILED %5lu ms  %s%s%s", (char *)results[i].host,
+                     (unsigned long)results[i].time_ms,
+                     U64_GetErrorString (results[i].result),
+                     results[i].message[0] ? ": " : "", results[i].message);
+        }
+      if (results[i].time_ms > slowest)
+        slowest = results[i].time_ms;
+    }
+  PrintInfo ("%lu of %lu devices OK, slowest %lu ms", (unsigned long)ok,
+             (unsigned long)U64_FleetCount (fleet), (unsigned long)slowest);
+
+  if (args[ARG_STATS])
+    {
+      for (i = 0; i < U64_FleetCount (fleet); i++)
+        {
+          PrintStats (U64_GetStats (U64_FleetConnection (fleet, i)),
+                      (const char *)results[i].host);
+        }
+    }
+
+  retval = ok == U64_FleetCount (fleet) ? 0 : 10;
+  U64_FleetFree (fleet);
+
+cleanup:
+  if (category_copy)
+    FreeMem (category_copy, strlen (text) + 1);
+  if (data)
+    FreeVec (data);
+  return retval;
+}
@@ -33,6 +33,7 @@ main (int argc, char **argv)
   char *command;
   char *host_arg;
   char *password_arg;
+  CONST_STRPTR *hosts;
 
   /* Settings loaded from ENV: */
   char *env_host = NULL;
@@ -43,6 +44,10 @@ main (int argc, char **argv)
   char *final_host = NULL;
   char *final_password = NULL;
 
+#ifdef U64_HOST
+  U64Host_Init (argc, argv);
+#endif
+
   /* Initialize arguments array */
   memset (args, 0, sizeof (args));
 
@@ -67,6 +72,7 @@ main (int argc, char **argv)
   host_arg = (char *)args[ARG_HOST];
   command = (char *)args[ARG_COMMAND];
   password_arg = (char *)args[ARG_PASSWORD];
+  hosts = (CONST_STRPTR *)args[ARG_HOSTS];
 
   /* Set flags */
   verbose = args[ARG_VERBOSE] ? TRUE : FALSE;
@@ -81,7 +87,7 @@ main (int argc, char **argv)
   final_host = host_arg ? host_arg : env_host;
   final_password = password_arg ? password_arg : env_password;
 
-  if (!final_host)
+  if (!final_host && !hosts)
     {
       PrintError ("No host specified. Use HOST argument or run 'ultimate64 "
                   "sethost HOST <ip>'");
@@ -89,7 +95,7 @@ main (int argc, char **argv)
       goto cleanup;
     }
 
-  PrintVerbose ("Using host: %s", final_host);
+  PrintVerbose ("Using host: %s", hosts ? "HOSTS" : final_host);
   PrintVerbose ("Using password: %s", final_password ? "***" : "none");
 
   /* Parse command */
@@ -110,6 +116,13 @@ main (int argc, char **argv)
       goto cleanup;
     }
 
+  /* HOSTS sends the command to all of them at once */
+  if (hosts)
+    {
+      retval = ExecuteFleetCommand (cmd, args, hosts, final_password);
+      goto cleanup;
+    }
+
   /* Connect to device */
   PrintVerbose ("Connecting to %s...", final_host);
   conn = U64_Connect ((CONST_STRPTR)final_host, (CONST_STRPTR)final_password);
@@ -121,10 +134,34 @@ main (int argc, char **argv)
     }
   PrintVerbose ("Connected to %s", final_host);
 
+  /* TRACE records the command's requests, REPLAY answers them from such a
+     recording without touching the network */
+  if (args[ARG_REPLAY]
+      && U64_TraceReplay (conn, (CONST_STRPTR)args[ARG_REPLAY], 0) != U64_OK)
+    {
+      PrintError ("Cannot replay %s", (char *)args[ARG_REPLAY]);
+      retval = 10;
+      goto cleanup;
+    }
+  else if (args[ARG_TRACE]
+           && U64_TraceRecord (conn, (CONST_STRPTR)args[ARG_TRACE]) != U64_OK)
+    {
+      PrintError ("Cannot create trace file %s", (char *)args[ARG_TRACE]);
+      retval = 10;
+      goto cleanup;
+    }
+
   /* Execute command */
   retval = ExecuteCommand (conn, cmd, args, env_host, env_password, env_port,
                            host_arg, password_arg);
 
+  /* STATS shows what the command cost; the latency command prints its own */
+  if (args[ARG_STATS] && cmd != U64CMD_LATENCY)
+    {
+      PrintStats (U64_GetStats (conn), "Requests");
+      PrintStats (U64_GetStats (NULL), "Downloads");
+    }
+
 cleanup:
   /* Disconnect first - this is the most dangerous part */
   if (conn)
@@ -77,6 +77,10 @@ PrintUsage (void)
   printf ("  SONG       - Song number for SID files\n");
   printf ("  VERBOSE    - Verbose output\n");
   printf ("  QUIET      - Suppress output\n");
+  printf ("  STATS      - Show request statistics after the command\n");
+  printf ("  TRACE      - Record the command's HTTP traffic to a file\n");
+  printf ("  REPLAY     - Answer requests from a TRACE file, offline\n");
+  printf ("  HOSTS      - Send the command to all these devices at once\n");
 
   printf ("\nConfiguration Examples:\n");
   printf ("  u64ctl sethost HOST 192.168.1.64      - Set default host\n");
@@ -158,4 +162,75 @@ PrintUsage (void)
   printf("  4. u64ctl setconfig TEXT \"cat/item\" ADDRESS \"value\" - Change value\n");
   printf("  5. u64ctl saveconfig                   - Make changes permanent\n");
 
+  printf ("\nStatistics Examples:\n");
+  printf ("  u64ctl latency                         - Time 10 rounds of "
+          "requests\n");
+  printf ("  u64ctl latency TEXT 50                 - Time 50 rounds\n");
+  printf ("  u64ctl drives STATS                    - Show what a command "
+          "cost\n");
+  printf ("  u64ctl drives TRACE RAM:drives.trc     - Record the traffic\n");
+  printf ("  u64ctl drives REPLAY RAM:drives.trc    - Replay it offline\n");
+
+  printf ("\nSeveral Devices Examples:\n");
+  printf ("  u64ctl reset HOSTS 10.0.0.64 10.0.0.65 - Reset both at once\n");
+  printf ("  u64ctl run FILE demo.prg HOSTS 10.0.0.64 10.0.0.65 10.0.0.66\n");
+  printf ("  u64ctl mount FILE disk1.d64 DRIVE a HOSTS lab1 lab2 lab3\n");
+  printf ("  u64ctl setconfig TEXT \"Drive A Settings/Drive Type\" ADDRESS "
+          "\"1571\" HOSTS lab1 lab2\n");
+
+}
+
+/* Print one line per endpoint: request and error counts, bytes each way
+   and connect / first byte / total times in ms (mean, and the total's
+   90th percentile bucket and maximum). */
+void
+PrintStats (CONST U64Stats *stats, const char *title)
+{
+  ULONG i, j;
+
+  if (quiet || !stats || stats->endpoint_count == 0)
+    {
+      return;
+    }
+
+  printf ("\n%s:\n", title);
+  printf ("%-30s %5s %4s %7s %8s %5s %5s %5s %5s %5s\n", "Endpoint", "Reqs",
+          "Err", "Sent", "Received", "Conn", "First", "Avg", "p90", "Max");
+
+  for (i = 0; i < stats->endpoint_count; i++)
+    {
+      CONST U64EndpointStats *ep = &stats->endpoints[i];
+      ULONG errors = 0;
+
+      for (j = 1; j < U64_STATS_ERRORS; j++)
+        {
+          errors += ep->errors[j];
+        }
+
+      printf ("%-30.30s %5lu %4lu %7lu %8lu %5lu %5lu %5lu %5lu %5lu\n",
+              ep->name, (unsigned long)ep->requests, (unsigned long)errors,
+              (unsigned long)ep->bytes_sent,
+              (unsigned long)ep->bytes_received,
+              (unsigned long)(ep->connect.count
+                                  ? ep->connect.total_ms / ep->connect.count
+                                  : 0),
+              (unsigned long)(ep->first_byte.count
+                                  ? ep->first_byte.total_ms
+                                        / ep->first_byte.count
+                                  : 0),
+              (unsigned long)(ep->total.count
+                                  ? ep->total.total_ms / ep->total.count
+                                  : 0),
+              (unsigned long)U64_StatsPercentile (&ep->total, 90),
+              (unsigned long)ep->total.max_ms);
+
+      for (j = 1; j < U64_STATS_ERRORS; j++)
+        {
+          if (ep->errors[j])
+            {
+              printf ("  %lu x %s\n", (unsigned long)ep->errors[j],
+                      U64_GetErrorString (-(LONG)j));
+            }
+        }
+    }
 }
@@ -70,6 +70,8 @@ const U64MountMode mode_values[]
 struct NewMenu MainMenu[]
     = { { NM_TITLE, (STRPTR) "Project", NULL, 0, 0, NULL },
         { NM_ITEM, (STRPTR) "About...", (STRPTR) "?", 0, 0, (APTR)ID_ABOUT },
+        { NM_ITEM, (STRPTR) "Statistics...", (STRPTR) "S", 0, 0,
+          (APTR)ID_STATS_OPEN },
         { NM_ITEM, NM_BARLABEL, NULL, 0, 0, NULL },
         { NM_ITEM, (STRPTR) "Quit", (STRPTR) "Q", 0, 0, (APTR)ID_QUIT },
 
@@ -409,6 +411,19 @@ AppMain (int argc, char *argv[])
           ClearConfig (&data);
           break;
 
+        case ID_STATS_OPEN:
+        case ID_STATS_REFRESH:
+          OpenStatsWindow (&data);
+          break;
+
+        case ID_STATS_RESET:
+          ResetStatsWindow (&data);
+          break;
+
+        case ID_STATS_CLOSE:
+          CloseStatsWindow (&data);
+          break;
+
         case ID_CONNECT:
           if (data.connection)
             {
@@ -506,6 +521,10 @@ AppMain (int argc, char *argv[])
     {
       set (data.config_window, MUIA_Window_Open, FALSE);
     }
+  if (data.stats_window)
+    {
+      set (data.stats_window, MUIA_Window_Open, FALSE);
+    }
 
   set (data.window, MUIA_Window_Open, FALSE);
   MUI_DisposeObject (data.app);
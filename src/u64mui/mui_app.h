@@ -100,6 +100,12 @@ enum
   ID_CONFIG_OPEN,
   ID_CONFIG_CLEAR,
 
+  /* Statistics window IDs */
+  ID_STATS_OPEN,
+  ID_STATS_REFRESH,
+  ID_STATS_RESET,
+  ID_STATS_CLOSE,
+
   /* Assembly64 tab IDs */
   ID_ASM_SEARCH = 200,
   ID_ASM_PREV,
@@ -128,6 +134,10 @@ struct AppData
   Object *config_ok_button;
   Object *config_cancel_button;
 
+  /* Statistics window */
+  Object *stats_window;
+  Object *flt_stats;
+
   /* Connection */
   Object *btn_connect;
   Object *txt_status;
@@ -212,6 +222,13 @@ void OpenConfigWindow (struct AppData *data);
 void CloseConfigWindow (struct AppData *data);
 void ApplyConfigChanges (struct AppData *data);
 
+/* stats.c */
+Object *CreateStatsWindow (struct AppData *data);
+void OpenStatsWindow (struct AppData *data);
+void RefreshStatsWindow (struct AppData *data);
+void ResetStatsWindow (struct AppData *data);
+void CloseStatsWindow (struct AppData *data);
+
 /* ui.c */
 void UpdateStatus (struct AppData *data, CONST_STRPTR text, BOOL add_to_output);
 Object *CreateConfigWindow (struct AppData *data);
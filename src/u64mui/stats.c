@@ -0,0 +1,180 @@
+/* Ultimate64 Control - request statistics window
+ * For Amiga OS 3.x by Marcin Spoczynski
+ */
+
+#include <libraries/mui.h>
+
+#include <proto/exec.h>
+#include <proto/intuition.h>
+#include <proto/muimaster.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mui_app.h"
+
+/* Both tables at full size come to about 6 KB of text */
+#define STATS_TEXT_SIZE 8192
+
+static char stats_text[STATS_TEXT_SIZE];
+
+/* Append one table (device requests or Assembly64 downloads) */
+static ULONG
+FormatStatsTable (char *out, ULONG size, CONST U64Stats *stats,
+                  const char *title)
+{
+  ULONG len, i, j;
+
+  len = snprintf (out, size, "%s\n%-28s %5s %4s %7s %5s %5s %5s %5s\n",
+                  title, "Endpoint", "Reqs", "Err", "KB", "Conn", "First",
+                  "Avg", "p90");
+
+  if (!stats || stats->endpoint_count == 0)
+    {
+      len += snprintf (out + len, size - len, "(none yet)\n");
+    }
+
+  for (i = 0; stats && i < stats->endpoint_count && len < size; i++)
+    {
+      CONST U64EndpointStats *ep = &stats->endpoints[i];
+      ULONG errors = 0;
+
+      for (j = 1; j < U64_STATS_ERRORS; j++)
+        {
+          errors += ep->errors[j];
+        }
+
+      len += snprintf (
+          out + len, size - len,
+          "%-28.28s %5lu %4lu %7lu %5lu %5lu %5lu %5lu\n", ep->name,
+          (unsigned long)ep->requests, (unsigned long)errors,
+          (unsigned long)((ep->bytes_sent + ep->bytes_received + 1023)
+                          / 1024),
+          (unsigned long)(ep->connect.count
+                              ? ep->connect.total_ms / ep->connect.count
+                              : 0),
+          (unsigned long)(ep->first_byte.count ? ep->first_byte.total_ms
+                                                     / ep->first_byte.count
+                                               : 0),
+          (unsigned long)(ep->total.count
+                              ? ep->total.total_ms / ep->total.count
+                              : 0),
+          (unsigned long)U64_StatsPercentile (&ep->total, 90));
+    }
+
+  return len < size ? len : size - 1;
+}
+
+/* Create statistics window */
+Object *
+CreateStatsWindow (struct AppData *data)
+{
+  Object *window, *text, *refresh_button, *reset_button, *close_button;
+
+  window = WindowObject, MUIA_Window_Title,
+  (CONST_STRPTR) "Request Statistics", MUIA_Window_ID,
+  MAKE_ID ('S', 'T', 'A', 'T'), MUIA_Window_Width, 560, MUIA_Window_Height,
+  300,
+
+  WindowContents, VGroup,
+
+  Child, MUI_NewObject (MUIC_Listview, MUIA_Listview_Input, FALSE,
+      MUIA_Listview_List, text = MUI_NewObject (MUIC_Floattext,
+          MUIA_Frame, MUIV_Frame_ReadList,
+          MUIA_Font, MUIV_Font_Fixed,
+          MUIA_Floattext_Text, (CONST_STRPTR) "",
+          TAG_DONE),
+      TAG_DONE),
+
+  Child, TextObject, MUIA_Text_Contents,
+  (CONST_STRPTR) "Times in ms: connect, first byte, mean and 90th "
+                 "percentile of the whole request.",
+  MUIA_Text_PreParse, (CONST_STRPTR) "\33c", MUIA_Font, MUIV_Font_Tiny, End,
+
+  Child, HGroup, Child, refresh_button = SimpleButton ("Refresh"),
+  Child, reset_button = SimpleButton ("Reset"),
+  Child, HSpace (0), Child, close_button = SimpleButton ("Close"), End,
+  End, End;
+
+  if (window)
+    {
+      data->stats_window = window;
+      data->flt_stats = text;
+
+      DoMethod (window, MUIM_Notify, MUIA_Window_CloseRequest, TRUE,
+                data->app, 2, MUIM_Application_ReturnID, ID_STATS_CLOSE);
+      DoMethod (refresh_button, MUIM_Notify, MUIA_Pressed, FALSE, data->app,
+                2, MUIM_Application_ReturnID, ID_STATS_REFRESH);
+      DoMethod (reset_button, MUIM_Notify, MUIA_Pressed, FALSE, data->app, 2,
+                MUIM_Application_ReturnID, ID_STATS_RESET);
+      DoMethod (close_button, MUIM_Notify, MUIA_Pressed, FALSE, data->app, 2,
+                MUIM_Application_ReturnID, ID_STATS_CLOSE);
+
+      DoMethod (data->app, OM_ADDMEMBER, window);
+    }
+
+  return window;
+}
+
+/* Show the current figures */
+void
+RefreshStatsWindow (struct AppData *data)
+{
+  ULONG len;
+
+  if (!data->stats_window)
+    {
+      return;
+    }
+
+  len = FormatStatsTable (stats_text, sizeof (stats_text),
+                          data->connection ? U64_GetStats (data->connection)
+                                           : NULL,
+                          "Ultimate device");
+  if (len + 2 < sizeof (stats_text))
+    {
+      stats_text[len++] = '\n';
+      FormatStatsTable (stats_text + len, sizeof (stats_text) - len,
+                        U64_GetStats (NULL), "Downloads");
+    }
+
+  set (data->flt_stats, MUIA_Floattext_Text, (CONST_STRPTR)stats_text);
+}
+
+/* Open statistics window */
+void
+OpenStatsWindow (struct AppData *data)
+{
+  if (!data->stats_window)
+    {
+      CreateStatsWindow (data);
+    }
+
+  if (data->stats_window)
+    {
+      RefreshStatsWindow (data);
+      set (data->stats_window, MUIA_Window_Open, TRUE);
+    }
+}
+
+/* Start counting afresh */
+void
+ResetStatsWindow (struct AppData *data)
+{
+  if (data->connection)
+    {
+      U64_ResetStats (data->connection);
+    }
+  U64_ResetStats (NULL);
+  RefreshStatsWindow (data);
+}
+
+/* Close statistics window */
+void
+CloseStatsWindow (struct AppData *data)
+{
+  if (data->stats_window)
+    {
+      set (data->stats_window, MUIA_Window_Open, FALSE);
+    }
+}
@@ -0,0 +1,642 @@
+/* Ultimate64 SID Player - benchmark suite
+ *
+ * "U64Player BENCHMARK [file]" from a shell times the CPU-bound paths of
+ * the player and the library on generated or canned data, so a change can
+ * be measured without a device, an HVSC copy or the GUI:
+ *
+ *     songdb.parse / songdb.cache   Songlengths.md5 text parse, binary cache
+ *     json.info / json.drives       U64_JsonFindKey over device replies
+ *     http.parse / http.parse.copy  status line and body split of a reply
+ *     md5.sid                       CalculateMD5 over a typical SID
+ *     petscii                       U64_StringToPETSCII of a typed line
+ *     md5set.load / md5set.save     journal replay and compaction
+ *     playlist.text / .binary       playlist load in both formats
+ *     search.full / search.typing   filter pass, and narrowing as typed
+ *
+ * Each case runs for BENCH_TICKS and reports operations per second and
+ * exec allocations per operation, after the MD5 kernel figures. Given a
+ * file, the same numbers also go there as tab-separated lines under a
+ * header naming the CPU, for comparing runs across commits and CPU
+ * targets:
+ *
+ *     # u64player benchmark 1
+ *     # cpu 68020 fpu 68881
+ *     name    ops_per_s    allocs_per_op    bytes_per_op
+ *     songdb.parse    3.42    2002.00    63812
+ *
+ * Allocations are counted by patching exec's AllocMem for the run and
+ * only counting calls from this task. AllocVec and new pool puddles go
+ * through it; AllocPooled out of an existing puddle doesn't, which is
+ * the point of pooling. Scratch files live in T: and are removed after.
+ */
+
+#include <dos/dos.h>
+#include <exec/execbase.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "player.h"
+#include "md5set.h"
+
+#define BENCH_FORMAT_VERSION 1
+#define BENCH_TICKS          (2 * TICKS_PER_SECOND)
+
+#define BENCH_SONGS          1000    /* Songlengths.md5 entries */
+#define BENCH_ENTRIES        1000    /* playlist entries, set members */
+#define BENCH_SID_BYTES      (8 * 1024)
+
+#define BENCH_SONGLENGTHS    "T:u64bench.md5"
+#define BENCH_SET            "T:u64bench.set"
+#define BENCH_PLAYLIST_TEXT  "T:u64bench.m3u"
+#define BENCH_PLAYLIST_BIN   "T:u64bench" PLAYLIST_BINARY_EXT
+
+/* ------------------------------------------------------------------ */
+/* Allocation counting                                                 */
+/* ------------------------------------------------------------------ */
+
+#define LVO_ALLOCMEM         (-198)
+
+/* Read and written by the patch below, so not static */
+volatile ULONG bench_allocs = 0;
+APTR bench_task = NULL;
+APTR bench_old_allocmem = NULL;
+
+void Bench_AllocMemPatch(void);
+
+/* Count the call if it comes from bench_task, then carry on into the
+ * original AllocMem with every register as the caller left it. a6 is
+ * SysBase on entry; 276 is offsetof(struct ExecBase, ThisTask). */
+__asm__(
+    "       .text\n"
+    "       .even\n"
+    "       .globl  _Bench_AllocMemPatch\n"
+    "_Bench_AllocMemPatch:\n"
+    "       move.l  %a0,-(%sp)\n"
+    "       move.l  276(%a6),%a0\n"
+    "       cmp.l   _bench_task,%a0\n"
+    "       bne.s   1f\n"
+    "       addq.l  #1,_bench_allocs\n"
+    "1:     move.l  (%sp)+,%a0\n"
+    "       move.l  _bench_old_allocmem,-(%sp)\n"
+    "       rts\n");
+
+static void
+Bench_CountAllocs(BOOL on)
+{
+    if (on && !bench_old_allocmem) {
+        bench_task = FindTask(NULL);
+        bench_old_allocmem = SetFunction((struct Library *)SysBase, LVO_ALLOCMEM,
+                                         (APTR)Bench_AllocMemPatch);
+    } else if (!on && bench_old_allocmem) {
+        SetFunction((struct Library *)SysBase, LVO_ALLOCMEM, bench_old_allocmem);
+        bench_old_allocmem = NULL;
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Timing and reporting                                                */
+/* ------------------------------------------------------------------ */
+
+/* Everything a case needs, built once before timing starts */
+struct BenchData {
+    struct ObjApp *obj;             /* bare ObjApp for the playlist cases */
+    UBYTE *sid;
+    char http_info[512];
+    ULONG http_info_len;
+    char http_drives[1024];
+    ULONG http_drives_len;
+    struct MD5Set *set;             /* loaded once, for md5set.save */
+    UWORD typing_step;
+};
+
+typedef BOOL (*BenchFunc)(struct BenchData *d);
+
+static BPTR bench_out = 0;
+
+/* Run fn until BENCH_TICKS pass (at least once after a warm-up call) and
+ * report it. bytes is the input each call works through, 0 if that means
+ * nothing for the case. Returns FALSE if fn failed. */
+static BOOL
+Bench_Time(CONST_STRPTR name, BenchFunc fn, struct BenchData *d, ULONG bytes)
+{
+    struct DateStamp start;
+    ULONG ops = 0, ticks, allocs, rate, per_op;
+    char line[128];
+
+    if (!fn(d)) {
+        printf("  %-18s failed\n", name);
+        return FALSE;
+    }
+
+    bench_allocs = 0;
+    DateStamp(&start);
+    do {
+        if (!fn(d)) {
+            printf("  %-18s failed\n", name);
+            return FALSE;
+        }
+        ops++;
+        ticks = TicksSince(&start);
+    } while (ticks < BENCH_TICKS);
+    allocs = bench_allocs;
+
+    /* Both in hundredths */
+    rate = (ULONG)(((double)ops * TICKS_PER_SECOND * 100.0) / (double)(ticks ? ticks : 1));
+    per_op = (ULONG)(((double)allocs * 100.0) / (double)ops);
+
+    printf("  %-18s %8lu.%02lu ops/s %8lu.%02lu allocs/op\n", name,
+           (unsigned long)(rate / 100), (unsigned long)(rate % 100),
+           (unsigned long)(per_op / 100), (unsigned long)(per_op % 100));
+
+    if (bench_out) {
+        sprintf(line, "%s\t%lu.%02lu\t%lu.%02lu\t%lu\n", name,
+                (unsigned long)(rate / 100), (unsigned long)(rate % 100),
+                (unsigned long)(per_op / 100), (unsigned long)(per_op % 100),
+                (unsigned long)bytes);
+        FPuts(bench_out, line);
+    }
+    return TRUE;
+}
+
+static ULONG
+Bench_FileSize(CONST_STRPTR path)
+{
+    ULONG size = 0;
+    struct DateStamp mtime;
+
+    return SongDB_SourceStat(path, &size, &mtime) ? size : 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Test data                                                           */
+/* ------------------------------------------------------------------ */
+
+static const char *const bench_authors[] = {
+    "Hubbard_Rob", "Galway_Martin", "Daglish_Ben", "Tel_Jeroen",
+    "Follin_Tim", "Gray_Matt", "Rowlands_Steve", "Whittaker_David"
+};
+
+static const char *const bench_titles[] = {
+    "Commando", "Monty on the Run", "Delta", "Cybernoid",
+    "Last Ninja", "Wizball", "Sanxion", "Parallax"
+};
+
+#define BENCH_NAMES (sizeof(bench_titles) / sizeof(bench_titles[0]))
+
+/* Search term typed one character at a time by search.typing */
+static const char bench_typed[] = "monty";
+
+/* A line typed into the C64 by the keyboard-buffer calls */
+static const char bench_typed_line[] = "LOAD\"MONTY ON THE RUN\",8,1\r";
+
+static ULONG bench_seed;
+
+static ULONG
+Bench_Random(void)
+{
+    bench_seed = bench_seed * 1103515245UL + 12345UL;
+    return bench_seed >> 8;
+}
+
+/* Same MD5 for the same i, so every file agrees on the tunes */
+static void
+Bench_MD5(ULONG i, UBYTE md5[MD5_HASH_SIZE])
+{
+    ULONG k;
+
+    bench_seed = i * 2654435761UL + 1;
+    for (k = 0; k < MD5_HASH_SIZE; k++) md5[k] = (UBYTE)Bench_Random();
+}
+
+/* Songlengths.md5 as HVSC ships it: a section header, then a path comment
+ * and an entry per tune with one to four subsongs. */
+static BOOL
+Bench_WriteSonglengths(void)
+{
+    BPTR file = Open(BENCH_SONGLENGTHS, MODE_NEWFILE);
+    char line[256], hex[MD5_STRING_SIZE];
+    UBYTE md5[MD5_HASH_SIZE];
+    ULONG i, k, subsongs;
+    int len;
+
+    if (!file) return FALSE;
+    FPuts(file, "[Database]\n");
+    for (i = 0; i < BENCH_SONGS; i++) {
+        sprintf(line, "; /MUSICIANS/%s/Tune_%lu.sid\n",
+                bench_authors[i % BENCH_NAMES], (unsigned long)i);
+        FPuts(file, line);
+
+        Bench_MD5(i, md5);
+        MD5ToHexString(md5, hex);
+        len = sprintf(line, "%s=", hex);
+        subsongs = 1 + (Bench_Random() & 3);
+        for (k = 0; k < subsongs; k++) {
+            ULONG seconds = 30 + Bench_Random() % 600;
+            len += sprintf(line + len, "%s%lu:%02lu", k ? " " : "",
+                           (unsigned long)(seconds / 60), (unsigned long)(seconds % 60));
+        }
+        strcpy(line + len, "\n");
+        FPuts(file, line);
+    }
+    Close(file);
+    return TRUE;
+}
+
+/* A playlist of BENCH_ENTRIES tunes, saved in both formats */
+static BOOL
+Bench_BuildPlaylist(struct ObjApp *obj)
+{
+    char filename[128], title[64];
+    UBYTE md5[MD5_HASH_SIZE];
+    ULONG i;
+
+    for (i = 0; i < BENCH_ENTRIES; i++) {
+        sprintf(filename, "HVSC:MUSICIANS/%s/Tune_%lu.sid",
+                bench_authors[i % BENCH_NAMES], (unsigned long)i);
+        sprintf(title, "%s %lu", bench_titles[(i / BENCH_NAMES) % BENCH_NAMES],
+                (unsigned long)i);
+        Bench_MD5(i, md5);
+        if (!AddPlaylistEntryWithInfo(obj, filename, title, md5, 1 + (i & 3))) {
+            return FALSE;
+        }
+    }
+    return SavePlaylistToFile(obj, BENCH_PLAYLIST_TEXT)
+        && SavePlaylistToFile(obj, BENCH_PLAYLIST_BIN);
+}
+
+/* A journal holding every playlist tune, compacted */
+static BOOL
+Bench_WriteSet(void)
+{
+    struct MD5Set *set = MD5Set_Create();
+    UBYTE md5[MD5_HASH_SIZE];
+    BOOL ok;
+    ULONG i;
+
+    if (!set) return FALSE;
+    DeleteFile(BENCH_SET);
+    ok = MD5Set_Load(set, BENCH_SET, NULL);
+    for (i = 0; ok && i < BENCH_ENTRIES; i++) {
+        Bench_MD5(i, md5);
+        MD5Set_Insert(set, md5);
+    }
+    ok = ok && MD5Set_Flush(set);
+    MD5Set_Free(set);
+    return ok;
+}
+
+/* Replies as an Ultimate 64 on 3.11 firmware sends them */
+static const char bench_info_json[] =
+    "{\n"
+    "  \"product\": \"Ultimate 64\",\n"
+    "  \"firmware_version\": \"3.11\",\n"
+    "  \"fpga_version\": \"11F\",\n"
+    "  \"core_version\": \"143\",\n"
+    "  \"hostname\": \"Terakura\",\n"
+    "  \"unique_id\": \"8D927F\",\n"
+    "  \"errors\": []\n"
+    "}\n";
+
+static const char bench_drives_json[] =
+    "{\n"
+    "  \"drives\": [\n"
+    "    { \"a\": { \"enabled\": true, \"bus_id\": 8, \"type\": \"1541\",\n"
+    "               \"rom\": \"1541.rom\", \"image_file\": \"games.d64\",\n"
+    "               \"image_path\": \"/USB0/Games/\" } },\n"
+    "    { \"b\": { \"enabled\": false, \"bus_id\": 9, \"type\": \"1571\",\n"
+    "               \"rom\": \"1571.rom\", \"image_file\": \"\",\n"
+    "               \"image_path\": \"\" } },\n"
+    "    { \"IEC Drive\": { \"enabled\": false, \"bus_id\": 11,\n"
+    "                     \"type\": \"DOS emulation\",\n"
+    "                     \"last_error\": \"73,U64IEC ULTIMATE DOS V1.1,00,00\",\n"
+    "                     \"partitions\": [ { \"id\": 0, \"path\": \"/USB0/\" } ] } },\n"
+    "    { \"Printer Emulation\": { \"enabled\": false, \"bus_id\": 4 } }\n"
+    "  ],\n"
+    "  \"errors\": []\n"
+    "}\n";
+
+static ULONG
+Bench_HttpReply(char *out, const char *json)
+{
+    return (ULONG)sprintf(out,
+                          "HTTP/1.1 200 OK\r\n"
+                          "Connection: keep-alive\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Content-Length: %lu\r\n"
+                          "\r\n%s",
+                          (unsigned long)strlen(json), json);
+}
+
+/* ------------------------------------------------------------------ */
+/* Cases                                                               */
+/* ------------------------------------------------------------------ */
+
+static BOOL
+Bench_SongDBParse(struct BenchData *d)
+{
+    struct SongLengthDB *db = SongDB_BenchParse(BENCH_SONGLENGTHS);
+
+    if (!db) return FALSE;
+    SongDB_BenchFree(db);
+    return TRUE;
+}
+
+static BOOL
+Bench_SongDBCache(struct BenchData *d)
+{
+    struct SongLengthDB *db = SongDB_BenchReadCache(BENCH_SONGLENGTHS);
+
+    if (!db) return FALSE;
+    SongDB_BenchFree(db);
+    return TRUE;
+}
+
+/* The lookups U64_ParseDeviceInfo makes */
+static BOOL
+Bench_JsonInfo(struct BenchData *d)
+{
+    static const char *const keys[] = {
+        "product", "firmware_version", "fpga_version", "core_version",
+        "hostname", "unique_id"
+    };
+    JsonParser parser;
+    ULONG i;
+
+    if (!U64_JsonInit(&parser, (CONST_STRPTR)bench_info_json)) return FALSE;
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (!U64_JsonFindKey(&parser, (CONST_STRPTR)keys[i])) return FALSE;
+    }
+    return TRUE;
+}
+
+/* The lookups U64_GetDriveStatus makes for drives A and B */
+static BOOL
+Bench_JsonDrives(struct BenchData *d)
+{
+    static const char *const drives[] = { "a", "b" };
+    static const char *const keys[] = {
+        "enabled", "bus_id", "type", "rom", "image_file", "image_path"
+    };
+    JsonParser parser;
+    ULONG i, k, obj_start;
+
+    if (!U64_JsonInit(&parser, (CONST_STRPTR)bench_drives_json)) return FALSE;
+    if (!U64_JsonFindKey(&parser, (CONST_STRPTR)"drives")) return FALSE;
+    for (i = 0; i < 2; i++) {
+        parser.position = 0;
+        if (!U64_JsonFindKey(&parser, (CONST_STRPTR)drives[i])) return FALSE;
+        obj_start = parser.position;
+        for (k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+            parser.position = obj_start;
+            if (!U64_JsonFindKey(&parser, (CONST_STRPTR)keys[k])) return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* A borrowed body, as most library calls take it */
+static BOOL
+Bench_HttpParse(struct BenchData *d)
+{
+    HttpRequest req;
+    BOOL borrowed = FALSE;
+
+    memset(&req, 0, sizeof(req));
+    req.flags = HTTP_BORROW_RESPONSE;
+    return U64_HttpParseResponse(&req, d->http_info, d->http_info_len, &borrowed) == U64_OK
+        && req.response_size > 0;
+}
+
+/* A body of its own, as the callers that keep it take it */
+static BOOL
+Bench_HttpParseCopy(struct BenchData *d)
+{
+    HttpRequest req;
+    BOOL borrowed = FALSE;
+
+    memset(&req, 0, sizeof(req));
+    if (U64_HttpParseResponse(&req, d->http_drives, d->http_drives_len, &borrowed) != U64_OK
+        || !req.response) {
+        return FALSE;
+    }
+    FreeMem(req.response, req.response_size + 1);
+    return TRUE;
+}
+
+static BOOL
+Bench_MD5Sid(struct BenchData *d)
+{
+    UBYTE digest[MD5_HASH_SIZE];
+
+    CalculateMD5(d->sid, BENCH_SID_BYTES, digest);
+    return TRUE;
+}
+
+static BOOL
+Bench_Petscii(struct BenchData *d)
+{
+    ULONG len;
+    UBYTE *petscii = U64_StringToPETSCII((CONST_STRPTR)bench_typed_line, &len);
+
+    if (!petscii) return FALSE;
+    FreeMem(petscii, len + 1);
+    return TRUE;
+}
+
+static BOOL
+Bench_MD5SetLoad(struct BenchData *d)
+{
+    struct MD5Set *set = MD5Set_Create();
+    BOOL ok;
+
+    if (!set) return FALSE;
+    ok = MD5Set_Load(set, BENCH_SET, NULL) && set->count == BENCH_ENTRIES;
+    MD5Set_Free(set);
+    return ok;
+}
+
+static BOOL
+Bench_MD5SetSave(struct BenchData *d)
+{
+    d->set->dirty = TRUE;           /* force the full rewrite */
+    return MD5Set_Flush(d->set);
+}
+
+static BOOL
+Bench_PlaylistText(struct BenchData *d)
+{
+    return LoadPlaylistFromFile(d->obj, BENCH_PLAYLIST_TEXT)
+        && d->obj->playlist_count == BENCH_ENTRIES;
+}
+
+static BOOL
+Bench_PlaylistBinary(struct BenchData *d)
+{
+    return LoadPlaylistFromFile(d->obj, BENCH_PLAYLIST_BIN)
+        && d->obj->playlist_count == BENCH_ENTRIES;
+}
+
+/* A term pasted in: one full pass over the playlist */
+static BOOL
+Bench_SearchFull(struct BenchData *d)
+{
+    strcpy(d->obj->search_text, "ninja");
+    InvalidateSearchMatches(d->obj);
+    UpdateSearchMatches();
+    return d->obj->search_applied_valid;
+}
+
+/* The term typed a key at a time: one full pass, then narrowing */
+static BOOL
+Bench_SearchTyping(struct BenchData *d)
+{
+    ULONG n = d->typing_step++ % (sizeof(bench_typed) - 1);
+
+    CopyMem((APTR)bench_typed, d->obj->search_text, n + 1);
+    d->obj->search_text[n + 1] = '\0';
+    UpdateSearchMatches();
+    return d->obj->search_applied_valid;
+}
+
+/* ------------------------------------------------------------------ */
+/* Entry point                                                         */
+/* ------------------------------------------------------------------ */
+
+static void
+Bench_Header(void)
+{
+    UWORD attn = SysBase->AttnFlags;
+    CONST_STRPTR cpu = "68000";
+    CONST_STRPTR fpu = "none";
+    char line[96];
+
+    if (attn & AFF_68040) cpu = "68040";
+    else if (attn & AFF_68030) cpu = "68030";
+    else if (attn & AFF_68020) cpu = "68020";
+    else if (attn & AFF_68010) cpu = "68010";
+#ifdef AFF_68060
+    if (attn & AFF_68060) cpu = "68060";  /* sets the 68040 bit too */
+#endif
+
+    if (attn & AFF_FPU40) fpu = "internal";
+    else if (attn & AFF_68882) fpu = "68882";
+    else if (attn & AFF_68881) fpu = "68881";
+
+    printf("\nHot paths (%s CPU, FPU %s):\n", cpu, fpu);
+    if (bench_out) {
+        sprintf(line, "# u64player benchmark %d\n# cpu %s fpu %s\n",
+                BENCH_FORMAT_VERSION, cpu, fpu);
+        FPuts(bench_out, line);
+        FPuts(bench_out, "name\tops_per_s\tallocs_per_op\tbytes_per_op\n");
+    }
+}
+
+/* "U64Player BENCHMARK [results]": MD5 kernels, then the suite. Returns
+ * a shell return code. */
+int
+Bench_Run(CONST_STRPTR results_path)
+{
+    struct BenchData *d;
+    struct SongLengthDB *db;
+    BOOL ok;
+    ULONG i;
+    int rc;
+
+    rc = MD5_Benchmark();
+    if (rc != RETURN_OK) return rc;
+
+    d = AllocVec(sizeof(struct BenchData), MEMF_PUBLIC | MEMF_CLEAR);
+    if (d) {
+        d->obj = AllocVec(sizeof(struct ObjApp), MEMF_PUBLIC | MEMF_CLEAR);
+        d->sid = AllocVec(BENCH_SID_BYTES, MEMF_PUBLIC);
+        d->set = MD5Set_Create();
+    }
+    if (!d || !d->obj || !d->sid || !d->set) {
+        printf("Out of memory\n");
+        rc = RETURN_FAIL;
+        goto done;
+    }
+
+    if (results_path) {
+        bench_out = Open(results_path, MODE_NEWFILE);
+        if (!bench_out) {
+            printf("Cannot create %s\n", results_path);
+            rc = RETURN_FAIL;
+            goto done;
+        }
+    }
+
+    /* The playlist cases run against this instead of the GUI's; every
+     * MUI object in it is NULL, which the display code skips. */
+    objApp = d->obj;
+
+    printf("\nPreparing test data in T:...\n");
+    for (i = 0; i < BENCH_SID_BYTES; i++) d->sid[i] = (UBYTE)(i * 13 + (i >> 7));
+    d->http_info_len = Bench_HttpReply(d->http_info, bench_info_json);
+    d->http_drives_len = Bench_HttpReply(d->http_drives, bench_drives_json);
+
+    ok = Bench_WriteSonglengths() && Bench_WriteSet() && Bench_BuildPlaylist(d->obj);
+    if (ok) {
+        db = SongDB_BenchParse(BENCH_SONGLENGTHS);
+        ok = db && SongDB_BenchWriteCache(db, BENCH_SONGLENGTHS);
+        SongDB_BenchFree(db);
+    }
+    ok = ok && MD5Set_Load(d->set, BENCH_SET, NULL);
+    if (!ok) {
+        printf("Could not write the test data (is T: full?)\n");
+        rc = RETURN_FAIL;
+        goto done;
+    }
+
+    Bench_Header();
+    Bench_CountAllocs(TRUE);
+
+    ok = Bench_Time("songdb.parse", Bench_SongDBParse, d, Bench_FileSize(BENCH_SONGLENGTHS));
+    ok &= Bench_Time("songdb.cache", Bench_SongDBCache, d,
+                     Bench_FileSize(BENCH_SONGLENGTHS ".cache"));
+    ok &= Bench_Time("json.info", Bench_JsonInfo, d, sizeof(bench_info_json) - 1);
+    ok &= Bench_Time("json.drives", Bench_JsonDrives, d, sizeof(bench_drives_json) - 1);
+    ok &= Bench_Time("http.parse", Bench_HttpParse, d, d->http_info_len);
+    ok &= Bench_Time("http.parse.copy", Bench_HttpParseCopy, d, d->http_drives_len);
+    ok &= Bench_Time("md5.sid", Bench_MD5Sid, d, BENCH_SID_BYTES);
+    ok &= Bench_Time("petscii", Bench_Petscii, d, sizeof(bench_typed_line) - 1);
+    ok &= Bench_Time("md5set.load", Bench_MD5SetLoad, d, Bench_FileSize(BENCH_SET));
+    ok &= Bench_Time("md5set.save", Bench_MD5SetSave, d, Bench_FileSize(BENCH_SET));
+    ok &= Bench_Time("playlist.text", Bench_PlaylistText, d, Bench_FileSize(BENCH_PLAYLIST_TEXT));
+    ok &= Bench_Time("playlist.binary", Bench_PlaylistBinary, d,
+                     Bench_FileSize(BENCH_PLAYLIST_BIN));
+    ok &= Bench_Time("search.full", Bench_SearchFull, d, 0);
+    ok &= Bench_Time("search.typing", Bench_SearchTyping, d, 0);
+
+    rc = ok ? RETURN_OK : RETURN_WARN;
+    if (results_path) printf("\nResults written to %s\n", results_path);
+
+done:
+    Bench_CountAllocs(FALSE);
+    if (bench_out) {
+        Close(bench_out);
+        bench_out = 0;
+    }
+    DeleteFile(BENCH_SONGLENGTHS);
+    DeleteFile(BENCH_SONGLENGTHS ".cache");
+    DeleteFile(BENCH_SET);
+    DeleteFile(BENCH_PLAYLIST_TEXT);
+    DeleteFile(BENCH_PLAYLIST_BIN);
+    if (d) {
+        if (d->obj) {
+            FreePlaylists(d->obj);
+            FreeVec(d->obj);
+        }
+        objApp = NULL;
+        if (d->sid) FreeVec(d->sid);
+        MD5Set_Free(d->set);
+        FreeVec(d);
+    }
+    return rc;
+}
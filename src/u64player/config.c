@@ -8,15 +8,17 @@
 #include <proto/dos.h>
 #include <proto/exec.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "player.h"
 #include "env_utils.h"
+#include "sidcache.h"
 
 /* Configuration functions */
 BOOL LoadConfig(struct ObjApp *obj)
 {
-    STRPTR env_host, env_password, env_dir;
+    STRPTR env_host, env_password, env_dir, env_cache, env_hvsc, env_smart, env_silence;
 
     env_host = U64_ReadEnvVar(ENV_ULTIMATE64_HOST);
     if (env_host) {
@@ -43,6 +45,43 @@ BOOL LoadConfig(struct ObjApp *obj)
         strcpy(obj->last_sid_dir, "");
     }
 
+    env_hvsc = U64_ReadEnvVar(ENV_ULTIMATE64_HVSC_ROOT);
+    if (env_hvsc) {
+        strncpy(obj->hvsc_root, env_hvsc, sizeof(obj->hvsc_root) - 1);
+        obj->hvsc_root[sizeof(obj->hvsc_root) - 1] = '\0';
+        FreeVec(env_hvsc);
+    } else {
+        obj->hvsc_root[0] = '\0';
+    }
+
+    /* Smart playlist left running last time; main.c resumes it */
+    env_smart = U64_ReadEnvVar(ENV_ULTIMATE64_SMART_QUERY);
+    if (env_smart) {
+        strncpy(obj->smart_query, env_smart, sizeof(obj->smart_query) - 1);
+        obj->smart_query[sizeof(obj->smart_query) - 1] = '\0';
+        FreeVec(env_smart);
+    } else {
+        obj->smart_query[0] = '\0';
+    }
+
+    /* Seconds of silence before "Skip silence" moves on */
+    obj->silence_secs = SILENCE_DEFAULT_SECS;
+    env_silence = U64_ReadEnvVar(ENV_ULTIMATE64_SILENCE_SECS);
+    if (env_silence) {
+        obj->silence_secs = (ULONG)atol(env_silence);
+        if (obj->silence_secs == 0) obj->silence_secs = SILENCE_DEFAULT_SECS;
+        FreeVec(env_silence);
+    }
+
+    /* SID file cache budget in KB; 0 keeps only the tune being played. */
+    obj->sid_cache_kb = SIDCACHE_DEFAULT_KB;
+    env_cache = U64_ReadEnvVar(ENV_ULTIMATE64_SID_CACHE);
+    if (env_cache) {
+        obj->sid_cache_kb = (ULONG)atol(env_cache);
+        FreeVec(env_cache);
+    }
+    SIDCache_SetBudget(obj->sid_cache, obj->sid_cache_kb * 1024);
+
     return TRUE;
 }
 
@@ -60,5 +99,9 @@ BOOL SaveConfig(struct ObjApp *obj)
         U64_WriteEnvVar(ENV_ULTIMATE64_SID_DIR, obj->last_sid_dir, TRUE);
     }
 
+    if (strlen(obj->hvsc_root) > 0) {
+        U64_WriteEnvVar(ENV_ULTIMATE64_HVSC_ROOT, obj->hvsc_root, TRUE);
+    }
+
     return TRUE;
 }
@@ -45,15 +45,14 @@ BOOL APP_ToggleFavourite(void)
         /* Fall back to the MUI-selected row. */
         LONG active = -1;
         get(objApp->LSV_PlaylistList, MUIA_List_Active, &active);
-        if (active < 0) return FALSE;
+        if (active < 0 || (ULONG)active >= objApp->playlist_count) return FALSE;
 
-        PlaylistEntry *e = objApp->playlist_head;
-        LONG i = 0;
-        while (e && i < active) { e = e->next; i++; }
-        target = e;
+        target = &objApp->playlist[active];
     }
     if (!target) return FALSE;
 
+    /* The set is keyed by MD5, so it has to be known first */
+    Resolver_ResolveNow(objApp, target);
     target->is_favourite = !target->is_favourite;
     if (target->is_favourite) {
         MD5Set_Insert(objApp->favourites, target->md5);
@@ -63,7 +62,7 @@ BOOL APP_ToggleFavourite(void)
         APP_UpdateStatus("Removed from favourites");
     }
 
-    APP_UpdatePlaylistDisplay();
+    APP_RedrawPlaylistRow((ULONG)(target - objApp->playlist));
     return TRUE;
 }
 
@@ -397,16 +396,14 @@ BOOL APP_AddFiles(void)
                 if (args[i].wa_Lock && args[i].wa_Name) {
                     if (NameFromLock(args[i].wa_Lock, filename, sizeof(filename) - 32)) {
                         if (AddPart(filename, args[i].wa_Name, sizeof(filename))) {
-                            if (AddPlaylistEntry(objApp, filename)) {
+                            /* Name only; resolver.c reads the files in
+                             * the background */
+                            if (AddPlaylistEntryLazy(objApp, filename)) {
                                 added++;
                             }
                         }
                     }
                 }
-
-                if ((i % 10) == 0) {
-                    Delay(1);
-                }
             }
         }
     }
@@ -419,9 +416,10 @@ BOOL APP_AddFiles(void)
     if (success && added > 0) {
         APP_UpdatePlaylistDisplay();
 
-        if (!objApp->current_entry && objApp->playlist_head) {
-            objApp->current_entry = objApp->playlist_head;
+        if (!objApp->current_entry && objApp->playlist_count > 0) {
+            objApp->current_entry = &objApp->playlist[0];
             objApp->current_index = 0;
+            Resolver_ResolveNow(objApp, objApp->current_entry);
             objApp->current_entry->duration = FindSongLength(objApp, objApp->current_entry->md5,
                                                              objApp->current_entry->current_subsong);
             if (objApp->current_entry->duration == 0) {
@@ -430,6 +428,7 @@ BOOL APP_AddFiles(void)
             APP_UpdateCurrentSongCache();
             APP_UpdateCurrentSongDisplay();
         }
+        Resolver_Kick(objApp);
 
         char status_msg[256];
         sprintf(status_msg, "Added %lu files to playlist", (unsigned int)added);
@@ -456,49 +455,19 @@ BOOL APP_RemoveFile(void)
         return FALSE;
     }
 
-    /* Find entry to remove */
-    PlaylistEntry *entry = objApp->playlist_head;
-    PlaylistEntry *prev = NULL;
-
-    for (ULONG i = 0; i < (ULONG)active && entry; i++) {
-        prev = entry;
-        entry = entry->next;
-    }
-
-    if (!entry) {
+    if ((ULONG)active >= objApp->playlist_count) {
         return FALSE;
     }
 
     /* Stop playback if removing current song */
-    if (entry == objApp->current_entry) {
+    if (objApp->current_entry == &objApp->playlist[active]) {
         if (objApp->state == PLAYER_PLAYING) {
             objApp->state = PLAYER_STOPPED;
         }
-        objApp->current_entry = entry->next;
-        if (!objApp->current_entry && objApp->playlist_head != entry) {
-            objApp->current_entry = objApp->playlist_head;
-            objApp->current_index = 0;
-        }
-    }
-
-    /* Remove from list */
-    if (prev) {
-        prev->next = entry->next;
-    } else {
-        objApp->playlist_head = entry->next;
     }
 
-    /* Adjust current index */
-    if (objApp->current_index > (ULONG)active) {
-        objApp->current_index--;
-    }
-
-    /* Free entry */
-    U64_SafeStrFree(entry->filename);
-    U64_SafeStrFree(entry->title);
-    FreeVec(entry);
-
-    objApp->playlist_count--;
+    /* Close the gap; the current entry moves along with its index */
+    RemovePlaylistEntry(objApp, (ULONG)active);
 
     APP_UpdatePlaylistDisplay();
     APP_UpdateCurrentSongDisplay();
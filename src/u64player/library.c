@@ -0,0 +1,1201 @@
+/* Ultimate64 SID Player - HVSC library catalogue and "search library" window
+ * For Amiga OS 3.x by Marcin Spoczynski
+ *
+ * See library.h for the catalogue layout. Library_Rescan walks the HVSC
+ * root and writes library.cat; trigram.c indexes it. The Library window
+ * queries that index and adds hits straight to the playlist.
+ */
+
+#include <dos/dos.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+#include <libraries/asl.h>
+#include <libraries/mui.h>
+
+#include <proto/asl.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/intuition.h>
+#include <proto/muimaster.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "player.h"
+#include "strpool.h"
+#include "library.h"
+#include "smartpl.h"
+
+#define LIBRARY_DIR_HASH 256        /* buckets for old-directory lookup */
+#define LIBRARY_NO_DIR   ((ULONG)~0)
+
+/* ------------------------------------------------------------------ */
+/* Reading                                                             */
+/* ------------------------------------------------------------------ */
+
+/* Join a root-relative directory and a file name into out. */
+static void
+Library_JoinPath(char *out, ULONG out_size, CONST_STRPTR dir, CONST_STRPTR name)
+{
+    if (dir && dir[0]) {
+        snprintf(out, out_size, "%s/%s", dir, name);
+    } else {
+        strncpy(out, name, out_size - 1);
+        out[out_size - 1] = '\0';
+    }
+}
+
+/* Unpack the record at p into rec. Returns the first byte after it, or
+ * NULL if the record runs past end. */
+static const UBYTE *
+Library_UnpackRecord(const UBYTE *p, const UBYTE *end, CONST_STRPTR dir_path,
+                     LibraryRecord *rec)
+{
+    char name[256];
+    ULONG lens[4];
+    ULONG i;
+
+    if (end - p < 4 + LIBCAT_INFO_SIZE) return NULL;
+    for (i = 0; i < 4; i++) lens[i] = p[i];
+    p += 4;
+    CopyMem((APTR)p, &rec->info, LIBCAT_INFO_SIZE);
+    p += LIBCAT_INFO_SIZE;
+    if ((ULONG)(end - p) < lens[0] + lens[1] + lens[2] + lens[3]) return NULL;
+
+    CopyMem((APTR)p, name, lens[0]);
+    name[lens[0]] = '\0';
+    p += lens[0];
+    Library_JoinPath(rec->path, sizeof(rec->path), dir_path, name);
+
+    CopyMem((APTR)p, rec->title, lens[1]);
+    rec->title[lens[1] < 32 ? lens[1] : 32] = '\0';
+    p += lens[1];
+    CopyMem((APTR)p, rec->author, lens[2]);
+    rec->author[lens[2] < 32 ? lens[2] : 32] = '\0';
+    p += lens[2];
+    CopyMem((APTR)p, rec->released, lens[3]);
+    rec->released[lens[3] < 32 ? lens[3] : 32] = '\0';
+    p += lens[3];
+
+    return p;
+}
+
+struct SIDLibrary *
+Library_Open(CONST_STRPTR cat_path)
+{
+    struct SIDLibrary *lib;
+    ULONG i;
+
+    lib = AllocVec(sizeof(struct SIDLibrary), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!lib) return NULL;
+
+    lib->cat = Open(cat_path, MODE_OLDFILE);
+    if (!lib->cat) goto fail;
+
+    if (Read(lib->cat, &lib->hdr, sizeof(lib->hdr)) != sizeof(lib->hdr)
+        || memcmp(lib->hdr.magic, LIBRARY_CAT_MAGIC, 8) != 0
+        || lib->hdr.version != LIBRARY_CAT_VERSION) {
+        U64_DEBUG("library: %s is not a v%d catalogue", cat_path, LIBRARY_CAT_VERSION);
+        goto fail;
+    }
+    lib->hdr.root[sizeof(lib->hdr.root) - 1] = '\0';
+
+    lib->strings = StrPool_Create();
+    if (!lib->strings) goto fail;
+
+    if (lib->hdr.dir_count > 0) {
+        LONG bytes = lib->hdr.dir_count * sizeof(LibCatDir);
+
+        lib->dirs = AllocVec(bytes, MEMF_PUBLIC);
+        lib->dir_paths = AllocVec(lib->hdr.dir_count * sizeof(STRPTR), MEMF_PUBLIC | MEMF_CLEAR);
+        if (!lib->dirs || !lib->dir_paths) goto fail;
+
+        Seek(lib->cat, lib->hdr.dir_table_offset, OFFSET_BEGINNING);
+        if (Read(lib->cat, lib->dirs, bytes) != bytes) goto fail;
+
+        for (i = 0; i < lib->hdr.dir_count; i++) {
+            char path[512];
+            UBYTE be[2];
+            ULONG len;
+
+            Seek(lib->cat, lib->dirs[i].block_offset, OFFSET_BEGINNING);
+            if (Read(lib->cat, be, 2) != 2) goto fail;
+            len = (be[0] << 8) | be[1];
+            if (len >= sizeof(path)) goto fail;
+            if (Read(lib->cat, path, len) != len) goto fail;
+            lib->dir_paths[i] = StrPool_AddLen(lib->strings, path, len);
+            if (!lib->dir_paths[i]) goto fail;
+        }
+    }
+
+    U64_DEBUG("library: opened %lu records in %lu dirs",
+              (unsigned long)lib->hdr.record_count, (unsigned long)lib->hdr.dir_count);
+    return lib;
+
+fail:
+    Library_Close(lib);
+    return NULL;
+}
+
+void
+Library_Close(struct SIDLibrary *lib)
+{
+    if (!lib) return;
+    if (lib->cat) Close(lib->cat);
+    if (lib->idx) Close(lib->idx);
+    if (lib->dirs) FreeVec(lib->dirs);
+    if (lib->dir_paths) FreeVec(lib->dir_paths);
+    StrPool_Free(lib->strings);
+    FreeVec(lib);
+}
+
+/* Directory holding record index — binary search on first_record. */
+static ULONG
+Library_DirOfRecord(struct SIDLibrary *lib, ULONG index)
+{
+    ULONG lo = 0, hi = lib->hdr.dir_count;
+
+    while (hi - lo > 1) {
+        ULONG mid = (lo + hi) / 2;
+        if (lib->dirs[mid].first_record <= index) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+BOOL
+Library_ReadRecord(struct SIDLibrary *lib, ULONG index, LibraryRecord *rec)
+{
+    UBYTE buf[4 + LIBCAT_INFO_SIZE + 4 * 255];
+    ULONG offset;
+    LONG got;
+
+    if (!lib || index >= lib->hdr.record_count) return FALSE;
+
+    Seek(lib->cat, lib->hdr.record_table_offset + index * sizeof(ULONG), OFFSET_BEGINNING);
+    if (Read(lib->cat, &offset, sizeof(offset)) != sizeof(offset)) return FALSE;
+
+    Seek(lib->cat, offset, OFFSET_BEGINNING);
+    got = Read(lib->cat, buf, sizeof(buf));
+    if (got < 4) return FALSE;
+
+    return Library_UnpackRecord(buf, buf + got,
+                                lib->dir_paths[Library_DirOfRecord(lib, index)],
+                                rec) != NULL;
+}
+
+BOOL
+Library_ForEach(struct SIDLibrary *lib, LibraryRecordFunc func, APTR user)
+{
+    UBYTE *block = NULL;
+    ULONG block_capacity = 0;
+    LibraryRecord rec;
+    BOOL ok = TRUE;
+    ULONG d, i;
+
+    if (!lib) return FALSE;
+
+    for (d = 0; d < lib->hdr.dir_count && ok; d++) {
+        LibCatDir *dir = &lib->dirs[d];
+        const UBYTE *p, *end;
+
+        if (dir->block_size > block_capacity) {
+            if (block) FreeVec(block);
+            block_capacity = dir->block_size;
+            block = AllocVec(block_capacity, MEMF_PUBLIC);
+            if (!block) return FALSE;
+        }
+
+        Seek(lib->cat, dir->block_offset, OFFSET_BEGINNING);
+        if (Read(lib->cat, block, dir->block_size) != (LONG)dir->block_size) {
+            ok = FALSE;
+            break;
+        }
+
+        end = block + dir->block_size;
+        p = block + 2 + ((block[0] << 8) | block[1]);
+        for (i = 0; i < dir->record_count && ok; i++) {
+            p = Library_UnpackRecord(p, end, lib->dir_paths[d], &rec);
+            if (!p) {
+                ok = FALSE;
+                break;
+            }
+            if (!func(dir->first_record + i, &rec, user)) ok = FALSE;
+        }
+    }
+
+    if (block) FreeVec(block);
+    return ok;
+}
+
+/* ------------------------------------------------------------------ */
+/* Rescan                                                              */
+/* ------------------------------------------------------------------ */
+
+#define LIBRARY_FILE_HASH 64        /* buckets for old-file lookup per dir */
+
+struct RescanState {
+    struct ObjApp *obj;
+    struct SIDLibrary *old;         /* previous catalogue, may be NULL */
+    ULONG *old_next;                /* hash chains over old->dir_paths */
+    ULONG old_head[LIBRARY_DIR_HASH];
+    ULONG *old_child;               /* first subdirectory of each old dir */
+    ULONG *old_sibling;             /* next subdirectory of the same parent */
+    BPTR   out;
+    ULONG  pos;                     /* bytes written so far */
+    ULONG *offsets;
+    ULONG  offset_count;
+    ULONG  offset_capacity;
+    LibCatDir *dirs;
+    ULONG  dir_count;
+    ULONG  dir_capacity;
+    struct LibraryDelta *delta;     /* NULL unless record moves are tracked */
+    char   root[256];
+    ULONG  files_seen;
+    ULONG  files_hashed;
+    ULONG  dirs_reused;
+    BOOL   failed;
+};
+
+/* Records of one old directory block, looked up by file name while the
+ * directory is re-enumerated. */
+struct OldFiles {
+    UBYTE *block;
+    const UBYTE **rec;              /* start of each record in block */
+    ULONG *next;
+    ULONG  head[LIBRARY_FILE_HASH];
+    ULONG  count;
+};
+
+static ULONG
+Library_HashPath(CONST_STRPTR s)
+{
+    ULONG h = 5381;
+    while (*s) h = (h * 33) ^ (UBYTE)*s++;
+    return h % LIBRARY_DIR_HASH;
+}
+
+static ULONG
+Library_HashName(const UBYTE *s, ULONG len)
+{
+    ULONG h = 5381;
+    while (len--) h = (h * 33) ^ *s++;
+    return h % LIBRARY_FILE_HASH;
+}
+
+static ULONG
+Library_RecordSize(const UBYTE *p)
+{
+    return 4 + LIBCAT_INFO_SIZE + p[0] + p[1] + p[2] + p[3];
+}
+
+/* Index of rel in the old catalogue, or LIBRARY_NO_DIR */
+static ULONG
+Library_FindOldDir(struct RescanState *st, CONST_STRPTR rel)
+{
+    ULONG i;
+
+    if (!st->old || !st->old_next) return LIBRARY_NO_DIR;
+    for (i = st->old_head[Library_HashPath(rel)]; i != LIBRARY_NO_DIR; i = st->old_next[i]) {
+        if (strcmp(st->old->dir_paths[i], rel) == 0) return i;
+    }
+    return LIBRARY_NO_DIR;
+}
+
+/* Hash the old directory paths and link each to its parent, so unchanged
+ * directories can be walked without enumerating them. */
+static void
+Library_IndexOldDirs(struct RescanState *st)
+{
+    ULONG n = st->old->hdr.dir_count;
+    ULONG i;
+
+    st->old_next = AllocVec(n * sizeof(ULONG), MEMF_PUBLIC);
+    st->old_child = AllocVec(n * sizeof(ULONG), MEMF_PUBLIC);
+    st->old_sibling = AllocVec(n * sizeof(ULONG), MEMF_PUBLIC);
+    if (!st->old_next || !st->old_child || !st->old_sibling) {
+        /* Without the index every directory is simply read again */
+        if (st->old_next) FreeVec(st->old_next);
+        if (st->old_child) FreeVec(st->old_child);
+        if (st->old_sibling) FreeVec(st->old_sibling);
+        st->old_next = st->old_child = st->old_sibling = NULL;
+        return;
+    }
+
+    for (i = 0; i < LIBRARY_DIR_HASH; i++) st->old_head[i] = LIBRARY_NO_DIR;
+    for (i = 0; i < n; i++) {
+        ULONG h = Library_HashPath(st->old->dir_paths[i]);
+        st->old_next[i] = st->old_head[h];
+        st->old_head[h] = i;
+        st->old_child[i] = LIBRARY_NO_DIR;
+        st->old_sibling[i] = LIBRARY_NO_DIR;
+    }
+
+    /* Walk backwards so each child list comes out in catalogue order */
+    for (i = n; i-- > 0; ) {
+        char parent[512];
+        char *slash;
+        ULONG p;
+
+        if (st->old->dir_paths[i][0] == '\0') continue;   /* the root */
+        strncpy(parent, st->old->dir_paths[i], sizeof(parent) - 1);
+        parent[sizeof(parent) - 1] = '\0';
+        slash = strrchr(parent, '/');
+        if (slash) *slash = '\0';
+        else parent[0] = '\0';
+
+        p = Library_FindOldDir(st, parent);
+        if (p != LIBRARY_NO_DIR) {
+            st->old_sibling[i] = st->old_child[p];
+            st->old_child[p] = i;
+        }
+    }
+}
+
+static BOOL
+Library_Emit(struct RescanState *st, const void *data, ULONG len)
+{
+    if (len && FWrite(st->out, (APTR)data, 1, len) != len) {
+        st->failed = TRUE;
+        return FALSE;
+    }
+    st->pos += len;
+    return TRUE;
+}
+
+/* Note that a record starts at the current position. */
+static BOOL
+Library_AddOffset(struct RescanState *st)
+{
+    if (st->offset_count >= st->offset_capacity) {
+        ULONG cap = st->offset_capacity ? st->offset_capacity * 2 : 4096;
+        ULONG *grown = AllocVec(cap * sizeof(ULONG), MEMF_PUBLIC);
+        if (!grown) {
+            st->failed = TRUE;
+            return FALSE;
+        }
+        if (st->offsets) {
+            CopyMem(st->offsets, grown, st->offset_count * sizeof(ULONG));
+            FreeVec(st->offsets);
+        }
+        st->offsets = grown;
+        st->offset_capacity = cap;
+    }
+    st->offsets[st->offset_count++] = st->pos;
+    return TRUE;
+}
+
+/* Fill in the start song's length from the song-length DB, if loaded. */
+static void
+Library_JoinSongLength(struct RescanState *st, LibCatRecordInfo *info)
+{
+    SongLengthEntry *e = SongDB_Find(st->obj->songlength_db, info->md5);
+    if (e && info->start_song > 0 && info->start_song <= e->num_subsongs) {
+        info->duration = e->lengths[info->start_song - 1];
+    }
+}
+
+static BOOL
+Library_WriteRecord(struct RescanState *st, CONST_STRPTR name,
+                    const SIDHeaderInfo *hdr, const LibCatRecordInfo *info)
+{
+    CONST_STRPTR fields[4];
+    UBYTE lens[4];
+    ULONG i;
+
+    fields[0] = name;
+    fields[1] = hdr->title;
+    fields[2] = hdr->author;
+    fields[3] = hdr->released;
+    for (i = 0; i < 4; i++) {
+        ULONG len = strlen(fields[i]);
+        lens[i] = (UBYTE)(len > 255 ? 255 : len);
+    }
+
+    if (!Library_AddOffset(st)) return FALSE;
+    if (!Library_Emit(st, lens, 4)) return FALSE;
+    if (!Library_Emit(st, info, LIBCAT_INFO_SIZE)) return FALSE;
+    for (i = 0; i < 4; i++) {
+        if (!Library_Emit(st, fields[i], lens[i])) return FALSE;
+    }
+    return TRUE;
+}
+
+/* Carry old record old_record over unchanged, apart from its song length,
+ * which follows whatever Songlengths.md5 is loaded now. */
+static BOOL
+Library_CopyRecord(struct RescanState *st, const UBYTE *p, ULONG old_record)
+{
+    ULONG len = Library_RecordSize(p);
+
+    if (st->delta) st->delta->old_to_new[old_record] = st->offset_count;
+    if (!Library_AddOffset(st)) return FALSE;
+    if (st->obj->songlength_db) {
+        LibCatRecordInfo info;
+
+        CopyMem((APTR)(p + 4), &info, LIBCAT_INFO_SIZE);
+        Library_JoinSongLength(st, &info);
+        return Library_Emit(st, p, 4)
+            && Library_Emit(st, &info, LIBCAT_INFO_SIZE)
+            && Library_Emit(st, p + 4 + LIBCAT_INFO_SIZE, len - 4 - LIBCAT_INFO_SIZE);
+    }
+    return Library_Emit(st, p, len);
+}
+
+/* Read an old directory block into memory; the caller frees it. Returns a
+ * pointer to the first record (past the path header) via *first. */
+static UBYTE *
+Library_LoadOldBlock(struct RescanState *st, ULONG old_index, const UBYTE **first)
+{
+    LibCatDir *od = &st->old->dirs[old_index];
+    UBYTE *block = AllocVec(od->block_size, MEMF_PUBLIC);
+
+    if (!block) {
+        st->failed = TRUE;
+        return NULL;
+    }
+    Seek(st->old->cat, od->block_offset, OFFSET_BEGINNING);
+    if (Read(st->old->cat, block, od->block_size) != (LONG)od->block_size) {
+        FreeVec(block);
+        st->failed = TRUE;
+        return NULL;
+    }
+    *first = block + 2 + ((block[0] << 8) | block[1]);
+    return block;
+}
+
+static BOOL
+Library_LoadOldFiles(struct RescanState *st, ULONG old_index, struct OldFiles *of)
+{
+    const UBYTE *p;
+    ULONG i;
+
+    memset(of, 0, sizeof(*of));
+    of->count = st->old->dirs[old_index].record_count;
+    of->block = Library_LoadOldBlock(st, old_index, &p);
+    if (!of->block) return FALSE;
+    if (of->count == 0) return TRUE;
+
+    of->rec = AllocVec(of->count * sizeof(UBYTE *), MEMF_PUBLIC);
+    of->next = AllocVec(of->count * sizeof(ULONG), MEMF_PUBLIC);
+    if (!of->rec || !of->next) return FALSE;
+
+    for (i = 0; i < LIBRARY_FILE_HASH; i++) of->head[i] = LIBRARY_NO_DIR;
+    for (i = 0; i < of->count; i++) {
+        ULONG h = Library_HashName(p + 4 + LIBCAT_INFO_SIZE, p[0]);
+        of->rec[i] = p;
+        of->next[i] = of->head[h];
+        of->head[h] = i;
+        p += Library_RecordSize(p);
+    }
+    return TRUE;
+}
+
+static void
+Library_FreeOldFiles(struct OldFiles *of)
+{
+    if (of->block) FreeVec(of->block);
+    if (of->rec) FreeVec((APTR)of->rec);
+    if (of->next) FreeVec(of->next);
+    memset(of, 0, sizeof(*of));
+}
+
+/* Old record for name if its size and date still match the file; *which
+ * is its position in the directory. */
+static const UBYTE *
+Library_FindOldFile(struct OldFiles *of, const struct FileInfoBlock *fib, ULONG *which)
+{
+    ULONG len = strlen(fib->fib_FileName);
+    ULONG i;
+
+    if (!of->rec) return NULL;
+    for (i = of->head[Library_HashName(fib->fib_FileName, len)];
+         i != LIBRARY_NO_DIR; i = of->next[i]) {
+        const UBYTE *p = of->rec[i];
+        if (p[0] == len && memcmp(p + 4 + LIBCAT_INFO_SIZE, fib->fib_FileName, len) == 0) {
+            LibCatRecordInfo info;
+            CopyMem((APTR)(p + 4), &info, LIBCAT_INFO_SIZE);
+            if (info.size == (ULONG)fib->fib_Size
+                && CompareDates(&info.date, &fib->fib_Date) == 0) {
+                *which = i;
+                return p;
+            }
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/* Note that the record just written was read from disk, not copied, so
+ * the index has to take it in. */
+static void
+Library_NoteAdded(struct RescanState *st)
+{
+    struct LibraryDelta *d = st->delta;
+
+    if (!d) return;
+    if (d->added_count >= d->added_capacity) {
+        ULONG cap = d->added_capacity ? d->added_capacity * 2 : 256;
+        ULONG *grown = AllocVec(cap * sizeof(ULONG), MEMF_PUBLIC);
+        if (!grown) {
+            /* The catalogue is still fine; the index is just rebuilt */
+            Library_FreeDelta(d);
+            st->delta = NULL;
+            return;
+        }
+        if (d->added) {
+            CopyMem(d->added, grown, d->added_count * sizeof(ULONG));
+            FreeVec(d->added);
+        }
+        d->added = grown;
+        d->added_capacity = cap;
+    }
+    d->added[d->added_count++] = st->offset_count - 1;
+}
+
+/* Hash one SID file, parse the header kept from its first block and
+ * append its record. */
+static BOOL
+Library_HashFile(struct RescanState *st, CONST_STRPTR dir_full,
+                 const struct FileInfoBlock *fib)
+{
+    char path[512];
+    SIDHeaderInfo hdr;
+    LibCatRecordInfo info;
+    UBYTE header[SID_HEADER_BUFFER];
+    UBYTE md5[MD5_HASH_SIZE];
+    ULONG size = 0;
+    BOOL ok = FALSE;
+
+    strcpy(path, dir_full);
+    if (!AddPart(path, (STRPTR)fib->fib_FileName, sizeof(path))) return FALSE;
+
+    if (!MD5File(path, 0, md5, header, sizeof(header), &size)) return FALSE;
+    st->files_hashed++;
+
+    if (ParseSIDHeader(header, size, &hdr)) {
+        memset(&info, 0, sizeof(info));
+        memcpy(info.md5, md5, MD5_HASH_SIZE);
+        info.size = fib->fib_Size;
+        info.date = fib->fib_Date;
+        info.subsongs = hdr.subsongs;
+        info.start_song = hdr.start_song;
+        info.flags = hdr.flags;
+        Library_JoinSongLength(st, &info);
+        ok = Library_WriteRecord(st, fib->fib_FileName, &hdr, &info);
+        if (ok) Library_NoteAdded(st);
+    }
+
+    return ok;
+}
+
+static BOOL
+Library_IsSIDName(CONST_STRPTR name)
+{
+    ULONG len = strlen(name);
+    return len > 4 && stricmp(name + len - 4, ".sid") == 0;
+}
+
+static BOOL
+Library_Progress(struct RescanState *st)
+{
+    char msg[128];
+    sprintf(msg, "Scanning HVSC... %lu files, %lu read, %lu folders unchanged",
+            (unsigned long)st->files_seen, (unsigned long)st->files_hashed,
+            (unsigned long)st->dirs_reused);
+    APP_UpdateStatus(msg);
+    return !APP_PumpEvents(st->obj);
+}
+
+static void
+Library_PushDir(struct RescanState *st, const LibCatDir *dir)
+{
+    if (st->failed) return;
+    if (st->dir_count >= st->dir_capacity) {
+        ULONG cap = st->dir_capacity ? st->dir_capacity * 2 : 256;
+        LibCatDir *grown = AllocVec(cap * sizeof(LibCatDir), MEMF_PUBLIC);
+        if (!grown) {
+            st->failed = TRUE;
+            return;
+        }
+        if (st->dirs) {
+            CopyMem(st->dirs, grown, st->dir_count * sizeof(LibCatDir));
+            FreeVec(st->dirs);
+        }
+        st->dirs = grown;
+        st->dir_capacity = cap;
+    }
+    st->dirs[st->dir_count++] = *dir;
+}
+
+/* Carry over the records of a directory whose entries are unchanged.
+ * Rewriting a file in place leaves the directory's date alone, so each
+ * file is still Examined by name and read again if its size or date
+ * moved; fib is scratch space. */
+static ULONG
+Library_CopyOldRecords(struct RescanState *st, ULONG old_index,
+                       CONST_STRPTR dir_full, struct FileInfoBlock *fib)
+{
+    const UBYTE *p;
+    UBYTE *block;
+    ULONG first = st->old->dirs[old_index].first_record;
+    ULONG i, n = st->old->dirs[old_index].record_count;
+    ULONG count = 0;
+
+    block = Library_LoadOldBlock(st, old_index, &p);
+    if (!block) return 0;
+
+    for (i = 0; i < n && !st->failed; i++) {
+        LibCatRecordInfo info;
+        char path[512];
+        char name[256];
+        BPTR lock = 0;
+        BOOL found = FALSE;
+
+        CopyMem((APTR)(p + 4 + LIBCAT_INFO_SIZE), name, p[0]);
+        name[p[0]] = '\0';
+        strcpy(path, dir_full);
+        if (AddPart(path, name, sizeof(path))) lock = Lock(path, ACCESS_READ);
+        if (lock) {
+            found = Examine(lock, fib) != DOSFALSE;
+            UnLock(lock);
+        }
+        st->files_seen++;
+
+        if (found) {
+            CopyMem((APTR)(p + 4), &info, LIBCAT_INFO_SIZE);
+            if (info.size == (ULONG)fib->fib_Size
+                && CompareDates(&info.date, &fib->fib_Date) == 0) {
+                if (Library_CopyRecord(st, p, first + i)) count++;
+            } else if (Library_HashFile(st, dir_full, fib)) {
+                count++;
+            }
+        }
+        p += Library_RecordSize(p);
+
+        if ((st->files_seen % 32) == 0 && !Library_Progress(st)) break;
+    }
+
+    FreeVec(block);
+    return count;
+}
+
+/* Catalogue one directory (rel is relative to the root, "" for the root
+ * itself), then recurse into its subdirectories.
+ *
+ * A directory's date changes when entries are added, removed or renamed.
+ * If it hasn't, its files and subdirectories are taken from the old
+ * catalogue, so it isn't even enumerated; each file is still Examined.
+ * Otherwise it is enumerated. Either way only files whose size or date
+ * differ are read again. */
+static void
+Library_ScanDir(struct RescanState *st, CONST_STRPTR rel)
+{
+    struct FileInfoBlock *fib;
+    struct StringPool *subdirs = NULL;
+    STRPTR *subdir_names = NULL;
+    ULONG subdir_count = 0, subdir_capacity = 0;
+    struct OldFiles old_files;
+    char full[512];
+    LibCatDir dir;
+    ULONG old_index;
+    UBYTE be[2];
+    ULONG rel_len;
+    BPTR lock;
+    ULONG i;
+
+    if (st->failed || st->obj->quit_requested) return;
+
+    strncpy(full, st->root, sizeof(full) - 1);
+    full[sizeof(full) - 1] = '\0';
+    if (rel[0] && !AddPart(full, (STRPTR)rel, sizeof(full))) return;
+
+    lock = Lock(full, ACCESS_READ);
+    if (!lock) return;
+    fib = AllocVec(sizeof(struct FileInfoBlock), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!fib || !Examine(lock, fib) || fib->fib_DirEntryType <= 0) {
+        if (fib) FreeVec(fib);
+        UnLock(lock);
+        return;
+    }
+
+    memset(&dir, 0, sizeof(dir));
+    dir.stamp = fib->fib_Date;
+    dir.block_offset = st->pos;
+    dir.first_record = st->offset_count;
+
+    rel_len = strlen(rel);
+    be[0] = (UBYTE)(rel_len >> 8);
+    be[1] = (UBYTE)rel_len;
+    Library_Emit(st, be, 2);
+    Library_Emit(st, rel, rel_len);
+
+    old_index = Library_FindOldDir(st, rel);
+
+    if (old_index != LIBRARY_NO_DIR && st->old_child
+        && CompareDates(&dir.stamp, &st->old->dirs[old_index].stamp) == 0) {
+        dir.record_count = Library_CopyOldRecords(st, old_index, full, fib);
+        FreeVec(fib);
+        UnLock(lock);
+
+        dir.block_size = st->pos - dir.block_offset;
+        Library_PushDir(st, &dir);
+        st->dirs_reused++;
+
+        if ((st->dirs_reused % 16) == 0 && !Library_Progress(st)) return;
+
+        for (i = st->old_child[old_index]; i != LIBRARY_NO_DIR && !st->failed;
+             i = st->old_sibling[i]) {
+            Library_ScanDir(st, st->old->dir_paths[i]);
+        }
+        return;
+    }
+
+    if (old_index != LIBRARY_NO_DIR) {
+        Library_LoadOldFiles(st, old_index, &old_files);
+    } else {
+        memset(&old_files, 0, sizeof(old_files));
+    }
+
+    while (!st->failed && ExNext(lock, fib)) {
+        const UBYTE *old_rec;
+        ULONG which;
+
+        if (fib->fib_DirEntryType > 0) {
+            if (subdir_count >= subdir_capacity) {
+                ULONG cap = subdir_capacity ? subdir_capacity * 2 : 16;
+                STRPTR *grown = AllocVec(cap * sizeof(STRPTR), MEMF_PUBLIC);
+                if (!grown) break;
+                if (subdir_names) {
+                    CopyMem(subdir_names, grown, subdir_count * sizeof(STRPTR));
+                    FreeVec(subdir_names);
+                }
+                subdir_names = grown;
+                subdir_capacity = cap;
+            }
+            if (!subdirs) subdirs = StrPool_Create();
+            subdir_names[subdir_count] = StrPool_Add(subdirs, fib->fib_FileName);
+            if (subdir_names[subdir_count]) subdir_count++;
+            continue;
+        }
+
+        if (!Library_IsSIDName(fib->fib_FileName)) continue;
+        st->files_seen++;
+
+        old_rec = Library_FindOldFile(&old_files, fib, &which);
+        if (old_rec) {
+            if (Library_CopyRecord(st, old_rec,
+                                   st->old->dirs[old_index].first_record + which)) {
+                dir.record_count++;
+            }
+        } else if (Library_HashFile(st, full, fib)) {
+            dir.record_count++;
+        }
+
+        if ((st->files_seen % 32) == 0 && !Library_Progress(st)) break;
+    }
+
+    Library_FreeOldFiles(&old_files);
+    FreeVec(fib);
+    UnLock(lock);
+
+    /* Close this directory's block before descending */
+    dir.block_size = st->pos - dir.block_offset;
+    Library_PushDir(st, &dir);
+
+    for (i = 0; i < subdir_count && !st->failed && !st->obj->quit_requested; i++) {
+        char child[512];
+        Library_JoinPath(child, sizeof(child), rel, subdir_names[i]);
+        Library_ScanDir(st, child);
+    }
+
+    if (subdir_names) FreeVec(subdir_names);
+    StrPool_Free(subdirs);
+}
+
+void
+Library_FreeDelta(struct LibraryDelta *delta)
+{
+    if (delta->old_to_new) FreeVec(delta->old_to_new);
+    if (delta->added) FreeVec(delta->added);
+    memset(delta, 0, sizeof(*delta));
+}
+
+BOOL
+Library_Rescan(struct ObjApp *obj, CONST_STRPTR root, CONST_STRPTR cat_path,
+               struct LibraryDelta *delta)
+{
+    struct RescanState *st;
+    struct LibCatHeader hdr;
+    char tmp_path[512];
+    BOOL ok = FALSE;
+
+    st = AllocVec(sizeof(struct RescanState), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!st) return FALSE;
+    st->obj = obj;
+    strncpy(st->root, root, sizeof(st->root) - 1);
+
+    /* The old catalogue is only reusable if it describes the same root. */
+    st->old = Library_Open(cat_path);
+    if (st->old && stricmp(st->old->hdr.root, st->root) != 0) {
+        Library_Close(st->old);
+        st->old = NULL;
+    }
+    if (st->old && st->old->hdr.dir_count > 0) {
+        Library_IndexOldDirs(st);
+    }
+
+    /* Track where the old records end up, for Trigram_UpdateIndex */
+    if (delta) {
+        memset(delta, 0, sizeof(*delta));
+        if (st->old && st->old->hdr.record_count > 0) {
+            ULONG i, n = st->old->hdr.record_count;
+
+            delta->old_to_new = AllocVec(n * sizeof(ULONG), MEMF_PUBLIC);
+            if (delta->old_to_new) {
+                for (i = 0; i < n; i++) delta->old_to_new[i] = LIBRARY_NO_RECORD;
+                delta->old_count = n;
+                st->delta = delta;
+            }
+        }
+    }
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.new", cat_path);
+    st->out = Open(tmp_path, MODE_NEWFILE);
+    if (!st->out) {
+        APP_UpdateStatus("Cannot write library catalogue");
+        goto done;
+    }
+
+    /* Header is rewritten once the tables' offsets are known */
+    memset(&hdr, 0, sizeof(hdr));
+    Library_Emit(st, &hdr, sizeof(hdr));
+
+    APP_UpdateStatus("Scanning HVSC...");
+    Library_ScanDir(st, "");
+
+    if (st->failed || obj->quit_requested) goto done;
+
+    memset(&hdr, 0, sizeof(hdr));
+    CopyMem((APTR)LIBRARY_CAT_MAGIC, hdr.magic, 8);
+    hdr.version = LIBRARY_CAT_VERSION;
+    hdr.dir_count = st->dir_count;
+    hdr.record_count = st->offset_count;
+    strcpy(hdr.root, st->root);
+
+    hdr.record_table_offset = st->pos;
+    Library_Emit(st, st->offsets, st->offset_count * sizeof(ULONG));
+    hdr.dir_table_offset = st->pos;
+    Library_Emit(st, st->dirs, st->dir_count * sizeof(LibCatDir));
+
+    if (st->failed || Flush(st->out) == DOSFALSE) goto done;
+    Seek(st->out, 0, OFFSET_BEGINNING);
+    if (Write(st->out, &hdr, sizeof(hdr)) != sizeof(hdr)) goto done;
+    ok = TRUE;
+
+done:
+    if (st->out) Close(st->out);
+    if (st->old) Library_Close(st->old);
+
+    if (ok) {
+        DeleteFile((STRPTR)cat_path);
+        ok = Rename(tmp_path, (STRPTR)cat_path) != DOSFALSE;
+    } else {
+        DeleteFile(tmp_path);
+    }
+
+    if (ok) {
+        char msg[160];
+        sprintf(msg, "Library: %lu SIDs in %lu folders (%lu files read, %lu folders unchanged)",
+                (unsigned long)st->offset_count, (unsigned long)st->dir_count,
+                (unsigned long)st->files_hashed, (unsigned long)st->dirs_reused);
+        APP_UpdateStatus(msg);
+    }
+
+    if (st->old_next) FreeVec(st->old_next);
+    if (st->old_child) FreeVec(st->old_child);
+    if (st->old_sibling) FreeVec(st->old_sibling);
+    if (st->offsets) FreeVec(st->offsets);
+    if (st->dirs) FreeVec(st->dirs);
+    FreeVec(st);
+    return ok;
+}
+
+/* ------------------------------------------------------------------ */
+/* Library window                                                      */
+/* ------------------------------------------------------------------ */
+
+static void
+Library_SetStatus(CONST_STRPTR text)
+{
+    set(objApp->TXT_LibraryStatus, MUIA_Text_Contents, text);
+}
+
+/* Open the catalogue and its index, bringing the index up to date if the
+ * catalogue is newer: from delta when a rescan left one, else by a full
+ * build. Leaves objApp->library NULL when there's no catalogue yet. */
+static BOOL
+Library_Load(const struct LibraryDelta *delta)
+{
+    char cat_path[512], idx_path[512];
+
+    if (objApp->library) return TRUE;
+
+    if (!build_progdir_path(cat_path, sizeof(cat_path), LIBRARY_CATALOGUE_FILENAME)
+        || !build_progdir_path(idx_path, sizeof(idx_path), LIBRARY_INDEX_FILENAME)) {
+        return FALSE;
+    }
+
+    objApp->library = Library_Open(cat_path);
+    if (!objApp->library) return FALSE;
+
+    if (!Trigram_IndexFresh(objApp->library, cat_path, idx_path)) {
+        Library_SetStatus("Updating search index...");
+        if (!delta || !delta->old_to_new
+            || !Trigram_UpdateIndex(objApp, objApp->library, delta, cat_path, idx_path)) {
+            Library_SetStatus("Building search index...");
+            if (!Trigram_BuildIndex(objApp, objApp->library, cat_path, idx_path)) {
+                Library_SetStatus("Failed to build search index");
+                return FALSE;
+            }
+        }
+    }
+    return Trigram_OpenIndex(objApp->library, idx_path);
+}
+
+/* Smart playlists (smartpl.c) query through the same handle. */
+BOOL
+LoadSIDLibrary(void)
+{
+    return Library_Load(NULL);
+}
+
+static void
+Library_Unload(void)
+{
+    if (objApp->library_results) {
+        DoMethod(objApp->LSV_LibraryResults, MUIM_List_Clear);
+        objApp->library_results->count = 0;
+    }
+    Library_Close(objApp->library);
+    objApp->library = NULL;
+}
+
+BOOL
+APP_LibraryOpen(void)
+{
+    char msg[128];
+
+    if (!objApp) return FALSE;
+
+    set(objApp->WIN_Library, MUIA_Window_Open, TRUE);
+
+    if (LoadSIDLibrary()) {
+        sprintf(msg, "%lu SIDs indexed", (unsigned long)objApp->library->hdr.record_count);
+        Library_SetStatus(msg);
+    } else if (!objApp->library) {
+        Library_SetStatus("No library yet - press Rescan to index your HVSC folder");
+    }
+
+    set(objApp->WIN_Library, MUIA_Window_ActiveObject, objApp->STR_LibrarySearch);
+    return TRUE;
+}
+
+BOOL
+APP_LibraryClose(void)
+{
+    if (!objApp) return FALSE;
+    set(objApp->WIN_Library, MUIA_Window_Open, FALSE);
+    return TRUE;
+}
+
+BOOL
+APP_LibrarySearch(void)
+{
+    STRPTR query = NULL;
+    char line[256];
+    char msg[128];
+    LONG found;
+    ULONG i;
+
+    if (!objApp || !objApp->library || !objApp->library->idx) return FALSE;
+
+    if (!objApp->library_results) {
+        objApp->library_results = AllocVec(sizeof(struct LibraryResults),
+                                           MEMF_PUBLIC | MEMF_CLEAR);
+        if (!objApp->library_results) return FALSE;
+    }
+
+    get(objApp->STR_LibrarySearch, MUIA_String_Contents, &query);
+
+    set(objApp->LSV_LibraryResults, MUIA_List_Quiet, TRUE);
+    DoMethod(objApp->LSV_LibraryResults, MUIM_List_Clear);
+
+    found = Trigram_Query(objApp->library, query ? query : (STRPTR)"", objApp->library_results);
+    for (i = 0; found > 0 && i < objApp->library_results->count; i++) {
+        LibraryResult *r = &objApp->library_results->items[i];
+
+        if (r->released && r->released[0]) {
+            snprintf(line, sizeof(line), "%s - %s (%s)", r->title, r->author, r->released);
+        } else {
+            snprintf(line, sizeof(line), "%s - %s", r->title, r->author);
+        }
+        if (r->info.duration > 0) {
+            ULONG len = strlen(line);
+            snprintf(line + len, sizeof(line) - len, " [%lu:%02lu]",
+                     (unsigned long)(r->info.duration / 60),
+                     (unsigned long)(r->info.duration % 60));
+        }
+        DoMethod(objApp->LSV_LibraryResults, MUIM_List_InsertSingle, line,
+                 MUIV_List_Insert_Bottom);
+    }
+
+    set(objApp->LSV_LibraryResults, MUIA_List_Quiet, FALSE);
+
+    if (found < 0) {
+        Library_SetStatus("Type at least 3 letters");
+    } else if (objApp->library_results->candidates > objApp->library_results->count) {
+        sprintf(msg, "%lu matches (best %lu shown)",
+                (unsigned long)objApp->library_results->candidates,
+                (unsigned long)objApp->library_results->count);
+        Library_SetStatus(msg);
+    } else {
+        sprintf(msg, "%lu matches", (unsigned long)objApp->library_results->count);
+        Library_SetStatus(msg);
+    }
+    return TRUE;
+}
+
+/* Add one hit to the playlist straight from its catalogue record, so the
+ * file itself isn't read until it is played. */
+static BOOL
+Library_AddResult(const LibraryResult *r)
+{
+    STRPTR title = FormatSIDTitle(r->title, r->author, (UBYTE)r->info.flags);
+    BOOL ok = AddPlaylistEntryWithInfo(objApp, r->path, title, r->info.md5,
+                                       r->info.subsongs);
+    if (title) FreeVec(title);
+    return ok;
+}
+
+/* Add library hits to the playlist — the selected ones, or all of them. */
+BOOL
+APP_LibraryAdd(BOOL all)
+{
+    struct LibraryResults *results = objApp ? objApp->library_results : NULL;
+    ULONG added = 0;
+    char msg[128];
+    LONG pos;
+
+    if (!results || results->count == 0) return FALSE;
+
+    if (all) {
+        for (pos = 0; pos < (LONG)results->count; pos++) {
+            if (Library_AddResult(&results->items[pos])) added++;
+        }
+    } else {
+        pos = MUIV_List_NextSelected_Start;
+        for (;;) {
+            DoMethod(objApp->LSV_LibraryResults, MUIM_List_NextSelected, &pos);
+            if (pos == MUIV_List_NextSelected_End) break;
+            if ((ULONG)pos < results->count
+                && Library_AddResult(&results->items[pos])) {
+                added++;
+            }
+        }
+    }
+
+    if (added == 0) {
+        Library_SetStatus("Nothing added - are the files still there?");
+        return FALSE;
+    }
+
+    APP_UpdatePlaylistDisplay();
+    if (!objApp->current_entry && objApp->playlist_count > 0) {
+        objApp->current_entry = &objApp->playlist[0];
+        objApp->current_index = 0;
+        APP_UpdateCurrentSongCache();
+        APP_UpdateCurrentSongDisplay();
+    }
+
+    sprintf(msg, "Added %lu files to playlist", (unsigned long)added);
+    Library_SetStatus(msg);
+    APP_UpdateStatus(msg);
+    return TRUE;
+}
+
+BOOL
+APP_LibraryRescan(void)
+{
+    struct LibraryDelta delta;
+    struct SIDLibrary *old;
+    char cat_path[512], idx_path[512];
+    BOOL reuse, ok;
+
+    if (!objApp) return FALSE;
+
+    /* First scan: ask where HVSC lives */
+    if (!objApp->hvsc_root[0]) {
+        struct FileRequester *req;
+
+        if (!AslBase) return FALSE;
+        req = AllocAslRequestTags(ASL_FileRequest,
+            ASLFR_TitleText, "Select your HVSC folder",
+            ASLFR_DrawersOnly, TRUE,
+            TAG_DONE);
+        if (!req) return FALSE;
+        if (AslRequest(req, NULL) && req->rf_Dir && req->rf_Dir[0]) {
+            strncpy(objApp->hvsc_root, req->rf_Dir, sizeof(objApp->hvsc_root) - 1);
+            objApp->hvsc_root[sizeof(objApp->hvsc_root) - 1] = '\0';
+        }
+        FreeAslRequest(req);
+        if (!objApp->hvsc_root[0]) return FALSE;
+    }
+
+    if (!build_progdir_path(cat_path, sizeof(cat_path), LIBRARY_CATALOGUE_FILENAME)
+        || !build_progdir_path(idx_path, sizeof(idx_path), LIBRARY_INDEX_FILENAME)) {
+        return FALSE;
+    }
+
+    /* Only an index that matches the old catalogue can be updated */
+    old = objApp->library ? objApp->library : Library_Open(cat_path);
+    reuse = old && Trigram_IndexFresh(old, cat_path, idx_path);
+    if (old != objApp->library) Library_Close(old);
+
+    /* The catalogue is replaced underneath us, so let go of it first */
+    Library_Unload();
+
+    Library_SetStatus("Scanning HVSC...");
+    set(objApp->App, MUIA_Application_Sleep, TRUE);
+    memset(&delta, 0, sizeof(delta));
+    ok = Library_Rescan(objApp, objApp->hvsc_root, cat_path, reuse ? &delta : NULL);
+    if (ok) ok = Library_Load(&delta);
+    Library_FreeDelta(&delta);
+    set(objApp->App, MUIA_Application_Sleep, FALSE);
+
+    if (ok) {
+        char msg[128];
+        sprintf(msg, "%lu SIDs indexed", (unsigned long)objApp->library->hdr.record_count);
+        Library_SetStatus(msg);
+        APP_LibrarySearch();
+
+        /* Record numbers changed under the smart playlist: run it again */
+        if (objApp->smart_playlist) SmartPL_Resume(objApp);
+    } else if (!objApp->quit_requested) {
+        Library_SetStatus("Rescan failed");
+    }
+    return ok;
+}
+
+/* Release everything the library window holds (called from DisposeApp). */
+void
+FreeSIDLibrary(struct ObjApp *obj)
+{
+    Library_Close(obj->library);
+    obj->library = NULL;
+    if (obj->library_results) {
+        Trigram_FreeResults(obj->library_results);
+        FreeVec(obj->library_results);
+        obj->library_results = NULL;
+    }
+}
@@ -0,0 +1,152 @@
+/* HVSC library catalogue and trigram search index.
+ *
+ * library.cat — every SID under the HVSC root, written by Library_Rescan:
+ *
+ *     LibCatHeader
+ *     one block per directory:  UWORD path_len, path bytes,
+ *                               then that directory's records
+ *     record offset table       ULONG file offset per record
+ *     directory table           LibCatDir per directory
+ *
+ *   A record is four length bytes (name, title, author, released), a
+ *   LibCatRecordInfo, then the unterminated strings. Directory paths are
+ *   relative to the root. Rescans copy the block of any directory whose
+ *   DateStamp is unchanged without enumerating it; in the others only
+ *   files whose size or date changed are read and hashed again.
+ *
+ * library.idx — trigram postings over the catalogue (trigram.c). After a
+ *   rescan the old lists are carried over, renumbered, with only the
+ *   records that were read again added in; it is built from scratch only
+ *   when there is no usable old index. Queries read only the posting
+ *   lists and records they need, so nothing HVSC-sized is held in memory.
+ */
+
+#ifndef U64_LIBRARY_H
+#define U64_LIBRARY_H
+
+#include <dos/dos.h>
+#include <exec/types.h>
+
+#include "player.h"
+
+#define LIBRARY_CATALOGUE_FILENAME "library.cat"
+#define LIBRARY_INDEX_FILENAME     "library.idx"
+
+#define LIBRARY_CAT_MAGIC    "U64CAT01"
+#define LIBRARY_CAT_VERSION  2
+
+#define LIBRARY_MAX_RESULTS  200    /* ranked hits kept per query */
+#define LIBRARY_NO_RECORD    ((ULONG)~0)
+
+struct LibCatHeader {
+    char   magic[8];
+    ULONG  version;
+    ULONG  dir_count;
+    ULONG  record_count;
+    ULONG  record_table_offset;
+    ULONG  dir_table_offset;
+    char   root[256];               /* HVSC root the paths are relative to */
+};
+
+typedef struct LibCatDir {
+    ULONG  block_offset;
+    ULONG  block_size;
+    struct DateStamp stamp;         /* directory date when it was read */
+    ULONG  first_record;
+    ULONG  record_count;
+} LibCatDir;
+
+/* Fixed part of a record. Stored unaligned — always CopyMem it out. */
+typedef struct LibCatRecordInfo {
+    UBYTE  md5[MD5_HASH_SIZE];
+    ULONG  size;                    /* file size when hashed */
+    struct DateStamp date;          /* file date when hashed */
+    ULONG  duration;                /* start song, seconds; 0 = not in DB */
+    UWORD  subsongs;
+    UWORD  start_song;              /* 1-based */
+    UWORD  flags;                   /* header flags word, SID_FLAG_* */
+    UWORD  reserved;
+} LibCatRecordInfo;
+
+#define LIBCAT_INFO_SIZE  sizeof(LibCatRecordInfo)
+
+/* One catalogue record, unpacked. path is relative to the HVSC root. */
+typedef struct LibraryRecord {
+    char path[512];
+    char title[33];
+    char author[33];
+    char released[33];
+    LibCatRecordInfo info;
+} LibraryRecord;
+
+/* An open catalogue (and its index, once built). The directory table and
+ * directory paths stay in memory; records are read on demand. */
+struct SIDLibrary {
+    BPTR   cat;
+    BPTR   idx;                     /* 0 until the index is opened */
+    struct LibCatHeader hdr;
+    LibCatDir *dirs;
+    STRPTR *dir_paths;
+    struct StringPool *strings;     /* backs dir_paths */
+};
+
+typedef struct LibraryResult {
+    ULONG  record;
+    ULONG  score;
+    LibCatRecordInfo info;
+    STRPTR path;                    /* full path, root included */
+    STRPTR title;
+    STRPTR author;
+    STRPTR released;
+} LibraryResult;
+
+struct LibraryResults {
+    LibraryResult items[LIBRARY_MAX_RESULTS];
+    ULONG  count;
+    ULONG  candidates;              /* records that passed the trigram filter */
+    struct StringPool *strings;     /* backs the item strings */
+};
+
+/* What a rescan did to the record numbers, so the index can follow it:
+ * where each old record went (LIBRARY_NO_RECORD if it is gone or was
+ * read again) and, in ascending order, the new records that were read. */
+struct LibraryDelta {
+    ULONG *old_to_new;
+    ULONG  old_count;
+    ULONG *added;
+    ULONG  added_count;
+    ULONG  added_capacity;
+};
+
+/* Called for each record by Library_ForEach; return FALSE to stop. */
+typedef BOOL (*LibraryRecordFunc)(ULONG index, const LibraryRecord *rec, APTR user);
+
+/* library.c */
+struct SIDLibrary *Library_Open(CONST_STRPTR cat_path);
+void Library_Close(struct SIDLibrary *lib);
+BOOL Library_ReadRecord(struct SIDLibrary *lib, ULONG index, LibraryRecord *rec);
+BOOL Library_ForEach(struct SIDLibrary *lib, LibraryRecordFunc func, APTR user);
+/* delta may be NULL; if given it is filled in when the old catalogue could
+ * be reused, and must be released with Library_FreeDelta either way. */
+BOOL Library_Rescan(struct ObjApp *obj, CONST_STRPTR root, CONST_STRPTR cat_path,
+                    struct LibraryDelta *delta);
+void Library_FreeDelta(struct LibraryDelta *delta);
+
+/* trigram.c */
+BOOL Trigram_IndexFresh(struct SIDLibrary *lib, CONST_STRPTR cat_path, CONST_STRPTR idx_path);
+BOOL Trigram_BuildIndex(struct ObjApp *obj, struct SIDLibrary *lib,
+                        CONST_STRPTR cat_path, CONST_STRPTR idx_path);
+/* Bring the index of the previous catalogue up to date with delta. FALSE
+ * if it can't (no matching old index, or too much changed): rebuild. */
+BOOL Trigram_UpdateIndex(struct ObjApp *obj, struct SIDLibrary *lib,
+                         const struct LibraryDelta *delta,
+                         CONST_STRPTR cat_path, CONST_STRPTR idx_path);
+BOOL Trigram_OpenIndex(struct SIDLibrary *lib, CONST_STRPTR idx_path);
+/* Sorted record numbers that may contain every word of text (a superset:
+ * verify each). Caller FreeVecs *records. -1 = text too short to narrow. */
+LONG Trigram_Candidates(struct SIDLibrary *lib, CONST_STRPTR text, ULONG **records);
+LONG Trigram_Query(struct SIDLibrary *lib, CONST_STRPTR query,
+                   struct LibraryResults *results);
+void Trigram_FreeResults(struct LibraryResults *results);
+
+#endif
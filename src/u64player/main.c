@@ -20,14 +20,23 @@
 
 #include "player.h"
 #include "md5set.h"
+#include "playstats.h"
+#include "sidcache.h"
+#include "smartpl.h"
+#include "stil.h"
 
 /* File names for persistent user state — all live in the program directory. */
-#define HEARD_FILENAME      "heard.txt"
-#define FAVOURITES_FILENAME "favourites.txt"
+#define HEARD_FILENAME      "heard.md5j"
+#define FAVOURITES_FILENAME "favourites.md5j"
+/* Pre-journal hex text versions, imported once if the journals are missing */
+#define HEARD_LEGACY_FILENAME      "heard.txt"
+#define FAVOURITES_LEGACY_FILENAME "favourites.txt"
+#define STATS_FILENAME      "playstats.db"
 #define SESSION_FILENAME    "session.u64pl"
+#define SHUFFLE_FILENAME    "shuffle.state"
 
 /* Build a path "PROGDIR/<name>" into out. Returns TRUE on success. */
-static BOOL
+BOOL
 build_progdir_path(char *out, ULONG out_size, CONST_STRPTR name)
 {
     BPTR lock = GetProgramDir();
@@ -39,6 +48,22 @@ build_progdir_path(char *out, ULONG out_size, CONST_STRPTR name)
     return TRUE;
 }
 
+/* Pump pending MUI events without blocking, for long loops on the main
+ * task (song-length DB, STIL, library scans). If the user triggered
+ * MUIV_Application_ReturnID_Quit we set obj->quit_requested and return
+ * TRUE so the caller can bail out; main() honours the flag on return. */
+BOOL
+APP_PumpEvents(struct ObjApp *obj)
+{
+    ULONG signals;
+    ULONG id = DoMethod(obj->App, MUIM_Application_Input, &signals);
+    if (id == MUIV_Application_ReturnID_Quit) {
+        obj->quit_requested = TRUE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 /* Guaranteed stack size (bytes). MUI + SID-playback + song-length-DB load
  * can burn through ~10-12KB; we request 48 KB headroom. StackSwap onto a
  * private buffer if the caller's stack is smaller. */
@@ -47,7 +72,12 @@ build_progdir_path(char *out, ULONG out_size, CONST_STRPTR name)
 static struct StackSwapStruct g_sss;
 static UBYTE *g_new_stack = NULL;
 
+/* "U64Player BENCHMARK [file]" runs bench.c instead of the GUI */
+static BOOL g_benchmark = FALSE;
+static CONST_STRPTR g_bench_results = NULL;
+
 static int AppMain(void);
+static int RunMain(void);
 
 /* Version string */
 static const char version[] = "$VER: u64player 0.4.0 (2025)";
@@ -94,8 +124,9 @@ struct ObjApp *CreateApp(void)
         CreateMenu(obj);
         CreateWindowMain(obj);
         CreateWindowConfig(obj);
+        CreateWindowLibrary(obj);
 
-        if (obj->WIN_Main && obj->WIN_Config) {
+        if (obj->WIN_Main && obj->WIN_Config && obj->WIN_Library) {
             /* Create Application object */
             obj->App = MUI_NewObject(MUIC_Application,
                 MUIA_Application_Title, "Ultimate64 SID Player",
@@ -107,6 +138,7 @@ struct ObjApp *CreateApp(void)
                 MUIA_Application_Menustrip, obj->MN_Main,
                 SubWindow, obj->WIN_Main,
                 SubWindow, obj->WIN_Config,
+                SubWindow, obj->WIN_Library,
                 TAG_DONE);
 
             if (obj->App) {
@@ -116,6 +148,7 @@ struct ObjApp *CreateApp(void)
                 CreateMenuEvents(obj);
                 CreateWindowMainEvents(obj);
                 CreateWindowConfigEvents(obj);
+                CreateWindowLibraryEvents(obj);
                 /* Initialize search data */
                 obj->search_text[0] = '\0';
                 obj->search_mode_filter = FALSE; /* Default to search mode */
@@ -142,14 +175,11 @@ void DisposeApp(struct ObjApp *obj)
         /* Persist user state before freeing playlist data. */
         {
             char path[512];
-            if (obj->heard_db
-                && build_progdir_path(path, sizeof(path), HEARD_FILENAME)) {
-                MD5Set_Save(obj->heard_db, path);
-            }
-            if (obj->favourites
-                && build_progdir_path(path, sizeof(path), FAVOURITES_FILENAME)) {
-                MD5Set_Save(obj->favourites, path);
-            }
+            /* Changes are journalled as they happen; this only compacts */
+            MD5Set_Flush(obj->heard_db);
+            MD5Set_Flush(obj->favourites);
+            APP_StatsEndPlay(obj, PLAYSTATS_END_OTHER);
+            PlayStats_Flush(obj->play_stats);
             /* Session restore: snapshot the current playlist. If it's empty,
              * delete any stale saved session so we don't restore a ghost. */
             if (build_progdir_path(path, sizeof(path), SESSION_FILENAME)) {
@@ -159,11 +189,22 @@ void DisposeApp(struct ObjApp *obj)
                     DeleteFile(path);
                 }
             }
+            /* Shuffle position goes with the session; deleted when shuffle
+             * is off so a stale cycle isn't resumed. */
+            if (build_progdir_path(path, sizeof(path), SHUFFLE_FILENAME)) {
+                Shuffle_Save(obj, path);
+            }
         }
 
         MD5Set_Free(obj->heard_db);     obj->heard_db = NULL;
         MD5Set_Free(obj->favourites);   obj->favourites = NULL;
+        PlayStats_Free(obj->play_stats); obj->play_stats = NULL;
+        SIDCache_Free(obj->sid_cache);  obj->sid_cache = NULL;
+        SmartPL_Free(obj);              /* query stays in ENV: to resume */
+        FreeSIDLibrary(obj);
+        FreeSTIL(obj);
 
+        Resolver_Stop();
         FreePlaylists(obj);
         FreeSongLengthDB(obj);
 
@@ -181,16 +222,24 @@ void DisposeApp(struct ObjApp *obj)
 }
 
 /* Main function — swaps to a private stack if caller's stack is too small,
- * then runs AppMain() and swaps back. */
-int main(void)
+ * then runs AppMain() and swaps back. "U64Player BENCHMARK [file]" from a
+ * shell runs the benchmark suite (bench.c) there instead of the GUI. */
+int main(int argc, char **argv)
 {
     struct Process *proc = (struct Process *)FindTask(NULL);
     ULONG current_stack =
         (ULONG)proc->pr_Task.tc_SPUpper - (ULONG)proc->pr_Task.tc_SPLower;
     int retval;
 
+    if ((argc == 2 || argc == 3) && stricmp(argv[1], "BENCHMARK") == 0) {
+        g_benchmark = TRUE;
+        g_bench_results = argc == 3 ? (CONST_STRPTR)argv[2] : NULL;
+    }
+
+    MD5_SelectKernels();
+
     if (current_stack >= REQUIRED_STACK)
-        return AppMain();
+        return RunMain();
 
     g_new_stack = AllocMem(REQUIRED_STACK, MEMF_PUBLIC);
     if (!g_new_stack) {
@@ -203,7 +252,7 @@ int main(void)
     g_sss.stk_Pointer = (APTR)(g_new_stack + REQUIRED_STACK);
 
     StackSwap(&g_sss);
-    retval = AppMain();
+    retval = RunMain();
     StackSwap(&g_sss);
 
     FreeMem(g_new_stack, REQUIRED_STACK);
@@ -211,6 +260,12 @@ int main(void)
     return retval;
 }
 
+/* The suite parses and loads on the same stack the GUI would */
+static int RunMain(void)
+{
+    return g_benchmark ? Bench_Run(g_bench_results) : AppMain();
+}
+
 static int AppMain(void)
 {
     int result = RETURN_FAIL;
@@ -234,16 +289,24 @@ static int AppMain(void)
 
         LoadConfig(objApp);
 
-        /* Load persistent user sets (heard + favourites). Absence of the
-         * files just yields empty sets, which is fine. */
+        /* SID file cache — a failed allocation just means uncached reads. */
+        objApp->sid_cache = SIDCache_Create(objApp->sid_cache_kb * 1024);
+
+        /* Load persistent user sets (heard + favourites) and the play
+         * statistics. Absence of the files just yields empty sets. */
         objApp->heard_db = MD5Set_Create();
         objApp->favourites = MD5Set_Create();
+        objApp->play_stats = PlayStats_Create();
         {
-            char path[512];
-            if (build_progdir_path(path, sizeof(path), HEARD_FILENAME))
-                MD5Set_Load(objApp->heard_db, path);
-            if (build_progdir_path(path, sizeof(path), FAVOURITES_FILENAME))
-                MD5Set_Load(objApp->favourites, path);
+            char path[512], legacy[512];
+            if (build_progdir_path(path, sizeof(path), HEARD_FILENAME)
+                && build_progdir_path(legacy, sizeof(legacy), HEARD_LEGACY_FILENAME))
+                MD5Set_Load(objApp->heard_db, path, legacy);
+            if (build_progdir_path(path, sizeof(path), FAVOURITES_FILENAME)
+                && build_progdir_path(legacy, sizeof(legacy), FAVOURITES_LEGACY_FILENAME))
+                MD5Set_Load(objApp->favourites, path, legacy);
+            if (build_progdir_path(path, sizeof(path), STATS_FILENAME))
+                PlayStats_Load(objApp->play_stats, path);
 
             /* Session restore: if a prior session was saved, reload it now
              * (before AutoLoadSongLengths so its playlist-refresh loop can
@@ -254,6 +317,16 @@ static int AppMain(void)
                     Close(test);
                     U64_DEBUG("restoring session playlist from %s", path);
                     LoadPlaylistFromFile(objApp, path);
+
+                    /* Pick the shuffle cycle up where it left off. */
+                    if (build_progdir_path(path, sizeof(path), SHUFFLE_FILENAME)
+                        && Shuffle_Load(objApp, path)) {
+                        objApp->shuffle_mode = TRUE;
+                        set(objApp->CHK_Shuffle, MUIA_Selected, TRUE);
+                        APP_UpdateCurrentSongCache();
+                        APP_UpdatePlaylistDisplay();
+                        APP_UpdateCurrentSongDisplay();
+                    }
                 }
             }
         }
@@ -274,6 +347,7 @@ static int AppMain(void)
         }
 
         AutoLoadSongLengths(objApp);
+        AutoLoadSTIL(objApp);
 
         /* After the DB is ready, report "X of Y SIDs heard" as a one-shot
          * status so the user sees their HVSC completion progress. */
@@ -296,6 +370,13 @@ static int AppMain(void)
             APP_UpdateStatus(msg);
         }
 
+        /* A smart playlist left running keeps queueing after the restored
+         * session, so an unattended station carries on where it was. */
+        if (!objApp->quit_requested && objApp->smart_query[0]) {
+            set(objApp->STR_SmartQuery, MUIA_String_Contents, objApp->smart_query);
+            SmartPL_Resume(objApp);
+        }
+
         /* If the user clicked Quit while the songlengths parser was running,
          * the parser flags it on objApp and bails; honour it here so the
          * event loop doesn't wait forever for a signal that already fired. */
@@ -326,6 +407,10 @@ static int AppMain(void)
                         get(objApp->CHK_Repeat, MUIA_Selected, &objApp->repeat_mode);
                         APP_UpdateStatus(objApp->repeat_mode ? "Repeat enabled" : "Repeat disabled");
                         break;
+                    case EVENT_SKIP_SILENCE:
+                        get(objApp->CHK_SkipSilence, MUIA_Selected, &objApp->skip_silence);
+                        APP_UpdateStatus(objApp->skip_silence ? "Skip silence enabled" : "Skip silence disabled");
+                        break;
                     case EVENT_DOWNLOAD_SONGLENGTHS: APP_DownloadSongLengths(); break;
                     case EVENT_ABOUT: APP_About(); break;
                     case EVENT_CONFIG_OPEN: APP_ConfigOpen(); break;
@@ -336,12 +421,26 @@ static int AppMain(void)
                     case EVENT_PLAYLIST_LOAD: APP_PlaylistLoad(); break;
                     case EVENT_PLAYLIST_SAVE: APP_PlaylistSave(); break;
                     case EVENT_PLAYLIST_SAVE_AS: APP_PlaylistSaveAs(); break;
+                    case EVENT_PLAYLIST_SORT_PLAYED:
+                    case EVENT_PLAYLIST_SORT_RECENT:
+                    case EVENT_PLAYLIST_SORT_UNFINISHED:
+                    case EVENT_PLAYLIST_SORT_ORIGINAL: APP_PlaylistSort(id); break;
                     case EVENT_SEARCH_TEXT: APP_SearchTextChanged(); break;
                     case EVENT_SEARCH_MODE_CHANGED: APP_SearchModeChanged(); break;
                     case EVENT_SEARCH_CLEAR: APP_SearchClear(); break;
                     case EVENT_SEARCH_NEXT: APP_SearchNext(); break;
                     case EVENT_SEARCH_PREV: APP_SearchPrev(); break;
                     case EVENT_TOGGLE_FAVOURITE: APP_ToggleFavourite(); break;
+                    case EVENT_LIBRARY_OPEN: APP_LibraryOpen(); break;
+                    case EVENT_SONGDB_UPDATE_FILE: APP_SongDBUpdateFile(); break;
+                    case EVENT_SONGDB_UPDATE_FETCH: APP_SongDBUpdateFetch(); break;
+                    case EVENT_LIBRARY_SEARCH: APP_LibrarySearch(); break;
+                    case EVENT_LIBRARY_ADD: APP_LibraryAdd(FALSE); break;
+                    case EVENT_LIBRARY_ADD_ALL: APP_LibraryAdd(TRUE); break;
+                    case EVENT_LIBRARY_RESCAN: APP_LibraryRescan(); break;
+                    case EVENT_LIBRARY_CLOSE: APP_LibraryClose(); break;
+                    case EVENT_SMART_START: APP_SmartStart(); break;
+                    case EVENT_SMART_STOP: APP_SmartStop(); break;
                     case MUIV_Application_ReturnID_Quit: running = FALSE; break;
                 }
             }
@@ -352,7 +451,8 @@ static int AppMain(void)
             }
 
             // Build wait signal mask - include timer if running
-            ULONG waitSignals = signals | SIGBREAKF_CTRL_C | TimerWaitMask();
+            ULONG waitSignals = signals | SIGBREAKF_CTRL_C | TimerWaitMask()
+                                | Resolver_WaitMask();
 
             // Only wait if we have signals to wait for
             if (waitSignals & ~SIGBREAKF_CTRL_C) {  // If more than just CTRL_C
@@ -363,6 +463,7 @@ static int AppMain(void)
                     break;
                 }
                 CheckTimerSignal(receivedSignals);
+                Resolver_CheckSignal(objApp, receivedSignals);
             }
         }
 
@@ -370,6 +471,9 @@ static int AppMain(void)
         if (objApp->WIN_Config) {
             set(objApp->WIN_Config, MUIA_Window_Open, FALSE);
         }
+        if (objApp->WIN_Library) {
+            set(objApp->WIN_Library, MUIA_Window_Open, FALSE);
+        }
 
         SaveConfig(objApp);
         DisposeApp(objApp);
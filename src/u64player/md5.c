@@ -1,12 +1,39 @@
 /* Ultimate64 SID Player - MD5 hash implementation
  * For Amiga OS 3.x by Marcin Spoczynski
+ *
+ * MD5File hashes a file MD5_FILE_BLOCK bytes at a time, so a tune of any
+ * size costs one block of memory; the caller gets the SID header from the
+ * first block on the way and never needs the file loaded.
+ *
+ * With MD5_OLD_STYLE it computes the fingerprint that keyed the HVSC
+ * song-length lists before Songlengths.md5 (Songlengths.txt, as made by
+ * libsidplay 2): only the C64 data after the header and any inline load
+ * address, followed by
+ *
+ *     init, play, songs         little-endian words, songs at most 256
+ *     one byte per song         60 if it runs off CIA timers, else 0
+ *     0x02                      only if the header says NTSC
+ *
+ * The block transform comes in two builds of the same rounds, picked at
+ * start-up by MD5_SelectKernels so one binary suits every CPU: the 68000
+ * has no barrel shifter (a rotate costs two clocks per bit) and faults on
+ * odd word addresses, so its version keeps rotates to 8 bits or less by
+ * going through swap and loads the block a word at a time when it is
+ * even; 68020+ rotate any distance in one go and read the block as
+ * longwords wherever it lies. "U64Player BENCHMARK" from a shell times
+ * both, and the hex helpers, in MB/s.
  */
 
+#include <dos/dos.h>
+#include <exec/execbase.h>
+#include <exec/memory.h>
 #include <exec/types.h>
 
+#include <proto/dos.h>
 #include <proto/exec.h>
 
-#include <ctype.h>
+#include <stdio.h>
+
 #include <string.h>
 
 #include "player.h"
@@ -34,8 +61,41 @@
 #define H(x, y, z) ((x) ^ (y) ^ (z))
 #define I(x, y, z) ((y) ^ ((x) | (~z)))
 
-#define ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#if defined(__GNUC__) && defined(__m68k__)
+/* Kept as an instruction: the compiler would fold swap-then-rotate back
+ * into the single long rotate the 68000 version exists to avoid */
+static inline ULONG
+MD5_Swap(ULONG x)
+{
+    __asm__ ("swap %0" : "+d" (x));
+    return x;
+}
+#else
+#define MD5_Swap(x) ROL(x, 16)
+#endif
+
+/* n is a constant, so all but one branch goes away */
+static inline ULONG
+Rotate68000(ULONG x, int n)
+{
+    if (n <= 8) return ROL(x, n);
+    if (n < 16) return ROR(MD5_Swap(x), 16 - n);
+    if (n == 16) return MD5_Swap(x);
+    if (n <= 24) return ROL(MD5_Swap(x), n - 16);
+    return ROR(x, 32 - n);
+}
+
+static inline ULONG
+Rotate68020(ULONG x, int n)
+{
+    return ROL(x, n);
+}
 
+/* ROTATE_LEFT is defined before each transform below; MD5_ROUNDS picks up
+ * whichever is current where it is expanded */
 #define FF(a, b, c, d, x, s, ac) { \
   (a) += F ((b), (c), (d)) + (x) + (ULONG)(ac); \
   (a) = ROTATE_LEFT ((a), (s)); \
@@ -63,7 +123,17 @@ static UBYTE PADDING[64] = {
   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-static void MD5Transform(ULONG state[4], const UBYTE block[64]);
+static void MD5Transform68000(ULONG state[4], const UBYTE block[64]);
+static void MD5Transform68020(ULONG state[4], const UBYTE block[64]);
+
+static void (*MD5Transform)(ULONG state[4], const UBYTE block[64]) = MD5Transform68000;
+
+/* Use the 68020 transform if the CPU has one; called once at start-up. */
+void MD5_SelectKernels(void)
+{
+    MD5Transform = (SysBase->AttnFlags & AFF_68020) ? MD5Transform68020
+                                                    : MD5Transform68000;
+}
 
 void MD5Init(MD5_CTX *ctx)
 {
@@ -132,88 +202,136 @@ void MD5Final(UBYTE digest[MD5_HASH_SIZE], MD5_CTX *ctx)
     memset((APTR)ctx, 0, sizeof(*ctx));
 }
 
-static void MD5Transform(ULONG state[4], const UBYTE block[64])
+/* The 64 steps, shared by both transforms */
+#define MD5_ROUNDS \
+    /* Round 1 */ \
+    FF(a, b, c, d, x[0], S11, 0xd76aa478); \
+    FF(d, a, b, c, x[1], S12, 0xe8c7b756); \
+    FF(c, d, a, b, x[2], S13, 0x242070db); \
+    FF(b, c, d, a, x[3], S14, 0xc1bdceee); \
+    FF(a, b, c, d, x[4], S11, 0xf57c0faf); \
+    FF(d, a, b, c, x[5], S12, 0x4787c62a); \
+    FF(c, d, a, b, x[6], S13, 0xa8304613); \
+    FF(b, c, d, a, x[7], S14, 0xfd469501); \
+    FF(a, b, c, d, x[8], S11, 0x698098d8); \
+    FF(d, a, b, c, x[9], S12, 0x8b44f7af); \
+    FF(c, d, a, b, x[10], S13, 0xffff5bb1); \
+    FF(b, c, d, a, x[11], S14, 0x895cd7be); \
+    FF(a, b, c, d, x[12], S11, 0x6b901122); \
+    FF(d, a, b, c, x[13], S12, 0xfd987193); \
+    FF(c, d, a, b, x[14], S13, 0xa679438e); \
+    FF(b, c, d, a, x[15], S14, 0x49b40821); \
+    /* Round 2 */ \
+    GG(a, b, c, d, x[1], S21, 0xf61e2562); \
+    GG(d, a, b, c, x[6], S22, 0xc040b340); \
+    GG(c, d, a, b, x[11], S23, 0x265e5a51); \
+    GG(b, c, d, a, x[0], S24, 0xe9b6c7aa); \
+    GG(a, b, c, d, x[5], S21, 0xd62f105d); \
+    GG(d, a, b, c, x[10], S22, 0x2441453); \
+    GG(c, d, a, b, x[15], S23, 0xd8a1e681); \
+    GG(b, c, d, a, x[4], S24, 0xe7d3fbc8); \
+    GG(a, b, c, d, x[9], S21, 0x21e1cde6); \
+    GG(d, a, b, c, x[14], S22, 0xc33707d6); \
+    GG(c, d, a, b, x[3], S23, 0xf4d50d87); \
+    GG(b, c, d, a, x[8], S24, 0x455a14ed); \
+    GG(a, b, c, d, x[13], S21, 0xa9e3e905); \
+    GG(d, a, b, c, x[2], S22, 0xfcefa3f8); \
+    GG(c, d, a, b, x[7], S23, 0x676f02d9); \
+    GG(b, c, d, a, x[12], S24, 0x8d2a4c8a); \
+    /* Round 3 */ \
+    HH(a, b, c, d, x[5], S31, 0xfffa3942); \
+    HH(d, a, b, c, x[8], S32, 0x8771f681); \
+    HH(c, d, a, b, x[11], S33, 0x6d9d6122); \
+    HH(b, c, d, a, x[14], S34, 0xfde5380c); \
+    HH(a, b, c, d, x[1], S31, 0xa4beea44); \
+    HH(d, a, b, c, x[4], S32, 0x4bdecfa9); \
+    HH(c, d, a, b, x[7], S33, 0xf6bb4b60); \
+    HH(b, c, d, a, x[10], S34, 0xbebfbc70); \
+    HH(a, b, c, d, x[13], S31, 0x289b7ec6); \
+    HH(d, a, b, c, x[0], S32, 0xeaa127fa); \
+    HH(c, d, a, b, x[3], S33, 0xd4ef3085); \
+    HH(b, c, d, a, x[6], S34, 0x4881d05); \
+    HH(a, b, c, d, x[9], S31, 0xd9d4d039); \
+    HH(d, a, b, c, x[12], S32, 0xe6db99e5); \
+    HH(c, d, a, b, x[15], S33, 0x1fa27cf8); \
+    HH(b, c, d, a, x[2], S34, 0xc4ac5665); \
+    /* Round 4 */ \
+    II(a, b, c, d, x[0], S41, 0xf4292244); \
+    II(d, a, b, c, x[7], S42, 0x432aff97); \
+    II(c, d, a, b, x[14], S43, 0xab9423a7); \
+    II(b, c, d, a, x[5], S44, 0xfc93a039); \
+    II(a, b, c, d, x[12], S41, 0x655b59c3); \
+    II(d, a, b, c, x[3], S42, 0x8f0ccc92); \
+    II(c, d, a, b, x[10], S43, 0xffeff47d); \
+    II(b, c, d, a, x[1], S44, 0x85845dd1); \
+    II(a, b, c, d, x[8], S41, 0x6fa87e4f); \
+    II(d, a, b, c, x[15], S42, 0xfe2ce6e0); \
+    II(c, d, a, b, x[6], S43, 0xa3014314); \
+    II(b, c, d, a, x[13], S44, 0x4e0811a1); \
+    II(a, b, c, d, x[4], S41, 0xf7537e82); \
+    II(d, a, b, c, x[11], S42, 0xbd3af235); \
+    II(c, d, a, b, x[2], S43, 0x2ad7d2bb); \
+    II(b, c, d, a, x[9], S44, 0xeb86d391);
+
+#define ROTATE_LEFT Rotate68000
+
+static void MD5Transform68000(ULONG state[4], const UBYTE block[64])
 {
     ULONG a = state[0], b = state[1], c = state[2], d = state[3], x[16];
     ULONG i;
 
+#if defined(__m68k__)
+    if (((ULONG)block & 1) == 0) {
+        /* Two big-endian word loads per little-endian longword */
+        const UWORD *w = (const UWORD *)block;
+        for (i = 0; i < 16; i++, w += 2) {
+            UWORD lo = (UWORD)((w[0] << 8) | (w[0] >> 8));
+            UWORD hi = (UWORD)((w[1] << 8) | (w[1] >> 8));
+            x[i] = ((ULONG)hi << 16) | lo;
+        }
+    } else
+#endif
     for (i = 0; i < 16; i++) {
         x[i] = (ULONG)block[i * 4] | ((ULONG)block[i * 4 + 1] << 8)
              | ((ULONG)block[i * 4 + 2] << 16)
              | ((ULONG)block[i * 4 + 3] << 24);
     }
 
-    /* Round 1 */
-    FF(a, b, c, d, x[0], S11, 0xd76aa478);
-    FF(d, a, b, c, x[1], S12, 0xe8c7b756);
-    FF(c, d, a, b, x[2], S13, 0x242070db);
-    FF(b, c, d, a, x[3], S14, 0xc1bdceee);
-    FF(a, b, c, d, x[4], S11, 0xf57c0faf);
-    FF(d, a, b, c, x[5], S12, 0x4787c62a);
-    FF(c, d, a, b, x[6], S13, 0xa8304613);
-    FF(b, c, d, a, x[7], S14, 0xfd469501);
-    FF(a, b, c, d, x[8], S11, 0x698098d8);
-    FF(d, a, b, c, x[9], S12, 0x8b44f7af);
-    FF(c, d, a, b, x[10], S13, 0xffff5bb1);
-    FF(b, c, d, a, x[11], S14, 0x895cd7be);
-    FF(a, b, c, d, x[12], S11, 0x6b901122);
-    FF(d, a, b, c, x[13], S12, 0xfd987193);
-    FF(c, d, a, b, x[14], S13, 0xa679438e);
-    FF(b, c, d, a, x[15], S14, 0x49b40821);
-
-    /* Round 2 */
-    GG(a, b, c, d, x[1], S21, 0xf61e2562);
-    GG(d, a, b, c, x[6], S22, 0xc040b340);
-    GG(c, d, a, b, x[11], S23, 0x265e5a51);
-    GG(b, c, d, a, x[0], S24, 0xe9b6c7aa);
-    GG(a, b, c, d, x[5], S21, 0xd62f105d);
-    GG(d, a, b, c, x[10], S22, 0x2441453);
-    GG(c, d, a, b, x[15], S23, 0xd8a1e681);
-    GG(b, c, d, a, x[4], S24, 0xe7d3fbc8);
-    GG(a, b, c, d, x[9], S21, 0x21e1cde6);
-    GG(d, a, b, c, x[14], S22, 0xc33707d6);
-    GG(c, d, a, b, x[3], S23, 0xf4d50d87);
-    GG(b, c, d, a, x[8], S24, 0x455a14ed);
-    GG(a, b, c, d, x[13], S21, 0xa9e3e905);
-    GG(d, a, b, c, x[2], S22, 0xfcefa3f8);
-    GG(c, d, a, b, x[7], S23, 0x676f02d9);
-    GG(b, c, d, a, x[12], S24, 0x8d2a4c8a);
-
-    /* Round 3 */
-    HH(a, b, c, d, x[5], S31, 0xfffa3942);
-    HH(d, a, b, c, x[8], S32, 0x8771f681);
-    HH(c, d, a, b, x[11], S33, 0x6d9d6122);
-    HH(b, c, d, a, x[14], S34, 0xfde5380c);
-    HH(a, b, c, d, x[1], S31, 0xa4beea44);
-    HH(d, a, b, c, x[4], S32, 0x4bdecfa9);
-    HH(c, d, a, b, x[7], S33, 0xf6bb4b60);
-    HH(b, c, d, a, x[10], S34, 0xbebfbc70);
-    HH(a, b, c, d, x[13], S31, 0x289b7ec6);
-    HH(d, a, b, c, x[0], S32, 0xeaa127fa);
-    HH(c, d, a, b, x[3], S33, 0xd4ef3085);
-    HH(b, c, d, a, x[6], S34, 0x4881d05);
-    HH(a, b, c, d, x[9], S31, 0xd9d4d039);
-    HH(d, a, b, c, x[12], S32, 0xe6db99e5);
-    HH(c, d, a, b, x[15], S33, 0x1fa27cf8);
-    HH(b, c, d, a, x[2], S34, 0xc4ac5665);
-
-    /* Round 4 */
-    II(a, b, c, d, x[0], S41, 0xf4292244);
-    II(d, a, b, c, x[7], S42, 0x432aff97);
-    II(c, d, a, b, x[14], S43, 0xab9423a7);
-    II(b, c, d, a, x[5], S44, 0xfc93a039);
-    II(a, b, c, d, x[12], S41, 0x655b59c3);
-    II(d, a, b, c, x[3], S42, 0x8f0ccc92);
-    II(c, d, a, b, x[10], S43, 0xffeff47d);
-    II(b, c, d, a, x[1], S44, 0x85845dd1);
-    II(a, b, c, d, x[8], S41, 0x6fa87e4f);
-    II(d, a, b, c, x[15], S42, 0xfe2ce6e0);
-    II(c, d, a, b, x[6], S43, 0xa3014314);
-    II(b, c, d, a, x[13], S44, 0x4e0811a1);
-    II(a, b, c, d, x[4], S41, 0xf7537e82);
-    II(d, a, b, c, x[11], S42, 0xbd3af235);
-    II(c, d, a, b, x[2], S43, 0x2ad7d2bb);
-    II(b, c, d, a, x[9], S44, 0xeb86d391);
+    MD5_ROUNDS
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+
+    /* Zeroize sensitive information. */
+    memset((APTR)x, 0, sizeof(x));
+}
+
+#undef ROTATE_LEFT
+#define ROTATE_LEFT Rotate68020
+
+static void MD5Transform68020(ULONG state[4], const UBYTE block[64])
+{
+    ULONG a = state[0], b = state[1], c = state[2], d = state[3], x[16];
+    ULONG i;
+
+#if defined(__m68k__)
+    /* The 68020 reads longwords at any address */
+    const ULONG *l = (const ULONG *)block;
+    for (i = 0; i < 16; i++) {
+        ULONG v = l[i];
+        x[i] = (v >> 24) | ((v >> 8) & 0xFF00) | ((v & 0xFF00) << 8) | (v << 24);
+    }
+#else
+    for (i = 0; i < 16; i++) {
+        x[i] = (ULONG)block[i * 4] | ((ULONG)block[i * 4 + 1] << 8)
+             | ((ULONG)block[i * 4 + 2] << 16)
+             | ((ULONG)block[i * 4 + 3] << 24);
+    }
+#endif
+
+    MD5_ROUNDS
 
     state[0] += a;
     state[1] += b;
@@ -224,6 +342,8 @@ static void MD5Transform(ULONG state[4], const UBYTE block[64])
     memset((APTR)x, 0, sizeof(x));
 }
 
+#undef ROTATE_LEFT
+
 void CalculateMD5(const UBYTE *data, ULONG size, UBYTE digest[MD5_HASH_SIZE])
 {
     MD5_CTX ctx;
@@ -232,6 +352,146 @@ void CalculateMD5(const UBYTE *data, ULONG size, UBYTE digest[MD5_HASH_SIZE])
     MD5Final(digest, &ctx);
 }
 
+/* ------------------------------------------------------------------ */
+/* Streaming file hash                                                 */
+/* ------------------------------------------------------------------ */
+
+#define MD5_OLD_MAX_SONGS  256
+#define MD5_OLD_SPEED_CIA  60
+#define MD5_OLD_CLOCK_NTSC 2
+
+/* What the old-style fingerprint needs from the header. */
+typedef struct MD5OldStyle {
+    ULONG data_offset;              /* first byte of C64 data in the file */
+    UWORD init;
+    UWORD play;
+    UWORD songs;
+    ULONG speed;
+    BOOL  rsid;
+    BOOL  ntsc;
+} MD5OldStyle;
+
+static BOOL
+MD5_OldStyleHeader(const UBYTE *data, ULONG size, MD5OldStyle *old)
+{
+    UWORD version, load, flags = 0;
+
+    if (size < SID_HEADER_MIN_SIZE) return FALSE;
+    if (memcmp(data, "PSID", 4) != 0 && memcmp(data, "RSID", 4) != 0) return FALSE;
+
+    version = (data[4] << 8) | data[5];
+    old->data_offset = (data[6] << 8) | data[7];
+    load = (data[8] << 8) | data[9];
+    old->init = (data[10] << 8) | data[11];
+    old->play = (data[12] << 8) | data[13];
+    old->songs = (data[14] << 8) | data[15];
+    old->speed = ((ULONG)data[18] << 24) | ((ULONG)data[19] << 16)
+               | ((ULONG)data[20] << 8) | data[21];
+    if (version >= 2 && size >= 0x78) flags = (data[0x76] << 8) | data[0x77];
+
+    old->rsid = data[0] == 'R';
+    old->ntsc = ((flags >> 2) & 3) == MD5_OLD_CLOCK_NTSC;
+
+    /* A zero load address means the data starts with it; libsidplay
+     * left those two bytes out, and used it for a missing init address
+     * (except for BASIC tunes, which have none) */
+    if (load == 0) {
+        if (old->data_offset + 2 <= size) {
+            load = data[old->data_offset] | (data[old->data_offset + 1] << 8);
+        }
+        old->data_offset += 2;
+    }
+    if (old->init == 0 && !(old->rsid && (flags & 0x02))) old->init = load;
+    if (old->songs > MD5_OLD_MAX_SONGS) old->songs = MD5_OLD_MAX_SONGS;
+    return TRUE;
+}
+
+static void
+MD5_OldStyleTrailer(MD5_CTX *ctx, const MD5OldStyle *old)
+{
+    UBYTE tmp[2];
+    UWORD s;
+
+    tmp[0] = old->init & 0xFF; tmp[1] = old->init >> 8;
+    MD5Update(ctx, tmp, 2);
+    tmp[0] = old->play & 0xFF; tmp[1] = old->play >> 8;
+    MD5Update(ctx, tmp, 2);
+    tmp[0] = old->songs & 0xFF; tmp[1] = old->songs >> 8;
+    MD5Update(ctx, tmp, 2);
+
+    /* Songs past the 32nd share the speed bit of the 32nd; RSIDs always
+     * count as CIA-timed */
+    for (s = 0; s < old->songs; s++) {
+        ULONG bit = 1UL << (s < 31 ? s : 31);
+        tmp[0] = (old->rsid || (old->speed & bit)) ? MD5_OLD_SPEED_CIA : 0;
+        MD5Update(ctx, tmp, 1);
+    }
+    if (old->ntsc) {
+        tmp[0] = MD5_OLD_CLOCK_NTSC;
+        MD5Update(ctx, tmp, 1);
+    }
+}
+
+/* Hash filename into digest, reading MD5_FILE_BLOCK bytes at a time. If
+ * header is given, up to header_size bytes from the start of the file are
+ * copied there and *header_len says how many. flags: MD5_OLD_STYLE. */
+BOOL
+MD5File(CONST_STRPTR filename, ULONG flags, UBYTE digest[MD5_HASH_SIZE],
+        UBYTE *header, ULONG header_size, ULONG *header_len)
+{
+    MD5_CTX ctx;
+    MD5OldStyle old;
+    UBYTE *block;
+    BPTR fh;
+    LONG got;
+    ULONG skip = 0;
+    BOOL first = TRUE, ok = FALSE;
+
+    if (header_len) *header_len = 0;
+
+    block = AllocVec(MD5_FILE_BLOCK, MEMF_ANY);
+    if (!block) return FALSE;
+    fh = Open(filename, MODE_OLDFILE);
+    if (!fh) {
+        FreeVec(block);
+        return FALSE;
+    }
+
+    MD5Init(&ctx);
+    while ((got = Read(fh, block, MD5_FILE_BLOCK)) > 0) {
+        if (first) {
+            first = FALSE;
+            if (header) {
+                ULONG n = (ULONG)got < header_size ? (ULONG)got : header_size;
+                CopyMem(block, header, n);
+                if (header_len) *header_len = n;
+            }
+            if (flags & MD5_OLD_STYLE) {
+                if (!MD5_OldStyleHeader(block, (ULONG)got, &old)) break;
+                skip = old.data_offset;
+            }
+        }
+        if (skip >= (ULONG)got) {
+            skip -= got;
+            continue;
+        }
+        MD5Update(&ctx, block + skip, (ULONG)got - skip);
+        skip = 0;
+    }
+
+    /* got is 0 at end of file, -1 on a read error, and 1.. if the loop
+     * stopped on a header the old-style hash can't use */
+    if (got == 0 && !first) {
+        if (flags & MD5_OLD_STYLE) MD5_OldStyleTrailer(&ctx, &old);
+        MD5Final(digest, &ctx);
+        ok = TRUE;
+    }
+
+    Close(fh);
+    FreeVec(block);
+    return ok;
+}
+
 /* Convert MD5 hash to hex string */
 void MD5ToHexString(const UBYTE hash[MD5_HASH_SIZE], char hex_string[MD5_STRING_SIZE])
 {
@@ -245,35 +505,141 @@ void MD5ToHexString(const UBYTE hash[MD5_HASH_SIZE], char hex_string[MD5_STRING_
     hex_string[MD5_STRING_SIZE - 1] = '\0';
 }
 
+/* Digit value + 1 for each hex character, 0 for anything else */
+static const UBYTE hex_values[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+    ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16
+};
+
 BOOL HexStringToMD5(const char *hex_string, UBYTE hash[MD5_HASH_SIZE])
 {
+    const UBYTE *p = (const UBYTE *)hex_string;
     int i;
 
-    if (strlen(hex_string) != 32) {
-        return FALSE;
+    /* A short string stops at its NUL, which isn't a hex digit */
+    for (i = 0; i < MD5_HASH_SIZE; i++, p += 2) {
+        UBYTE high = hex_values[p[0]];
+        UBYTE low;
+
+        if (!high) return FALSE;
+        low = hex_values[p[1]];
+        if (!low) return FALSE;
+
+        hash[i] = (UBYTE)(((high - 1) << 4) | (low - 1));
     }
 
-    for (i = 0; i < MD5_HASH_SIZE; i++) {
-        char high = hex_string[i * 2];
-        char low = hex_string[i * 2 + 1];
+    return *p == '\0';
+}
 
-        if (!isxdigit(high) || !isxdigit(low)) {
-            return FALSE;
-        }
+BOOL MD5Compare(const UBYTE hash1[MD5_HASH_SIZE], const UBYTE hash2[MD5_HASH_SIZE])
+{
+    return (memcmp(hash1, hash2, MD5_HASH_SIZE) == 0);
+}
 
-        high = tolower(high);
-        low = tolower(low);
+/* ------------------------------------------------------------------ */
+/* Kernel benchmark                                                    */
+/* ------------------------------------------------------------------ */
 
-        UBYTE high_val = (high >= 'a') ? (high - 'a' + 10) : (high - '0');
-        UBYTE low_val = (low >= 'a') ? (low - 'a' + 10) : (low - '0');
+#define MD5_BENCH_BYTES  (64 * 1024)
+#define MD5_BENCH_TICKS  (2 * TICKS_PER_SECOND)
 
-        hash[i] = (high_val << 4) | low_val;
-    }
+/* Print bytes processed per second as MB/s with two decimals. */
+static void
+MD5_Report(CONST_STRPTR name, ULONG bytes, ULONG ticks, BOOL selected)
+{
+    ULONG rate = ticks ? (ULONG)(((double)bytes * TICKS_PER_SECOND * 100.0)
+                                 / ((double)ticks * 1048576.0)) : 0;
 
-    return TRUE;
+    printf("  %-24s %5lu.%02lu MB/s%s\n", name, (unsigned long)(rate / 100),
+           (unsigned long)(rate % 100), selected ? "  (in use)" : "");
 }
 
-BOOL MD5Compare(const UBYTE hash1[MD5_HASH_SIZE], const UBYTE hash2[MD5_HASH_SIZE])
+/* Time one MD5 transform over the buffer until MD5_BENCH_TICKS pass. */
+static void
+MD5_BenchTransform(CONST_STRPTR name, void (*transform)(ULONG[4], const UBYTE[64]),
+                   const UBYTE *buffer)
 {
-    return (memcmp(hash1, hash2, MD5_HASH_SIZE) == 0);
+    struct DateStamp start;
+    ULONG state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    ULONG bytes = 0, ticks, i;
+
+    DateStamp(&start);
+    do {
+        for (i = 0; i < MD5_BENCH_BYTES; i += 64) transform(state, buffer + i);
+        bytes += MD5_BENCH_BYTES;
+        ticks = TicksSince(&start);
+    } while (ticks < MD5_BENCH_TICKS);
+
+    MD5_Report(name, bytes, ticks, transform == MD5Transform);
+}
+
+/* First part of "U64Player BENCHMARK" (bench.c): time each kernel on this
+ * machine and print MB/s (of input for the encoders, of output for
+ * HexStringToMD5). Returns a shell return code. */
+int MD5_Benchmark(void)
+{
+    struct DateStamp start;
+    UBYTE *buffer;
+    char hex[MD5_STRING_SIZE];
+    char *wide;
+    UBYTE hash[MD5_HASH_SIZE];
+    ULONG bytes, ticks, i;
+
+    buffer = AllocVec(MD5_BENCH_BYTES, MEMF_ANY);
+    wide = AllocVec(2 * 128 + 1, MEMF_ANY);
+    if (!buffer || !wide) {
+        if (buffer) FreeVec(buffer);
+        if (wide) FreeVec(wide);
+        printf("Out of memory\n");
+        return RETURN_FAIL;
+    }
+    for (i = 0; i < MD5_BENCH_BYTES; i++) buffer[i] = (UBYTE)(i * 7 + (i >> 8));
+
+    MD5_SelectKernels();
+    printf("Kernel throughput (%s CPU):\n",
+           (SysBase->AttnFlags & AFF_68020) ? "68020+" : "68000/68010");
+
+    MD5_BenchTransform("MD5 transform, 68000", MD5Transform68000, buffer);
+    MD5_BenchTransform("MD5 transform, 68020", MD5Transform68020, buffer);
+
+    bytes = 0;
+    DateStamp(&start);
+    do {
+        for (i = 0; i + MD5_HASH_SIZE <= MD5_BENCH_BYTES; i += MD5_HASH_SIZE) {
+            MD5ToHexString(buffer + i, hex);
+        }
+        bytes += MD5_BENCH_BYTES;
+        ticks = TicksSince(&start);
+    } while (ticks < MD5_BENCH_TICKS);
+    MD5_Report("MD5ToHexString", bytes, ticks, FALSE);
+
+    bytes = 0;
+    DateStamp(&start);
+    do {
+        for (i = 0; i < MD5_BENCH_BYTES / MD5_HASH_SIZE; i++) {
+            hex[i & 31] = "0123456789abcdef"[i & 15];
+            HexStringToMD5(hex, hash);
+        }
+        bytes += MD5_BENCH_BYTES;
+        ticks = TicksSince(&start);
+    } while (ticks < MD5_BENCH_TICKS);
+    MD5_Report("HexStringToMD5", bytes, ticks, FALSE);
+
+    /* WriteMem payloads are at most 128 bytes */
+    bytes = 0;
+    DateStamp(&start);
+    do {
+        for (i = 0; i + 128 <= MD5_BENCH_BYTES; i += 128) {
+            U64_HexEncode(buffer + i, 128, wide);
+        }
+        bytes += MD5_BENCH_BYTES;
+        ticks = TicksSince(&start);
+    } while (ticks < MD5_BENCH_TICKS);
+    MD5_Report("U64_HexEncode (WriteMem)", bytes, ticks, FALSE);
+
+    FreeVec(wide);
+    FreeVec(buffer);
+    return RETURN_OK;
 }
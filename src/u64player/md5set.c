@@ -9,91 +9,267 @@
 #include <stdio.h>
 #include <string.h>
 
-#include "player.h"      /* for MD5Compare, HexStringToMD5, MD5ToHexString */
+#include "player.h"      /* for MD5Compare, HexStringToMD5 */
 #include "md5set.h"
 
-static UWORD
-md5set_bucket(const UBYTE md5[16])
+#define MD5SET_IO_RECORDS 64        /* records per Read/Write batch */
+
+static ULONG
+md5set_home(const UBYTE md5[16], ULONG capacity)
+{
+    ULONG h = ((ULONG)md5[0] << 24) | ((ULONG)md5[1] << 16)
+            | ((ULONG)md5[2] << 8) | md5[3];
+    return h & (capacity - 1);
+}
+
+/* Slot holding md5, or else the slot it should go in (the first tombstone
+ * on its probe path if any, otherwise the empty slot that ended it). */
+static ULONG
+md5set_find(struct MD5Set *set, const UBYTE md5[16], BOOL *found)
+{
+    ULONG mask = set->capacity - 1;
+    ULONG i = md5set_home(md5, set->capacity);
+    ULONG free_slot = (ULONG)~0;
+
+    for (;;) {
+        UBYTE st = set->state[i];
+        if (st == MD5SET_EMPTY) {
+            *found = FALSE;
+            return free_slot != (ULONG)~0 ? free_slot : i;
+        }
+        if (st == MD5SET_USED) {
+            if (MD5Compare(&set->keys[i * 16], md5)) {
+                *found = TRUE;
+                return i;
+            }
+        } else if (free_slot == (ULONG)~0) {
+            free_slot = i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+/* Re-hash into a table of new_capacity slots, dropping tombstones. */
+static BOOL
+md5set_resize(struct MD5Set *set, ULONG new_capacity)
+{
+    UBYTE *old_keys = set->keys;
+    UBYTE *old_state = set->state;
+    ULONG old_capacity = set->capacity;
+    UBYTE *block;
+
+    block = AllocVec(new_capacity * 17, MEMF_PUBLIC | MEMF_CLEAR);
+    if (!block) return FALSE;
+
+    set->keys = block;
+    set->state = block + new_capacity * 16;
+    set->capacity = new_capacity;
+    set->deleted = 0;
+
+    for (ULONG i = 0; i < old_capacity; i++) {
+        if (old_state[i] == MD5SET_USED) {
+            BOOL found;
+            ULONG slot = md5set_find(set, &old_keys[i * 16], &found);
+            CopyMem(&old_keys[i * 16], &set->keys[slot * 16], 16);
+            set->state[slot] = MD5SET_USED;
+        }
+    }
+
+    FreeVec(old_keys);
+    return TRUE;
+}
+
+/* Make room for extra more keys, keeping the load (tombstones included)
+ * at or below 3/4 so probe runs stay short. */
+static BOOL
+md5set_reserve(struct MD5Set *set, ULONG extra)
+{
+    ULONG capacity = set->capacity;
+
+    if ((set->count + set->deleted + extra) * 4 <= capacity * 3) return TRUE;
+
+    /* Grow if the live keys need it, otherwise just sweep tombstones */
+    while ((set->count + extra) * 2 > capacity) capacity <<= 1;
+    return md5set_resize(set, capacity);
+}
+
+/* Table-only insert; TRUE if md5 was new. */
+static BOOL
+md5set_add(struct MD5Set *set, const UBYTE md5[16])
+{
+    BOOL found;
+    ULONG slot;
+
+    if (!md5set_reserve(set, 1)) return FALSE;
+    slot = md5set_find(set, md5, &found);
+    if (found) return FALSE;
+
+    if (set->state[slot] == MD5SET_DELETED) set->deleted--;
+    CopyMem((APTR)md5, &set->keys[slot * 16], 16);
+    set->state[slot] = MD5SET_USED;
+    set->count++;
+    return TRUE;
+}
+
+/* Table-only removal; TRUE if md5 was present. */
+static BOOL
+md5set_drop(struct MD5Set *set, const UBYTE md5[16])
+{
+    BOOL found;
+    ULONG slot = md5set_find(set, md5, &found);
+
+    if (!found) return FALSE;
+    set->state[slot] = MD5SET_DELETED;
+    set->count--;
+    set->deleted++;
+    return TRUE;
+}
+
+/* TRUE once a journal of records entries is mostly dead weight. */
+static BOOL
+md5set_wasteful(struct MD5Set *set, ULONG records)
+{
+    return records >= MD5SET_COMPACT_MIN && records > set->count * 2;
+}
+
+/* Write the set out as a fresh journal, one ADD per member, via a
+ * temporary file so a failure never leaves a half-written original. */
+static BOOL
+md5set_compact(struct MD5Set *set)
+{
+    char tmp[520];
+    UBYTE buf[MD5SET_IO_RECORDS * MD5SET_RECORD_SIZE];
+    ULONG used = 0;
+    BOOL ok;
+
+    sprintf(tmp, "%s.new", set->path);
+    BPTR file = Open(tmp, MODE_NEWFILE);
+    if (!file) return FALSE;
+
+    ok = Write(file, MD5SET_MAGIC, MD5SET_MAGIC_SIZE) == MD5SET_MAGIC_SIZE;
+    for (ULONG i = 0; ok && i < set->capacity; i++) {
+        if (set->state[i] != MD5SET_USED) continue;
+
+        buf[used * MD5SET_RECORD_SIZE] = MD5SET_OP_ADD;
+        CopyMem(&set->keys[i * 16], &buf[used * MD5SET_RECORD_SIZE + 1], 16);
+        if (++used == MD5SET_IO_RECORDS) {
+            ok = Write(file, buf, sizeof(buf)) == (LONG)sizeof(buf);
+            used = 0;
+        }
+    }
+    if (ok && used > 0) {
+        LONG len = used * MD5SET_RECORD_SIZE;
+        ok = Write(file, buf, len) == len;
+    }
+    Close(file);
+
+    if (!ok) {
+        DeleteFile(tmp);
+        return FALSE;
+    }
+
+    DeleteFile(set->path);
+    if (!Rename(tmp, set->path)) return FALSE;
+
+    set->journal_records = set->count;
+    set->dirty = FALSE;
+    U64_DEBUG("MD5Set: compacted %s to %lu records",
+              set->path, (unsigned long)set->count);
+    return TRUE;
+}
+
+/* Append one record to the journal, compacting instead when the file has
+ * grown well past the set. Any failure leaves dirty set so the next
+ * MD5Set_Flush rewrites the lot. */
+static void
+md5set_journal(struct MD5Set *set, UBYTE op, const UBYTE md5[16])
 {
-    return (UWORD)md5[0];           /* 0..255 */
+    UBYTE rec[MD5SET_RECORD_SIZE];
+
+    if (!set->path[0]) return;
+    if (set->dirty) {
+        md5set_compact(set);
+        return;
+    }
+
+    if (md5set_wasteful(set, set->journal_records + 1)) {
+        if (!md5set_compact(set)) set->dirty = TRUE;
+        return;
+    }
+
+    rec[0] = op;
+    CopyMem((APTR)md5, &rec[1], 16);
+
+    BPTR file = Open(set->path, MODE_READWRITE);
+    if (!file) {
+        set->dirty = TRUE;
+        return;
+    }
+    Seek(file, 0, OFFSET_END);
+    if (Write(file, rec, MD5SET_RECORD_SIZE) == MD5SET_RECORD_SIZE) {
+        set->journal_records++;
+    } else {
+        set->dirty = TRUE;
+    }
+    Close(file);
 }
 
 struct MD5Set *
 MD5Set_Create(void)
 {
-    return AllocVec(sizeof(struct MD5Set), MEMF_PUBLIC | MEMF_CLEAR);
+    struct MD5Set *set = AllocVec(sizeof(struct MD5Set), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!set) return NULL;
+
+    set->keys = AllocVec(MD5SET_MIN_CAPACITY * 17, MEMF_PUBLIC | MEMF_CLEAR);
+    if (!set->keys) {
+        FreeVec(set);
+        return NULL;
+    }
+    set->state = set->keys + MD5SET_MIN_CAPACITY * 16;
+    set->capacity = MD5SET_MIN_CAPACITY;
+    return set;
 }
 
 void
 MD5Set_Free(struct MD5Set *set)
 {
     if (!set) return;
-    for (int i = 0; i < MD5SET_BUCKETS; i++) {
-        MD5SetEntry *e = set->buckets[i];
-        while (e) {
-            MD5SetEntry *next = e->next;
-            FreeVec(e);
-            e = next;
-        }
-    }
+    FreeVec(set->keys);
     FreeVec(set);
 }
 
 BOOL
 MD5Set_Contains(struct MD5Set *set, const UBYTE md5[16])
 {
+    BOOL found;
+
     if (!set) return FALSE;
-    for (MD5SetEntry *e = set->buckets[md5set_bucket(md5)]; e; e = e->next) {
-        if (MD5Compare(e->md5, md5)) return TRUE;
-    }
-    return FALSE;
+    md5set_find(set, md5, &found);
+    return found;
 }
 
 BOOL
 MD5Set_Insert(struct MD5Set *set, const UBYTE md5[16])
 {
-    if (!set) return FALSE;
-    UWORD b = md5set_bucket(md5);
-    for (MD5SetEntry *e = set->buckets[b]; e; e = e->next) {
-        if (MD5Compare(e->md5, md5)) return FALSE;
-    }
-    MD5SetEntry *fresh = AllocVec(sizeof(MD5SetEntry), MEMF_PUBLIC);
-    if (!fresh) return FALSE;
-    CopyMem((APTR)md5, fresh->md5, 16);
-    fresh->next = set->buckets[b];
-    set->buckets[b] = fresh;
-    set->count++;
-    set->dirty = TRUE;
+    if (!set || !md5set_add(set, md5)) return FALSE;
+    md5set_journal(set, MD5SET_OP_ADD, md5);
     return TRUE;
 }
 
 BOOL
 MD5Set_Remove(struct MD5Set *set, const UBYTE md5[16])
 {
-    if (!set) return FALSE;
-    UWORD b = md5set_bucket(md5);
-    MD5SetEntry **pp = &set->buckets[b];
-    while (*pp) {
-        if (MD5Compare((*pp)->md5, md5)) {
-            MD5SetEntry *victim = *pp;
-            *pp = victim->next;
-            FreeVec(victim);
-            set->count--;
-            set->dirty = TRUE;
-            return TRUE;
-        }
-        pp = &(*pp)->next;
-    }
-    return FALSE;
+    if (!set || !md5set_drop(set, md5)) return FALSE;
+    md5set_journal(set, MD5SET_OP_REMOVE, md5);
+    return TRUE;
 }
 
-BOOL
-MD5Set_Load(struct MD5Set *set, CONST_STRPTR path)
+/* Import the old newline-delimited hex text format. */
+static BOOL
+md5set_import_text(struct MD5Set *set, CONST_STRPTR path)
 {
-    if (!set || !path) return FALSE;
-
     BPTR file = Open(path, MODE_OLDFILE);
-    if (!file) return FALSE;            /* missing file is not an error */
+    if (!file) return FALSE;
 
     char line[64];
     while (FGets(file, line, sizeof(line))) {
@@ -107,46 +283,87 @@ MD5Set_Load(struct MD5Set *set, CONST_STRPTR path)
 
         UBYTE md5[16];
         if (!HexStringToMD5(line, md5)) continue;
-
-        /* Insert without flipping dirty (we just loaded from disk). */
-        UWORD b = md5set_bucket(md5);
-        BOOL exists = FALSE;
-        for (MD5SetEntry *e = set->buckets[b]; e; e = e->next) {
-            if (MD5Compare(e->md5, md5)) { exists = TRUE; break; }
-        }
-        if (exists) continue;
-
-        MD5SetEntry *fresh = AllocVec(sizeof(MD5SetEntry), MEMF_PUBLIC);
-        if (!fresh) break;
-        CopyMem(md5, fresh->md5, 16);
-        fresh->next = set->buckets[b];
-        set->buckets[b] = fresh;
-        set->count++;
+        md5set_add(set, md5);
     }
 
     Close(file);
-    set->dirty = FALSE;
     return TRUE;
 }
 
 BOOL
-MD5Set_Save(struct MD5Set *set, CONST_STRPTR path)
+MD5Set_Load(struct MD5Set *set, CONST_STRPTR path, CONST_STRPTR legacy_path)
 {
-    if (!set || !path) return FALSE;
-    if (!set->dirty) return TRUE;       /* nothing changed */
+    UBYTE buf[MD5SET_IO_RECORDS * MD5SET_RECORD_SIZE];
+    LONG file_size, got;
 
-    BPTR file = Open(path, MODE_NEWFILE);
-    if (!file) return FALSE;
+    if (!set || !path || strlen(path) >= sizeof(set->path)) return FALSE;
+    strcpy(set->path, path);
+
+    BPTR file = Open(path, MODE_OLDFILE);
+    if (!file) {
+        /* Nothing to append to yet; the first change writes the header */
+        set->dirty = TRUE;
 
-    char hex[33];
-    for (int i = 0; i < MD5SET_BUCKETS; i++) {
-        for (MD5SetEntry *e = set->buckets[i]; e; e = e->next) {
-            MD5ToHexString(e->md5, hex);
-            FPuts(file, hex);
-            FPuts(file, "\n");
+        /* First run with the journal: carry over the old text file */
+        if (legacy_path && md5set_import_text(set, legacy_path)) {
+            U64_DEBUG("MD5Set: imported %lu from %s",
+                      (unsigned long)set->count, legacy_path);
+            md5set_compact(set);
+        }
+        return TRUE;                    /* missing file is not an error */
+    }
+
+    Seek(file, 0, OFFSET_END);
+    file_size = Seek(file, 0, OFFSET_BEGINNING);
+
+    if (Read(file, buf, MD5SET_MAGIC_SIZE) != MD5SET_MAGIC_SIZE
+        || memcmp(buf, MD5SET_MAGIC, MD5SET_MAGIC_SIZE) != 0) {
+        /* Not ours; don't append to it, rewrite it on the first change */
+        Close(file);
+        set->dirty = TRUE;
+        return FALSE;
+    }
+
+    /* Size the table for every record being an ADD up front */
+    if (file_size > MD5SET_MAGIC_SIZE) {
+        md5set_reserve(set, (file_size - MD5SET_MAGIC_SIZE) / MD5SET_RECORD_SIZE);
+    }
+
+    while (!set->dirty && (got = Read(file, buf, sizeof(buf))) > 0) {
+        LONG n = got / MD5SET_RECORD_SIZE;
+
+        for (LONG r = 0; r < n && !set->dirty; r++) {
+            UBYTE *rec = &buf[r * MD5SET_RECORD_SIZE];
+            if (rec[0] == MD5SET_OP_ADD) {
+                md5set_add(set, rec + 1);
+            } else if (rec[0] == MD5SET_OP_REMOVE) {
+                md5set_drop(set, rec + 1);
+            } else {
+                set->dirty = TRUE;      /* garbage: keep what came before */
+                break;
+            }
+            set->journal_records++;
+        }
+        if (got % MD5SET_RECORD_SIZE) {
+            /* Torn last record from a crash mid-append */
+            set->dirty = TRUE;
         }
     }
     Close(file);
-    set->dirty = FALSE;
+
+    /* Everything replayed above is already on disk */
+    if (set->dirty || md5set_wasteful(set, set->journal_records)) {
+        md5set_compact(set);
+    }
+    return TRUE;
+}
+
+BOOL
+MD5Set_Flush(struct MD5Set *set)
+{
+    if (!set || !set->path[0]) return FALSE;
+    if (set->dirty || md5set_wasteful(set, set->journal_records)) {
+        return md5set_compact(set);
+    }
     return TRUE;
 }
@@ -1,9 +1,22 @@
-/* Small bucketed MD5 hash set backed by a newline-delimited hex text file.
+/* Open-addressing MD5 hash set backed by a binary append-only journal.
  *
  * Used for two persistent player features:
  *   - "heard" tracker   (set of SIDs the user has ever played)
  *   - "favourites"      (set of SIDs the user hearted)
  *
+ * The table is one flat allocation of raw 16-byte keys plus a state byte
+ * per slot, probed linearly from the first four MD5 bytes (already
+ * uniformly distributed, no extra hashing needed).
+ *
+ * Journal layout:
+ *   "U64MD5J1"                     8-byte magic
+ *   { UBYTE op; UBYTE md5[16]; }*  MD5SET_OP_ADD or MD5SET_OP_REMOVE
+ *
+ * Once a set is loaded from its journal every Insert/Remove that changes
+ * it appends one 17-byte record, so nothing is lost on a crash and there
+ * is no whole-file rewrite on exit. When removals (or a damaged tail) make
+ * the file much larger than the set it is compacted: rewritten as one ADD
+ * per member under a temporary name and renamed over the original.
  */
 
 #ifndef U64_MD5SET_H
@@ -11,43 +24,60 @@
 
 #include <exec/types.h>
 
-#define MD5SET_BUCKETS 256          /* 8 bits of MD5[0], 1 KB of pointers */
+#define MD5SET_MIN_CAPACITY 256     /* slots; always a power of two */
 
-typedef struct MD5SetEntry
-{
-    UBYTE md5[16];                  /* raw 16 bytes, not hex */
-    struct MD5SetEntry *next;
-} MD5SetEntry;
+#define MD5SET_MAGIC        "U64MD5J1"
+#define MD5SET_MAGIC_SIZE   8
+#define MD5SET_RECORD_SIZE  17
+
+#define MD5SET_OP_ADD       'A'
+#define MD5SET_OP_REMOVE    'R'
+
+/* Compact once the journal holds this many records and more than twice
+ * as many as the set has members */
+#define MD5SET_COMPACT_MIN  256
+
+/* Slot states */
+#define MD5SET_EMPTY        0
+#define MD5SET_USED         1
+#define MD5SET_DELETED      2
 
 struct MD5Set
 {
-    MD5SetEntry *buckets[MD5SET_BUCKETS];
-    ULONG count;
-    BOOL  dirty;                    /* TRUE if mutated since last save */
+    UBYTE *keys;                    /* capacity * 16 raw MD5 bytes */
+    UBYTE *state;                   /* capacity slot states, after keys */
+    ULONG capacity;
+    ULONG count;                    /* USED slots */
+    ULONG deleted;                  /* DELETED slots (tombstones) */
+    ULONG journal_records;          /* records currently in the file */
+    BOOL  dirty;                    /* file must be rewritten to match */
+    char  path[512];                /* journal; empty = memory only */
 };
 
 /* Allocate an empty set. Caller frees with MD5Set_Free. */
 struct MD5Set *MD5Set_Create(void);
 
-/* Destroy a set; NULL is safe. */
+/* Destroy a set; NULL is safe. Does not touch the journal. */
 void MD5Set_Free(struct MD5Set *set);
 
 /* TRUE if md5 is present in set. NULL set = FALSE. */
 BOOL MD5Set_Contains(struct MD5Set *set, const UBYTE md5[16]);
 
 /* Insert md5 if not already present. Returns TRUE when it's newly inserted
- * (in which case dirty is flipped on), FALSE if it was already there. */
+ * (and journalled), FALSE if it was already there. */
 BOOL MD5Set_Insert(struct MD5Set *set, const UBYTE md5[16]);
 
-/* Remove md5. Returns TRUE if it was present. */
+/* Remove md5. Returns TRUE if it was present (and journalled). */
 BOOL MD5Set_Remove(struct MD5Set *set, const UBYTE md5[16]);
 
-/* Load the hex text file at path into set. Missing file = empty set.
- * Callable on a non-empty set (accumulates). */
-BOOL MD5Set_Load(struct MD5Set *set, CONST_STRPTR path);
+/* Replay the journal at path into set and keep appending changes to it.
+ * If path doesn't exist, legacy_path (may be NULL) is imported instead as
+ * the old hex text format, one MD5 per line, and written out as a fresh
+ * journal. Missing files just give an empty set. */
+BOOL MD5Set_Load(struct MD5Set *set, CONST_STRPTR path, CONST_STRPTR legacy_path);
 
-/* Persist set to path, one hex MD5 per line. Does nothing if !set->dirty.
- * Returns TRUE on success (or if nothing to write). */
-BOOL MD5Set_Save(struct MD5Set *set, CONST_STRPTR path);
+/* Compact the journal if it is damaged, out of date or mostly dead
+ * records; otherwise nothing to do. Returns TRUE if the file is current. */
+BOOL MD5Set_Flush(struct MD5Set *set);
 
 #endif
@@ -18,6 +18,10 @@
 #include "player.h"
 #include "file_utils.h"
 #include "md5set.h"
+#include "playstats.h"
+#include "sidcache.h"
+#include "smartpl.h"
+#include "stil.h"
 
 /* Simple cache for current song info to prevent corruption */
 static struct {
@@ -220,13 +224,62 @@ APP_UpdateCurrentSongDisplay(void)
     U64_DEBUG("=== APP_UpdateCurrentSongDisplay FIXED END ===");
 }
 
+/* A smart playlist queues its matches already shuffled when shuffle is on,
+ * so playback then just walks the playlist in order. */
+static BOOL
+PlaysShuffled(struct ObjApp *obj)
+{
+    return obj->shuffle_mode && !obj->smart_playlist;
+}
+
+/* Warm the SID cache with the track playback will reach next, so the
+ * following Next (or auto-advance) is served from memory. In shuffle mode
+ * that's the next slot of the pre-shuffled order. */
+static void
+PrefetchNextEntry(struct ObjApp *obj)
+{
+    PlaylistEntry *next;
+
+    if (!obj->sid_cache || !obj->current_entry) return;
+
+    if (PlaysShuffled(obj)) {
+        LONG index = Shuffle_Peek(obj);
+        if (index < 0) return;
+        next = &obj->playlist[index];
+    } else if (obj->current_index + 1 < obj->playlist_count) {
+        next = &obj->playlist[obj->current_index + 1];
+    } else if (obj->repeat_mode) {
+        next = &obj->playlist[0];
+    } else {
+        return;
+    }
+    /* A pending entry has no MD5 to key the cache on yet */
+    if (next == obj->current_entry || next->pending) return;
+
+    SIDCache_Prefetch(obj->sid_cache, next->md5, next->filename);
+}
+
+/* Close out the play in progress, if any, in the statistics: how long it
+ * ran and why it ended (PLAYSTATS_END_*) decide whether it counts as
+ * skipped or finished. */
+void
+APP_StatsEndPlay(struct ObjApp *obj, ULONG reason)
+{
+    if (!obj->stats_active) return;
+    obj->stats_active = FALSE;
+    PlayStats_Ended(obj->play_stats, obj->stats_md5,
+                    obj->current_time, obj->total_time, reason);
+}
+
 BOOL
 PlayCurrentSong(struct ObjApp *obj)
 {
-    UBYTE *file_data;
+    const UBYTE *file_data;
+    UBYTE *owned_data = NULL;
     ULONG file_size;
     STRPTR error_details = NULL;
     LONG result;
+    BOOL same_file;
 
     if (!obj->connection || !obj->current_entry) {
         return FALSE;
@@ -234,6 +287,17 @@ PlayCurrentSong(struct ObjApp *obj)
 
     U64_DEBUG("=== PlayCurrentSong FIXED START ===");
 
+    /* Subsongs and MD5 must be known before the cache is filled */
+    Resolver_ResolveNow(obj, obj->current_entry);
+
+    /* Whatever was playing stops here, however far it got. Moving on to
+     * another subsong of the same file continues the same play in the
+     * statistics rather than counting a new one (or a skip). */
+    same_file = obj->stats_active
+        && MD5Compare(obj->stats_md5, obj->current_entry->md5);
+    APP_StatsEndPlay(obj, same_file ? PLAYSTATS_END_SUBSONG : obj->stats_end);
+    obj->stats_end = PLAYSTATS_END_OTHER;
+
     /* Update cache BEFORE doing anything else */
     APP_UpdateCurrentSongCache();
 
@@ -247,8 +311,14 @@ PlayCurrentSong(struct ObjApp *obj)
     U64_DEBUG("PlayCurrentSong: Playing subsong %d (0-based) = %d (Ultimate64 1-based)",
               current_subsong, ultimate64_subsong);
 
-    /* Load file */
-    file_data = U64_ReadFile(obj->current_entry->filename, &file_size);
+    /* Load file — from the LRU cache when we've played it recently, so
+     * subsong changes and replays don't touch the disk. */
+    if (obj->sid_cache) {
+        file_data = SIDCache_Get(obj->sid_cache, obj->current_entry->md5,
+                                 obj->current_entry->filename, &file_size);
+    } else {
+        file_data = owned_data = U64_ReadFile(obj->current_entry->filename, &file_size);
+    }
     if (!file_data) {
         APP_UpdateStatus("Failed to load SID file");
         return FALSE;
@@ -256,8 +326,13 @@ PlayCurrentSong(struct ObjApp *obj)
 
     /* Play SID with specific subsong (1-based for Ultimate64) */
     result = U64_PlaySID(obj->connection, file_data, file_size, ultimate64_subsong, &error_details);
+    if (result == U64_OK) {
+        Silence_Start(file_data, file_size);   /* needs the header's SID addresses */
+    }
 
-    FreeVec(file_data);
+    if (owned_data) {
+        FreeVec(owned_data);
+    }
 
     if (result != U64_OK) {
         char error_msg[512];
@@ -286,11 +361,17 @@ PlayCurrentSong(struct ObjApp *obj)
 
     /* Phosphor-style heard tracker: remember we've played this MD5. The
      * set only flips dirty if it's a newly-heard SID, so no I/O cost on
-     * replays. Saved to heard.txt on DisposeApp. */
+     * replays. New ones are appended to heard.md5j straight away. */
     if (obj->heard_db) {
         MD5Set_Insert(obj->heard_db, obj->current_entry->md5);
     }
 
+    if (!same_file) {
+        PlayStats_Started(obj->play_stats, obj->current_entry->md5);
+    }
+    CopyMem(obj->current_entry->md5, obj->stats_md5, MD5_HASH_SIZE);
+    obj->stats_active = TRUE;
+
     /* Get duration for the specific subsong being played */
     obj->total_time = FindSongLength(obj, obj->current_entry->md5, current_subsong);
 
@@ -301,6 +382,7 @@ PlayCurrentSong(struct ObjApp *obj)
 
     /* Update display using cached values */
     APP_UpdateCurrentSongDisplay();
+    APP_UpdateSTILDisplay(obj);
 
     char *basename = FilePart(current_song_cache.cached_filename);
 
@@ -343,6 +425,10 @@ PlayCurrentSong(struct ObjApp *obj)
     U64_DEBUG("Status message built: '%s'", status_msg);
     APP_UpdateStatus(status_msg);
 
+    /* Keep a smart playlist's queue ahead of playback */
+    SmartPL_TopUp(obj);
+    PrefetchNextEntry(obj);
+
     U64_DEBUG("=== PlayCurrentSong FIXED END ===");
     return TRUE;
 }
@@ -368,14 +454,14 @@ BOOL APP_Play(void)
             /* NEW: Start periodic timer */
             StartPeriodicTimer();
 
-            APP_UpdatePlaylistDisplay();
+            APP_RedrawPlaylistRow(objApp->current_index);
             return TRUE;
         } else {
             return FALSE;
         }
     }
-    else if (objApp->playlist_head) {
-        objApp->current_entry = objApp->playlist_head;
+    else if (objApp->playlist_count > 0) {
+        objApp->current_entry = &objApp->playlist[0];
         objApp->current_index = 0;
 
         set(objApp->LSV_PlaylistList, MUIA_List_Active, 0);
@@ -385,7 +471,7 @@ BOOL APP_Play(void)
             /* NEW: Start periodic timer */
             StartPeriodicTimer();
 
-            APP_UpdatePlaylistDisplay();
+            APP_RedrawPlaylistRow(objApp->current_index);
             return TRUE;
         } else {
             return FALSE;
@@ -403,6 +489,7 @@ BOOL APP_Stop(void)
     if (!objApp) return FALSE;
 
     if (objApp->state == PLAYER_PLAYING) {
+        APP_StatsEndPlay(objApp, PLAYSTATS_END_OTHER);
         objApp->state = PLAYER_STOPPED;
         objApp->current_time = 0;
 
@@ -430,8 +517,13 @@ BOOL APP_Stop(void)
     return TRUE;
 }
 
-BOOL APP_Next(void)
+/* Move on to the next subsong or song. reason is how the statistics see
+ * the end of the current one: PLAYSTATS_END_NEXT when the user asked. */
+static BOOL
+NextSong(ULONG reason)
 {
+    ULONG previous_index;
+
     if (!objApp || !objApp->current_entry) {
         return FALSE;
     }
@@ -446,7 +538,7 @@ BOOL APP_Next(void)
         }
 
         APP_UpdateCurrentSongCache();
-        APP_UpdatePlaylistDisplay();
+        APP_RedrawPlaylistRow(objApp->current_index);
 
         if (objApp->state == PLAYER_PLAYING) {
             PlayCurrentSong(objApp);
@@ -458,40 +550,37 @@ BOOL APP_Next(void)
 
     /* Reset current subsong and move to next entry */
     objApp->current_entry->current_subsong = 0;
+    previous_index = objApp->current_index;
 
     /* Move to next entry */
-    if (objApp->shuffle_mode) {
-        /* Random selection */
+    if (PlaysShuffled(objApp)) {
+        /* Next slot of the shuffled order — each track once per cycle */
         if (objApp->playlist_count > 1) {
-            ULONG random_index;
-            PlaylistEntry *entry;
-
-            do {
-                random_index = rand() % objApp->playlist_count;
-            } while (random_index == objApp->current_index && objApp->playlist_count > 1);
+            LONG shuffled_index = Shuffle_Next(objApp);
 
-            entry = objApp->playlist_head;
-            for (ULONG i = 0; i < random_index && entry; i++) {
-                entry = entry->next;
+            if (shuffled_index >= 0) {
+                objApp->current_index = (ULONG)shuffled_index;
+                objApp->current_entry = &objApp->playlist[shuffled_index];
+                set(objApp->LSV_PlaylistList, MUIA_List_Active, shuffled_index);
             }
-
-            objApp->current_entry = entry;
-            objApp->current_index = random_index;
-            set(objApp->LSV_PlaylistList, MUIA_List_Active, random_index);
         }
     } else {
-        /* Sequential */
-        if (objApp->current_entry->next) {
-            objApp->current_entry = objApp->current_entry->next;
+        /* Sequential; a smart playlist may still have more to queue */
+        if (objApp->current_index + 1 >= objApp->playlist_count) {
+            SmartPL_TopUp(objApp);
+        }
+        if (objApp->current_index + 1 < objApp->playlist_count) {
             objApp->current_index++;
+            objApp->current_entry = &objApp->playlist[objApp->current_index];
             set(objApp->LSV_PlaylistList, MUIA_List_Active, objApp->current_index);
         } else if (objApp->repeat_mode) {
-            objApp->current_entry = objApp->playlist_head;
+            objApp->current_entry = &objApp->playlist[0];
             objApp->current_index = 0;
             set(objApp->LSV_PlaylistList, MUIA_List_Active, 0);
         } else {
             LONG result;
 
+            APP_StatsEndPlay(objApp, reason);
             objApp->state = PLAYER_STOPPED;
 
             /* NEW: Reset the Ultimate64 when playlist ends */
@@ -511,6 +600,7 @@ BOOL APP_Next(void)
                 APP_UpdateStatus("Playlist finished");
             }
 
+            APP_RedrawPlaylistRow(previous_index);
             APP_UpdateCurrentSongDisplay();
             return TRUE;
 
@@ -525,9 +615,11 @@ BOOL APP_Next(void)
     }
 
     APP_UpdateCurrentSongCache();
-    APP_UpdatePlaylistDisplay();
+    APP_RedrawPlaylistRow(previous_index);
+    APP_RedrawPlaylistRow(objApp->current_index);
 
     if (objApp->state == PLAYER_PLAYING) {
+        objApp->stats_end = reason;
         PlayCurrentSong(objApp);
     } else {
         APP_UpdateCurrentSongDisplay();
@@ -536,6 +628,18 @@ BOOL APP_Next(void)
     return TRUE;
 }
 
+/* Next pressed */
+BOOL APP_Next(void)
+{
+    return NextSong(PLAYSTATS_END_NEXT);
+}
+
+/* The tune ran its length or went silent */
+BOOL APP_Advance(void)
+{
+    return NextSong(PLAYSTATS_END_OTHER);
+}
+
 BOOL APP_Prev(void)
 {
     if (!objApp || !objApp->current_entry) {
@@ -560,7 +664,7 @@ BOOL APP_Prev(void)
         }
 
         APP_UpdateCurrentSongCache();
-        APP_UpdatePlaylistDisplay();
+        APP_RedrawPlaylistRow(objApp->current_index);
 
         if (objApp->state == PLAYER_PLAYING) {
             PlayCurrentSong(objApp);
@@ -570,35 +674,35 @@ BOOL APP_Prev(void)
         return TRUE;
     }
 
-    /* Move to previous entry */
-    if (objApp->current_index > 0) {
-        PlaylistEntry *entry = objApp->playlist_head;
-
-        for (ULONG i = 0; i < objApp->current_index - 1 && entry; i++) {
-            entry = entry->next;
-        }
+    /* Move to previous entry — in shuffle mode the one actually played
+     * before this, not the one above it in the list */
+    LONG prev_index = -1;
+    if (PlaysShuffled(objApp)) {
+        prev_index = Shuffle_Prev(objApp);
+    } else if (objApp->current_index > 0) {
+        prev_index = (LONG)objApp->current_index - 1;
+    }
 
-        if (entry) {
-            objApp->current_entry = entry;
-            objApp->current_index--;
+    if (prev_index >= 0) {
+        objApp->current_index = (ULONG)prev_index;
+        objApp->current_entry = &objApp->playlist[prev_index];
 
-            /* Set to last subsong */
-            objApp->current_entry->current_subsong = objApp->current_entry->subsongs - 1;
-            objApp->current_entry->duration = FindSongLength(objApp, objApp->current_entry->md5,
-                                                             objApp->current_entry->current_subsong);
-            if (objApp->current_entry->duration == 0) {
-                objApp->current_entry->duration = DEFAULT_SONG_LENGTH;
-            }
+        /* Set to last subsong */
+        objApp->current_entry->current_subsong = objApp->current_entry->subsongs - 1;
+        objApp->current_entry->duration = FindSongLength(objApp, objApp->current_entry->md5,
+                                                         objApp->current_entry->current_subsong);
+        if (objApp->current_entry->duration == 0) {
+            objApp->current_entry->duration = DEFAULT_SONG_LENGTH;
+        }
 
-            set(objApp->LSV_PlaylistList, MUIA_List_Active, objApp->current_index);
-            APP_UpdateCurrentSongCache();
-            APP_UpdatePlaylistDisplay();
+        set(objApp->LSV_PlaylistList, MUIA_List_Active, objApp->current_index);
+        APP_UpdateCurrentSongCache();
+        APP_RedrawPlaylistRow(objApp->current_index);
 
-            if (objApp->state == PLAYER_PLAYING) {
-                PlayCurrentSong(objApp);
-            } else {
-                APP_UpdateCurrentSongDisplay();
-            }
+        if (objApp->state == PLAYER_PLAYING) {
+            PlayCurrentSong(objApp);
+        } else {
+            APP_UpdateCurrentSongDisplay();
         }
     }
 
@@ -620,7 +724,13 @@ void APP_TimerUpdate(void)
 
             /* Check if current subsong is finished */
             if (objApp->current_time >= objApp->total_time) {
-                APP_Next(); /* Auto-advance to next subsong/song */
+                APP_Advance(); /* Auto-advance to next subsong/song */
+            } else if (Silence_Check(objApp)) {
+                /* Ended early rather than skipped, as far as the
+                 * statistics are concerned */
+                objApp->total_time = objApp->current_time;
+                APP_UpdateStatus("Silence detected - next song");
+                APP_Advance();
             }
         }
     }
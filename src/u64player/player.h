@@ -7,6 +7,7 @@
 
 #include <stddef.h>
 
+#include <dos/dos.h>
 #include <exec/types.h>
 #include <intuition/intuition.h>
 #include <libraries/mui.h>
@@ -18,14 +19,24 @@
 
 /* Constants */
 #define DEFAULT_SONG_LENGTH 300 /* 5 minutes in seconds */
-#define MAX_PLAYLIST_ENTRIES 1000
+#define SILENCE_DEFAULT_SECS 5 /* quiet this long ends a tune early */
+#define PLAYLIST_INITIAL_CAPACITY 256 /* entries; the array doubles as needed */
+#define PLAYLIST_BINARY_EXT ".u64pl" /* saved in the binary format, plbinary.c */
+#define PLAYLIST_ROW_TEXT 512 /* one formatted playlist row */
 #define MD5_HASH_SIZE 16
 #define MD5_STRING_SIZE 33 /* 32 hex chars + null terminator */
+#define MD5_FILE_BLOCK 4096 /* read size when hashing a file, md5.c */
+#define MD5_OLD_STYLE 0x0001 /* MD5File: pre-Songlengths.md5 fingerprint */
 
 /* Environment variable names */
 #define ENV_ULTIMATE64_HOST "Ultimate64/Host"
 #define ENV_ULTIMATE64_PASSWORD "Ultimate64/Password"
 #define ENV_ULTIMATE64_SID_DIR "Ultimate64/SidDir"
+#define ENV_ULTIMATE64_SID_CACHE "Ultimate64/SidCacheKB" /* LRU budget, KB */
+#define ENV_ULTIMATE64_HVSC_ROOT "Ultimate64/HVSCRoot" /* library search root */
+#define ENV_ULTIMATE64_SMART_QUERY "Ultimate64/SmartQuery" /* active smart playlist */
+#define ENV_ULTIMATE64_SILENCE_SECS "Ultimate64/SilenceSecs" /* quiet before skipping */
+#define ENV_ULTIMATE64_SONGDB_UPDATE_URL "Ultimate64/SongDBUpdateURL" /* release diffs */
 
 /* Window IDs */
 #ifndef MAKE_ID
@@ -35,6 +46,7 @@
 
 #define APP_ID_WIN_MAIN MAKE_ID('S', 'I', 'D', '0')
 #define APP_ID_WIN_CONFIG MAKE_ID('S', 'I', 'D', '1')
+#define APP_ID_WIN_LIBRARY MAKE_ID('S', 'I', 'D', '2')
 
 /* Custom button creation function to avoid macro conflicts */
 #define U64SimpleButton(text) \
@@ -88,6 +100,7 @@ enum EVENT_IDS {
   EVENT_PREV,
   EVENT_SHUFFLE,
   EVENT_REPEAT,
+  EVENT_SKIP_SILENCE,
   EVENT_DOWNLOAD_SONGLENGTHS,
   EVENT_QUIT,
   EVENT_ABOUT,
@@ -101,33 +114,80 @@ enum EVENT_IDS {
   EVENT_PLAYLIST_SAVE = 200,
   EVENT_PLAYLIST_LOAD,
   EVENT_PLAYLIST_SAVE_AS,
+  EVENT_PLAYLIST_SORT_PLAYED,
+  EVENT_PLAYLIST_SORT_RECENT,
+  EVENT_PLAYLIST_SORT_UNFINISHED,
+  EVENT_PLAYLIST_SORT_ORIGINAL,
   EVENT_SEARCH_TEXT,
   EVENT_SEARCH_MODE_CHANGED,
   EVENT_SEARCH_CLEAR,
   EVENT_SEARCH_NEXT,
   EVENT_SEARCH_PREV,
-  EVENT_TOGGLE_FAVOURITE = 300
+  EVENT_TOGGLE_FAVOURITE = 300,
+  EVENT_LIBRARY_OPEN = 400,
+  EVENT_LIBRARY_SEARCH,
+  EVENT_LIBRARY_ADD,
+  EVENT_LIBRARY_ADD_ALL,
+  EVENT_LIBRARY_RESCAN,
+  EVENT_LIBRARY_CLOSE,
+  EVENT_SMART_START,
+  EVENT_SMART_STOP,
+  EVENT_SONGDB_UPDATE_FILE = 500,
+  EVENT_SONGDB_UPDATE_FETCH
 };
 
-/* Playlist entry structure */
+/* Playlist entry structure. Entries live contiguously in ObjApp.playlist;
+ * filename and title point into ObjApp.playlist_strings. */
 typedef struct PlaylistEntry
 {
   STRPTR filename;
   STRPTR title;
+  STRPTR search_key; /* lowercase "title\nbasename", built once on add */
   UBYTE md5[MD5_HASH_SIZE];
   ULONG duration; /* in seconds, 0 = unknown */
   UWORD subsongs;
   UWORD current_subsong;
   BOOL is_favourite;  /* hearted — shown with '*' prefix, filterable */
-  struct PlaylistEntry *next;
+  BOOL pending;       /* md5/title/subsongs not read yet (resolver.c) */
+  ULONG order;        /* when it was added; Original Order sorts on it */
 } PlaylistEntry;
 
+/* Playlist view rows are tokens naming a playlist index, never NULL;
+ * PlaylistDisplayHook formats the entry when the row is drawn. */
+#define PLAYLIST_ROW(i)       ((APTR)((ULONG)(i) + 1))
+#define PLAYLIST_ROW_INDEX(p) ((ULONG)(p) - 1)
+
+/* Fields of a PSID/RSID header (sid.c) */
+#define SID_HEADER_MIN_SIZE 0x76 /* through the 'released' field */
+#define SID_HEADER_V2_SIZE  0x7C /* v2+ adds flags, relocation and SID2/3 */
+#define SID_HEADER_BUFFER   0x80 /* enough header for every parser in sid.c */
+
+/* Bits of the v2+ flags word */
+#define SID_FLAG_CLOCK_PAL   0x0004
+#define SID_FLAG_CLOCK_NTSC  0x0008
+#define SID_FLAG_MODEL_6581  0x0010
+#define SID_FLAG_MODEL_8580  0x0020
+
+typedef struct SIDHeaderInfo
+{
+  char title[33];
+  char author[33];
+  char released[33];
+  UWORD version;
+  UWORD subsongs;
+  UWORD start_song; /* 1-based, clamped to subsongs */
+  UWORD flags;      /* 0 for v1 headers */
+  UWORD sid2_address; /* v3+ second SID, e.g. $D420; 0 if none */
+  UWORD sid3_address; /* v4+ third SID; 0 if none */
+} SIDHeaderInfo;
+
 /* Song length database entry — chained into a bucket inside SongLengthDB. */
 typedef struct SongLengthEntry
 {
   UBYTE md5[MD5_HASH_SIZE];
   ULONG *lengths; /* Array of lengths for each subsong */
   UWORD num_subsongs;
+  ULONG cache_offset; /* of its record in the binary cache; 0 = not there */
   struct SongLengthEntry *next;
 } SongLengthEntry;
 
@@ -140,6 +200,9 @@ struct SongLengthDB
 {
   SongLengthEntry *buckets[SONGDB_BUCKETS];
   ULONG entry_count;
+  ULONG record_count;   /* records in the cache file, dead ones included */
+  ULONG hvsc_version;   /* release applied by the last update; 0 = as parsed */
+  char cache_path[512]; /* binary cache backing this db; "" if none */
 };
 
 /* Player state */
@@ -185,6 +248,7 @@ struct ObjApp
   Object *BTN_Favourite;   /* hearts the playing/selected track */
   Object *CHK_Shuffle;
   Object *CHK_Repeat;
+  Object *CHK_SkipSilence;
 
   /* Current song info */
   Object *TXT_CurrentSong;
@@ -192,6 +256,7 @@ struct ObjApp
   Object *TXT_TotalTime;
   Object *GAU_Progress;
   Object *TXT_SubsongInfo;
+  Object *FLT_STILInfo;    /* STIL comment for the playing subsong */
 
   /* Configuration window */
   Object *STR_ConfigHost;
@@ -204,15 +269,43 @@ struct ObjApp
   Object *MN_Project_About;
   Object *MN_Project_Config;
   Object *MN_Project_Quit;
+  Object *MN_Project_Library;
+  Object *MN_Project_SongDBUpdate;
+  Object *MN_Project_SongDBFetch;
+
+  /* Library window (library.c) */
+  Object *WIN_Library;
+  Object *STR_LibrarySearch;
+  Object *LSV_LibraryResults;
+  Object *BTN_LibraryAdd;
+  Object *BTN_LibraryAddAll;
+  Object *BTN_LibraryRescan;
+  Object *TXT_LibraryStatus;
+  Object *STR_SmartQuery;
+  Object *BTN_SmartStart;
+  Object *BTN_SmartStop;
 
   /* Data */
   U64Connection *connection;
-  PlaylistEntry *playlist_head;
+  /* Playlist: playlist_count entries used out of playlist_capacity. The
+   * array moves when it grows, so current_entry is only ever
+   * &playlist[current_index] and is rebased by ReservePlaylistSlot. */
+  PlaylistEntry *playlist;
   PlaylistEntry *current_entry;
+  struct StringPool *playlist_strings;
   struct SongLengthDB *songlength_db;
   ULONG playlist_count;
+  ULONG playlist_capacity;
+  ULONG playlist_next_order; /* PlaylistEntry.order for the next one added */
   ULONG current_index;
 
+  /* Shuffle mode plays shuffle_order (a permutation of playlist indices,
+   * see shuffle.c); shuffle_order[shuffle_pos] is the current track. */
+  ULONG *shuffle_order;
+  ULONG shuffle_count;
+  ULONG shuffle_capacity;
+  ULONG shuffle_pos;
+
   /* Set to TRUE when a long-running operation (e.g. songlengths parse)
    * observed a MUIV_Application_ReturnID_Quit via its own DoMethod polling.
    * main() honours this by skipping the event loop and going straight to
@@ -220,15 +313,46 @@ struct ObjApp
   BOOL quit_requested;
 
   /* Persistent MD5 sets (ported from Phosphor):
-   *   heard_db   — every SID the user has ever played (heard.txt)
-   *   favourites — tracks the user hearted (favourites.txt)
+   *   heard_db   — every SID the user has ever played (heard.md5j)
+   *   favourites — tracks the user hearted (favourites.md5j)
    * Both live in PROGDIR. NULL if load failed, set is created on demand. */
   struct MD5Set *heard_db;
   struct MD5Set *favourites;
 
+  /* Play counts, skips, listening time per SID (playstats.c). The play in
+   * progress is stats_md5 while stats_active; it is closed out when the
+   * next one starts, on Stop and on exit. stats_end is the PLAYSTATS_END_*
+   * reason PlayCurrentSong closes it with, set by Next just before. */
+  struct PlayStatsDB *play_stats;
+  UBYTE stats_md5[MD5_HASH_SIZE];
+  BOOL stats_active;
+  ULONG stats_end;
+
+  /* LRU cache of recently played SID files (sidcache.c). Budget comes from
+   * ENV:Ultimate64/SidCacheKB, falling back to SIDCACHE_DEFAULT_KB. */
+  struct SIDCache *sid_cache;
+  ULONG sid_cache_kb;
+
+  /* HVSC catalogue + trigram index for "Search Library" (library.c,
+   * trigram.c). NULL until the window is first opened. */
+  struct SIDLibrary *library;
+  struct LibraryResults *library_results;
+
+  /* Smart playlist being materialized into the playlist (smartpl.c), and
+   * its query, kept in ENV: so an unattended station resumes it. */
+  struct SmartPlaylist *smart_playlist;
+  char smart_query[256];
+
+  /* Path-hash index into HVSC's STIL.txt (stil.c); NULL if none found. */
+  struct STILIndex *stil;
+
   Object *MN_Playlist_Load;
   Object *MN_Playlist_Save;
   Object *MN_Playlist_SaveAs;
+  Object *MN_Playlist_SortPlayed;
+  Object *MN_Playlist_SortRecent;
+  Object *MN_Playlist_SortUnfinished;
+  Object *MN_Playlist_SortOriginal;
   Object *BTN_LoadPlaylist;
   Object *BTN_SavePlaylist;
 
@@ -238,6 +362,8 @@ struct ObjApp
   ULONG total_time;
   BOOL shuffle_mode;
   BOOL repeat_mode;
+  BOOL skip_silence;   /* advance once the SIDs have been quiet (silence.c) */
+  ULONG silence_secs;  /* ...for this long; ENV:Ultimate64/SilenceSecs */
   ULONG timer_counter;
 
   Object *TXT_SID1_Info;
@@ -254,7 +380,10 @@ struct ObjApp
   /* Search data */
   char search_text[256];
   BOOL search_mode_filter;  /* TRUE = filter, FALSE = search/navigate */
-  BOOL *playlist_visible;   /* Array tracking visibility in filter mode */
+  ULONG *playlist_visible;  /* Bitmap, bit i set = entry i matches */
+  ULONG playlist_visible_words; /* Allocated size of the bitmap in ULONGs */
+  char search_applied[256]; /* Lowercase term the bitmap reflects */
+  BOOL search_applied_valid; /* FALSE once the playlist changes under it */
   ULONG search_current_match; /* Current match index in search mode */
   ULONG search_total_matches; /* Total matches found */
 
@@ -264,6 +393,7 @@ struct ObjApp
   char password[256];
   char last_sid_dir[256];
   char current_playlist_file[512];
+  char hvsc_root[256]; /* ENV:Ultimate64/HVSCRoot, asked for on first rescan */
 
 };
 
@@ -277,6 +407,8 @@ BOOL InitLibs(void);
 void CleanupLibs(void);
 struct ObjApp *CreateApp(void);
 void DisposeApp(struct ObjApp *obj);
+BOOL build_progdir_path(char *out, ULONG out_size, CONST_STRPTR name);
+BOOL APP_PumpEvents(struct ObjApp *obj);
 
 /* config.c */
 BOOL LoadConfig(struct ObjApp *obj);
@@ -289,12 +421,20 @@ void StartPeriodicTimer(void);
 void StopPeriodicTimer(void);
 BOOL CheckTimerSignal(ULONG sigs);
 ULONG TimerWaitMask(void);  /* returns signal bit to OR into Wait(), or 0 */
+ULONG TicksSince(const struct DateStamp *start);
+
+/* bench.c */
+int Bench_Run(CONST_STRPTR results_path);
 
 /* md5.c */
+void MD5_SelectKernels(void);
+int MD5_Benchmark(void);
 void MD5Init(MD5_CTX *ctx);
 void MD5Update(MD5_CTX *ctx, const UBYTE *input, ULONG inputLen);
 void MD5Final(UBYTE digest[MD5_HASH_SIZE], MD5_CTX *ctx);
 void CalculateMD5(const UBYTE *data, ULONG size, UBYTE digest[MD5_HASH_SIZE]);
+BOOL MD5File(CONST_STRPTR filename, ULONG flags, UBYTE digest[MD5_HASH_SIZE],
+             UBYTE *header, ULONG header_size, ULONG *header_len);
 void MD5ToHexString(const UBYTE hash[MD5_HASH_SIZE], char hex_string[MD5_STRING_SIZE]);
 BOOL HexStringToMD5(const char *hex_string, UBYTE hash[MD5_HASH_SIZE]);
 BOOL MD5Compare(const UBYTE hash1[MD5_HASH_SIZE], const UBYTE hash2[MD5_HASH_SIZE]);
@@ -302,6 +442,8 @@ BOOL MD5Compare(const UBYTE hash1[MD5_HASH_SIZE], const UBYTE hash2[MD5_HASH_SIZ
 /* sid.c */
 UWORD ParseSIDSubsongs(const UBYTE *data, ULONG size);
 STRPTR ExtractSIDTitle(const UBYTE *data, ULONG size);
+STRPTR FormatSIDTitle(CONST_STRPTR title, CONST_STRPTR author, UBYTE flags);
+BOOL ParseSIDHeader(const UBYTE *data, ULONG size, SIDHeaderInfo *info);
 ULONG ParseTimeString(const char *time_str);
 
 /* songdb.c */
@@ -313,27 +455,82 @@ ULONG FindSongLength(struct ObjApp *obj, const UBYTE md5[MD5_HASH_SIZE], UWORD s
 /* Returns the SongLengthEntry for md5 or NULL if not found. Use when you
  * need both the duration and the subsong count without two lookups. */
 SongLengthEntry *SongDB_Find(struct SongLengthDB *db, const UBYTE md5[MD5_HASH_SIZE]);
+/* Size and date of a source file, and whether a cache built from it is
+ * still fresh — shared with the other derived caches (stil.c). */
+BOOL SongDB_SourceStat(CONST_STRPTR source_path, ULONG *out_size,
+                       struct DateStamp *out_mtime);
+BOOL SongDB_SameSource(ULONG cached_size, const struct DateStamp *cached_mtime,
+                       ULONG src_size, const struct DateStamp *src_mtime);
 void FreeSongLengthDB(struct ObjApp *obj);
+BOOL APP_SongDBUpdateFile(void);
+BOOL APP_SongDBUpdateFetch(void);
+struct SongLengthDB *SongDB_BenchParse(CONST_STRPTR filename);
+BOOL SongDB_BenchWriteCache(struct SongLengthDB *db, CONST_STRPTR filename);
+struct SongLengthDB *SongDB_BenchReadCache(CONST_STRPTR filename);
+void SongDB_BenchFree(struct SongLengthDB *db);
 
 /* playlist.c */
+PlaylistEntry *ReservePlaylistSlot(struct ObjApp *obj);
+STRPTR PlaylistStrDup(struct ObjApp *obj, CONST_STRPTR s);
+void RemovePlaylistEntry(struct ObjApp *obj, ULONG index);
 BOOL AddPlaylistEntry(struct ObjApp *obj, CONST_STRPTR filename);
+BOOL AddPlaylistEntryWithInfo(struct ObjApp *obj, CONST_STRPTR filename,
+                              CONST_STRPTR title, const UBYTE md5[MD5_HASH_SIZE],
+                              UWORD header_subsongs);
+BOOL AddPlaylistEntryLazy(struct ObjApp *obj, CONST_STRPTR filename);
+void FillPlaylistEntry(struct ObjApp *obj, PlaylistEntry *entry,
+                       CONST_STRPTR title, const UBYTE md5[MD5_HASH_SIZE],
+                       UWORD header_subsongs);
+void FormatPlaylistLine(PlaylistEntry *entry, STRPTR list_string);
 BOOL SavePlaylistToFile(struct ObjApp *obj, CONST_STRPTR filename);
 BOOL LoadPlaylistFromFile(struct ObjApp *obj, CONST_STRPTR filename);
 BOOL APP_PlaylistSave(void);
 BOOL APP_PlaylistSaveAs(void);
 BOOL APP_PlaylistLoad(void);
+BOOL APP_PlaylistSort(ULONG event);
 BOOL APP_ClearPlaylist(void);
 BOOL APP_PlaylistDoubleClick(void);
 BOOL APP_PlaylistActive(void);
 void FreePlaylists(struct ObjApp *obj);
 void APP_UpdatePlaylistDisplay(void);
+void APP_AppendPlaylistRows(ULONG first);
+void APP_RedrawPlaylistRow(ULONG index);
+extern struct Hook PlaylistDisplayHook;
+
+/* plbinary.c */
+BOOL IsPlaylistBinary(CONST_STRPTR filename);
+BOOL SavePlaylistBinary(struct ObjApp *obj, CONST_STRPTR filename);
+BOOL LoadPlaylistBinary(struct ObjApp *obj, CONST_STRPTR filename);
+
+/* resolver.c */
+ULONG Resolver_WaitMask(void);
+BOOL Resolver_CheckSignal(struct ObjApp *obj, ULONG sigs);
+void Resolver_Kick(struct ObjApp *obj);
+BOOL Resolver_ResolveNow(struct ObjApp *obj, PlaylistEntry *entry);
+void Resolver_Stop(void);
+
+/* silence.c */
+void Silence_Start(const UBYTE *sid_data, ULONG size);
+BOOL Silence_Check(struct ObjApp *obj);
+
+/* shuffle.c */
+ULONG Shuffle_Random(ULONG n);
+LONG Shuffle_Next(struct ObjApp *obj);
+LONG Shuffle_Prev(struct ObjApp *obj);
+LONG Shuffle_Peek(struct ObjApp *obj);
+void Shuffle_Remove(struct ObjApp *obj, ULONG index);
+void Shuffle_Reset(struct ObjApp *obj);
+BOOL Shuffle_Save(struct ObjApp *obj, CONST_STRPTR path);
+BOOL Shuffle_Load(struct ObjApp *obj, CONST_STRPTR path);
 
 /* playback.c */
 BOOL APP_Play(void);
 BOOL APP_Stop(void);
 BOOL APP_Next(void);
+BOOL APP_Advance(void);
 BOOL APP_Prev(void);
 BOOL PlayCurrentSong(struct ObjApp *obj);
+void APP_StatsEndPlay(struct ObjApp *obj, ULONG reason);
 void APP_TimerUpdate(void);
 void APP_UpdateCurrentSongDisplay(void);
 void APP_UpdateCurrentSongCache(void);
@@ -343,6 +540,8 @@ void CreateWindowMain(struct ObjApp *obj);
 void CreateWindowMainEvents(struct ObjApp *obj);
 void CreateWindowConfig(struct ObjApp *obj);
 void CreateWindowConfigEvents(struct ObjApp *obj);
+void CreateWindowLibrary(struct ObjApp *obj);
+void CreateWindowLibraryEvents(struct ObjApp *obj);
 void CreateMenu(struct ObjApp *obj);
 void CreateMenuEvents(struct ObjApp *obj);
 
@@ -353,9 +552,24 @@ BOOL APP_SearchClear(void);
 BOOL APP_SearchNext(void);
 BOOL APP_SearchPrev(void);
 BOOL MatchesSearchTerm(PlaylistEntry *entry, const char *search_term);
+STRPTR BuildSearchKey(struct ObjApp *obj, PlaylistEntry *entry);
+void InvalidateSearchMatches(struct ObjApp *obj);
 void UpdateSearchMatches(void);
 void UpdateFilteredPlaylistDisplay(void);
 
+/* library.c */
+BOOL APP_LibraryOpen(void);
+BOOL APP_LibraryClose(void);
+BOOL APP_LibrarySearch(void);
+BOOL APP_LibraryAdd(BOOL all);
+BOOL APP_LibraryRescan(void);
+BOOL LoadSIDLibrary(void);
+void FreeSIDLibrary(struct ObjApp *obj);
+
+/* smartpl.c */
+BOOL APP_SmartStart(void);
+BOOL APP_SmartStop(void);
+
 /* handlers.c */
 BOOL APP_Connect(void);
 BOOL APP_AddFiles(void);
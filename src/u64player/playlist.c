@@ -14,14 +14,18 @@
 #include <proto/intuition.h>
 #include <proto/muimaster.h>
 
+#include "SDI_hook.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "player.h"
-#include "file_utils.h"
 #include "string_utils.h"
 #include "md5set.h"
+#include "playstats.h"
+#include "smartpl.h"
+#include "strpool.h"
 
 /* Simple ULONG -> string helper (local to this module) */
 static void
@@ -50,6 +54,87 @@ ULONGToString(ULONG value, char *buffer)
     buffer[pos] = '\0';
 }
 
+/* Return a cleared slot at playlist[playlist_count], doubling the array
+ * when it is full. The caller fills the slot and bumps playlist_count to
+ * commit it; an uncommitted slot is simply reused by the next call.
+ * Growing moves the array, so current_entry is rebased here. */
+PlaylistEntry *
+ReservePlaylistSlot(struct ObjApp *obj)
+{
+    if (obj->playlist_count >= obj->playlist_capacity) {
+        ULONG new_capacity = obj->playlist_capacity
+            ? obj->playlist_capacity * 2 : PLAYLIST_INITIAL_CAPACITY;
+        PlaylistEntry *grown = AllocVec(new_capacity * sizeof(PlaylistEntry), MEMF_PUBLIC);
+        if (!grown) {
+            return NULL;
+        }
+        if (obj->playlist) {
+            CopyMem(obj->playlist, grown, obj->playlist_count * sizeof(PlaylistEntry));
+            FreeVec(obj->playlist);
+        }
+        obj->playlist = grown;
+        obj->playlist_capacity = new_capacity;
+        if (obj->current_entry) {
+            obj->current_entry = &obj->playlist[obj->current_index];
+        }
+    }
+
+    PlaylistEntry *slot = &obj->playlist[obj->playlist_count];
+    memset(slot, 0, sizeof(PlaylistEntry));
+    slot->order = obj->playlist_next_order++;
+    InvalidateSearchMatches(obj);
+    return slot;
+}
+
+/* Copy s into the playlist string pool, creating the pool on first use.
+ * Pooled strings are released together by FreePlaylists. */
+STRPTR
+PlaylistStrDup(struct ObjApp *obj, CONST_STRPTR s)
+{
+    if (!s) return NULL;
+    if (!obj->playlist_strings) {
+        obj->playlist_strings = StrPool_Create();
+    }
+    return StrPool_Add(obj->playlist_strings, s);
+}
+
+/* Drop playlist[index], closing the gap. Its strings stay in the pool until
+ * the playlist is cleared. current_entry keeps pointing at the same track,
+ * or at whatever slid into its place if it was the one removed. */
+void
+RemovePlaylistEntry(struct ObjApp *obj, ULONG index)
+{
+    if (index >= obj->playlist_count) return;
+
+    memmove(&obj->playlist[index], &obj->playlist[index + 1],
+            (obj->playlist_count - index - 1) * sizeof(PlaylistEntry));
+    obj->playlist_count--;
+    Shuffle_Remove(obj, index);
+    InvalidateSearchMatches(obj);
+
+    if (obj->current_index > index) {
+        obj->current_index--;
+    } else if (obj->current_index >= obj->playlist_count) {
+        obj->current_index = 0;
+    }
+
+    if (obj->current_entry) {
+        obj->current_entry = obj->playlist_count
+            ? &obj->playlist[obj->current_index] : NULL;
+    }
+}
+
+/* Playlists named *.u64pl are written in the binary format (plbinary.c);
+ * anything else, e.g. .m3u, as text for exchange with other tools. */
+static BOOL
+IsBinaryPlaylistName(CONST_STRPTR filename)
+{
+    ULONG len = strlen(filename);
+    ULONG ext = strlen(PLAYLIST_BINARY_EXT);
+
+    return len > ext && stricmp(filename + len - ext, PLAYLIST_BINARY_EXT) == 0;
+}
+
 BOOL SavePlaylistToFile(struct ObjApp *obj, CONST_STRPTR filename)
 {
     BPTR file;
@@ -58,6 +143,16 @@ BOOL SavePlaylistToFile(struct ObjApp *obj, CONST_STRPTR filename)
     char md5_str[MD5_STRING_SIZE];
     STRPTR escaped_filename, escaped_title;
     ULONG count = 0;
+    ULONG i;
+
+    if (IsBinaryPlaylistName(filename)) {
+        return SavePlaylistBinary(obj, filename);
+    }
+
+    /* The file stores MD5s, so read anything still pending first */
+    for (i = 0; i < obj->playlist_count; i++) {
+        Resolver_ResolveNow(obj, &obj->playlist[i]);
+    }
 
     file = Open(filename, MODE_NEWFILE);
     if (!file) {
@@ -69,8 +164,8 @@ BOOL SavePlaylistToFile(struct ObjApp *obj, CONST_STRPTR filename)
     Write(file, "# Format: \"filename\" \"title\" md5hash subsongs current_subsong\n", 61);
     Write(file, "\n", 1);
 
-    entry = obj->playlist_head;
-    while (entry) {
+    for (i = 0; i < obj->playlist_count; i++) {
+        entry = &obj->playlist[i];
         count++;
 
         if ((count % 10) == 0) {
@@ -118,8 +213,6 @@ BOOL SavePlaylistToFile(struct ObjApp *obj, CONST_STRPTR filename)
 
         if (escaped_filename) FreeVec(escaped_filename);
         if (escaped_title) FreeVec(escaped_title);
-
-        entry = entry->next;
     }
 
     Close(file);
@@ -144,6 +237,11 @@ BOOL LoadPlaylistFromFile(struct ObjApp *obj, CONST_STRPTR filename)
     ULONG count = 0;
     ULONG line_number = 0;
 
+    /* Either format loads from either name */
+    if (IsPlaylistBinary(filename)) {
+        return LoadPlaylistBinary(obj, filename);
+    }
+
     file = Open(filename, MODE_OLDFILE);
     if (!file) {
         APP_UpdateStatus("Failed to open playlist file");
@@ -251,8 +349,16 @@ BOOL LoadPlaylistFromFile(struct ObjApp *obj, CONST_STRPTR filename)
             current_start++;
         }
 
-        entry = AllocVec(sizeof(PlaylistEntry), MEMF_PUBLIC | MEMF_CLEAR);
+        entry = ReservePlaylistSlot(obj);
         if (!entry) {
+            U64_DEBUG("Out of memory at playlist line %lu", (unsigned long)line_number);
+            break;
+        }
+
+        char md5_temp[33];
+        CopyMem(md5_start, md5_temp, 32);
+        md5_temp[32] = '\0';
+        if (!HexStringToMD5(md5_temp, entry->md5)) {
             *filename_end = '"';
             *title_end = '"';
             continue;
@@ -264,24 +370,16 @@ BOOL LoadPlaylistFromFile(struct ObjApp *obj, CONST_STRPTR filename)
         *filename_end = '"';
         *title_end = '"';
 
-        if (!unescaped_filename) {
-            if (unescaped_title) FreeVec(unescaped_title);
-            FreeVec(entry);
-            continue;
-        }
+        /* Move both strings into the pool; the temporaries go straight back. */
+        entry->filename = PlaylistStrDup(obj, unescaped_filename);
+        entry->title = PlaylistStrDup(obj, unescaped_title);
+        if (unescaped_filename) FreeVec(unescaped_filename);
+        if (unescaped_title) FreeVec(unescaped_title);
 
-        entry->filename = unescaped_filename;
-        entry->title = unescaped_title;
-
-        char md5_temp[33];
-        CopyMem(md5_start, md5_temp, 32);
-        md5_temp[32] = '\0';
-        if (!HexStringToMD5(md5_temp, entry->md5)) {
-            U64_SafeStrFree(entry->filename);
-            U64_SafeStrFree(entry->title);
-            FreeVec(entry);
+        if (!entry->filename) {
             continue;
         }
+        entry->search_key = BuildSearchKey(obj, entry);
 
         entry->subsongs = (UWORD)atoi(subsongs_start);
         entry->current_subsong = (UWORD)atoi(current_start);
@@ -299,24 +397,14 @@ BOOL LoadPlaylistFromFile(struct ObjApp *obj, CONST_STRPTR filename)
         /* Sync favourite flag from persistent set. */
         entry->is_favourite = MD5Set_Contains(obj->favourites, entry->md5);
 
-        if (!obj->playlist_head) {
-            obj->playlist_head = entry;
-        } else {
-            PlaylistEntry *last = obj->playlist_head;
-            while (last->next) {
-                last = last->next;
-            }
-            last->next = entry;
-        }
-
         obj->playlist_count++;
         count++;
     }
 
     Close(file);
 
-    if (obj->playlist_head && !obj->current_entry) {
-        obj->current_entry = obj->playlist_head;
+    if (obj->playlist_count > 0 && !obj->current_entry) {
+        obj->current_entry = &obj->playlist[0];
         obj->current_index = 0;
         APP_UpdateCurrentSongCache();
     }
@@ -364,7 +452,7 @@ BOOL APP_PlaylistSaveAs(void)
         ASLFR_TitleText, "Save Playlist As",
         ASLFR_DoSaveMode, TRUE,
         ASLFR_DoPatterns, TRUE,
-        ASLFR_InitialPattern, "#?.m3u",
+        ASLFR_InitialPattern, "#?.(m3u|u64pl)",
         ASLFR_InitialFile, "playlist.m3u",
         ASLFR_RejectIcons, TRUE,
         TAG_DONE);
@@ -374,7 +462,8 @@ BOOL APP_PlaylistSaveAs(void)
         strcpy(filename, req->rf_Dir);
         AddPart(filename, req->rf_File, sizeof(filename));
 
-        if (!strstr(filename, ".m3u") && !strstr(filename, ".M3U")) {
+        if (!strstr(filename, ".m3u") && !strstr(filename, ".M3U")
+            && !IsBinaryPlaylistName(filename)) {
             strcat(filename, ".m3u");
         }
 
@@ -403,7 +492,7 @@ BOOL APP_PlaylistLoad(void)
     req = AllocAslRequestTags(ASL_FileRequest,
         ASLFR_TitleText, "Load Playlist",
         ASLFR_DoPatterns, TRUE,
-        ASLFR_InitialPattern, "#?.m3u",
+        ASLFR_InitialPattern, "#?.(m3u|u64pl)",
         ASLFR_RejectIcons, TRUE,
         TAG_DONE);
 
@@ -413,6 +502,7 @@ BOOL APP_PlaylistLoad(void)
         AddPart(filename, req->rf_File, sizeof(filename));
 
         if (LoadPlaylistFromFile(objApp, filename)) {
+            SmartPL_Stop(objApp);
             strncpy(objApp->current_playlist_file, filename,
                     sizeof(objApp->current_playlist_file) - 1);
             objApp->current_playlist_file[sizeof(objApp->current_playlist_file) - 1] = '\0';
@@ -427,6 +517,112 @@ BOOL APP_PlaylistLoad(void)
     return success;
 }
 
+/* Sort key for APP_PlaylistSort: larger primary/secondary first, playlist
+ * order among equals. */
+typedef struct StatsSortKey {
+    ULONG primary;
+    ULONG secondary;
+    ULONG index;
+} StatsSortKey;
+
+static int
+CompareStatsSortKeys(const void *a, const void *b)
+{
+    const StatsSortKey *ka = a, *kb = b;
+
+    if (ka->primary != kb->primary) return ka->primary > kb->primary ? -1 : 1;
+    if (ka->secondary != kb->secondary) return ka->secondary > kb->secondary ? -1 : 1;
+    return ka->index < kb->index ? -1 : 1;
+}
+
+/* Reorder the playlist by play statistics: most played (plays, then time
+ * listened), recently played, or never finished (played but always left
+ * early, most attempts first). Tracks without history keep their order at
+ * the end. Each entry keeps the order it was added in, which
+ * EVENT_PLAYLIST_SORT_ORIGINAL restores. The shuffle order refers to
+ * indices, so it is started afresh. */
+BOOL APP_PlaylistSort(ULONG event)
+{
+    StatsSortKey *keys;
+    PlaylistEntry *sorted;
+    ULONG i, n;
+    CONST_STRPTR what;
+
+    if (!objApp || objApp->playlist_count < 2) return FALSE;
+    n = objApp->playlist_count;
+
+    keys = AllocVec(n * sizeof(StatsSortKey), MEMF_PUBLIC | MEMF_CLEAR);
+    sorted = AllocVec(objApp->playlist_capacity * sizeof(PlaylistEntry), MEMF_PUBLIC);
+    if (!keys || !sorted) {
+        if (keys) FreeVec(keys);
+        if (sorted) FreeVec(sorted);
+        APP_UpdateStatus("Not enough memory to sort playlist");
+        return FALSE;
+    }
+
+    for (i = 0; i < n; i++) {
+        PlayStats *st = NULL;
+
+        if (event == EVENT_PLAYLIST_SORT_ORIGINAL) {
+            keys[i].index = i;
+            keys[i].primary = ~objApp->playlist[i].order;   /* oldest first */
+            continue;
+        }
+        if (!objApp->playlist[i].pending) {
+            st = PlayStats_Find(objApp->play_stats, objApp->playlist[i].md5);
+        }
+        keys[i].index = i;
+        if (!st) continue;
+
+        switch (event) {
+            case EVENT_PLAYLIST_SORT_PLAYED:
+                keys[i].primary = st->plays;
+                keys[i].secondary = st->listened;
+                break;
+            case EVENT_PLAYLIST_SORT_RECENT:
+                keys[i].primary = st->last_played;
+                break;
+            default:
+                keys[i].primary = (st->plays > 0 && st->finishes == 0);
+                keys[i].secondary = st->plays;
+                break;
+        }
+    }
+
+    qsort(keys, n, sizeof(StatsSortKey), CompareStatsSortKeys);
+
+    for (i = 0; i < n; i++) {
+        CopyMem(&objApp->playlist[keys[i].index], &sorted[i], sizeof(PlaylistEntry));
+        if (objApp->current_entry && keys[i].index == objApp->current_index) {
+            objApp->current_index = i;
+        }
+    }
+    FreeVec(keys);
+    FreeVec(objApp->playlist);
+    objApp->playlist = sorted;
+    if (objApp->current_entry) {
+        objApp->current_entry = &objApp->playlist[objApp->current_index];
+    }
+
+    Shuffle_Reset(objApp);
+    InvalidateSearchMatches(objApp);
+    APP_UpdatePlaylistDisplay();
+    set(objApp->LSV_PlaylistList, MUIA_List_Active, objApp->current_index);
+
+    what = event == EVENT_PLAYLIST_SORT_PLAYED ? "most played"
+         : event == EVENT_PLAYLIST_SORT_RECENT ? "recently played"
+         : event == EVENT_PLAYLIST_SORT_ORIGINAL ? NULL
+         : "never finished";
+    static char status_msg[64];
+    if (what) {
+        sprintf(status_msg, "Playlist sorted by %s", what);
+    } else {
+        strcpy(status_msg, "Playlist back in original order");
+    }
+    APP_UpdateStatus(status_msg);
+    return TRUE;
+}
+
 BOOL APP_ClearPlaylist(void)
 {
     if (!objApp) return FALSE;
@@ -436,6 +632,7 @@ BOOL APP_ClearPlaylist(void)
         objApp->state = PLAYER_STOPPED;
     }
 
+    SmartPL_Stop(objApp);
     FreePlaylists(objApp);
     APP_UpdatePlaylistDisplay();
     APP_UpdateCurrentSongDisplay();
@@ -444,51 +641,26 @@ BOOL APP_ClearPlaylist(void)
     return TRUE;
 }
 
-BOOL AddPlaylistEntry(struct ObjApp *obj, CONST_STRPTR filename)
+/* Fill in everything that depends on the file contents: MD5 and the
+ * favourite flag, subsong count, title, search key and duration. title may
+ * be NULL to fall back to the file name. */
+void FillPlaylistEntry(struct ObjApp *obj, PlaylistEntry *entry, CONST_STRPTR title,
+                       const UBYTE md5[MD5_HASH_SIZE], UWORD header_subsongs)
 {
-    UBYTE *file_data;
-    ULONG file_size;
-    PlaylistEntry *entry;
-    PlaylistEntry *last;
-
-    /* Load file to calculate MD5 and parse header */
-    file_data = U64_ReadFile(filename, &file_size);
-    if (!file_data) {
-        return FALSE;
-    }
-
-    /* Create new entry */
-    entry = AllocVec(sizeof(PlaylistEntry), MEMF_PUBLIC | MEMF_CLEAR);
-    if (!entry) {
-        FreeVec(file_data);
-        return FALSE;
-    }
-
-    /* Copy filename */
-    entry->filename = U64_SafeStrDup(filename);
-    if (!entry->filename) {
-        FreeVec(entry);
-        FreeVec(file_data);
-        return FALSE;
-    }
-
-    /* Calculate MD5 */
-    CalculateMD5(file_data, file_size, entry->md5);
+    CopyMem((APTR)md5, entry->md5, MD5_HASH_SIZE);
+    entry->pending = FALSE;
 
     /* Restore favourite flag from persistent set. */
     entry->is_favourite = MD5Set_Contains(obj->favourites, entry->md5);
 
-    /* Parse SID header for basic subsong count */
-    UWORD header_subsongs = ParseSIDSubsongs(file_data, file_size);
     entry->subsongs = header_subsongs;
-    entry->current_subsong = 0; /* Always start with first subsong */
 
     /* Check if we have this SID in our songlength database */
     if (obj->songlength_db) {
         SongLengthEntry *db_entry = SongDB_Find(obj->songlength_db, entry->md5);
         if (db_entry) {
             U64_DEBUG("Found %s in database: %d subsongs (header said %d)",
-                      FilePart(filename), db_entry->num_subsongs, header_subsongs);
+                      FilePart(entry->filename), db_entry->num_subsongs, header_subsongs);
 
             if (db_entry->num_subsongs > header_subsongs
                 && db_entry->num_subsongs <= 256) {
@@ -496,38 +668,105 @@ BOOL AddPlaylistEntry(struct ObjApp *obj, CONST_STRPTR filename)
             }
         }
     }
+    if (entry->current_subsong >= entry->subsongs) {
+        entry->current_subsong = 0;
+    }
 
-    /* Extract title */
-    entry->title = ExtractSIDTitle(file_data, file_size);
-    if (!entry->title) {
+    if (title) {
+        entry->title = PlaylistStrDup(obj, title);
+    } else {
         /* Use filename as title */
-        STRPTR basename = FilePart(filename);
-        entry->title = U64_SafeStrDup(basename);
+        entry->title = PlaylistStrDup(obj, FilePart(entry->filename));
     }
+    entry->search_key = BuildSearchKey(obj, entry);
 
     /* Find song length for the first subsong (subsong 0) */
     entry->duration = FindSongLength(obj, entry->md5, 0);
     if (entry->duration == 0) {
         entry->duration = DEFAULT_SONG_LENGTH;
     }
+}
 
-    FreeVec(file_data);
+/* Append an entry whose MD5, header subsong count and display title are
+ * already known. title may be NULL to fall back to the file name. */
+BOOL AddPlaylistEntryWithInfo(struct ObjApp *obj, CONST_STRPTR filename,
+                              CONST_STRPTR title, const UBYTE md5[MD5_HASH_SIZE],
+                              UWORD header_subsongs)
+{
+    PlaylistEntry *entry;
 
-    /* Add to playlist */
-    if (!obj->playlist_head) {
-        obj->playlist_head = entry;
-    } else {
-        last = obj->playlist_head;
-        while (last->next) {
-            last = last->next;
-        }
-        last->next = entry;
+    /* Claim the next slot; it only becomes part of the playlist below */
+    entry = ReservePlaylistSlot(obj);
+    if (!entry) {
+        return FALSE;
+    }
+
+    /* Copy filename */
+    entry->filename = PlaylistStrDup(obj, filename);
+    if (!entry->filename) {
+        return FALSE;
     }
 
+    entry->current_subsong = 0; /* Always start with first subsong */
+    FillPlaylistEntry(obj, entry, title, md5, header_subsongs);
+
+    /* Commit the slot */
     obj->playlist_count++;
     return TRUE;
 }
 
+/* Append an entry knowing only its file name. It shows up straight away
+ * under that name; resolver.c reads the file later and fills in the rest
+ * (call Resolver_Kick once done adding). */
+BOOL AddPlaylistEntryLazy(struct ObjApp *obj, CONST_STRPTR filename)
+{
+    PlaylistEntry *entry;
+
+    entry = ReservePlaylistSlot(obj);
+    if (!entry) {
+        return FALSE;
+    }
+
+    entry->filename = PlaylistStrDup(obj, filename);
+    if (!entry->filename) {
+        return FALSE;
+    }
+
+    memset(entry->md5, 0, MD5_HASH_SIZE);
+    entry->title = FilePart(entry->filename);  /* until the header is read */
+    entry->search_key = BuildSearchKey(obj, entry);
+    entry->subsongs = 1;
+    entry->current_subsong = 0;
+    entry->duration = DEFAULT_SONG_LENGTH;
+    entry->is_favourite = FALSE;
+    entry->pending = TRUE;
+
+    obj->playlist_count++;
+    return TRUE;
+}
+
+BOOL AddPlaylistEntry(struct ObjApp *obj, CONST_STRPTR filename)
+{
+    UBYTE header[SID_HEADER_BUFFER];
+    ULONG header_len;
+    UBYTE md5[MD5_HASH_SIZE];
+    STRPTR title;
+    BOOL ok;
+
+    /* Hash the file block by block, keeping the header to parse */
+    if (!MD5File(filename, 0, md5, header, sizeof(header), &header_len)) {
+        return FALSE;
+    }
+
+    title = ExtractSIDTitle(header, header_len);
+
+    ok = AddPlaylistEntryWithInfo(obj, filename, title, md5,
+                                  ParseSIDSubsongs(header, header_len));
+
+    if (title) FreeVec(title);
+    return ok;
+}
+
 BOOL
 APP_PlaylistDoubleClick(void)
 {
@@ -544,9 +783,9 @@ APP_PlaylistDoubleClick(void)
     }
 
     /* Find the entry */
-    PlaylistEntry *entry = objApp->playlist_head;
-    for (ULONG i = 0; i < (ULONG)active && entry; i++) {
-        entry = entry->next;
+    PlaylistEntry *entry = NULL;
+    if ((ULONG)active < objApp->playlist_count) {
+        entry = &objApp->playlist[active];
     }
 
     if (entry) {
@@ -592,9 +831,9 @@ APP_PlaylistActive(void)
     }
 
     /* Find the selected entry */
-    PlaylistEntry *entry = objApp->playlist_head;
-    for (ULONG i = 0; i < (ULONG)index && entry; i++) {
-        entry = entry->next;
+    PlaylistEntry *entry = NULL;
+    if ((ULONG)index < objApp->playlist_count) {
+        entry = &objApp->playlist[index];
     }
 
     if (entry) {
@@ -661,9 +900,6 @@ APP_PlaylistActive(void)
 /* Free Playlists */
 void FreePlaylists(struct ObjApp *obj)
 {
-    PlaylistEntry *entry = obj->playlist_head;
-    PlaylistEntry *next;
-
     /* Clear the MUI list first to prevent access to freed memory */
     if (obj->LSV_PlaylistList) {
         set(obj->LSV_PlaylistList, MUIA_List_Quiet, TRUE);
@@ -671,232 +907,291 @@ void FreePlaylists(struct ObjApp *obj)
         set(obj->LSV_PlaylistList, MUIA_List_Quiet, FALSE);
     }
 
-    /* Free playlist entries */
-    while (entry) {
-        next = entry->next;
-        U64_SafeStrFree(entry->filename);
-        U64_SafeStrFree(entry->title);
-        FreeVec(entry);
-        entry = next;
+    /* Free playlist entries and every string they point at */
+    if (obj->playlist) {
+        FreeVec(obj->playlist);
     }
+    StrPool_Free(obj->playlist_strings);
+    Shuffle_Reset(obj);
 
     /* Clean up search data */
     if (obj->playlist_visible) {
         FreeVec(obj->playlist_visible);
         obj->playlist_visible = NULL;
     }
+    obj->playlist_visible_words = 0;
+    InvalidateSearchMatches(obj);
 
-    obj->playlist_head = NULL;
+    obj->playlist = NULL;
+    obj->playlist_strings = NULL;
     obj->current_entry = NULL;
     obj->playlist_count = 0;
+    obj->playlist_capacity = 0;
     obj->current_index = 0;
     obj->search_current_match = 0;
     obj->search_total_matches = 0;
 }
 
-void
-APP_UpdatePlaylistDisplay(void)
+/* Build the playlist row text for entry into list_string (at least
+ * PLAYLIST_ROW_TEXT bytes). Called by the display hook for every row MUI
+ * draws, so it stays quiet and allocation-free. */
+void FormatPlaylistLine(PlaylistEntry *entry, STRPTR list_string)
 {
-    PlaylistEntry *entry;
-    ULONG i;
+    char *basename = FilePart(entry->filename);
 
-    if (!objApp || !objApp->LSV_PlaylistList) return;
+    /* Read values safely into local int variables */
+    int entry_subsongs = (int)entry->subsongs;
+    int entry_current = (int)entry->current_subsong;
+    int entry_duration = (int)entry->duration;
 
-    U64_DEBUG("=== APP_UpdatePlaylistDisplay FIXED START ===");
+    /* Validate values */
+    if (entry_subsongs <= 0) {
+        entry_subsongs = 1;
+    }
+    if (entry_current < 0 || entry_current >= entry_subsongs) {
+        entry_current = 0;
+    }
 
-    /* Clear list first */
-    set(objApp->LSV_PlaylistList, MUIA_List_Quiet, TRUE);
-    DoMethod(objApp->LSV_PlaylistList, MUIM_List_Clear);
+    /* Remove .sid extension for cleaner display */
+    char clean_name[256];
+    strncpy(clean_name, basename, sizeof(clean_name) - 1);
+    clean_name[sizeof(clean_name) - 1] = '\0';
+    char *dot = strrchr(clean_name, '.');
+    if (dot && stricmp(dot, ".sid") == 0) {
+        *dot = '\0';
+    }
 
-    if (objApp->playlist_count == 0) {
-        set(objApp->LSV_PlaylistList, MUIA_List_Quiet, FALSE);
-        U64_DEBUG("Playlist is empty");
-        return;
+    /* Use title if available, otherwise use cleaned filename */
+    char *display_name;
+    if (entry->title && strlen(entry->title) > 0) {
+        display_name = entry->title;
+    } else {
+        display_name = clean_name;
     }
 
-    /* Add entries one by one to the list */
-    entry = objApp->playlist_head;
-    for (i = 0; i < objApp->playlist_count && entry; i++) {
-        char *basename = FilePart(entry->filename);
+    /* Build display string manually without sprintf */
+    list_string[0] = '\0';
+    if (entry->is_favourite) {
+        strcpy(list_string, "* ");
+    }
+    strcat(list_string, display_name);
+
+    if (entry_subsongs > 1) {
+        /* Add subsong info: " [1/12]" */
+        strcat(list_string, " [");
+
+        /* Add current subsong number (1-based) */
+        int display_current = entry_current + 1;
+        if (display_current < 10) {
+            char c = '0' + display_current;
+            strncat(list_string, &c, 1);
+        } else if (display_current < 100) {
+            char temp[3];
+            temp[0] = '0' + (display_current / 10);
+            temp[1] = '0' + (display_current % 10);
+            temp[2] = '\0';
+            strcat(list_string, temp);
+        } else {
+            strcat(list_string, "99+"); /* Fallback for very high numbers */
+        }
 
-        U64_DEBUG("=== PROCESSING ENTRY %d ===", (int)i);
-        U64_DEBUG("Entry address: %p", entry);
-        U64_DEBUG("Filename: %s", basename);
+        strcat(list_string, "/");
 
-        /* Read values safely into local int variables */
-        int entry_subsongs = (int)entry->subsongs;
-        int entry_current = (int)entry->current_subsong;
-        int entry_duration = (int)entry->duration;
+        /* Add total subsongs */
+        if (entry_subsongs < 10) {
+            char c = '0' + entry_subsongs;
+            strncat(list_string, &c, 1);
+        } else if (entry_subsongs < 100) {
+            char temp[3];
+            temp[0] = '0' + (entry_subsongs / 10);
+            temp[1] = '0' + (entry_subsongs % 10);
+            temp[2] = '\0';
+            strcat(list_string, temp);
+        } else {
+            strcat(list_string, "99+"); /* Fallback */
+        }
 
-        U64_DEBUG("Raw entry values: subsongs=%d, current=%d, duration=%d",
-                  entry_subsongs, entry_current, entry_duration);
+        strcat(list_string, "] ");
 
-        /* Validate values */
-        if (entry_subsongs <= 0) {
-            entry_subsongs = 1;
-            U64_DEBUG("WARNING: Fixed subsongs to 1");
-        }
-        if (entry_current < 0 || entry_current >= entry_subsongs) {
-            entry_current = 0;
-            U64_DEBUG("WARNING: Fixed current subsong to 0");
+        /* Get duration for current subsong */
+        ULONG current_duration = FindSongLength(objApp, entry->md5, entry_current);
+        if (current_duration == 0) {
+            current_duration = (ULONG)entry_duration;
+            if (current_duration == 0) {
+                current_duration = DEFAULT_SONG_LENGTH;
+            }
         }
 
-        /* Remove .sid extension for cleaner display */
-        char clean_name[256];
-        strncpy(clean_name, basename, sizeof(clean_name) - 1);
-        clean_name[sizeof(clean_name) - 1] = '\0';
-        char *dot = strrchr(clean_name, '.');
-        if (dot && stricmp(dot, ".sid") == 0) {
-            *dot = '\0';
-        }
+        /* Add time manually */
+        int minutes = (int)(current_duration / 60);
+        int seconds = (int)(current_duration % 60);
 
-        /* Use title if available, otherwise use cleaned filename */
-        char *display_name;
-        if (entry->title && strlen(entry->title) > 0) {
-            display_name = entry->title;
+        /* Add minutes */
+        if (minutes < 10) {
+            char c = '0' + minutes;
+            strncat(list_string, &c, 1);
         } else {
-            display_name = clean_name;
+            char temp[3];
+            temp[0] = '0' + (minutes / 10);
+            temp[1] = '0' + (minutes % 10);
+            temp[2] = '\0';
+            strcat(list_string, temp);
         }
 
-        /* Allocate display string on heap */
-        STRPTR list_string = AllocVec(512, MEMF_PUBLIC | MEMF_CLEAR);
-        if (!list_string) {
-            U64_DEBUG("ERROR: Failed to allocate display string");
-            entry = entry->next;
-            continue;
-        }
+        strcat(list_string, ":");
 
-        /* Build display string manually without sprintf */
-        list_string[0] = '\0';
-        if (entry->is_favourite) {
-            strcpy(list_string, "* ");
+        /* Add seconds (always 2 digits) */
+        char temp[3];
+        temp[0] = '0' + (seconds / 10);
+        temp[1] = '0' + (seconds % 10);
+        temp[2] = '\0';
+        strcat(list_string, temp);
+    } else {
+        /* Single subsong: show just time */
+        ULONG duration = (ULONG)entry_duration;
+        if (duration == 0) {
+            duration = FindSongLength(objApp, entry->md5, 0);
+            if (duration == 0) {
+                duration = DEFAULT_SONG_LENGTH;
+            }
         }
-        strcat(list_string, display_name);
-
-        if (entry_subsongs > 1) {
-            /* Add subsong info: " [1/12]" */
-            strcat(list_string, " [");
 
-            /* Add current subsong number (1-based) */
-            int display_current = entry_current + 1;
-            if (display_current < 10) {
-                char c = '0' + display_current;
-                strncat(list_string, &c, 1);
-            } else if (display_current < 100) {
-                char temp[3];
-                temp[0] = '0' + (display_current / 10);
-                temp[1] = '0' + (display_current % 10);
-                temp[2] = '\0';
-                strcat(list_string, temp);
-            } else {
-                strcat(list_string, "99+"); /* Fallback for very high numbers */
-            }
+        strcat(list_string, " - ");
 
-            strcat(list_string, "/");
+        /* Add time manually */
+        int minutes = (int)(duration / 60);
+        int seconds = (int)(duration % 60);
 
-            /* Add total subsongs */
-            if (entry_subsongs < 10) {
-                char c = '0' + entry_subsongs;
-                strncat(list_string, &c, 1);
-            } else if (entry_subsongs < 100) {
-                char temp[3];
-                temp[0] = '0' + (entry_subsongs / 10);
-                temp[1] = '0' + (entry_subsongs % 10);
-                temp[2] = '\0';
-                strcat(list_string, temp);
-            } else {
-                strcat(list_string, "99+"); /* Fallback */
-            }
+        /* Add minutes */
+        if (minutes < 10) {
+            char c = '0' + minutes;
+            strncat(list_string, &c, 1);
+        } else {
+            char temp[3];
+            temp[0] = '0' + (minutes / 10);
+            temp[1] = '0' + (minutes % 10);
+            temp[2] = '\0';
+            strcat(list_string, temp);
+        }
 
-            strcat(list_string, "] ");
+        strcat(list_string, ":");
 
-            /* Get duration for current subsong */
-            ULONG current_duration = FindSongLength(objApp, entry->md5, entry_current);
-            if (current_duration == 0) {
-                current_duration = (ULONG)entry_duration;
-                if (current_duration == 0) {
-                    current_duration = DEFAULT_SONG_LENGTH;
-                }
-            }
+        /* Add seconds (always 2 digits) */
+        char temp[3];
+        temp[0] = '0' + (seconds / 10);
+        temp[1] = '0' + (seconds % 10);
+        temp[2] = '\0';
+        strcat(list_string, temp);
+    }
+}
 
-            /* Add time manually */
-            int minutes = (int)(current_duration / 60);
-            int seconds = (int)(current_duration % 60);
+/* Playlist view. The list holds no text of its own: each row is a token
+ * naming a playlist index (PLAYLIST_ROW) and the display hook formats that
+ * entry into one reused buffer whenever MUI draws the row, so only rows on
+ * screen get formatted and nothing is allocated per row. */
 
-            /* Add minutes */
-            if (minutes < 10) {
-                char c = '0' + minutes;
-                strncat(list_string, &c, 1);
-            } else {
-                char temp[3];
-                temp[0] = '0' + (minutes / 10);
-                temp[1] = '0' + (minutes % 10);
-                temp[2] = '\0';
-                strcat(list_string, temp);
-            }
+static char playlist_row_text[PLAYLIST_ROW_TEXT];
 
-            strcat(list_string, ":");
+HOOKPROTONH(PlaylistDisplayFunc, VOID, char **array, APTR row)
+{
+    ULONG index = PLAYLIST_ROW_INDEX(row);
 
-            /* Add seconds (always 2 digits) */
-            char temp[3];
-            temp[0] = '0' + (seconds / 10);
-            temp[1] = '0' + (seconds % 10);
-            temp[2] = '\0';
-            strcat(list_string, temp);
-        } else {
-            /* Single subsong: show just time */
-            ULONG duration = (ULONG)entry_duration;
-            if (duration == 0) {
-                duration = FindSongLength(objApp, entry->md5, 0);
-                if (duration == 0) {
-                    duration = DEFAULT_SONG_LENGTH;
-                }
-            }
+    if (row && objApp && index < objApp->playlist_count) {
+        FormatPlaylistLine(&objApp->playlist[index], playlist_row_text);
+        *array = playlist_row_text;
+    } else {
+        *array = (STRPTR)"";
+    }
+}
+MakeHook(PlaylistDisplayHook, PlaylistDisplayFunc);
 
-            strcat(list_string, " - ");
+/* Append rows for playlist entries first..playlist_count-1 in one insert,
+ * leaving the rows above alone. */
+void
+APP_AppendPlaylistRows(ULONG first)
+{
+    struct ObjApp *obj = objApp;
+    ULONG count;
+    APTR *rows;
+    ULONG i;
 
-            /* Add time manually */
-            int minutes = (int)(duration / 60);
-            int seconds = (int)(duration % 60);
+    if (!obj || !obj->LSV_PlaylistList || first >= obj->playlist_count) return;
+    count = obj->playlist_count - first;
 
-            /* Add minutes */
-            if (minutes < 10) {
-                char c = '0' + minutes;
-                strncat(list_string, &c, 1);
-            } else {
-                char temp[3];
-                temp[0] = '0' + (minutes / 10);
-                temp[1] = '0' + (minutes % 10);
-                temp[2] = '\0';
-                strcat(list_string, temp);
-            }
+    rows = AllocVec(count * sizeof(APTR), MEMF_PUBLIC);
+    if (!rows) {
+        for (i = first; i < obj->playlist_count; i++) {
+            DoMethod(obj->LSV_PlaylistList, MUIM_List_InsertSingle, PLAYLIST_ROW(i),
+                     MUIV_List_Insert_Bottom);
+        }
+        return;
+    }
+    for (i = 0; i < count; i++) rows[i] = PLAYLIST_ROW(first + i);
+    DoMethod(obj->LSV_PlaylistList, MUIM_List_Insert, rows, count, MUIV_List_Insert_Bottom);
+    FreeVec(rows);
+}
 
-            strcat(list_string, ":");
+/* Bring the view in line with the playlist. Rows are indices, so after a
+ * sort or removal the rows that are kept only need redrawing; rows are
+ * added or dropped at the bottom. A filtered view (search.c) is replaced
+ * by the full one. */
+void
+APP_UpdatePlaylistDisplay(void)
+{
+    struct ObjApp *obj = objApp;
+    LONG rows = 0;
+    APTR last = NULL;
 
-            /* Add seconds (always 2 digits) */
-            char temp[3];
-            temp[0] = '0' + (seconds / 10);
-            temp[1] = '0' + (seconds % 10);
-            temp[2] = '\0';
-            strcat(list_string, temp);
-        }
+    if (!obj || !obj->LSV_PlaylistList) return;
 
-        U64_DEBUG("Final display string: '%s'", list_string);
+    get(obj->LSV_PlaylistList, MUIA_List_Entries, &rows);
+    if (rows > 0) {
+        DoMethod(obj->LSV_PlaylistList, MUIM_List_GetEntry, rows - 1, &last);
+    }
 
-        /* Add to MUI list */
-        DoMethod(objApp->LSV_PlaylistList, MUIM_List_InsertSingle, list_string,
-                 MUIV_List_Insert_Bottom);
+    set(obj->LSV_PlaylistList, MUIA_List_Quiet, TRUE);
 
-        U64_DEBUG("=== END ENTRY %d ===", (int)i);
-        entry = entry->next;
+    /* Filtered rows are increasing indices, so the last row naming entry
+     * rows-1 means every row is its own index. Dropping most of the list
+     * is quicker as a rebuild. */
+    if (rows > 0 && (last != PLAYLIST_ROW(rows - 1)
+                     || (ULONG)rows > 2 * obj->playlist_count)) {
+        DoMethod(obj->LSV_PlaylistList, MUIM_List_Clear);
+        rows = 0;
+    }
+    while ((ULONG)rows > obj->playlist_count) {
+        DoMethod(obj->LSV_PlaylistList, MUIM_List_Remove, MUIV_List_Remove_Last);
+        rows--;
     }
+    APP_AppendPlaylistRows((ULONG)rows);
 
-    set(objApp->LSV_PlaylistList, MUIA_List_Quiet, FALSE);
+    set(obj->LSV_PlaylistList, MUIA_List_Quiet, FALSE);
+    if (rows > 0) {
+        DoMethod(obj->LSV_PlaylistList, MUIM_List_Redraw, MUIV_List_Redraw_All);
+    }
 
     /* Highlight current entry */
-    if (objApp->current_entry) {
-        set(objApp->LSV_PlaylistList, MUIA_List_Active, objApp->current_index);
+    if (obj->current_entry) {
+        set(obj->LSV_PlaylistList, MUIA_List_Active, obj->current_index);
     }
+}
 
-    U64_DEBUG("=== APP_UpdatePlaylistDisplay FIXED END ===");
+/* Redraw just the row showing entry index, after that entry changed. */
+void
+APP_RedrawPlaylistRow(ULONG index)
+{
+    LONG rows = 0;
+
+    if (!objApp || !objApp->LSV_PlaylistList || index >= objApp->playlist_count) return;
+
+    if (objApp->search_mode_filter && objApp->search_text[0]) {
+        /* Row numbers aren't indices in a filtered view */
+        DoMethod(objApp->LSV_PlaylistList, MUIM_List_Redraw, MUIV_List_Redraw_All);
+        return;
+    }
+
+    get(objApp->LSV_PlaylistList, MUIA_List_Entries, &rows);
+    if (index < (ULONG)rows) {
+        DoMethod(objApp->LSV_PlaylistList, MUIM_List_Redraw, index);
+    }
 }
@@ -0,0 +1,276 @@
+#include <dos/dos.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "player.h"      /* for MD5Compare */
+#include "playstats.h"
+
+#define PLAYSTATS_MIN_CAPACITY  256     /* records */
+#define PLAYSTATS_IO_RECORDS    64      /* records per Read batch */
+
+static ULONG
+playstats_home(const UBYTE md5[16], ULONG slot_count)
+{
+    ULONG h = ((ULONG)md5[0] << 24) | ((ULONG)md5[1] << 16)
+            | ((ULONG)md5[2] << 8) | md5[3];
+    return h & (slot_count - 1);
+}
+
+/* Slot for md5: the one pointing at its record, or the empty slot where
+ * it would go. Records are never removed, so there are no tombstones. */
+static ULONG
+playstats_slot(struct PlayStatsDB *db, const UBYTE md5[16])
+{
+    ULONG mask = db->slot_count - 1;
+    ULONG i = playstats_home(md5, db->slot_count);
+
+    while (db->slots[i]
+           && !MD5Compare(db->records[db->slots[i] - 1].md5, md5)) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/* Room for one more record: grow the array, and the slot table so it
+ * stays at most half full. */
+static BOOL
+playstats_reserve(struct PlayStatsDB *db)
+{
+    if (db->count >= db->capacity) {
+        ULONG new_capacity = db->capacity ? db->capacity * 2 : PLAYSTATS_MIN_CAPACITY;
+        PlayStats *grown = AllocVec(new_capacity * sizeof(PlayStats), MEMF_PUBLIC);
+        if (!grown) return FALSE;
+        if (db->records) {
+            CopyMem(db->records, grown, db->count * sizeof(PlayStats));
+            FreeVec(db->records);
+        }
+        db->records = grown;
+        db->capacity = new_capacity;
+    }
+
+    if ((db->count + 1) * 2 > db->slot_count) {
+        ULONG new_slots = db->slot_count ? db->slot_count * 2 : PLAYSTATS_MIN_CAPACITY * 2;
+        ULONG *table = AllocVec(new_slots * sizeof(ULONG), MEMF_PUBLIC | MEMF_CLEAR);
+        if (!table) return FALSE;
+        if (db->slots) FreeVec(db->slots);
+        db->slots = table;
+        db->slot_count = new_slots;
+        for (ULONG r = 0; r < db->count; r++) {
+            db->slots[playstats_slot(db, db->records[r].md5)] = r + 1;
+        }
+    }
+    return TRUE;
+}
+
+/* Record for md5, created zeroed if missing. NULL when out of memory. */
+static PlayStats *
+playstats_get(struct PlayStatsDB *db, const UBYTE md5[16])
+{
+    PlayStats *rec = PlayStats_Find(db, md5);
+    if (rec) return rec;
+
+    if (!playstats_reserve(db)) return NULL;
+    rec = &db->records[db->count];
+    memset(rec, 0, sizeof(PlayStats));
+    CopyMem((APTR)md5, rec->md5, 16);
+    db->slots[playstats_slot(db, md5)] = ++db->count;
+    return rec;
+}
+
+static BOOL
+playstats_wasteful(struct PlayStatsDB *db, ULONG records)
+{
+    return records >= PLAYSTATS_COMPACT_MIN
+        && records > db->count * PLAYSTATS_COMPACT_RATIO;
+}
+
+/* Rewrite the journal as one record per SID via a temporary file. */
+static BOOL
+playstats_compact(struct PlayStatsDB *db)
+{
+    char tmp[520];
+    LONG len = db->count * sizeof(PlayStats);
+    BOOL ok;
+
+    sprintf(tmp, "%s.new", db->path);
+    BPTR file = Open(tmp, MODE_NEWFILE);
+    if (!file) return FALSE;
+
+    ok = Write(file, PLAYSTATS_MAGIC, PLAYSTATS_MAGIC_SIZE) == PLAYSTATS_MAGIC_SIZE
+      && (len == 0 || Write(file, db->records, len) == len);
+    Close(file);
+
+    if (!ok) {
+        DeleteFile(tmp);
+        return FALSE;
+    }
+
+    DeleteFile(db->path);
+    if (!Rename(tmp, db->path)) return FALSE;
+
+    db->journal_records = db->count;
+    db->dirty = FALSE;
+    U64_DEBUG("PlayStats: compacted %s to %lu records",
+              db->path, (unsigned long)db->count);
+    return TRUE;
+}
+
+/* Append rec to the journal, or compact instead once that pays off. */
+static void
+playstats_journal(struct PlayStatsDB *db, const PlayStats *rec)
+{
+    if (!db->path[0]) return;
+    if (db->dirty || playstats_wasteful(db, db->journal_records + 1)) {
+        if (!playstats_compact(db)) db->dirty = TRUE;
+        return;
+    }
+
+    BPTR file = Open(db->path, MODE_READWRITE);
+    if (!file) {
+        db->dirty = TRUE;
+        return;
+    }
+    Seek(file, 0, OFFSET_END);
+    if (Write(file, (APTR)rec, sizeof(PlayStats)) == sizeof(PlayStats)) {
+        db->journal_records++;
+    } else {
+        db->dirty = TRUE;
+    }
+    Close(file);
+}
+
+struct PlayStatsDB *
+PlayStats_Create(void)
+{
+    return AllocVec(sizeof(struct PlayStatsDB), MEMF_PUBLIC | MEMF_CLEAR);
+}
+
+void
+PlayStats_Free(struct PlayStatsDB *db)
+{
+    if (!db) return;
+    if (db->records) FreeVec(db->records);
+    if (db->slots) FreeVec(db->slots);
+    FreeVec(db);
+}
+
+PlayStats *
+PlayStats_Find(struct PlayStatsDB *db, const UBYTE md5[16])
+{
+    ULONG slot;
+
+    if (!db || !db->slots) return NULL;
+    slot = playstats_slot(db, md5);
+    return db->slots[slot] ? &db->records[db->slots[slot] - 1] : NULL;
+}
+
+void
+PlayStats_Started(struct PlayStatsDB *db, const UBYTE md5[16])
+{
+    struct DateStamp now;
+    PlayStats *rec;
+
+    if (!db || !(rec = playstats_get(db, md5))) return;
+
+    DateStamp(&now);
+    if (rec->plays < 0xFFFF) rec->plays++;
+    rec->last_played = (ULONG)now.ds_Days * 1440 + now.ds_Minute;
+    playstats_journal(db, rec);
+}
+
+void
+PlayStats_Ended(struct PlayStatsDB *db, const UBYTE md5[16],
+                ULONG listened, ULONG length_secs, ULONG reason)
+{
+    PlayStats *rec;
+
+    if (!db || !(rec = playstats_get(db, md5))) return;
+
+    rec->listened += listened;
+    if (length_secs > 0 && reason != PLAYSTATS_END_SUBSONG) {
+        if (listened * 100 < length_secs * PLAYSTATS_SKIP_PERCENT) {
+            if (reason == PLAYSTATS_END_NEXT && rec->skips < 0xFFFF) rec->skips++;
+        } else if (listened * 100 >= length_secs * PLAYSTATS_FINISH_PERCENT) {
+            if (rec->finishes < 0xFFFF) rec->finishes++;
+        }
+    }
+    playstats_journal(db, rec);
+}
+
+ULONG
+PlayStats_Weight(struct PlayStatsDB *db, const UBYTE md5[16])
+{
+    PlayStats *rec = PlayStats_Find(db, md5);
+    LONG weight = PLAYSTATS_WEIGHT_DEFAULT;
+
+    if (!rec) return PLAYSTATS_WEIGHT_DEFAULT;
+
+    weight += rec->finishes > 8 ? 8 : rec->finishes;
+    weight -= rec->skips > 8 ? 16 : rec->skips * 2;
+    if (weight < 1) weight = 1;
+    if (weight > PLAYSTATS_WEIGHT_MAX) weight = PLAYSTATS_WEIGHT_MAX;
+    return (ULONG)weight;
+}
+
+BOOL
+PlayStats_Load(struct PlayStatsDB *db, CONST_STRPTR path)
+{
+    PlayStats buf[PLAYSTATS_IO_RECORDS];
+    char magic[PLAYSTATS_MAGIC_SIZE];
+    LONG got;
+
+    if (!db || !path || strlen(path) >= sizeof(db->path)) return FALSE;
+    strcpy(db->path, path);
+
+    BPTR file = Open(path, MODE_OLDFILE);
+    if (!file) {
+        /* Nothing to append to yet; the first change writes the header */
+        db->dirty = TRUE;
+        return TRUE;                    /* missing file is not an error */
+    }
+
+    if (Read(file, magic, PLAYSTATS_MAGIC_SIZE) != PLAYSTATS_MAGIC_SIZE
+        || memcmp(magic, PLAYSTATS_MAGIC, PLAYSTATS_MAGIC_SIZE) != 0) {
+        Close(file);
+        db->dirty = TRUE;
+        return FALSE;
+    }
+
+    while ((got = Read(file, buf, sizeof(buf))) > 0) {
+        LONG n = got / sizeof(PlayStats);
+
+        for (LONG r = 0; r < n; r++) {
+            PlayStats *rec = playstats_get(db, buf[r].md5);
+            if (!rec) break;
+            CopyMem(&buf[r], rec, sizeof(PlayStats));
+            db->journal_records++;
+        }
+        if (got % sizeof(PlayStats)) {
+            /* Torn last record from a crash mid-append */
+            db->dirty = TRUE;
+            break;
+        }
+    }
+    Close(file);
+
+    if (db->dirty || playstats_wasteful(db, db->journal_records)) {
+        playstats_compact(db);
+    }
+    return TRUE;
+}
+
+BOOL
+PlayStats_Flush(struct PlayStatsDB *db)
+{
+    if (!db || !db->path[0]) return FALSE;
+    if (db->dirty || playstats_wasteful(db, db->journal_records)) {
+        return playstats_compact(db);
+    }
+    return TRUE;
+}
@@ -0,0 +1,103 @@
+/* Per-SID play statistics keyed by MD5, backed by an append-only journal.
+ *
+ * One fixed 32-byte PlayStats record per SID that has ever been played:
+ * how often it was started, skipped early and played to (nearly) the end,
+ * how long it was listened to in total and when it last played. Records
+ * live in one growable array, found through an open-addressing table of
+ * array indices so a 60,000-track history costs two allocations.
+ *
+ * Journal layout:
+ *   "U64STAT1"                     8-byte magic
+ *   PlayStats*                     full record after each change; the last
+ *                                  one for an MD5 wins on replay
+ *
+ * Each change appends its record, so saving is never a rewrite. When the
+ * journal holds several times more records than there are SIDs it is
+ * compacted (rewritten as one record per SID and renamed into place).
+ */
+
+#ifndef U64_PLAYSTATS_H
+#define U64_PLAYSTATS_H
+
+#include <exec/types.h>
+
+#define PLAYSTATS_MAGIC         "U64STAT1"
+#define PLAYSTATS_MAGIC_SIZE    8
+
+/* Next pressed before this share of the length counts as a skip, reaching
+ * this one as finished (percent) */
+#define PLAYSTATS_SKIP_PERCENT      30
+#define PLAYSTATS_FINISH_PERCENT    90
+
+/* Compact once the journal has this many records and PLAYSTATS_COMPACT_RATIO
+ * times as many as there are SIDs (every play appends two) */
+#define PLAYSTATS_COMPACT_MIN       256
+#define PLAYSTATS_COMPACT_RATIO     4
+
+/* Why a play ended, for PlayStats_Ended */
+enum
+{
+    PLAYSTATS_END_OTHER,            /* ran out, Stop, quit, another picked */
+    PLAYSTATS_END_NEXT,             /* the user pressed Next */
+    PLAYSTATS_END_SUBSONG           /* moved on to another subsong of it */
+};
+
+/* Shuffle weight of a SID with no history; see PlayStats_Weight */
+#define PLAYSTATS_WEIGHT_DEFAULT    8
+#define PLAYSTATS_WEIGHT_MAX        16
+
+typedef struct PlayStats
+{
+    UBYTE md5[16];
+    UWORD plays;                    /* times started */
+    UWORD skips;                    /* Next before PLAYSTATS_SKIP_PERCENT */
+    UWORD finishes;                 /* reached PLAYSTATS_FINISH_PERCENT */
+    UWORD reserved;
+    ULONG listened;                 /* seconds, all plays together */
+    ULONG last_played;              /* minutes since 1.1.1978, 0 = never */
+} PlayStats;
+
+struct PlayStatsDB
+{
+    PlayStats *records;             /* count used out of capacity */
+    ULONG count;
+    ULONG capacity;
+    ULONG *slots;                   /* record index + 1, 0 = empty */
+    ULONG slot_count;               /* power of two, >= 2 * count */
+    ULONG journal_records;          /* records currently in the file */
+    BOOL  dirty;                    /* file must be rewritten to match */
+    char  path[512];                /* journal; empty = memory only */
+};
+
+/* Allocate an empty database. Caller frees with PlayStats_Free. */
+struct PlayStatsDB *PlayStats_Create(void);
+
+/* Destroy a database; NULL is safe. Does not touch the journal. */
+void PlayStats_Free(struct PlayStatsDB *db);
+
+/* Replay the journal at path and keep appending changes to it. A missing
+ * file just gives an empty database. */
+BOOL PlayStats_Load(struct PlayStatsDB *db, CONST_STRPTR path);
+
+/* Compact the journal if it is damaged, out of date or mostly superseded
+ * records. Returns TRUE if the file is current. */
+BOOL PlayStats_Flush(struct PlayStatsDB *db);
+
+/* Record for md5, or NULL if it has never been played. NULL db = NULL. */
+PlayStats *PlayStats_Find(struct PlayStatsDB *db, const UBYTE md5[16]);
+
+/* A play of md5 started now. */
+void PlayStats_Started(struct PlayStatsDB *db, const UBYTE md5[16]);
+
+/* A play of md5 ended after listened seconds of a length_secs long tune,
+ * for reason (PLAYSTATS_END_*). Counts as finished by how far it got, and
+ * as skipped only if it was Next that cut it short. A subsong change only
+ * adds the listening time; the play goes on. */
+void PlayStats_Ended(struct PlayStatsDB *db, const UBYTE md5[16],
+                     ULONG listened, ULONG length_secs, ULONG reason);
+
+/* Relative shuffle weight, 1..PLAYSTATS_WEIGHT_MAX: tunes that get played
+ * through come up more often, ones that keep being skipped less. */
+ULONG PlayStats_Weight(struct PlayStatsDB *db, const UBYTE md5[16]);
+
+#endif
@@ -0,0 +1,329 @@
+/* Ultimate64 SID Player - binary playlist format
+ * For Amiga OS 3.x by Marcin Spoczynski
+ *
+ * Everything the text format makes LoadPlaylistFromFile work out again on
+ * every load (unescaping, hex MD5s, search keys, song lengths) is stored
+ * ready to use, so loading is a header check, one Read of the records and
+ * duration table, one Read of the strings straight into the playlist pool
+ * and a pointer fix-up per entry. Written in native (big-endian) order.
+ *
+ *   PlaylistBinHeader
+ *   PlaylistBinRecord[count]
+ *   UWORD durations[duration_count]   seconds per subsong, 0 = unknown
+ *   char  pool[pool_size]             NUL-terminated strings
+ *
+ * Records point into the pool by byte offset and into the duration table
+ * by index; each record owns subsongs consecutive durations. Entries the
+ * resolver hadn't got to yet are saved as they are and queued again on
+ * load.
+ */
+
+#include <dos/dos.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "player.h"
+#include "md5set.h"
+#include "strpool.h"
+
+#define PLAYLIST_BIN_MAGIC      "U64PLB01"
+#define PLAYLIST_BIN_VERSION    1
+#define PLAYLIST_BIN_NO_STRING  ((ULONG)~0)
+
+#define PLAYLIST_BIN_FAVOURITE  0x0001
+#define PLAYLIST_BIN_PENDING    0x0002
+
+typedef struct PlaylistBinHeader {
+    char   magic[8];
+    ULONG  version;
+    ULONG  count;
+    ULONG  record_size;             /* sizeof(PlaylistBinRecord) */
+    ULONG  duration_count;
+    ULONG  pool_size;
+    ULONG  current_index;
+} PlaylistBinHeader;
+
+typedef struct PlaylistBinRecord {
+    ULONG  filename;                /* pool offsets */
+    ULONG  title;
+    ULONG  search_key;
+    ULONG  durations;               /* first index into the duration table */
+    UBYTE  md5[MD5_HASH_SIZE];
+    UWORD  subsongs;
+    UWORD  current_subsong;
+    UWORD  flags;
+    UWORD  reserved;
+} PlaylistBinRecord;
+
+/* TRUE if filename starts with the binary playlist magic. */
+BOOL IsPlaylistBinary(CONST_STRPTR filename)
+{
+    char magic[8];
+    BOOL binary = FALSE;
+
+    BPTR file = Open(filename, MODE_OLDFILE);
+    if (!file) return FALSE;
+    if (Read(file, magic, 8) == 8) {
+        binary = memcmp(magic, PLAYLIST_BIN_MAGIC, 8) == 0;
+    }
+    Close(file);
+    return binary;
+}
+
+/* Pool bytes taken by s, NUL included; 0 for a missing string. */
+static ULONG
+PoolSize(CONST_STRPTR s)
+{
+    return s ? strlen(s) + 1 : 0;
+}
+
+static ULONG
+PoolPlace(CONST_STRPTR s, ULONG *pool_size)
+{
+    ULONG offset;
+
+    if (!s) return PLAYLIST_BIN_NO_STRING;
+    offset = *pool_size;
+    *pool_size += PoolSize(s);
+    return offset;
+}
+
+BOOL SavePlaylistBinary(struct ObjApp *obj, CONST_STRPTR filename)
+{
+    PlaylistBinHeader hdr;
+    PlaylistBinRecord rec;
+    ULONG pool_size = 0, duration_count = 0;
+    ULONG i;
+    UWORD s;
+    BOOL ok = TRUE;
+
+    BPTR file = Open(filename, MODE_NEWFILE);
+    if (!file) {
+        APP_UpdateStatus("Failed to create playlist file");
+        return FALSE;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    CopyMem((APTR)PLAYLIST_BIN_MAGIC, hdr.magic, 8);
+    hdr.version = PLAYLIST_BIN_VERSION;
+    hdr.count = obj->playlist_count;
+    hdr.record_size = sizeof(PlaylistBinRecord);
+    hdr.current_index = obj->current_index;
+    for (i = 0; i < obj->playlist_count; i++) {
+        PlaylistEntry *e = &obj->playlist[i];
+        duration_count += e->subsongs;
+        pool_size += PoolSize(e->filename) + PoolSize(e->title)
+                   + PoolSize(e->search_key);
+    }
+    hdr.duration_count = duration_count;
+    hdr.pool_size = pool_size;
+
+    /* Buffered from here on: three small writes per entry otherwise */
+    if (FWrite(file, &hdr, sizeof(hdr), 1) != 1) ok = FALSE;
+
+    pool_size = 0;
+    duration_count = 0;
+    for (i = 0; ok && i < obj->playlist_count; i++) {
+        PlaylistEntry *e = &obj->playlist[i];
+
+        memset(&rec, 0, sizeof(rec));
+        rec.filename = PoolPlace(e->filename, &pool_size);
+        rec.title = PoolPlace(e->title, &pool_size);
+        rec.search_key = PoolPlace(e->search_key, &pool_size);
+        rec.durations = duration_count;
+        CopyMem(e->md5, rec.md5, MD5_HASH_SIZE);
+        rec.subsongs = e->subsongs;
+        rec.current_subsong = e->current_subsong;
+        if (e->is_favourite) rec.flags |= PLAYLIST_BIN_FAVOURITE;
+        if (e->pending) rec.flags |= PLAYLIST_BIN_PENDING;
+        duration_count += e->subsongs;
+
+        if (FWrite(file, &rec, sizeof(rec), 1) != 1) ok = FALSE;
+    }
+
+    for (i = 0; ok && i < obj->playlist_count; i++) {
+        PlaylistEntry *e = &obj->playlist[i];
+
+        for (s = 0; s < e->subsongs; s++) {
+            ULONG secs = e->pending ? 0 : FindSongLength(obj, e->md5, s);
+            UWORD d = secs > 0xFFFF ? 0xFFFF : (UWORD)secs;
+            if (FWrite(file, &d, 2, 1) != 1) {
+                ok = FALSE;
+                break;
+            }
+        }
+    }
+
+    for (i = 0; ok && i < obj->playlist_count; i++) {
+        PlaylistEntry *e = &obj->playlist[i];
+        CONST_STRPTR strings[3];
+        int k;
+
+        strings[0] = e->filename;
+        strings[1] = e->title;
+        strings[2] = e->search_key;
+        for (k = 0; k < 3; k++) {
+            ULONG len = PoolSize(strings[k]);
+            if (len && FWrite(file, (APTR)strings[k], len, 1) != 1) ok = FALSE;
+        }
+    }
+
+    if (!Close(file)) ok = FALSE;
+
+    if (!ok) {
+        DeleteFile(filename);
+        APP_UpdateStatus("Failed to write playlist file");
+        return FALSE;
+    }
+
+    static char status_msg[256];
+    sprintf(status_msg, "Saved %lu entries to playlist",
+            (unsigned long)obj->playlist_count);
+    APP_UpdateStatus(status_msg);
+    return TRUE;
+}
+
+/* Pointer for a pool offset, or NULL if it's missing or out of range. */
+static STRPTR
+PoolString(STRPTR pool, ULONG pool_size, ULONG offset)
+{
+    if (offset == PLAYLIST_BIN_NO_STRING || offset >= pool_size) return NULL;
+    return pool + offset;
+}
+
+BOOL LoadPlaylistBinary(struct ObjApp *obj, CONST_STRPTR filename)
+{
+    PlaylistBinHeader hdr;
+    PlaylistBinRecord *records = NULL;
+    UWORD *durations;
+    STRPTR pool = NULL;
+    ULONG meta_size, capacity, i;
+    BOOL any_pending = FALSE;
+
+    BPTR file = Open(filename, MODE_OLDFILE);
+    if (!file) {
+        APP_UpdateStatus("Failed to open playlist file");
+        return FALSE;
+    }
+
+    if (Read(file, &hdr, sizeof(hdr)) != sizeof(hdr)
+        || memcmp(hdr.magic, PLAYLIST_BIN_MAGIC, 8) != 0
+        || hdr.version != PLAYLIST_BIN_VERSION
+        || hdr.record_size != sizeof(PlaylistBinRecord)) {
+        Close(file);
+        APP_UpdateStatus("Unsupported playlist file");
+        return FALSE;
+    }
+
+    FreePlaylists(obj);
+    APP_UpdateStatus("Loading playlist...");
+
+    if (hdr.count == 0) {
+        Close(file);
+        goto done;
+    }
+
+    /* Records and durations in one Read, converted below */
+    meta_size = hdr.count * sizeof(PlaylistBinRecord) + hdr.duration_count * 2;
+    records = AllocVec(meta_size, MEMF_PUBLIC);
+    capacity = hdr.count > PLAYLIST_INITIAL_CAPACITY
+        ? hdr.count : PLAYLIST_INITIAL_CAPACITY;
+    obj->playlist = AllocVec(capacity * sizeof(PlaylistEntry), MEMF_PUBLIC | MEMF_CLEAR);
+    obj->playlist_strings = StrPool_Create();
+    if (hdr.pool_size > 0) {
+        pool = StrPool_Reserve(obj->playlist_strings, hdr.pool_size);
+    }
+    if (!records || !obj->playlist || (hdr.pool_size > 0 && !pool)) {
+        U64_DEBUG("Out of memory loading %lu playlist entries",
+                  (unsigned long)hdr.count);
+        goto fail;
+    }
+    obj->playlist_capacity = capacity;
+
+    /* ...and the strings in another, straight into the pool */
+    if (Read(file, records, meta_size) != (LONG)meta_size
+        || (hdr.pool_size > 0
+            && (Read(file, pool, hdr.pool_size) != (LONG)hdr.pool_size
+                || pool[hdr.pool_size - 1] != '\0'))) {
+        goto fail;
+    }
+    Close(file);
+    file = 0;
+
+    durations = (UWORD *)&records[hdr.count];
+    for (i = 0; i < hdr.count; i++) {
+        PlaylistBinRecord *rec = &records[i];
+        PlaylistEntry *entry = &obj->playlist[obj->playlist_count];
+
+        entry->filename = PoolString(pool, hdr.pool_size, rec->filename);
+        if (!entry->filename) continue;
+        entry->order = obj->playlist_next_order++;
+        entry->title = PoolString(pool, hdr.pool_size, rec->title);
+        entry->search_key = PoolString(pool, hdr.pool_size, rec->search_key);
+        CopyMem(rec->md5, entry->md5, MD5_HASH_SIZE);
+
+        entry->subsongs = rec->subsongs ? rec->subsongs : 1;
+        entry->current_subsong = rec->current_subsong;
+        if (entry->current_subsong >= entry->subsongs) {
+            entry->current_subsong = 0;
+        }
+
+        entry->duration = 0;
+        if (rec->current_subsong < rec->subsongs
+            && rec->durations + rec->subsongs <= hdr.duration_count) {
+            entry->duration = durations[rec->durations + entry->current_subsong];
+        }
+
+        entry->pending = (rec->flags & PLAYLIST_BIN_PENDING) != 0;
+        if (entry->pending) {
+            any_pending = TRUE;
+        } else if (entry->duration == 0) {
+            /* Unknown when saved; the database may have it by now */
+            entry->duration = FindSongLength(obj, entry->md5, entry->current_subsong);
+        }
+        if (entry->duration == 0) {
+            entry->duration = DEFAULT_SONG_LENGTH;
+        }
+
+        /* The favourites set wins when there is one; it may have changed */
+        entry->is_favourite = obj->favourites
+            ? (!entry->pending && MD5Set_Contains(obj->favourites, entry->md5))
+            : (rec->flags & PLAYLIST_BIN_FAVOURITE) != 0;
+
+        obj->playlist_count++;
+    }
+    FreeVec(records);
+
+done:
+    if (obj->playlist_count > 0 && !obj->current_entry) {
+        obj->current_index = hdr.current_index < obj->playlist_count
+            ? hdr.current_index : 0;
+        obj->current_entry = &obj->playlist[obj->current_index];
+        Resolver_ResolveNow(obj, obj->current_entry);
+        APP_UpdateCurrentSongCache();
+    }
+
+    APP_UpdatePlaylistDisplay();
+    APP_UpdateCurrentSongDisplay();
+    if (any_pending) Resolver_Kick(obj);
+
+    static char status_msg[256];
+    sprintf(status_msg, "Loaded %lu entries from playlist",
+            (unsigned long)obj->playlist_count);
+    APP_UpdateStatus(status_msg);
+    return TRUE;
+
+fail:
+    if (file) Close(file);
+    if (records) FreeVec(records);
+    FreePlaylists(obj);
+    APP_UpdatePlaylistDisplay();
+    APP_UpdateStatus("Failed to read playlist file");
+    return FALSE;
+}
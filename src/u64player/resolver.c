@@ -0,0 +1,366 @@
+/* Ultimate64 SID Player - background metadata resolver
+ * For Amiga OS 3.x by Marcin Spoczynski
+ *
+ * AddPlaylistEntryLazy inserts entries knowing only the file name. A
+ * low-priority child process reads those files in batches of
+ * RESOLVE_BATCH and works out MD5, title and subsong count; the main task
+ * applies each batch when it comes back, redraws just the affected rows
+ * and sends the next one. Anything that needs an entry's MD5 before then
+ * (playing it, hearting it, saving the playlist) resolves it on the spot
+ * with Resolver_ResolveNow.
+ *
+ * Only one batch is ever in flight, and the worker never touches the
+ * playlist: it gets copies of the file names and hands back plain data.
+ */
+
+#include <dos/dos.h>
+#include <dos/dosextens.h>
+#include <dos/dostags.h>
+#include <exec/memory.h>
+#include <exec/ports.h>
+#include <exec/types.h>
+#include <libraries/mui.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/intuition.h>
+#include <proto/muimaster.h>
+
+#include <string.h>
+
+#include "player.h"
+
+#define RESOLVE_BATCH       16
+#define RESOLVER_STACK      8192
+#define RESOLVER_PRIORITY   -1      /* below the UI, so it never stalls it */
+
+typedef struct ResolveItem {
+    STRPTR key;                     /* entry->filename when queued */
+    ULONG  index_hint;              /* where the entry was at the time */
+    BOOL   ok;
+    UWORD  subsongs;
+    UBYTE  md5[MD5_HASH_SIZE];
+    char   title[128];
+    char   filename[512];
+} ResolveItem;
+
+struct ResolveBatch {
+    struct Message msg;
+    ULONG  count;                   /* 0 asks the worker to exit */
+    ResolveItem items[RESOLVE_BATCH];
+};
+
+/* Main-task side, module-private like the timer state */
+static struct MsgPort      *ReplyPort   = NULL;
+static struct ResolveBatch *Batch       = NULL;
+static BOOL                 BatchOut    = FALSE;
+static ULONG                ScanPos     = 0;
+static BOOL                 WorkerFailed = FALSE;
+static struct MsgPort      *WorkerPort  = NULL;
+
+/* Sent to the worker's process port when it starts; it replies with the
+ * port it takes batches on, NULL if it couldn't make one. */
+struct ResolverStartup {
+    struct Message  msg;
+    struct MsgPort *port;
+};
+
+/* Read one file and fill in its item. Runs in either task, so it sticks
+ * to dos/exec calls and touches nothing but the item. */
+static void
+Resolver_ReadItem(ResolveItem *item)
+{
+    UBYTE header[SID_HEADER_BUFFER];
+    ULONG size = 0;
+    STRPTR title;
+
+    item->ok = FALSE;
+    item->title[0] = '\0';
+
+    if (!MD5File(item->filename, 0, item->md5, header, sizeof(header), &size)) return;
+
+    item->subsongs = ParseSIDSubsongs(header, size);
+    title = ExtractSIDTitle(header, size);
+    if (title) {
+        strncpy(item->title, title, sizeof(item->title) - 1);
+        item->title[sizeof(item->title) - 1] = '\0';
+        FreeVec(title);
+    }
+    item->ok = TRUE;
+}
+
+/* Entry point of the worker process. Everything is built -fbaserel and a
+ * new process starts with a4 undefined, so __saveds loads it before any
+ * global (library bases, the MD5 kernel pointer) is touched. */
+static void __saveds
+ResolverProc(void)
+{
+    struct Process *me = (struct Process *)FindTask(NULL);
+    struct ResolverStartup *startup;
+    struct MsgPort *port;
+    struct ResolveBatch *batch;
+    ULONG i;
+
+    WaitPort(&me->pr_MsgPort);
+    startup = (struct ResolverStartup *)GetMsg(&me->pr_MsgPort);
+    port = CreateMsgPort();
+    startup->port = port;
+    if (!port) {
+        /* As at exit below: the parent may unload us once it has the reply */
+        Forbid();
+        ReplyMsg(&startup->msg);
+        return;
+    }
+    ReplyMsg(&startup->msg);
+
+    for (;;) {
+        WaitPort(port);
+        while ((batch = (struct ResolveBatch *)GetMsg(port)) != NULL) {
+            if (batch->count == 0) {
+                DeleteMsgPort(port);
+                /* Stay in Forbid so the parent can't unload our code
+                 * before this process has finished exiting. */
+                Forbid();
+                ReplyMsg(&batch->msg);
+                return;
+            }
+            for (i = 0; i < batch->count; i++) {
+                Resolver_ReadItem(&batch->items[i]);
+            }
+            ReplyMsg(&batch->msg);
+        }
+    }
+}
+
+static BOOL
+Resolver_Start(void)
+{
+    struct ResolverStartup startup;
+    struct Process *proc;
+
+    if (WorkerPort) return TRUE;
+    if (WorkerFailed) return FALSE;
+
+    if (!ReplyPort) {
+        ReplyPort = CreateMsgPort();
+        if (!ReplyPort) goto fail;
+    }
+    if (!Batch) {
+        Batch = AllocVec(sizeof(struct ResolveBatch), MEMF_PUBLIC | MEMF_CLEAR);
+        if (!Batch) goto fail;
+        Batch->msg.mn_ReplyPort = ReplyPort;
+        Batch->msg.mn_Length = sizeof(struct ResolveBatch);
+    }
+
+    proc = CreateNewProcTags(NP_Entry, (ULONG)ResolverProc,
+                             NP_Name, (ULONG)"u64player resolver",
+                             NP_StackSize, RESOLVER_STACK,
+                             NP_Priority, RESOLVER_PRIORITY,
+                             TAG_DONE);
+    if (!proc) goto fail;
+
+    /* No batch is out yet, so the only reply ReplyPort can get is this one */
+    memset(&startup, 0, sizeof(startup));
+    startup.msg.mn_ReplyPort = ReplyPort;
+    startup.msg.mn_Length = sizeof(startup);
+    PutMsg(&proc->pr_MsgPort, &startup.msg);
+    WaitPort(ReplyPort);
+    GetMsg(ReplyPort);
+    WorkerPort = startup.port;
+    if (!WorkerPort) goto fail;
+
+    U64_DEBUG("resolver: worker started");
+    return TRUE;
+
+fail:
+    U64_DEBUG("resolver: no worker, resolving in the main task");
+    WorkerFailed = TRUE;
+    return FALSE;
+}
+
+/* The entry an item was queued for, or NULL if it has since gone. */
+static PlaylistEntry *
+Resolver_FindEntry(struct ObjApp *obj, const ResolveItem *item)
+{
+    ULONG i;
+
+    if (item->index_hint < obj->playlist_count) {
+        PlaylistEntry *e = &obj->playlist[item->index_hint];
+        if (e->pending && e->filename == item->key
+            && strcmp(e->filename, item->filename) == 0) {
+            return e;
+        }
+    }
+    /* Entries above it were removed, or the playlist was rebuilt */
+    for (i = 0; i < obj->playlist_count; i++) {
+        PlaylistEntry *e = &obj->playlist[i];
+        if (e->pending && e->filename == item->key
+            && strcmp(e->filename, item->filename) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void
+Resolver_Apply(struct ObjApp *obj, PlaylistEntry *entry, const ResolveItem *item)
+{
+    if (item->ok) {
+        FillPlaylistEntry(obj, entry, item->title[0] ? item->title : NULL,
+                          item->md5, item->subsongs);
+    } else {
+        /* Unreadable: keep the file name, stop retrying */
+        entry->pending = FALSE;
+    }
+    if (entry == obj->current_entry) {
+        APP_UpdateCurrentSongCache();
+        APP_UpdateCurrentSongDisplay();
+    }
+}
+
+/* TRUE while rows map 1:1 onto playlist indices, i.e. no filter is hiding
+ * entries; only then can single rows be rewritten in place. */
+static BOOL
+Resolver_RowsAreIndices(struct ObjApp *obj)
+{
+    return !(obj->search_mode_filter && obj->search_text[0]);
+}
+
+static BOOL
+Resolver_SendBatch(struct ObjApp *obj)
+{
+    ULONG scanned, i;
+
+    if (BatchOut || !Resolver_Start()) return FALSE;
+
+    Batch->count = 0;
+    if (ScanPos >= obj->playlist_count) ScanPos = 0;
+
+    /* One lap from ScanPos, wrapping, so entries skipped by a removal
+     * above the scan position are still picked up */
+    i = ScanPos;
+    for (scanned = 0; scanned < obj->playlist_count && Batch->count < RESOLVE_BATCH;
+         scanned++) {
+        PlaylistEntry *e = &obj->playlist[i];
+
+        if (e->pending) {
+            ResolveItem *item = &Batch->items[Batch->count++];
+            item->key = e->filename;
+            item->index_hint = i;
+            strncpy(item->filename, e->filename, sizeof(item->filename) - 1);
+            item->filename[sizeof(item->filename) - 1] = '\0';
+        }
+        if (++i >= obj->playlist_count) i = 0;
+    }
+    ScanPos = i;
+
+    if (Batch->count == 0) return FALSE;
+
+    PutMsg(WorkerPort, &Batch->msg);
+    BatchOut = TRUE;
+    return TRUE;
+}
+
+void
+Resolver_Kick(struct ObjApp *obj)
+{
+    if (!obj || BatchOut) return;
+
+    if (!Resolver_SendBatch(obj) && WorkerFailed) {
+        /* No worker: fall back to the old behaviour of reading everything
+         * now, in the main task */
+        ULONG i;
+        for (i = 0; i < obj->playlist_count; i++) {
+            Resolver_ResolveNow(obj, &obj->playlist[i]);
+        }
+        APP_UpdatePlaylistDisplay();
+    }
+}
+
+ULONG
+Resolver_WaitMask(void)
+{
+    return (ReplyPort && BatchOut) ? (1UL << ReplyPort->mp_SigBit) : 0;
+}
+
+BOOL
+Resolver_CheckSignal(struct ObjApp *obj, ULONG sigs)
+{
+    BOOL rows;
+    ULONG i, applied = 0;
+
+    if (!ReplyPort || !BatchOut || !(sigs & (1UL << ReplyPort->mp_SigBit))) {
+        return FALSE;
+    }
+    if (!GetMsg(ReplyPort)) return FALSE;
+    BatchOut = FALSE;
+
+    rows = Resolver_RowsAreIndices(obj);
+    for (i = 0; i < Batch->count; i++) {
+        PlaylistEntry *entry = Resolver_FindEntry(obj, &Batch->items[i]);
+        if (!entry) continue;
+
+        Resolver_Apply(obj, entry, &Batch->items[i]);
+        applied++;
+        if (rows) APP_RedrawPlaylistRow((ULONG)(entry - obj->playlist));
+    }
+
+    if (applied > 0) InvalidateSearchMatches(obj);
+
+    if (!Resolver_SendBatch(obj)) {
+        /* All done. With a filter active the titles it matched on have
+         * changed, so rebuild the filtered view once, now. */
+        if (!rows) {
+            UpdateSearchMatches();
+            UpdateFilteredPlaylistDisplay();
+        }
+        U64_DEBUG("resolver: playlist fully resolved");
+    }
+    return TRUE;
+}
+
+BOOL
+Resolver_ResolveNow(struct ObjApp *obj, PlaylistEntry *entry)
+{
+    ResolveItem item;
+
+    if (!entry || !entry->pending) return TRUE;
+
+    /* A copy of this entry may be with the worker; its result is simply
+     * dropped on return since the entry is no longer pending. */
+    memset(&item, 0, sizeof(item));
+    strncpy(item.filename, entry->filename, sizeof(item.filename) - 1);
+    Resolver_ReadItem(&item);
+    Resolver_Apply(obj, entry, &item);
+    InvalidateSearchMatches(obj);
+    return item.ok;
+}
+
+void
+Resolver_Stop(void)
+{
+    if (WorkerPort) {
+        /* Let an in-flight batch finish, then ask the worker to exit */
+        if (BatchOut) {
+            WaitPort(ReplyPort);
+            GetMsg(ReplyPort);
+            BatchOut = FALSE;
+        }
+        Batch->count = 0;
+        PutMsg(WorkerPort, &Batch->msg);
+        WaitPort(ReplyPort);
+        GetMsg(ReplyPort);
+        WorkerPort = NULL;
+    }
+
+    if (Batch) {
+        FreeVec(Batch);
+        Batch = NULL;
+    }
+    if (ReplyPort) {
+        DeleteMsgPort(ReplyPort);
+        ReplyPort = NULL;
+    }
+    ScanPos = 0;
+    WorkerFailed = FALSE;
+}
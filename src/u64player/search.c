@@ -17,116 +17,148 @@
 #include "player.h"
 #include "string_utils.h"
 
-/* Helper function to safely convert string to lowercase */
-static STRPTR SafeToLower(CONST_STRPTR input)
+/* Bit i of the visibility bitmap */
+#define SEARCH_VISIBLE(obj, i) \
+    (((obj)->playlist_visible[(i) >> 5] >> ((i) & 31)) & 1)
+
+/* Lowercase src into dst, truncating to dst_size - 1 characters. */
+static void
+LowerCopy(char *dst, CONST_STRPTR src, ULONG dst_size)
 {
-    ULONG len;
-    STRPTR result;
-    ULONG i;
+    ULONG i = 0;
 
-    if (!input) return NULL;
+    if (src) {
+        while (src[i] && i < dst_size - 1) {
+            dst[i] = tolower((unsigned char)src[i]);
+            i++;
+        }
+    }
+    dst[i] = '\0';
+}
 
-    len = strlen(input);
-    if (len > 512) len = 512; /* Limit to prevent excessive memory use */
+/* Build an entry's search key — lowercase title and basename joined by a
+ * newline, so a term can't match across the two — into the playlist
+ * string pool. Called once when the entry is added; every keystroke after
+ * that is a plain strstr with no allocation. */
+STRPTR
+BuildSearchKey(struct ObjApp *obj, PlaylistEntry *entry)
+{
+    char key[512];
+    ULONG len;
 
-    result = AllocVec(len + 1, MEMF_PUBLIC | MEMF_CLEAR);
-    if (!result) return NULL;
+    LowerCopy(key, entry->title, sizeof(key) - 1);
+    len = strlen(key);
+    key[len++] = '\n';
+    LowerCopy(key + len, entry->filename ? FilePart(entry->filename) : NULL,
+              sizeof(key) - len);
 
-    for (i = 0; i < len; i++) {
-        result[i] = tolower((unsigned char)input[i]);
-    }
-    result[len] = '\0';
+    return PlaylistStrDup(obj, key);
+}
+
+/* Drop the "previous query" state so the next search rescans everything.
+ * Called whenever entries are added, removed or cleared. */
+void
+InvalidateSearchMatches(struct ObjApp *obj)
+{
+    obj->search_applied_valid = FALSE;
+}
 
-    return result;
+/* Match an entry against an already-lowercased term. */
+static BOOL
+KeyMatches(PlaylistEntry *entry, CONST_STRPTR term_lower)
+{
+    if (!term_lower[0]) return TRUE;
+    return entry->search_key && strstr(entry->search_key, term_lower) != NULL;
 }
 
 /* Helper function to check if entry matches search term */
 BOOL MatchesSearchTerm(PlaylistEntry *entry, const char *search_term)
 {
-    STRPTR search_lower = NULL;
-    STRPTR title_lower = NULL;
-    STRPTR filename_lower = NULL;
-    STRPTR basename = NULL;
-    BOOL result = FALSE;
+    char term_lower[256];
 
     if (!entry || !search_term || strlen(search_term) == 0) {
         return TRUE; /* No search term means everything matches */
     }
 
-    /* Convert search term to lowercase */
-    search_lower = SafeToLower(search_term);
-    if (!search_lower) {
-        return FALSE;
-    }
-
-    /* Check title */
-    if (entry->title && strlen(entry->title) > 0) {
-        title_lower = SafeToLower(entry->title);
-        if (title_lower && strstr(title_lower, search_lower)) {
-            result = TRUE;
-            goto cleanup;
-        }
-    }
+    LowerCopy(term_lower, search_term, sizeof(term_lower));
+    return KeyMatches(entry, term_lower);
+}
 
-    /* Check filename */
-    if (entry->filename && strlen(entry->filename) > 0) {
-        basename = FilePart(entry->filename);
-        if (basename) {
-            filename_lower = SafeToLower(basename);
-            if (filename_lower && strstr(filename_lower, search_lower)) {
-                result = TRUE;
-                goto cleanup;
-            }
-        }
+/* Does entry i match the current term? Uses the bitmap when it is up to
+ * date, otherwise matches directly. */
+static BOOL
+EntryMatches(ULONG i)
+{
+    if (objApp->playlist_visible && objApp->search_applied_valid) {
+        return SEARCH_VISIBLE(objApp, i);
     }
-
-cleanup:
-    if (search_lower) FreeVec(search_lower);
-    if (title_lower) FreeVec(title_lower);
-    if (filename_lower) FreeVec(filename_lower);
-
-    return result;
+    return MatchesSearchTerm(&objApp->playlist[i], objApp->search_text);
 }
 
-/* Update search matches and visibility array */
+/* Update search matches and the visibility bitmap. When the term only
+ * grew since the last call (the usual case while typing), just the
+ * previous matches are re-checked; everything else does a full pass. */
 void UpdateSearchMatches(void)
 {
-    PlaylistEntry *entry;
-    ULONG i;
+    char term[256];
+    ULONG words, w, i;
+    BOOL refine;
 
     if (!objApp) return;
 
-    /* Allocate/reallocate visibility array */
-    if (objApp->playlist_visible) {
-        FreeVec(objApp->playlist_visible);
-    }
+    LowerCopy(term, objApp->search_text, sizeof(term));
+    words = (objApp->playlist_count + 31) >> 5;
 
-    if (objApp->playlist_count > 0) {
-        objApp->playlist_visible = AllocVec(objApp->playlist_count * sizeof(BOOL), MEMF_PUBLIC);
+    /* The bitmap only ever grows; it is reused across keystrokes */
+    if (words > objApp->playlist_visible_words) {
+        if (objApp->playlist_visible) {
+            FreeVec(objApp->playlist_visible);
+        }
+        objApp->playlist_visible = AllocVec(words * sizeof(ULONG), MEMF_PUBLIC);
+        objApp->playlist_visible_words = objApp->playlist_visible ? words : 0;
+        objApp->search_applied_valid = FALSE;
         if (!objApp->playlist_visible) {
             return;
         }
     }
 
-    /* Update visibility and count matches */
-    objApp->search_total_matches = 0;
-    objApp->search_current_match = 0;
+    refine = objApp->search_applied_valid && objApp->search_applied[0] && term[0]
+          && strncmp(term, objApp->search_applied, strlen(objApp->search_applied)) == 0;
 
-    entry = objApp->playlist_head;
-    for (i = 0; i < objApp->playlist_count && entry; i++) {
-        BOOL matches = MatchesSearchTerm(entry, objApp->search_text);
+    objApp->search_current_match = 0;
 
-        if (objApp->playlist_visible) {
-            objApp->playlist_visible[i] = matches;
+    if (refine) {
+        /* Narrowing: an entry that didn't match before can't match now */
+        for (w = 0; w < words; w++) {
+            ULONG bits = objApp->playlist_visible[w];
+            if (!bits) continue;
+            for (i = 0; i < 32; i++) {
+                if ((bits & (1UL << i))
+                    && !KeyMatches(&objApp->playlist[(w << 5) + i], term)) {
+                    bits &= ~(1UL << i);
+                    objApp->search_total_matches--;
+                }
+            }
+            objApp->playlist_visible[w] = bits;
         }
-
-        if (matches) {
-            objApp->search_total_matches++;
+    } else {
+        objApp->search_total_matches = 0;
+        for (w = 0; w < words; w++) {
+            ULONG bits = 0;
+            ULONG base = w << 5;
+            for (i = 0; i < 32 && base + i < objApp->playlist_count; i++) {
+                if (KeyMatches(&objApp->playlist[base + i], term)) {
+                    bits |= 1UL << i;
+                    objApp->search_total_matches++;
+                }
+            }
+            objApp->playlist_visible[w] = bits;
         }
-
-        entry = entry->next;
     }
 
+    strcpy(objApp->search_applied, term);
+    objApp->search_applied_valid = TRUE;
+
     /* Update button states */
     BOOL has_matches = (objApp->search_total_matches > 0);
     BOOL has_search = (strlen(objApp->search_text) > 0);
@@ -136,11 +168,12 @@ void UpdateSearchMatches(void)
     set(objApp->BTN_SearchClear, MUIA_Disabled, !has_search);
 }
 
-/* Modified playlist display function for filtering */
+/* Modified playlist display function for filtering. Rows are the same
+ * index tokens as the full view (PLAYLIST_ROW), just fewer of them. */
 void UpdateFilteredPlaylistDisplay(void)
 {
-    PlaylistEntry *entry;
-    ULONG i, display_index;
+    APTR *rows;
+    ULONG i, shown;
 
     if (!objApp || !objApp->LSV_PlaylistList) return;
 
@@ -153,91 +186,27 @@ void UpdateFilteredPlaylistDisplay(void)
         return;
     }
 
-    /* Add entries based on filter mode */
-    entry = objApp->playlist_head;
-    display_index = 0;
-
-    for (i = 0; i < objApp->playlist_count && entry; i++) {
-        BOOL should_display = TRUE;
+    rows = AllocVec(objApp->playlist_count * sizeof(APTR), MEMF_PUBLIC);
+    if (!rows) {
+        set(objApp->LSV_PlaylistList, MUIA_List_Quiet, FALSE);
+        return;
+    }
 
+    /* Add entries based on filter mode */
+    shown = 0;
+    for (i = 0; i < objApp->playlist_count; i++) {
         /* In filter mode, only show visible entries */
-        if (objApp->search_mode_filter && objApp->playlist_visible) {
-            should_display = objApp->playlist_visible[i];
-        }
-
-        if (should_display) {
-            STRPTR basename = FilePart(entry->filename);
-            STRPTR list_string = AllocVec(512, MEMF_PUBLIC | MEMF_CLEAR);
-
-            if (list_string && basename) {
-                /* Build clean filename */
-                char clean_name[128];
-                ULONG clean_len = strlen(basename);
-                if (clean_len >= sizeof(clean_name)) {
-                    clean_len = sizeof(clean_name) - 1;
-                }
-
-                CopyMem(basename, clean_name, clean_len);
-                clean_name[clean_len] = '\0';
-
-                char *dot = strrchr(clean_name, '.');
-                if (dot && stricmp(dot, ".sid") == 0) {
-                    *dot = '\0';
-                }
-
-                /* Choose display name safely */
-                STRPTR display_name = clean_name;
-                if (entry->title && strlen(entry->title) > 0) {
-                    display_name = entry->title;
-                }
-
-                /* Build display string using safe operations */
-                list_string[0] = '\0';
-                if (entry->is_favourite) {
-                    strcpy(list_string, "* ");
-                }
-                strncat(list_string, display_name, 200);
-
-                /* Add subsong and timing info */
-                if (entry->subsongs > 1) {
-                    char temp[64];
-                    sprintf(temp, " [%u/%u]",
-                           (unsigned int)(entry->current_subsong + 1),
-                           (unsigned int)entry->subsongs);
-                    strncat(list_string, temp, 50);
-
-                    ULONG current_duration = FindSongLength(objApp, entry->md5, entry->current_subsong);
-                    if (current_duration == 0) current_duration = entry->duration;
-                    if (current_duration == 0) current_duration = DEFAULT_SONG_LENGTH;
-
-                    sprintf(temp, " %u:%02u",
-                           (unsigned int)(current_duration / 60),
-                           (unsigned int)(current_duration % 60));
-                    strncat(list_string, temp, 30);
-                } else {
-                    ULONG duration = entry->duration;
-                    if (duration == 0) duration = FindSongLength(objApp, entry->md5, 0);
-                    if (duration == 0) duration = DEFAULT_SONG_LENGTH;
-
-                    char temp[32];
-                    sprintf(temp, " - %u:%02u",
-                           (unsigned int)(duration / 60),
-                           (unsigned int)(duration % 60));
-                    strncat(list_string, temp, 30);
-                }
-
-                DoMethod(objApp->LSV_PlaylistList, MUIM_List_InsertSingle, list_string,
-                         MUIV_List_Insert_Bottom);
-                display_index++;
-            }
-
-            if (list_string) {
-                /* Don't free here - MUI will handle it */
-            }
+        if (objApp->search_mode_filter && objApp->playlist_visible
+            && objApp->search_applied_valid && !SEARCH_VISIBLE(objApp, i)) {
+            continue;
         }
-
-        entry = entry->next;
+        rows[shown++] = PLAYLIST_ROW(i);
+    }
+    if (shown > 0) {
+        DoMethod(objApp->LSV_PlaylistList, MUIM_List_Insert, rows, shown,
+                 MUIV_List_Insert_Bottom);
     }
+    FreeVec(rows);
 
     set(objApp->LSV_PlaylistList, MUIA_List_Quiet, FALSE);
 
@@ -339,11 +308,11 @@ BOOL APP_SearchNext(void)
     }
 
     /* Find next match after current position */
-    entry = objApp->playlist_head;
     match_count = 0;
 
-    for (i = 0; i < objApp->playlist_count && entry; i++) {
-        if (MatchesSearchTerm(entry, objApp->search_text)) {
+    for (i = 0; i < objApp->playlist_count; i++) {
+        entry = &objApp->playlist[i];
+        if (EntryMatches(i)) {
             match_count++;
 
             if (i > objApp->current_index ||
@@ -369,7 +338,6 @@ BOOL APP_SearchNext(void)
                 return TRUE;
             }
         }
-        entry = entry->next;
     }
 
     /* Wrap around to first match */
@@ -390,11 +358,11 @@ BOOL APP_SearchPrev(void)
     }
 
     /* Find previous match before current position */
-    entry = objApp->playlist_head;
     match_count = 0;
 
-    for (i = 0; i < objApp->playlist_count && entry; i++) {
-        if (MatchesSearchTerm(entry, objApp->search_text)) {
+    for (i = 0; i < objApp->playlist_count; i++) {
+        entry = &objApp->playlist[i];
+        if (EntryMatches(i)) {
             match_count++;
 
             if (i < objApp->current_index) {
@@ -405,7 +373,6 @@ BOOL APP_SearchPrev(void)
                 break; /* Found current or later match */
             }
         }
-        entry = entry->next;
     }
 
     if (prev_match) {
@@ -0,0 +1,348 @@
+/* Ultimate64 SID Player - shuffle order
+ *
+ * Shuffle mode walks a Fisher-Yates permutation of playlist indices instead
+ * of picking rand() % count each time, so every track plays exactly once
+ * per cycle and Next is O(1). shuffle_order[0..shuffle_pos] is the history
+ * of the current cycle — Prev steps back through it. Entries appended to
+ * the playlist are folded into the unplayed tail lazily on the next call,
+ * and the order plus position survive restarts via a small state file.
+ *
+ * With play statistics available a new cycle is weighted: each track draws
+ * a random key scaled by PlayStats_Weight and the cycle plays in key order,
+ * so tunes usually listened through tend to come up early and ones that
+ * keep getting skipped late — but every track still plays once per cycle.
+ */
+
+#include <dos/dos.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "player.h"
+#include "playstats.h"
+
+#define SHUFFLE_STATE_MAGIC   "U64SHUF1"
+
+struct ShuffleStateHeader {
+    char   magic[8];
+    ULONG  count;           /* playlist_count when saved */
+    ULONG  pos;
+};
+
+/* Uniform-enough index in [0, n). rand() may only give 15 bits, which
+ * would never reach the back half of an HVSC-sized playlist. */
+ULONG
+Shuffle_Random(ULONG n)
+{
+    ULONG r = ((ULONG)rand() << 15) ^ (ULONG)rand();
+    return r % n;
+}
+
+static void
+shuffle_swap(ULONG *order, ULONG a, ULONG b)
+{
+    ULONG t = order[a];
+    order[a] = order[b];
+    order[b] = t;
+}
+
+static BOOL
+shuffle_reserve(struct ObjApp *obj, ULONG needed)
+{
+    if (needed <= obj->shuffle_capacity) return TRUE;
+
+    ULONG new_capacity = obj->shuffle_capacity ? obj->shuffle_capacity : PLAYLIST_INITIAL_CAPACITY;
+    while (new_capacity < needed) new_capacity *= 2;
+
+    ULONG *grown = AllocVec(new_capacity * sizeof(ULONG), MEMF_PUBLIC);
+    if (!grown) return FALSE;
+    if (obj->shuffle_order) {
+        CopyMem(obj->shuffle_order, grown, obj->shuffle_count * sizeof(ULONG));
+        FreeVec(obj->shuffle_order);
+    }
+    obj->shuffle_order = grown;
+    obj->shuffle_capacity = new_capacity;
+    return TRUE;
+}
+
+typedef struct ShuffleKey {
+    ULONG key;
+    ULONG index;
+} ShuffleKey;
+
+static int
+shuffle_compare_keys(const void *a, const void *b)
+{
+    const ShuffleKey *ka = a, *kb = b;
+    if (ka->key == kb->key) return 0;
+    return ka->key > kb->key ? -1 : 1;
+}
+
+/* Reorder the first n slots by weighted random keys. Without statistics,
+ * or memory for the keys, the uniform order is kept. */
+static void
+shuffle_weight(struct ObjApp *obj, ULONG n)
+{
+    ShuffleKey *keys;
+    ULONG i;
+
+    if (!obj->play_stats || obj->play_stats->count == 0 || n < 2) return;
+
+    keys = AllocVec(n * sizeof(ShuffleKey), MEMF_PUBLIC);
+    if (!keys) return;
+
+    for (i = 0; i < n; i++) {
+        PlaylistEntry *e = &obj->playlist[obj->shuffle_order[i]];
+        ULONG weight = e->pending ? PLAYSTATS_WEIGHT_DEFAULT
+                                  : PlayStats_Weight(obj->play_stats, e->md5);
+        keys[i].key = Shuffle_Random(65536) * weight;
+        keys[i].index = obj->shuffle_order[i];
+    }
+    qsort(keys, n, sizeof(ShuffleKey), shuffle_compare_keys);
+    for (i = 0; i < n; i++) {
+        obj->shuffle_order[i] = keys[i].index;
+    }
+    FreeVec(keys);
+}
+
+/* Start a fresh cycle: a full Fisher-Yates shuffle with first_index (the
+ * track playing now) moved to the front as the cycle's history. */
+static BOOL
+shuffle_build(struct ObjApp *obj, ULONG first_index)
+{
+    ULONG n = obj->playlist_count;
+    ULONG i;
+
+    if (!shuffle_reserve(obj, n)) return FALSE;
+
+    for (i = 0; i < n; i++) obj->shuffle_order[i] = i;
+    for (i = n; i > 1; i--) {
+        shuffle_swap(obj->shuffle_order, i - 1, Shuffle_Random(i));
+    }
+    shuffle_weight(obj, n);
+    for (i = 0; i < n; i++) {
+        if (obj->shuffle_order[i] == first_index) {
+            shuffle_swap(obj->shuffle_order, 0, i);
+            break;
+        }
+    }
+
+    obj->shuffle_count = n;
+    obj->shuffle_pos = 0;
+    return TRUE;
+}
+
+/* Fold playlist entries appended since the order was built into the
+ * unplayed part, each at a uniformly random position — O(1) per entry. */
+static BOOL
+shuffle_extend(struct ObjApp *obj)
+{
+    if (obj->shuffle_count >= obj->playlist_count) return TRUE;
+    if (!shuffle_reserve(obj, obj->playlist_count)) return FALSE;
+
+    while (obj->shuffle_count < obj->playlist_count) {
+        ULONG slot = obj->shuffle_count;
+        ULONG unplayed = slot - obj->shuffle_pos;   /* positions pos+1..slot */
+
+        obj->shuffle_order[slot] = slot;
+        shuffle_swap(obj->shuffle_order, slot,
+                     obj->shuffle_pos + 1 + Shuffle_Random(unplayed));
+        obj->shuffle_count++;
+    }
+    return TRUE;
+}
+
+/* Bring the order in line with the playlist and the current track. If the
+ * user picked a track by hand it is moved to shuffle_pos: an unplayed one
+ * is pulled forward (it now counts as played), an already-played one is
+ * moved to the end of the history. */
+static BOOL
+shuffle_sync(struct ObjApp *obj)
+{
+    ULONG current = obj->current_index;
+    ULONG *order;
+    ULONG p;
+
+    if (obj->playlist_count == 0) return FALSE;
+
+    if (obj->shuffle_count == 0) {
+        return shuffle_build(obj, current);
+    }
+    if (!shuffle_extend(obj)) return FALSE;
+
+    order = obj->shuffle_order;
+    if (order[obj->shuffle_pos] == current) return TRUE;
+
+    for (p = 0; p < obj->shuffle_count; p++) {
+        if (order[p] == current) break;
+    }
+    if (p == obj->shuffle_count) {
+        return shuffle_build(obj, current);
+    }
+
+    if (p > obj->shuffle_pos) {
+        obj->shuffle_pos++;
+        shuffle_swap(order, p, obj->shuffle_pos);
+    } else {
+        memmove(&order[p], &order[p + 1], (obj->shuffle_pos - p) * sizeof(ULONG));
+        order[obj->shuffle_pos] = current;
+    }
+    return TRUE;
+}
+
+LONG
+Shuffle_Next(struct ObjApp *obj)
+{
+    if (!shuffle_sync(obj)) return -1;
+
+    if (obj->shuffle_pos + 1 >= obj->shuffle_count) {
+        /* Cycle complete — reshuffle, but never start the new cycle with
+         * the track that just finished. */
+        ULONG last = obj->shuffle_order[obj->shuffle_pos];
+        if (!shuffle_build(obj, last)) return -1;
+        if (obj->shuffle_count < 2) return (LONG)last;
+        shuffle_swap(obj->shuffle_order, 0, 1 + Shuffle_Random(obj->shuffle_count - 1));
+        return (LONG)obj->shuffle_order[0];
+    }
+
+    obj->shuffle_pos++;
+    return (LONG)obj->shuffle_order[obj->shuffle_pos];
+}
+
+LONG
+Shuffle_Prev(struct ObjApp *obj)
+{
+    if (!shuffle_sync(obj) || obj->shuffle_pos == 0) return -1;
+
+    obj->shuffle_pos--;
+    return (LONG)obj->shuffle_order[obj->shuffle_pos];
+}
+
+LONG
+Shuffle_Peek(struct ObjApp *obj)
+{
+    if (obj->shuffle_count != obj->playlist_count
+        || obj->shuffle_pos + 1 >= obj->shuffle_count
+        || obj->shuffle_order[obj->shuffle_pos] != obj->current_index) {
+        return -1;
+    }
+    return (LONG)obj->shuffle_order[obj->shuffle_pos + 1];
+}
+
+void
+Shuffle_Remove(struct ObjApp *obj, ULONG index)
+{
+    ULONG *order = obj->shuffle_order;
+    ULONG p, found = obj->shuffle_count;
+
+    for (p = 0; p < obj->shuffle_count; p++) {
+        if (order[p] == index) found = p;
+        else if (order[p] > index) order[p]--;
+    }
+    if (found == obj->shuffle_count) return;
+
+    memmove(&order[found], &order[found + 1],
+            (obj->shuffle_count - found - 1) * sizeof(ULONG));
+    obj->shuffle_count--;
+    if (found <= obj->shuffle_pos && obj->shuffle_pos > 0) {
+        obj->shuffle_pos--;
+    }
+}
+
+void
+Shuffle_Reset(struct ObjApp *obj)
+{
+    if (obj->shuffle_order) {
+        FreeVec(obj->shuffle_order);
+    }
+    obj->shuffle_order = NULL;
+    obj->shuffle_count = 0;
+    obj->shuffle_capacity = 0;
+    obj->shuffle_pos = 0;
+}
+
+BOOL
+Shuffle_Save(struct ObjApp *obj, CONST_STRPTR path)
+{
+    struct ShuffleStateHeader hdr;
+    BPTR file;
+    LONG bytes;
+
+    if (!obj->shuffle_mode || obj->shuffle_count == 0
+        || obj->shuffle_count != obj->playlist_count) {
+        DeleteFile((STRPTR)path);
+        return FALSE;
+    }
+
+    file = Open(path, MODE_NEWFILE);
+    if (!file) return FALSE;
+
+    memset(&hdr, 0, sizeof(hdr));
+    CopyMem((APTR)SHUFFLE_STATE_MAGIC, hdr.magic, 8);
+    hdr.count = obj->shuffle_count;
+    hdr.pos = obj->shuffle_pos;
+
+    bytes = obj->shuffle_count * sizeof(ULONG);
+    BOOL ok = Write(file, &hdr, sizeof(hdr)) == sizeof(hdr)
+           && Write(file, obj->shuffle_order, bytes) == bytes;
+    Close(file);
+
+    if (!ok) DeleteFile((STRPTR)path);
+    return ok;
+}
+
+/* Restore a saved order if it still matches the playlist (same length and
+ * a genuine permutation), and make its current track the current entry. */
+BOOL
+Shuffle_Load(struct ObjApp *obj, CONST_STRPTR path)
+{
+    struct ShuffleStateHeader hdr;
+    UBYTE *seen = NULL;
+    BOOL ok = FALSE;
+    BPTR file;
+    ULONG i;
+
+    if (obj->playlist_count == 0) return FALSE;
+
+    file = Open(path, MODE_OLDFILE);
+    if (!file) return FALSE;
+
+    if (Read(file, &hdr, sizeof(hdr)) != sizeof(hdr)
+        || memcmp(hdr.magic, SHUFFLE_STATE_MAGIC, 8) != 0
+        || hdr.count != obj->playlist_count || hdr.pos >= hdr.count) {
+        U64_DEBUG("shuffle state doesn't match the playlist — ignoring");
+        Close(file);
+        return FALSE;
+    }
+
+    Shuffle_Reset(obj);
+    if (!shuffle_reserve(obj, hdr.count)) goto done;
+
+    LONG bytes = hdr.count * sizeof(ULONG);
+    if (Read(file, obj->shuffle_order, bytes) != bytes) goto done;
+
+    seen = AllocVec(hdr.count, MEMF_PUBLIC | MEMF_CLEAR);
+    if (!seen) goto done;
+    for (i = 0; i < hdr.count; i++) {
+        ULONG v = obj->shuffle_order[i];
+        if (v >= hdr.count || seen[v]) goto done;
+        seen[v] = 1;
+    }
+
+    obj->shuffle_count = hdr.count;
+    obj->shuffle_pos = hdr.pos;
+    obj->current_index = obj->shuffle_order[hdr.pos];
+    obj->current_entry = &obj->playlist[obj->current_index];
+    ok = TRUE;
+
+done:
+    Close(file);
+    if (seen) FreeVec(seen);
+    if (!ok) Shuffle_Reset(obj);
+    return ok;
+}
@@ -50,16 +50,20 @@ STRPTR ExtractSIDTitle(const UBYTE *data, ULONG size)
         author[i] = '\0';
     }
 
+    return FormatSIDTitle(title, author, size >= 0x78 ? data[0x77] : 0);
+}
+
+/* Build the playlist display title from header fields already trimmed.
+ * flags is the low byte of the v2+ header flags word (0 if absent). */
+STRPTR FormatSIDTitle(CONST_STRPTR title, CONST_STRPTR author, UBYTE flags)
+{
     // Extract SID model information
     char sid_info[32] = "";
-    if (size >= 0x78) {
-        UBYTE flags = data[0x77];
-        if (flags & 0x10) {  // SID model specified
-            if (flags & 0x40) {  // Dual SID
-                strcpy(sid_info, (flags & 0x20) ? " (8580+)" : " (6581+)");
-            } else {
-                strcpy(sid_info, (flags & 0x20) ? " (8580)" : " (6581)");
-            }
+    if (flags & 0x10) {  // SID model specified
+        if (flags & 0x40) {  // Dual SID
+            strcpy(sid_info, (flags & 0x20) ? " (8580+)" : " (6581+)");
+        } else {
+            strcpy(sid_info, (flags & 0x20) ? " (8580)" : " (6581)");
         }
     }
 
@@ -105,6 +109,56 @@ STRPTR ExtractSIDTitle(const UBYTE *data, ULONG size)
     return NULL;
 }
 
+/* Copy one of the 32-byte Latin-1 header fields, trimming padding. */
+static void
+CopyHeaderString(char *dst, const UBYTE *src)
+{
+    int i;
+
+    CopyMem((APTR)src, dst, 32);
+    dst[32] = '\0';
+    for (i = 31; i >= 0 && (dst[i] == ' ' || dst[i] == '\0'); i--) {
+        dst[i] = '\0';
+    }
+}
+
+/* Address of an extra SID from its v3/v4 header byte: $Dxx0, where xx
+ * must be even and in $42-$7E or $E0-$FE. Anything else means none. */
+static UWORD
+ExtraSIDAddress(UBYTE b)
+{
+    if (b & 1) return 0;
+    if ((b >= 0x42 && b <= 0x7E) || (b >= 0xE0 && b <= 0xFE)) {
+        return (UWORD)(0xD000 | (b << 4));
+    }
+    return 0;
+}
+
+/* Parse a PSID/RSID header. Only the first SID_HEADER_MIN_SIZE bytes are
+ * needed; the v2+ flags word and the v3+ SID addresses are read when the
+ * data reaches them. */
+BOOL ParseSIDHeader(const UBYTE *data, ULONG size, SIDHeaderInfo *info)
+{
+    if (size < SID_HEADER_MIN_SIZE
+        || (memcmp(data, "PSID", 4) != 0 && memcmp(data, "RSID", 4) != 0)) {
+        return FALSE;
+    }
+
+    info->version = (data[4] << 8) | data[5];
+    info->subsongs = (data[14] << 8) | data[15];
+    info->start_song = (data[16] << 8) | data[17];
+    if (info->subsongs == 0) info->subsongs = 1;
+    if (info->start_song == 0 || info->start_song > info->subsongs) info->start_song = 1;
+    info->flags = (info->version >= 2 && size >= 0x78) ? ((data[0x76] << 8) | data[0x77]) : 0;
+    info->sid2_address = (info->version >= 3 && size >= SID_HEADER_V2_SIZE) ? ExtraSIDAddress(data[0x7A]) : 0;
+    info->sid3_address = (info->version >= 4 && size >= SID_HEADER_V2_SIZE) ? ExtraSIDAddress(data[0x7B]) : 0;
+
+    CopyHeaderString(info->title, data + 0x16);
+    CopyHeaderString(info->author, data + 0x36);
+    CopyHeaderString(info->released, data + 0x56);
+    return TRUE;
+}
+
 ULONG ParseTimeString(const char *time_str)
 {
     char *colon_pos;
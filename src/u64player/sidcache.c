@@ -0,0 +1,194 @@
+#include <exec/memory.h>
+#include <exec/types.h>
+
+#include <proto/exec.h>
+
+#include <string.h>
+
+#include "player.h"      /* for MD5Compare, U64_DEBUG */
+#include "file_utils.h"
+#include "sidcache.h"
+
+static SIDCacheEntry *
+sidcache_find(struct SIDCache *cache, const UBYTE md5[16])
+{
+    for (SIDCacheEntry *e = cache->head; e; e = e->next) {
+        if (MD5Compare(e->md5, md5)) return e;
+    }
+    return NULL;
+}
+
+static void
+sidcache_unlink(struct SIDCache *cache, SIDCacheEntry *e)
+{
+    if (e->prev) e->prev->next = e->next;
+    else         cache->head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else         cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void
+sidcache_push_front(struct SIDCache *cache, SIDCacheEntry *e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head) cache->head->prev = e;
+    cache->head = e;
+    if (!cache->tail) cache->tail = e;
+}
+
+static void
+sidcache_push_back(struct SIDCache *cache, SIDCacheEntry *e)
+{
+    e->next = NULL;
+    e->prev = cache->tail;
+    if (cache->tail) cache->tail->next = e;
+    cache->tail = e;
+    if (!cache->head) cache->head = e;
+}
+
+static void
+sidcache_drop(struct SIDCache *cache, SIDCacheEntry *e)
+{
+    sidcache_unlink(cache, e);
+    cache->bytes -= e->size;
+    cache->count--;
+    FreeVec(e->data);
+    FreeVec(e);
+}
+
+/* Evict from the LRU end until bytes fit the budget. keep is never evicted,
+ * so a single file larger than the whole budget still survives until the
+ * next insert. */
+static void
+sidcache_evict(struct SIDCache *cache, SIDCacheEntry *keep)
+{
+    SIDCacheEntry *e = cache->tail;
+    while (e && cache->bytes > cache->budget) {
+        SIDCacheEntry *prev = e->prev;
+        if (e != keep) sidcache_drop(cache, e);
+        e = prev;
+    }
+}
+
+/* Read filename and wrap it in a fresh, unlinked entry. */
+static SIDCacheEntry *
+sidcache_load(const UBYTE md5[16], CONST_STRPTR filename)
+{
+    ULONG size = 0;
+    UBYTE *data = U64_ReadFile(filename, &size);
+    if (!data) return NULL;
+
+    SIDCacheEntry *e = AllocVec(sizeof(SIDCacheEntry), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!e) {
+        FreeVec(data);
+        return NULL;
+    }
+    CopyMem((APTR)md5, e->md5, 16);
+    e->data = data;
+    e->size = size;
+    return e;
+}
+
+struct SIDCache *
+SIDCache_Create(ULONG budget_bytes)
+{
+    struct SIDCache *cache
+        = AllocVec(sizeof(struct SIDCache), MEMF_PUBLIC | MEMF_CLEAR);
+    if (cache) cache->budget = budget_bytes;
+    return cache;
+}
+
+void
+SIDCache_Flush(struct SIDCache *cache)
+{
+    if (!cache) return;
+    while (cache->head) sidcache_drop(cache, cache->head);
+}
+
+void
+SIDCache_Free(struct SIDCache *cache)
+{
+    if (!cache) return;
+    U64_DEBUG("sidcache: %lu hits, %lu misses",
+              (unsigned long)cache->hits, (unsigned long)cache->misses);
+    SIDCache_Flush(cache);
+    FreeVec(cache);
+}
+
+void
+SIDCache_CheckMemory(struct SIDCache *cache)
+{
+    if (!cache || !cache->head) return;
+    if (AvailMem(MEMF_ANY) >= SIDCACHE_LOWMEM_BYTES) return;
+
+    U64_DEBUG("sidcache: low memory, releasing %lu bytes",
+              (unsigned long)cache->bytes);
+    SIDCache_Flush(cache);
+}
+
+void
+SIDCache_SetBudget(struct SIDCache *cache, ULONG budget_bytes)
+{
+    if (!cache) return;
+    cache->budget = budget_bytes;
+    sidcache_evict(cache, NULL);
+}
+
+const UBYTE *
+SIDCache_Get(struct SIDCache *cache, const UBYTE md5[16],
+             CONST_STRPTR filename, ULONG *size)
+{
+    if (!cache || !filename) return NULL;
+
+    SIDCacheEntry *e = sidcache_find(cache, md5);
+    if (e) {
+        cache->hits++;
+        if (e != cache->head) {
+            sidcache_unlink(cache, e);
+            sidcache_push_front(cache, e);
+        }
+    } else {
+        cache->misses++;
+        SIDCache_CheckMemory(cache);
+        e = sidcache_load(md5, filename);
+        if (!e) return NULL;
+        sidcache_push_front(cache, e);
+        cache->bytes += e->size;
+        cache->count++;
+        sidcache_evict(cache, e);
+    }
+
+    if (size) *size = e->size;
+    return e->data;
+}
+
+BOOL
+SIDCache_Prefetch(struct SIDCache *cache, const UBYTE md5[16],
+                  CONST_STRPTR filename)
+{
+    if (!cache || !filename || cache->budget == 0) return FALSE;
+    if (sidcache_find(cache, md5)) return TRUE;
+
+    SIDCache_CheckMemory(cache);
+    SIDCacheEntry *e = sidcache_load(md5, filename);
+    if (!e) return FALSE;
+
+    /* Prefetched data goes in just behind the head so it can displace
+     * older tracks but never the one currently playing. */
+    if (cache->head) {
+        e->prev = cache->head;
+        e->next = cache->head->next;
+        if (cache->head->next) cache->head->next->prev = e;
+        else                   cache->tail = e;
+        cache->head->next = e;
+    } else {
+        sidcache_push_back(cache, e);
+    }
+    cache->bytes += e->size;
+    cache->count++;
+    sidcache_evict(cache, cache->head);
+
+    return sidcache_find(cache, md5) != NULL;
+}
@@ -0,0 +1,69 @@
+/* Size-bounded LRU cache of SID file contents, keyed by the file MD5.
+ *
+ * Every subsong change, Prev/Next or replay used to U64_ReadFile the same
+ * few KB again. PlayCurrentSong and the next-track prefetch go through this
+ * cache instead, so browsing the subsongs of a tune never touches the disk.
+ *
+ * Buffers are owned by the cache. A pointer returned by SIDCache_Get stays
+ * valid until the next call that can insert or evict (Get/Prefetch/
+ * CheckMemory/SetBudget/Flush) — copy or consume it before then.
+ */
+
+#ifndef U64_SIDCACHE_H
+#define U64_SIDCACHE_H
+
+#include <exec/types.h>
+
+#define SIDCACHE_DEFAULT_KB     256     /* budget when ENV var is unset */
+#define SIDCACHE_LOWMEM_BYTES   (256UL * 1024)  /* flush below this AvailMem */
+
+typedef struct SIDCacheEntry
+{
+    UBYTE md5[16];                  /* raw 16 bytes, not hex */
+    UBYTE *data;                    /* AllocVec'd file contents */
+    ULONG size;
+    struct SIDCacheEntry *prev;     /* towards most recently used */
+    struct SIDCacheEntry *next;     /* towards least recently used */
+} SIDCacheEntry;
+
+struct SIDCache
+{
+    SIDCacheEntry *head;            /* most recently used */
+    SIDCacheEntry *tail;            /* least recently used — evicted first */
+    ULONG bytes;                    /* sum of entry sizes */
+    ULONG budget;                   /* upper bound for bytes */
+    ULONG count;
+    ULONG hits;
+    ULONG misses;
+};
+
+/* Allocate an empty cache holding at most budget_bytes of file data.
+ * Caller frees with SIDCache_Free. */
+struct SIDCache *SIDCache_Create(ULONG budget_bytes);
+
+/* Destroy a cache and every buffer in it; NULL is safe. */
+void SIDCache_Free(struct SIDCache *cache);
+
+/* Return the contents of filename, serving them from memory when md5 is
+ * cached and reading the file (then caching it) otherwise. *size receives
+ * the byte count. Returns NULL on read failure or when cache is NULL. */
+const UBYTE *SIDCache_Get(struct SIDCache *cache, const UBYTE md5[16],
+                          CONST_STRPTR filename, ULONG *size);
+
+/* Warm the cache with filename if md5 isn't already present. Never
+ * promotes an existing entry, so prefetching can't push out the track
+ * that is playing. Returns TRUE if the data is cached afterwards. */
+BOOL SIDCache_Prefetch(struct SIDCache *cache, const UBYTE md5[16],
+                       CONST_STRPTR filename);
+
+/* Change the budget, evicting least-recently-used entries to fit. */
+void SIDCache_SetBudget(struct SIDCache *cache, ULONG budget_bytes);
+
+/* Drop every cached buffer (keeps the cache itself). */
+void SIDCache_Flush(struct SIDCache *cache);
+
+/* Release all cached buffers if free memory has fallen below
+ * SIDCACHE_LOWMEM_BYTES. Cheap enough to call once per timer tick. */
+void SIDCache_CheckMemory(struct SIDCache *cache);
+
+#endif
@@ -0,0 +1,162 @@
+/* Ultimate64 SID Player - silence detection
+ *
+ * Many tunes end, or loop on silence, well before their song-length entry
+ * says — and tunes without one run the full DEFAULT_SONG_LENGTH. With
+ * "Skip silence" on, the SID registers are sampled about once a second
+ * while a tune plays and playback moves on once every chip has been quiet
+ * for silence_secs.
+ *
+ * A sample is one readmem of $D400-$D41C (voices, filter/volume, OSC3 and
+ * ENV3), widened to cover the second and third SID when the PSID header
+ * names them and they lie close enough; otherwise one read per chip. A
+ * chip is quiet when its master volume is zero or no voice has its gate
+ * bit set and ENV3 has decayed, and its $D418 hasn't changed since the
+ * last sample — digi tunes play samples through the volume register with
+ * every gate off.
+ *
+ * The detector arms only after hearing sound, so a machine whose registers
+ * read back as all zero simply never skips. Reads that keep failing turn
+ * it off for the rest of the tune.
+ *
+ * Sampling runs on the GUI task from the playback timer, so each read is
+ * held to SILENCE_TIMEOUT_SECS for the connect and for the reply instead
+ * of the library's 10 and 30 seconds: a device that stops answering costs
+ * a few seconds in all before the detector gives up, never minutes.
+ */
+
+#include <exec/types.h>
+
+#include <string.h>
+
+#include "player.h"
+
+#define SILENCE_SAMPLE_SECS   1       /* between register samples */
+#define SILENCE_MAX_CHIPS     3
+#define SILENCE_REG_SPAN      0x1D    /* $D400-$D41C */
+#define SILENCE_MAX_BATCH     0x100   /* widest single read covering all chips */
+#define SILENCE_MAX_FAILURES  3
+#define SILENCE_TIMEOUT_SECS  1       /* connect, and each wait for the reply */
+
+#define SID_REG_CTRL1         0x04
+#define SID_REG_CTRL2         0x0B
+#define SID_REG_CTRL3         0x12
+#define SID_REG_MODE_VOL      0x18
+#define SID_REG_ENV3          0x1C
+
+static struct {
+    UWORD  chips[SILENCE_MAX_CHIPS];
+    UWORD  chip_count;
+    UWORD  base;                    /* first address of the batched read */
+    UWORD  span;                    /* its length; 0 = one read per chip */
+    UBYTE  last_mode_vol[SILENCE_MAX_CHIPS];
+    BOOL   have_last;
+    BOOL   armed;                   /* sound heard since the tune started */
+    BOOL   disabled;
+    UWORD  failures;
+    ULONG  quiet_samples;
+    ULONG  next_sample;             /* current_time of the next sample */
+} silence;
+
+static UBYTE silence_buffer[SILENCE_MAX_BATCH];
+
+void
+Silence_Start(const UBYTE *sid_data, ULONG size)
+{
+    SIDHeaderInfo info;
+    UWORD lowest, highest;
+    ULONG i;
+
+    memset(&silence, 0, sizeof(silence));
+    silence.chips[silence.chip_count++] = 0xD400;
+
+    if (sid_data && ParseSIDHeader(sid_data, size, &info)) {
+        if (info.sid2_address) silence.chips[silence.chip_count++] = info.sid2_address;
+        if (info.sid3_address) silence.chips[silence.chip_count++] = info.sid3_address;
+    }
+
+    lowest = highest = silence.chips[0];
+    for (i = 1; i < silence.chip_count; i++) {
+        if (silence.chips[i] < lowest) lowest = silence.chips[i];
+        if (silence.chips[i] > highest) highest = silence.chips[i];
+    }
+    if ((ULONG)(highest - lowest) + SILENCE_REG_SPAN <= SILENCE_MAX_BATCH) {
+        silence.base = lowest;
+        silence.span = (UWORD)(highest - lowest + SILENCE_REG_SPAN);
+    }
+
+    silence.next_sample = SILENCE_SAMPLE_SECS;
+}
+
+/* Read every chip's registers into silence_buffer; chip i's block then
+ * starts at Silence_RegsOf(i). */
+static BOOL
+Silence_Read(U64Connection *conn)
+{
+    ULONG i;
+
+    if (silence.span) {
+        return U64_ReadMem(conn, silence.base, silence_buffer, silence.span) == U64_OK;
+    }
+    for (i = 0; i < silence.chip_count; i++) {
+        if (U64_ReadMem(conn, silence.chips[i],
+                        silence_buffer + i * SILENCE_REG_SPAN, SILENCE_REG_SPAN) != U64_OK) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static const UBYTE *
+Silence_RegsOf(ULONG chip)
+{
+    if (silence.span) return silence_buffer + (silence.chips[chip] - silence.base);
+    return silence_buffer + chip * SILENCE_REG_SPAN;
+}
+
+/* Called once a second from the playback timer. TRUE once the tune has
+ * been quiet for obj->silence_secs. */
+BOOL
+Silence_Check(struct ObjApp *obj)
+{
+    BOOL quiet = TRUE;
+    BOOL read_ok;
+    ULONG i;
+
+    if (!obj->skip_silence || silence.disabled || !obj->connection) return FALSE;
+    if (obj->current_time < silence.next_sample) return FALSE;
+    silence.next_sample = obj->current_time + SILENCE_SAMPLE_SECS;
+
+    U64_SetTimeouts(obj->connection, SILENCE_TIMEOUT_SECS, SILENCE_TIMEOUT_SECS);
+    read_ok = Silence_Read(obj->connection);
+    U64_SetTimeouts(obj->connection, 0, 0);
+
+    if (!read_ok) {
+        if (++silence.failures >= SILENCE_MAX_FAILURES) {
+            U64_DEBUG("silence: register reads failing, off for this tune");
+            silence.disabled = TRUE;
+        }
+        return FALSE;
+    }
+    silence.failures = 0;
+
+    for (i = 0; i < silence.chip_count; i++) {
+        const UBYTE *regs = Silence_RegsOf(i);
+        UBYTE mode_vol = regs[SID_REG_MODE_VOL];
+        BOOL gated = ((regs[SID_REG_CTRL1] | regs[SID_REG_CTRL2] | regs[SID_REG_CTRL3]) & 0x01) != 0;
+
+        if ((mode_vol & 0x0F) != 0 && (gated || regs[SID_REG_ENV3] != 0)) quiet = FALSE;
+        if (silence.have_last && mode_vol != silence.last_mode_vol[i]) quiet = FALSE;
+        silence.last_mode_vol[i] = mode_vol;
+    }
+    silence.have_last = TRUE;
+
+    if (!quiet) {
+        silence.armed = TRUE;
+        silence.quiet_samples = 0;
+        return FALSE;
+    }
+    if (!silence.armed) return FALSE;
+
+    silence.quiet_samples++;
+    return silence.quiet_samples * SILENCE_SAMPLE_SECS >= obj->silence_secs;
+}
@@ -0,0 +1,949 @@
+/* Ultimate64 SID Player - smart playlists
+ * For Amiga OS 3.x by Marcin Spoczynski
+ *
+ * See smartpl.h for the query language. A query compiles into a postfix
+ * program over catalogue fields and play statistics; evaluating it reads
+ * only library.cat (and library.idx to narrow the records down), and its
+ * matches join the playlist SMARTPL_LOOKAHEAD tracks ahead of playback.
+ */
+
+#include <dos/dos.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+#include <libraries/mui.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/intuition.h>
+#include <proto/muimaster.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "player.h"
+#include "env_utils.h"
+#include "md5set.h"
+#include "playstats.h"
+#include "smartpl.h"
+
+#define SMARTPL_PUMP_EVERY  512     /* records scanned between MUI input checks */
+
+/* ------------------------------------------------------------------ */
+/* Compiling                                                           */
+/* ------------------------------------------------------------------ */
+
+enum SMARTPL_TOKENS {
+    SMART_TOK_END,
+    SMART_TOK_WORD,
+    SMART_TOK_STRING,
+    SMART_TOK_LPAREN,
+    SMART_TOK_RPAREN,
+    SMART_TOK_AND,
+    SMART_TOK_OR,
+    SMART_TOK_NOT,
+    SMART_TOK_CMP
+};
+
+static const struct {
+    CONST_STRPTR name;
+    UBYTE field;
+} smart_fields[] = {
+    { "title",      SMART_FIELD_TITLE },
+    { "author",     SMART_FIELD_AUTHOR },
+    { "composer",   SMART_FIELD_AUTHOR },
+    { "released",   SMART_FIELD_RELEASED },
+    { "path",       SMART_FIELD_PATH },
+    { "model",      SMART_FIELD_MODEL },
+    { "clock",      SMART_FIELD_CLOCK },
+    { "year",       SMART_FIELD_YEAR },
+    { "duration",   SMART_FIELD_DURATION },
+    { "length",     SMART_FIELD_DURATION },
+    { "subsongs",   SMART_FIELD_SUBSONGS },
+    { "plays",      SMART_FIELD_PLAYS },
+    { "skips",      SMART_FIELD_SKIPS },
+    { "finishes",   SMART_FIELD_FINISHES },
+    { "listened",   SMART_FIELD_LISTENED },
+    { "lastplayed", SMART_FIELD_LASTPLAYED },
+    { "heard",      SMART_FIELD_HEARD },
+    { "favourite",  SMART_FIELD_FAVOURITE },
+    { "favorite",   SMART_FIELD_FAVOURITE },
+    { NULL, 0 }
+};
+
+#define SMART_IS_TEXT(f)  ((f) <= SMART_FIELD_CLOCK)
+#define SMART_IS_FLAG(f)  ((f) >= SMART_FIELD_HEARD)
+/* Fields the trigram index covers, so their literals can narrow a query */
+#define SMART_IS_INDEXED(f) ((f) <= SMART_FIELD_ANY)
+
+struct SmartParser {
+    struct SmartQuery *q;
+    CONST_STRPTR p;
+    ULONG  tok;
+    UBYTE  cmp;                     /* SMART_CMP_* of a SMART_TOK_CMP */
+    char   word[128];               /* text of a word or string token */
+    BOOL   failed;
+};
+
+/* Same Latin-1 folding as the trigram index */
+static UBYTE
+SmartPL_Lower(UBYTE c)
+{
+    return (UBYTE)((c >= 'A' && c <= 'Z') || (c >= 0xC0 && c <= 0xDE && c != 0xD7)
+                   ? c + 32 : c);
+}
+
+static void
+SmartPL_Fail(struct SmartParser *ps, CONST_STRPTR what, CONST_STRPTR arg)
+{
+    if (ps->failed) return;
+    ps->failed = TRUE;
+    if (arg) {
+        snprintf(ps->q->error, sizeof(ps->q->error), what, arg);
+    } else {
+        strncpy(ps->q->error, what, sizeof(ps->q->error) - 1);
+        ps->q->error[sizeof(ps->q->error) - 1] = '\0';
+    }
+}
+
+static BOOL
+SmartPL_IsWordChar(UBYTE c)
+{
+    return c > ' ' && !strchr("()~=!<>\"&|", c);
+}
+
+static void
+SmartPL_NextToken(struct SmartParser *ps)
+{
+    CONST_STRPTR p = ps->p;
+    ULONG len = 0;
+
+    while (*p == ' ' || *p == '\t') p++;
+    ps->word[0] = '\0';
+
+    switch (*p) {
+        case '\0':
+            ps->tok = SMART_TOK_END;
+            break;
+        case '(':
+            ps->tok = SMART_TOK_LPAREN;
+            p++;
+            break;
+        case ')':
+            ps->tok = SMART_TOK_RPAREN;
+            p++;
+            break;
+        case '"':
+            for (p++; *p && *p != '"'; p++) {
+                if (len < sizeof(ps->word) - 1) ps->word[len++] = *p;
+            }
+            ps->word[len] = '\0';
+            if (*p != '"') {
+                SmartPL_Fail(ps, "Missing closing quote", NULL);
+                ps->tok = SMART_TOK_END;
+                break;
+            }
+            p++;
+            ps->tok = SMART_TOK_STRING;
+            break;
+        case '&':
+        case '|':
+            if (p[1] != p[0]) {
+                SmartPL_Fail(ps, "Use && or || (or AND, OR)", NULL);
+                ps->tok = SMART_TOK_END;
+                break;
+            }
+            ps->tok = *p == '&' ? SMART_TOK_AND : SMART_TOK_OR;
+            p += 2;
+            break;
+        case '!':
+            if (p[1] == '=') {
+                ps->tok = SMART_TOK_CMP;
+                ps->cmp = SMART_CMP_NE;
+                p += 2;
+            } else {
+                ps->tok = SMART_TOK_NOT;
+                p++;
+            }
+            break;
+        case '~':
+            ps->tok = SMART_TOK_CMP;
+            ps->cmp = SMART_CMP_CONTAINS;
+            p++;
+            break;
+        case '=':
+            ps->tok = SMART_TOK_CMP;
+            ps->cmp = SMART_CMP_EQ;
+            p += p[1] == '=' ? 2 : 1;
+            break;
+        case '<':
+        case '>':
+            ps->tok = SMART_TOK_CMP;
+            if (p[1] == '=') {
+                ps->cmp = *p == '<' ? SMART_CMP_LE : SMART_CMP_GE;
+                p += 2;
+            } else {
+                ps->cmp = *p == '<' ? SMART_CMP_LT : SMART_CMP_GT;
+                p++;
+            }
+            break;
+        default:
+            while (SmartPL_IsWordChar((UBYTE)*p)) {
+                if (len < sizeof(ps->word) - 1) ps->word[len++] = *p;
+                p++;
+            }
+            ps->word[len] = '\0';
+            if (stricmp(ps->word, "and") == 0) ps->tok = SMART_TOK_AND;
+            else if (stricmp(ps->word, "or") == 0) ps->tok = SMART_TOK_OR;
+            else if (stricmp(ps->word, "not") == 0) ps->tok = SMART_TOK_NOT;
+            else ps->tok = SMART_TOK_WORD;
+            break;
+    }
+    ps->p = p;
+}
+
+static SmartOp *
+SmartPL_Emit(struct SmartParser *ps, UBYTE kind)
+{
+    SmartOp *op;
+
+    if (ps->failed) return NULL;
+    if (ps->q->op_count >= SMARTPL_MAX_OPS) {
+        SmartPL_Fail(ps, "Query is too long", NULL);
+        return NULL;
+    }
+    op = &ps->q->ops[ps->q->op_count++];
+    memset(op, 0, sizeof(*op));
+    op->kind = kind;
+    return op;
+}
+
+/* Store the current token's text, lowercased. Returns its offset. */
+static UWORD
+SmartPL_AddLiteral(struct SmartParser *ps)
+{
+    struct SmartQuery *q = ps->q;
+    ULONG len = strlen(ps->word);
+    ULONG offset = q->text_used;
+    ULONG i;
+
+    if (q->text_used + len + 1 > sizeof(q->text)) {
+        SmartPL_Fail(ps, "Query is too long", NULL);
+        return 0;
+    }
+    for (i = 0; i <= len; i++) {
+        q->text[offset + i] = (char)SmartPL_Lower((UBYTE)ps->word[i]);
+    }
+    q->text_used += len + 1;
+    return (UWORD)offset;
+}
+
+/* Every match must contain this literal: let the trigram index know. */
+static void
+SmartPL_AddFilter(struct SmartQuery *q, UWORD literal)
+{
+    ULONG used = strlen(q->filter);
+    ULONG len = strlen(&q->text[literal]);
+
+    if (used + len + 2 > sizeof(q->filter)) return;  /* the rest still filters */
+    if (used) q->filter[used++] = ' ';
+    strcpy(&q->filter[used], &q->text[literal]);
+}
+
+/* Number or m:ss. */
+static BOOL
+SmartPL_ParseNumber(CONST_STRPTR s, LONG *out)
+{
+    LONG v = 0, part = 0;
+    BOOL digits = FALSE, colon = FALSE;
+
+    for (; *s; s++) {
+        if (*s >= '0' && *s <= '9') {
+            part = part * 10 + (*s - '0');
+            digits = TRUE;
+        } else if (*s == ':' && digits && !colon) {
+            v = part * 60;
+            part = 0;
+            colon = TRUE;
+            digits = FALSE;
+        } else {
+            return FALSE;
+        }
+    }
+    if (!digits) return FALSE;
+    *out = v + part;
+    return TRUE;
+}
+
+static void SmartPL_ParseExpr(struct SmartParser *ps, BOOL required);
+
+static void
+SmartPL_ParseFactor(struct SmartParser *ps, BOOL required)
+{
+    SmartOp *op;
+    UBYTE field;
+    ULONG i;
+
+    if (ps->failed) return;
+
+    switch (ps->tok) {
+        case SMART_TOK_NOT:
+            SmartPL_NextToken(ps);
+            SmartPL_ParseFactor(ps, FALSE);
+            SmartPL_Emit(ps, SMART_OP_NOT);
+            return;
+
+        case SMART_TOK_LPAREN:
+            SmartPL_NextToken(ps);
+            SmartPL_ParseExpr(ps, required);
+            if (ps->tok != SMART_TOK_RPAREN) {
+                SmartPL_Fail(ps, "Missing )", NULL);
+                return;
+            }
+            SmartPL_NextToken(ps);
+            return;
+
+        case SMART_TOK_STRING:
+            op = SmartPL_Emit(ps, SMART_OP_TEST);
+            if (!op) return;
+            op->field = SMART_FIELD_ANY;
+            op->cmp = SMART_CMP_CONTAINS;
+            op->text = SmartPL_AddLiteral(ps);
+            if (required && !ps->failed) SmartPL_AddFilter(ps->q, op->text);
+            SmartPL_NextToken(ps);
+            return;
+
+        case SMART_TOK_WORD:
+            break;
+
+        default:
+            SmartPL_Fail(ps, ps->tok == SMART_TOK_END ? "Query ends too early"
+                                                      : "Expected a field name", NULL);
+            return;
+    }
+
+    for (i = 0; smart_fields[i].name; i++) {
+        if (stricmp(ps->word, smart_fields[i].name) == 0) break;
+    }
+    if (!smart_fields[i].name) {
+        SmartPL_Fail(ps, "Unknown field '%s'", ps->word);
+        return;
+    }
+    field = smart_fields[i].field;
+    SmartPL_NextToken(ps);
+
+    if (SMART_IS_FLAG(field)) {
+        if (ps->tok == SMART_TOK_CMP) {
+            SmartPL_Fail(ps, "'%s' is a flag: use it alone or with NOT",
+                         smart_fields[i].name);
+            return;
+        }
+        op = SmartPL_Emit(ps, SMART_OP_FLAG);
+        if (op) op->field = field;
+        return;
+    }
+
+    if (ps->tok != SMART_TOK_CMP) {
+        SmartPL_Fail(ps, "Expected ~, =, !=, <, > after '%s'", smart_fields[i].name);
+        return;
+    }
+    op = SmartPL_Emit(ps, SMART_OP_TEST);
+    if (!op) return;
+    op->field = field;
+    op->cmp = ps->cmp;
+
+    SmartPL_NextToken(ps);
+    if (ps->tok != SMART_TOK_WORD && ps->tok != SMART_TOK_STRING) {
+        SmartPL_Fail(ps, "Expected a value after '%s'", smart_fields[i].name);
+        return;
+    }
+
+    if (SMART_IS_TEXT(field)) {
+        if (op->cmp > SMART_CMP_NE) {
+            SmartPL_Fail(ps, "'%s' is text: use ~, = or !=", smart_fields[i].name);
+            return;
+        }
+        op->text = SmartPL_AddLiteral(ps);
+        if (required && SMART_IS_INDEXED(field) && op->cmp != SMART_CMP_NE
+            && !ps->failed) {
+            SmartPL_AddFilter(ps->q, op->text);
+        }
+    } else {
+        if (op->cmp == SMART_CMP_CONTAINS) {
+            SmartPL_Fail(ps, "'%s' is a number: use =, !=, <, <=, >, >=",
+                         smart_fields[i].name);
+            return;
+        }
+        if (!SmartPL_ParseNumber(ps->word, &op->number)) {
+            SmartPL_Fail(ps, "'%s' is not a number", ps->word);
+            return;
+        }
+    }
+    SmartPL_NextToken(ps);
+}
+
+static void
+SmartPL_ParseTerm(struct SmartParser *ps, BOOL required)
+{
+    SmartPL_ParseFactor(ps, required);
+    while (!ps->failed && ps->tok == SMART_TOK_AND) {
+        SmartPL_NextToken(ps);
+        SmartPL_ParseFactor(ps, required);
+        SmartPL_Emit(ps, SMART_OP_AND);
+    }
+}
+
+/* Literals under an OR are no longer required, so the filter collected
+ * since this expression began is dropped as soon as one shows up. */
+static void
+SmartPL_ParseExpr(struct SmartParser *ps, BOOL required)
+{
+    ULONG mark = strlen(ps->q->filter);
+
+    SmartPL_ParseTerm(ps, required);
+    while (!ps->failed && ps->tok == SMART_TOK_OR) {
+        ps->q->filter[mark] = '\0';
+        SmartPL_NextToken(ps);
+        SmartPL_ParseTerm(ps, FALSE);
+        SmartPL_Emit(ps, SMART_OP_OR);
+    }
+}
+
+BOOL
+SmartQuery_Compile(struct SmartQuery *q, CONST_STRPTR source)
+{
+    struct SmartParser ps;
+
+    memset(q, 0, sizeof(*q));
+    memset(&ps, 0, sizeof(ps));
+    ps.q = q;
+    ps.p = source;
+
+    SmartPL_NextToken(&ps);
+    if (ps.tok == SMART_TOK_END && !ps.failed) {
+        SmartPL_Fail(&ps, "Empty query", NULL);
+    }
+    SmartPL_ParseExpr(&ps, TRUE);
+    if (!ps.failed && ps.tok != SMART_TOK_END) {
+        SmartPL_Fail(&ps, ps.tok == SMART_TOK_RPAREN ? "Unbalanced )"
+                                                     : "Expected AND or OR", NULL);
+    }
+    return !ps.failed;
+}
+
+/* ------------------------------------------------------------------ */
+/* Evaluating                                                          */
+/* ------------------------------------------------------------------ */
+
+/* Case-insensitive substring test; needle is already lowercase. */
+static BOOL
+SmartPL_Contains(CONST_STRPTR hay, CONST_STRPTR needle)
+{
+    ULONG i;
+
+    if (!needle[0]) return TRUE;
+    for (; *hay; hay++) {
+        for (i = 0; needle[i] && SmartPL_Lower((UBYTE)hay[i]) == (UBYTE)needle[i]; i++);
+        if (!needle[i]) return TRUE;
+    }
+    return FALSE;
+}
+
+static BOOL
+SmartPL_Equals(CONST_STRPTR s, CONST_STRPTR lower)
+{
+    while (*s && SmartPL_Lower((UBYTE)*s) == (UBYTE)*lower) {
+        s++;
+        lower++;
+    }
+    return *s == '\0' && *lower == '\0';
+}
+
+/* First four-digit run of 'released', or 0 ("198?" and the like). */
+static LONG
+SmartPL_Year(CONST_STRPTR released)
+{
+    for (; *released; released++) {
+        ULONG n = 0;
+        while (n < 5 && released[n] >= '0' && released[n] <= '9') n++;
+        if (n == 4) {
+            return (released[0] - '0') * 1000 + (released[1] - '0') * 100
+                 + (released[2] - '0') * 10 + (released[3] - '0');
+        }
+        if (n) released += n - 1;
+    }
+    return 0;
+}
+
+static CONST_STRPTR
+SmartPL_FieldText(UBYTE field, const LibraryRecord *rec)
+{
+    UWORD flags = rec->info.flags;
+
+    switch (field) {
+        case SMART_FIELD_TITLE:    return rec->title;
+        case SMART_FIELD_AUTHOR:   return rec->author;
+        case SMART_FIELD_RELEASED: return rec->released;
+        case SMART_FIELD_PATH:     return rec->path;
+        case SMART_FIELD_MODEL:
+            if ((flags & SID_FLAG_MODEL_6581) && (flags & SID_FLAG_MODEL_8580)) return "both";
+            if (flags & SID_FLAG_MODEL_6581) return "6581";
+            if (flags & SID_FLAG_MODEL_8580) return "8580";
+            return "";
+        case SMART_FIELD_CLOCK:
+            if ((flags & SID_FLAG_CLOCK_PAL) && (flags & SID_FLAG_CLOCK_NTSC)) return "both";
+            if (flags & SID_FLAG_CLOCK_PAL) return "pal";
+            if (flags & SID_FLAG_CLOCK_NTSC) return "ntsc";
+            return "";
+    }
+    return "";
+}
+
+static BOOL
+SmartPL_TestText(const SmartOp *op, CONST_STRPTR value, CONST_STRPTR literal)
+{
+    switch (op->cmp) {
+        case SMART_CMP_CONTAINS: return SmartPL_Contains(value, literal);
+        case SMART_CMP_EQ:       return SmartPL_Equals(value, literal);
+        default:                 return !SmartPL_Equals(value, literal);
+    }
+}
+
+/* Evaluation state for one record: its statistics are looked up at most
+ * once, and only if the query asks. */
+struct SmartRecordState {
+    struct ObjApp *obj;
+    const LibraryRecord *rec;
+    PlayStats *stats;
+    BOOL stats_done;
+};
+
+static PlayStats *
+SmartPL_Stats(struct SmartRecordState *rs)
+{
+    if (!rs->stats_done) {
+        rs->stats = PlayStats_Find(rs->obj->play_stats, rs->rec->info.md5);
+        rs->stats_done = TRUE;
+    }
+    return rs->stats;
+}
+
+/* Value of a numeric field; FALSE if the catalogue doesn't know it. */
+static BOOL
+SmartPL_FieldNumber(struct SmartQuery *q, UBYTE field, struct SmartRecordState *rs,
+                    LONG *out)
+{
+    const LibraryRecord *rec = rs->rec;
+    PlayStats *st;
+
+    switch (field) {
+        case SMART_FIELD_YEAR:
+            *out = SmartPL_Year(rec->released);
+            return *out != 0;
+        case SMART_FIELD_DURATION:
+            *out = (LONG)rec->info.duration;
+            return *out != 0;
+        case SMART_FIELD_SUBSONGS:
+            *out = rec->info.subsongs;
+            return TRUE;
+        case SMART_FIELD_LASTPLAYED:
+            st = SmartPL_Stats(rs);
+            if (!st || !st->last_played || q->now < st->last_played) return FALSE;
+            *out = (LONG)((q->now - st->last_played) / 1440);
+            return TRUE;
+    }
+
+    /* Counters: a tune with no history simply has zero of everything */
+    st = SmartPL_Stats(rs);
+    switch (field) {
+        case SMART_FIELD_PLAYS:    *out = st ? st->plays : 0; break;
+        case SMART_FIELD_SKIPS:    *out = st ? st->skips : 0; break;
+        case SMART_FIELD_FINISHES: *out = st ? st->finishes : 0; break;
+        default:                   *out = st ? (LONG)st->listened : 0; break;
+    }
+    return TRUE;
+}
+
+static BOOL
+SmartPL_Test(struct SmartQuery *q, const SmartOp *op, struct SmartRecordState *rs)
+{
+    CONST_STRPTR literal = &q->text[op->text];
+    const LibraryRecord *rec = rs->rec;
+    LONG v;
+
+    if (op->field == SMART_FIELD_ANY) {
+        return SmartPL_Contains(rec->title, literal)
+            || SmartPL_Contains(rec->author, literal)
+            || SmartPL_Contains(rec->released, literal)
+            || SmartPL_Contains(rec->path, literal);
+    }
+    if (SMART_IS_TEXT(op->field)) {
+        return SmartPL_TestText(op, SmartPL_FieldText(op->field, rec), literal);
+    }
+
+    if (!SmartPL_FieldNumber(q, op->field, rs, &v)) return FALSE;
+    switch (op->cmp) {
+        case SMART_CMP_EQ: return v == op->number;
+        case SMART_CMP_NE: return v != op->number;
+        case SMART_CMP_LT: return v < op->number;
+        case SMART_CMP_LE: return v <= op->number;
+        case SMART_CMP_GT: return v > op->number;
+        default:           return v >= op->number;
+    }
+}
+
+BOOL
+SmartQuery_Match(struct SmartQuery *q, struct ObjApp *obj, const LibraryRecord *rec)
+{
+    struct SmartRecordState rs;
+    BOOL stack[SMARTPL_MAX_OPS];
+    ULONG sp = 0;
+    ULONG i;
+
+    rs.obj = obj;
+    rs.rec = rec;
+    rs.stats = NULL;
+    rs.stats_done = FALSE;
+
+    /* Compile only emits well-formed programs, so the stack never
+     * underflows and ends with exactly one value. */
+    for (i = 0; i < q->op_count; i++) {
+        const SmartOp *op = &q->ops[i];
+
+        switch (op->kind) {
+            case SMART_OP_TEST:
+                stack[sp++] = SmartPL_Test(q, op, &rs);
+                break;
+            case SMART_OP_FLAG:
+                stack[sp++] = MD5Set_Contains(op->field == SMART_FIELD_HEARD
+                                              ? obj->heard_db : obj->favourites,
+                                              rec->info.md5);
+                break;
+            case SMART_OP_AND:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] && stack[sp];
+                break;
+            case SMART_OP_OR:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] || stack[sp];
+                break;
+            case SMART_OP_NOT:
+                stack[sp - 1] = !stack[sp - 1];
+                break;
+        }
+    }
+    return sp > 0 && stack[sp - 1];
+}
+
+/* ------------------------------------------------------------------ */
+/* Materializing                                                       */
+/* ------------------------------------------------------------------ */
+
+static void
+SmartPL_SetStatus(struct ObjApp *obj, CONST_STRPTR text)
+{
+    if (obj->TXT_LibraryStatus) set(obj->TXT_LibraryStatus, MUIA_Text_Contents, text);
+    APP_UpdateStatus(text);
+}
+
+static void
+SmartPL_Now(struct SmartQuery *q)
+{
+    struct DateStamp now;
+    DateStamp(&now);
+    q->now = (ULONG)now.ds_Days * 1440 + now.ds_Minute;
+}
+
+struct SmartScan {
+    struct ObjApp *obj;
+    struct SmartPlaylist *sp;
+    ULONG capacity;
+    ULONG seen;
+    BOOL  failed;
+};
+
+static BOOL
+SmartPL_Collect(ULONG index, const LibraryRecord *rec, APTR user)
+{
+    struct SmartScan *scan = user;
+    struct SmartPlaylist *sp = scan->sp;
+
+    if (++scan->seen % SMARTPL_PUMP_EVERY == 0 && APP_PumpEvents(scan->obj)) {
+        return FALSE;
+    }
+    if (!SmartQuery_Match(&sp->query, scan->obj, rec)) return TRUE;
+
+    if (sp->match_count >= scan->capacity) {
+        ULONG capacity = scan->capacity ? scan->capacity * 2 : 1024;
+        ULONG *grown = AllocVec(capacity * sizeof(ULONG), MEMF_PUBLIC);
+
+        if (!grown) {
+            scan->failed = TRUE;
+            return FALSE;
+        }
+        if (sp->matches) {
+            CopyMem(sp->matches, grown, sp->match_count * sizeof(ULONG));
+            FreeVec(sp->matches);
+        }
+        sp->matches = grown;
+        scan->capacity = capacity;
+    }
+    sp->matches[sp->match_count++] = index;
+    return TRUE;
+}
+
+/* Run the query over the whole catalogue into sp->matches, in shuffled
+ * order when shuffle mode is on. Returns the match count, -1 on failure. */
+static LONG
+SmartPL_Evaluate(struct ObjApp *obj, struct SmartPlaylist *sp)
+{
+    struct SmartScan scan;
+    ULONG *cand = NULL;
+    LONG ncand = -1;
+    ULONG i;
+
+    if (sp->matches) FreeVec(sp->matches);
+    sp->matches = NULL;
+    sp->match_count = 0;
+    sp->next = 0;
+    SmartPL_Now(&sp->query);
+
+    memset(&scan, 0, sizeof(scan));
+    scan.obj = obj;
+    scan.sp = sp;
+
+    if (sp->query.filter[0]) {
+        ncand = Trigram_Candidates(obj->library, sp->query.filter, &cand);
+    }
+
+    if (ncand >= 0) {
+        /* Matches are a subset of the candidates, in the same order, so
+         * they are compacted into the candidate array in place */
+        LibraryRecord rec;
+
+        for (i = 0; i < (ULONG)ncand; i++) {
+            if (Library_ReadRecord(obj->library, cand[i], &rec)
+                && SmartQuery_Match(&sp->query, obj, &rec)) {
+                cand[sp->match_count++] = cand[i];
+            }
+        }
+        sp->matches = cand;
+    } else {
+        Library_ForEach(obj->library, SmartPL_Collect, &scan);
+        if (scan.failed || obj->quit_requested) return -1;
+    }
+
+    if (obj->shuffle_mode) {
+        for (i = sp->match_count; i > 1; i--) {
+            ULONG j = Shuffle_Random(i);
+            ULONG t = sp->matches[i - 1];
+            sp->matches[i - 1] = sp->matches[j];
+            sp->matches[j] = t;
+        }
+    }
+    return (LONG)sp->match_count;
+}
+
+static BOOL
+SmartPL_AddRecord(struct ObjApp *obj, const LibraryRecord *rec)
+{
+    char full[768];
+    STRPTR title;
+    BOOL ok;
+
+    strncpy(full, obj->library->hdr.root, sizeof(full) - 1);
+    full[sizeof(full) - 1] = '\0';
+    AddPart(full, (STRPTR)rec->path, sizeof(full));
+
+    title = FormatSIDTitle(rec->title, rec->author, (UBYTE)rec->info.flags);
+    ok = AddPlaylistEntryWithInfo(obj, full, title, rec->info.md5, rec->info.subsongs);
+    if (title) FreeVec(title);
+    return ok;
+}
+
+/* Show entries first.. in the list without redrawing the rows before. */
+static void
+SmartPL_ShowAdded(struct ObjApp *obj, ULONG first)
+{
+    if (obj->search_mode_filter && obj->search_text[0]) {
+        UpdateSearchMatches();
+        UpdateFilteredPlaylistDisplay();
+        return;
+    }
+    APP_AppendPlaylistRows(first);
+}
+
+ULONG
+SmartPL_TopUp(struct ObjApp *obj)
+{
+    struct SmartPlaylist *sp = obj->smart_playlist;
+    ULONG first = obj->playlist_count;
+    ULONG played;
+    BOOL rerun = FALSE;
+    LibraryRecord rec;
+
+    if (!sp || !obj->library) return 0;
+
+    SmartPL_Now(&sp->query);
+    played = obj->current_entry ? obj->current_index + 1 : 0;
+
+    while (obj->playlist_count < played + SMARTPL_LOOKAHEAD) {
+        if (sp->next >= sp->match_count) {
+            /* One new rotation per call at most: a query that has just
+             * matched nothing won't match anything on a second try */
+            if (!obj->repeat_mode || rerun) break;
+            rerun = TRUE;
+            if (SmartPL_Evaluate(obj, sp) <= 0) break;
+            sp->rotation++;
+            continue;
+        }
+
+        /* Statistics move on while the list plays, so look again */
+        if (!Library_ReadRecord(obj->library, sp->matches[sp->next++], &rec)
+            || !SmartQuery_Match(&sp->query, obj, &rec)) {
+            continue;
+        }
+        if (!SmartPL_AddRecord(obj, &rec)) break;
+    }
+
+    if (obj->playlist_count > first) SmartPL_ShowAdded(obj, first);
+    return obj->playlist_count - first;
+}
+
+/* Compile and evaluate query into a new obj->smart_playlist. */
+static LONG
+SmartPL_Open(struct ObjApp *obj, CONST_STRPTR query)
+{
+    struct SmartPlaylist *sp;
+    char msg[128];
+    LONG found;
+
+    sp = AllocVec(sizeof(struct SmartPlaylist), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!sp) return -1;
+
+    if (!SmartQuery_Compile(&sp->query, query)) {
+        snprintf(msg, sizeof(msg), "Query: %s", sp->query.error);
+        SmartPL_SetStatus(obj, msg);
+        FreeVec(sp);
+        return -1;
+    }
+    strncpy(sp->source, query, sizeof(sp->source) - 1);
+
+    if (!LoadSIDLibrary()) {
+        SmartPL_SetStatus(obj, "No library yet - press Rescan to index your HVSC folder");
+        FreeVec(sp);
+        return -1;
+    }
+
+    SmartPL_Free(obj);
+    obj->smart_playlist = sp;
+
+    SmartPL_SetStatus(obj, "Running query...");
+    set(obj->App, MUIA_Application_Sleep, TRUE);
+    found = SmartPL_Evaluate(obj, sp);
+    set(obj->App, MUIA_Application_Sleep, FALSE);
+
+    if (found < 0) {
+        SmartPL_Free(obj);
+        if (!obj->quit_requested) SmartPL_SetStatus(obj, "Query failed");
+        return -1;
+    }
+    sp->rotation = 1;
+    return found;
+}
+
+LONG
+SmartPL_Start(struct ObjApp *obj, CONST_STRPTR query)
+{
+    char msg[128];
+    LONG found;
+
+    found = SmartPL_Open(obj, query);
+    if (found < 0) return -1;
+
+    strncpy(obj->smart_query, query, sizeof(obj->smart_query) - 1);
+    obj->smart_query[sizeof(obj->smart_query) - 1] = '\0';
+    U64_WriteEnvVar(ENV_ULTIMATE64_SMART_QUERY, obj->smart_query, TRUE);
+
+    FreePlaylists(obj);
+    SmartPL_TopUp(obj);
+
+    if (obj->playlist_count > 0) {
+        obj->current_index = 0;
+        obj->current_entry = &obj->playlist[0];
+        set(obj->LSV_PlaylistList, MUIA_List_Active, 0);
+    }
+    APP_UpdateCurrentSongCache();
+    APP_UpdateCurrentSongDisplay();
+
+    sprintf(msg, "Smart playlist: %ld matching SIDs", (long)found);
+    SmartPL_SetStatus(obj, msg);
+    return found;
+}
+
+BOOL
+SmartPL_Resume(struct ObjApp *obj)
+{
+    char msg[128];
+    LONG found;
+
+    if (!obj->smart_query[0]) return FALSE;
+
+    found = SmartPL_Open(obj, obj->smart_query);
+    if (found < 0) return FALSE;
+
+    SmartPL_TopUp(obj);
+    sprintf(msg, "Smart playlist resumed: %ld matching SIDs", (long)found);
+    APP_UpdateStatus(msg);
+    return TRUE;
+}
+
+void
+SmartPL_Stop(struct ObjApp *obj)
+{
+    if (!obj->smart_query[0] && !obj->smart_playlist) return;
+
+    SmartPL_Free(obj);
+    obj->smart_query[0] = '\0';
+    DeleteVar(ENV_ULTIMATE64_SMART_QUERY, GVF_GLOBAL_ONLY);
+    DeleteFile("ENVARC:" ENV_ULTIMATE64_SMART_QUERY);
+}
+
+void
+SmartPL_Free(struct ObjApp *obj)
+{
+    struct SmartPlaylist *sp = obj->smart_playlist;
+
+    if (!sp) return;
+    if (sp->matches) FreeVec(sp->matches);
+    FreeVec(sp);
+    obj->smart_playlist = NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Library window buttons                                              */
+/* ------------------------------------------------------------------ */
+
+BOOL
+APP_SmartStart(void)
+{
+    STRPTR query = NULL;
+
+    if (!objApp) return FALSE;
+
+    get(objApp->STR_SmartQuery, MUIA_String_Contents, &query);
+    if (SmartPL_Start(objApp, query ? query : (STRPTR)"") <= 0) return FALSE;
+
+    if (objApp->connection && objApp->playlist_count > 0) APP_Play();
+    return TRUE;
+}
+
+BOOL
+APP_SmartStop(void)
+{
+    if (!objApp) return FALSE;
+    if (!objApp->smart_playlist) return TRUE;
+
+    SmartPL_Stop(objApp);
+    SmartPL_SetStatus(objApp, "Smart playlist stopped - queued tracks stay");
+    return TRUE;
+}
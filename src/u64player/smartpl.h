@@ -0,0 +1,138 @@
+/* Smart playlists: queries over the HVSC catalogue and play statistics.
+ *
+ * A query such as
+ *
+ *     author ~ "Hubbard" AND year < 1988 AND duration > 120 AND NOT heard
+ *
+ * is compiled once into a small postfix program and run against the
+ * catalogue records (library.c) — the SID files themselves are never
+ * opened. Grammar:
+ *
+ *     expr    := term { OR term }
+ *     term    := factor { AND factor }
+ *     factor  := NOT factor | '(' expr ')' | "text" | field [op value]
+ *     op      := ~  =  !=  <  <=  >  >=
+ *
+ * Keywords are case-insensitive; && || ! work too. A bare "text" matches
+ * any of title, author, released or path. Text fields compare without
+ * case: ~ is contains, = and != whole-field. Numeric fields take numbers
+ * (duration also m:ss); a value the catalogue doesn't know (no year in
+ * 'released', a tune missing from the song-length DB, a never-played
+ * tune's lastplayed) fails every comparison. heard and favourite are flags.
+ *
+ * Text literals that every match must contain — ones not under NOT or OR —
+ * are fed to the trigram index first, so only the records it returns are
+ * read. Queries without one walk the catalogue block by block.
+ *
+ * The matching record numbers are kept (shuffled when shuffle mode is on)
+ * and turned into playlist entries a few at a time as playback advances,
+ * each re-checked first so statistics that changed meanwhile still count.
+ * With repeat on, running out re-runs the query for a new rotation.
+ */
+
+#ifndef U64_SMARTPL_H
+#define U64_SMARTPL_H
+
+#include <exec/types.h>
+
+#include "library.h"
+
+#define SMARTPL_MAX_OPS     64      /* postfix program length */
+#define SMARTPL_TEXT_SIZE   512     /* literal storage per query */
+#define SMARTPL_LOOKAHEAD   8       /* tracks kept queued past the current */
+
+enum SMARTPL_FIELDS {
+    SMART_FIELD_TITLE,
+    SMART_FIELD_AUTHOR,
+    SMART_FIELD_RELEASED,
+    SMART_FIELD_PATH,
+    SMART_FIELD_ANY,                /* title, author, released or path */
+    SMART_FIELD_MODEL,              /* "6581", "8580", "both" */
+    SMART_FIELD_CLOCK,              /* "pal", "ntsc", "both" */
+    SMART_FIELD_YEAR,
+    SMART_FIELD_DURATION,           /* start song, seconds */
+    SMART_FIELD_SUBSONGS,
+    SMART_FIELD_PLAYS,
+    SMART_FIELD_SKIPS,
+    SMART_FIELD_FINISHES,
+    SMART_FIELD_LISTENED,           /* seconds, all plays together */
+    SMART_FIELD_LASTPLAYED,         /* days ago */
+    SMART_FIELD_HEARD,
+    SMART_FIELD_FAVOURITE
+};
+
+enum SMARTPL_OPS {
+    SMART_OP_TEST,                  /* field cmp value */
+    SMART_OP_FLAG,                  /* field is set */
+    SMART_OP_AND,
+    SMART_OP_OR,
+    SMART_OP_NOT
+};
+
+enum SMARTPL_CMPS {
+    SMART_CMP_CONTAINS,
+    SMART_CMP_EQ,
+    SMART_CMP_NE,
+    SMART_CMP_LT,
+    SMART_CMP_LE,
+    SMART_CMP_GT,
+    SMART_CMP_GE
+};
+
+typedef struct SmartOp {
+    UBYTE  kind;                    /* SMART_OP_* */
+    UBYTE  field;                   /* SMART_FIELD_* */
+    UBYTE  cmp;                     /* SMART_CMP_* */
+    UBYTE  reserved;
+    LONG   number;
+    UWORD  text;                    /* offset of the lowercase literal */
+    UWORD  reserved2;
+} SmartOp;
+
+struct SmartQuery {
+    SmartOp ops[SMARTPL_MAX_OPS];
+    ULONG  op_count;
+    char   text[SMARTPL_TEXT_SIZE]; /* NUL-terminated literals */
+    ULONG  text_used;
+    char   filter[SMARTPL_TEXT_SIZE]; /* required literals, space separated */
+    ULONG  now;                     /* minutes since 1.1.1978, for lastplayed */
+    char   error[80];               /* why SmartQuery_Compile failed */
+};
+
+/* An active smart playlist (ObjApp.smart_playlist). */
+struct SmartPlaylist {
+    struct SmartQuery query;
+    char   source[256];
+    ULONG *matches;                 /* catalogue record numbers */
+    ULONG  match_count;
+    ULONG  next;                    /* matches[next] is queued next */
+    ULONG  rotation;                /* passes started, 1 = the first */
+};
+
+/* Compile source into q. On failure q->error says what is wrong. */
+BOOL SmartQuery_Compile(struct SmartQuery *q, CONST_STRPTR source);
+
+/* Does rec satisfy q? Statistics and the heard/favourite sets come from
+ * obj; set q->now first if the query uses lastplayed. */
+BOOL SmartQuery_Match(struct SmartQuery *q, struct ObjApp *obj,
+                      const LibraryRecord *rec);
+
+/* Replace the playlist with query's matches and remember it across
+ * restarts. Returns the number of matches, or -1 (status already shown). */
+LONG SmartPL_Start(struct ObjApp *obj, CONST_STRPTR query);
+
+/* Pick the remembered query up again after a restart or rescan, keeping
+ * the playlist as it is. */
+BOOL SmartPL_Resume(struct ObjApp *obj);
+
+/* Queue matches until SMARTPL_LOOKAHEAD tracks follow the current one.
+ * Returns the number of entries added. */
+ULONG SmartPL_TopUp(struct ObjApp *obj);
+
+/* Stop materializing and forget the query; the playlist stays. */
+void SmartPL_Stop(struct ObjApp *obj);
+
+/* Release the smart playlist but keep the query for the next start. */
+void SmartPL_Free(struct ObjApp *obj);
+
+#endif
@@ -6,13 +6,33 @@
  *
  * Lookups go through SongDB_Find() for O(~15) bucket-chain scans instead of
  * O(60 000) over a single linked list.
+ *
+ * "Download Songlengths" parses the body as it arrives (SongDBStream) while
+ * it is saved to disk, then writes the binary cache — the text is never
+ * read back.
+ *
+ * Between full downloads a release update can be applied instead: a small
+ * text file holding only what changed,
+ *
+ *     ; comments as in Songlengths.md5
+ *     from=80                      release it applies to (optional)
+ *     to=81                        release it brings the database to
+ *     <32-char-md5-hex>=MM:SS ...  entry added or changed
+ *     -<32-char-md5-hex>           entry removed
+ *
+ * It is patched straight into the binary cache: same-length entries are
+ * rewritten where they are, others are marked dead and appended, and the
+ * header records the release. The cache is compacted once dead records
+ * pass an eighth of the live ones.
  */
 
 #include <dos/dos.h>
 #include <exec/memory.h>
 #include <exec/types.h>
+#include <libraries/asl.h>
 #include <libraries/mui.h>
 
+#include <proto/asl.h>
 #include <proto/dos.h>
 #include <proto/exec.h>
 #include <proto/intuition.h>
@@ -23,28 +43,9 @@
 #include <string.h>
 
 #include "player.h"
+#include "env_utils.h"
 #include "file_utils.h"
 
-/* ------------------------------------------------------------------ */
-/* Event pump helper                                                   */
-/* ------------------------------------------------------------------ */
-
-/* Pump pending MUI events without blocking. If the user triggered
- * MUIV_Application_ReturnID_Quit we set obj->quit_requested and return TRUE
- * so the caller can bail out of its long-running loop; main() honours the
- * flag on return. */
-static BOOL
-SongDB_PumpEvents(struct ObjApp *obj)
-{
-    ULONG signals;
-    ULONG id = DoMethod(obj->App, MUIM_Application_Input, &signals);
-    if (id == MUIV_Application_ReturnID_Quit) {
-        obj->quit_requested = TRUE;
-        return TRUE;
-    }
-    return FALSE;
-}
-
 /* ------------------------------------------------------------------ */
 /* Hash table helpers                                                  */
 /* ------------------------------------------------------------------ */
@@ -72,6 +73,19 @@ SongDB_InsertEntry(struct SongLengthDB *db, SongLengthEntry *entry)
     db->entry_count++;
 }
 
+/* Unlinks entry from its bucket chain and frees it. */
+static void
+SongDB_RemoveEntry(struct SongLengthDB *db, SongLengthEntry *entry)
+{
+    SongLengthEntry **link = &db->buckets[SongDB_BucketIndex(entry->md5)];
+    while (*link && *link != entry) link = &(*link)->next;
+    if (!*link) return;
+    *link = entry->next;
+    db->entry_count--;
+    if (entry->lengths) FreeVec(entry->lengths);
+    FreeVec(entry);
+}
+
 SongLengthEntry *
 SongDB_Find(struct SongLengthDB *db, const UBYTE md5[MD5_HASH_SIZE])
 {
@@ -159,14 +173,20 @@ BOOL CheckSongLengthsFile(char *filepath, ULONG filepath_size)
 /* ------------------------------------------------------------------ */
 
 #define SONGDB_CACHE_MAGIC "U64SDBv1"      /* 8 bytes, no terminator needed */
-#define SONGDB_CACHE_VERSION 1
+#define SONGDB_CACHE_VERSION 2
+
+/* Each record: md5[16], UWORD num_subsongs, UWORD flags, ULONG lengths[] */
+#define SONGDB_RECORD_HEAD   (MD5_HASH_SIZE + 4)
+#define SONGDB_RECORD_DEAD   0x0001  /* superseded or removed by an update */
 
 struct SongDBCacheHeader {
     char   magic[8];
     ULONG  version;
     ULONG  source_size;
     struct DateStamp source_mtime;   /* 3 × LONG = 12 bytes */
-    ULONG  entry_count;
+    ULONG  entry_count;              /* live records */
+    ULONG  record_count;             /* all records, dead ones included */
+    ULONG  hvsc_version;             /* release of the last update; 0 = none */
 };
 
 /* Derive "<source>.cache" path. Writes to out[out_size]. */
@@ -180,7 +200,7 @@ SongDB_CachePath(char *out, ULONG out_size, CONST_STRPTR source_path)
 }
 
 /* Fetch source file's size and DateStamp. Returns TRUE on success. */
-static BOOL
+BOOL
 SongDB_SourceStat(CONST_STRPTR source_path, ULONG *out_size,
                   struct DateStamp *out_mtime)
 {
@@ -206,6 +226,19 @@ SongDB_SourceStat(CONST_STRPTR source_path, ULONG *out_size,
     return ok;
 }
 
+/* TRUE if a cache built from a source of cached_size/cached_mtime still
+ * describes the source as it is now (src_size/src_mtime). */
+BOOL
+SongDB_SameSource(ULONG cached_size, const struct DateStamp *cached_mtime,
+                  ULONG src_size, const struct DateStamp *src_mtime)
+{
+    if (cached_size != src_size) return FALSE;
+    if (cached_mtime->ds_Days   != src_mtime->ds_Days)   return FALSE;
+    if (cached_mtime->ds_Minute != src_mtime->ds_Minute) return FALSE;
+    if (cached_mtime->ds_Tick   != src_mtime->ds_Tick)   return FALSE;
+    return TRUE;
+}
+
 /* Compares src_size/src_mtime against the cache header. */
 static BOOL
 SongDB_CacheFresh(const struct SongDBCacheHeader *hdr, ULONG src_size,
@@ -213,11 +246,8 @@ SongDB_CacheFresh(const struct SongDBCacheHeader *hdr, ULONG src_size,
 {
     if (memcmp(hdr->magic, SONGDB_CACHE_MAGIC, 8) != 0) return FALSE;
     if (hdr->version != SONGDB_CACHE_VERSION) return FALSE;
-    if (hdr->source_size != src_size) return FALSE;
-    if (hdr->source_mtime.ds_Days   != src_mtime->ds_Days)   return FALSE;
-    if (hdr->source_mtime.ds_Minute != src_mtime->ds_Minute) return FALSE;
-    if (hdr->source_mtime.ds_Tick   != src_mtime->ds_Tick)   return FALSE;
-    return TRUE;
+    return SongDB_SameSource(hdr->source_size, &hdr->source_mtime,
+                             src_size, src_mtime);
 }
 
 /* Populate a fresh DB from the cache file. Returns NULL on any failure. */
@@ -246,21 +276,30 @@ SongDB_ReadCache(CONST_STRPTR cache_path, ULONG src_size,
         return NULL;
     }
 
-    for (ULONG i = 0; i < hdr.entry_count; i++) {
+    ULONG offset = sizeof(hdr);
+    for (ULONG i = 0; i < hdr.record_count; i++) {
         UBYTE md5[MD5_HASH_SIZE];
         UWORD num_subsongs;
-        UWORD pad;
+        UWORD flags;
+        ULONG record = offset;
 
         if (Read(file, md5, MD5_HASH_SIZE) != MD5_HASH_SIZE) goto corrupt;
         if (Read(file, &num_subsongs, 2) != 2) goto corrupt;
-        if (Read(file, &pad, 2) != 2) goto corrupt;
+        if (Read(file, &flags, 2) != 2) goto corrupt;
         if (num_subsongs == 0 || num_subsongs > 256) goto corrupt;
+        offset += SONGDB_RECORD_HEAD + sizeof(ULONG) * num_subsongs;
+
+        if (flags & SONGDB_RECORD_DEAD) {
+            if (Seek(file, sizeof(ULONG) * num_subsongs, OFFSET_CURRENT) < 0) goto corrupt;
+            continue;
+        }
 
         SongLengthEntry *e
             = AllocVec(sizeof(SongLengthEntry), MEMF_PUBLIC | MEMF_CLEAR);
         if (!e) goto corrupt;
         CopyMem(md5, e->md5, MD5_HASH_SIZE);
         e->num_subsongs = num_subsongs;
+        e->cache_offset = record;
         e->lengths = AllocVec(sizeof(ULONG) * num_subsongs, MEMF_PUBLIC);
         if (!e->lengths) {
             FreeVec(e);
@@ -276,7 +315,11 @@ SongDB_ReadCache(CONST_STRPTR cache_path, ULONG src_size,
     }
 
     Close(file);
-    U64_DEBUG("songdb cache loaded: %lu entries", (unsigned long)db->entry_count);
+    db->record_count = hdr.record_count;
+    db->hvsc_version = hdr.hvsc_version;
+    strncpy(db->cache_path, cache_path, sizeof(db->cache_path) - 1);
+    U64_DEBUG("songdb cache loaded: %lu entries, release %lu",
+              (unsigned long)db->entry_count, (unsigned long)db->hvsc_version);
     return db;
 
 corrupt:
@@ -286,12 +329,14 @@ corrupt:
     return NULL;
 }
 
-/* Serialise db to cache_path. Best-effort; failures are logged but ignored. */
+/* Serialise db to cache_path, which then backs db for updates.
+ * Best-effort; failures are logged but ignored. */
 static void
-SongDB_WriteCache(const struct SongLengthDB *db, CONST_STRPTR cache_path,
+SongDB_WriteCache(struct SongLengthDB *db, CONST_STRPTR cache_path,
                   ULONG src_size, const struct DateStamp *src_mtime)
 {
     if (!db) return;
+    db->cache_path[0] = '\0';
 
     BPTR file = Open(cache_path, MODE_NEWFILE);
     if (!file) {
@@ -306,21 +351,29 @@ SongDB_WriteCache(const struct SongLengthDB *db, CONST_STRPTR cache_path,
     hdr.source_size = src_size;
     hdr.source_mtime = *src_mtime;
     hdr.entry_count = db->entry_count;
+    hdr.record_count = db->entry_count;
+    hdr.hvsc_version = db->hvsc_version;
 
     if (Write(file, &hdr, sizeof(hdr)) != sizeof(hdr)) goto fail;
 
-    UWORD pad = 0;
+    UWORD flags = 0;
+    ULONG offset = sizeof(hdr);
     for (ULONG i = 0; i < SONGDB_BUCKETS; i++) {
         for (SongLengthEntry *e = db->buckets[i]; e; e = e->next) {
             if (Write(file, e->md5, MD5_HASH_SIZE) != MD5_HASH_SIZE) goto fail;
             if (Write(file, &e->num_subsongs, 2) != 2) goto fail;
-            if (Write(file, &pad, 2) != 2) goto fail;
+            if (Write(file, &flags, 2) != 2) goto fail;
             LONG want = (LONG)(sizeof(ULONG) * e->num_subsongs);
             if (Write(file, e->lengths, want) != want) goto fail;
+            e->cache_offset = offset;
+            offset += SONGDB_RECORD_HEAD + want;
         }
     }
 
     Close(file);
+    db->record_count = db->entry_count;
+    strncpy(db->cache_path, cache_path, sizeof(db->cache_path) - 1);
+    db->cache_path[sizeof(db->cache_path) - 1] = '\0';
     U64_DEBUG("songdb cache written: %s (%lu entries)",
               cache_path, (unsigned long)db->entry_count);
     return;
@@ -335,6 +388,81 @@ fail:
 /* Text parser (single pass, byte-progress)                            */
 /* ------------------------------------------------------------------ */
 
+/* Split a "<md5>=MM:SS MM:SS ..." line (CR/LF already stripped) into md5
+ * and lengths[256]. Returns the number of lengths, 0 if malformed. line is
+ * modified. */
+static UWORD
+SongDB_ParseEntry(char *line, UBYTE md5[MD5_HASH_SIZE], ULONG lengths[256])
+{
+    char *eq = strchr(line, '=');
+    if (!eq) return 0;
+    *eq = '\0';
+    char *md5_str = line;
+    char *length_str = eq + 1;
+
+    if (strlen(md5_str) != 32) return 0;
+    if (!HexStringToMD5(md5_str, md5)) return 0;
+
+    /* Parse space/tab-delimited list of MM:SS durations. */
+    UWORD num_lengths = 0;
+
+    char length_copy[512];
+    strncpy(length_copy, length_str, sizeof(length_copy) - 1);
+    length_copy[sizeof(length_copy) - 1] = '\0';
+
+    char *token = strtok(length_copy, " \t");
+    while (token && num_lengths < 256) {
+        ULONG duration = ParseTimeString(token);
+        if (duration > 0) {
+            lengths[num_lengths++] = duration + 1; /* +1s buffer */
+        }
+        token = strtok(NULL, " \t");
+    }
+    return num_lengths;
+}
+
+/* Strip CR/LF; TRUE if what is left is a comment or empty. */
+static BOOL
+SongDB_SkipLine(char *line)
+{
+    char *nl = strchr(line, '\n');
+    if (nl) *nl = '\0';
+    nl = strchr(line, '\r');
+    if (nl) *nl = '\0';
+
+    return line[0] == '\0' || line[0] == '#' || line[0] == ';';
+}
+
+/* Parse one line of Songlengths.md5 into db; comments, section headers and
+ * malformed lines are ignored. line is modified. */
+static void
+SongDB_ParseLine(struct SongLengthDB *db, char *line)
+{
+    UBYTE md5[MD5_HASH_SIZE];
+    ULONG lengths[256];
+    UWORD num_lengths;
+
+    if (SongDB_SkipLine(line)) return;
+
+    num_lengths = SongDB_ParseEntry(line, md5, lengths);
+    if (num_lengths == 0) return;
+
+    SongLengthEntry *entry
+        = AllocVec(sizeof(SongLengthEntry), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!entry) return;
+
+    CopyMem(md5, entry->md5, MD5_HASH_SIZE);
+    entry->num_subsongs = num_lengths;
+    entry->lengths = AllocVec(sizeof(ULONG) * num_lengths, MEMF_PUBLIC);
+    if (!entry->lengths) {
+        FreeVec(entry);
+        return;
+    }
+    CopyMem(lengths, entry->lengths, sizeof(ULONG) * num_lengths);
+    SongDB_InsertEntry(db, entry);
+}
+
+/* obj may be NULL (bench.c) to parse without progress or event pumping. */
 static struct SongLengthDB *
 SongDB_ParseText(struct ObjApp *obj, CONST_STRPTR filename)
 {
@@ -367,7 +495,7 @@ SongDB_ParseText(struct ObjApp *obj, CONST_STRPTR filename)
          * pumping events we MUST check for Quit — if we discard it here the
          * main loop will have nothing to wake on and the process will hang
          * after the parse finishes. */
-        if ((processed_lines % 500) == 0) {
+        if (obj && (processed_lines % 500) == 0) {
             LONG here = Seek(file, 0, OFFSET_CURRENT);
             ULONG percent = (total_bytes > 0)
                 ? (ULONG)(((LONG)((ULONG)here) * 100) / total_bytes)
@@ -377,7 +505,7 @@ SongDB_ParseText(struct ObjApp *obj, CONST_STRPTR filename)
                     (unsigned long)db->entry_count);
             APP_UpdateStatus(progress_msg);
 
-            if (SongDB_PumpEvents(obj)) {
+            if (APP_PumpEvents(obj)) {
                 U64_DEBUG("songdb parse aborted — quit requested");
                 Close(file);
                 SongDB_FreeAll(db);
@@ -385,57 +513,7 @@ SongDB_ParseText(struct ObjApp *obj, CONST_STRPTR filename)
             }
         }
 
-        /* Strip CR/LF */
-        char *nl = strchr(line, '\n');
-        if (nl) *nl = '\0';
-        nl = strchr(line, '\r');
-        if (nl) *nl = '\0';
-
-        if (line[0] == '\0' || line[0] == '#' || line[0] == ';') continue;
-
-        char *eq = strchr(line, '=');
-        if (!eq) continue;
-        *eq = '\0';
-        char *md5_str = line;
-        char *length_str = eq + 1;
-
-        if (strlen(md5_str) != 32) continue;
-
-        UBYTE md5[MD5_HASH_SIZE];
-        if (!HexStringToMD5(md5_str, md5)) continue;
-
-        /* Parse space/tab-delimited list of MM:SS durations. */
-        ULONG lengths[256];
-        UWORD num_lengths = 0;
-
-        char length_copy[512];
-        strncpy(length_copy, length_str, sizeof(length_copy) - 1);
-        length_copy[sizeof(length_copy) - 1] = '\0';
-
-        char *token = strtok(length_copy, " \t");
-        while (token && num_lengths < 256) {
-            ULONG duration = ParseTimeString(token);
-            if (duration > 0) {
-                lengths[num_lengths++] = duration + 1; /* +1s buffer */
-            }
-            token = strtok(NULL, " \t");
-        }
-
-        if (num_lengths == 0) continue;
-
-        SongLengthEntry *entry
-            = AllocVec(sizeof(SongLengthEntry), MEMF_PUBLIC | MEMF_CLEAR);
-        if (!entry) continue;
-
-        CopyMem(md5, entry->md5, MD5_HASH_SIZE);
-        entry->num_subsongs = num_lengths;
-        entry->lengths = AllocVec(sizeof(ULONG) * num_lengths, MEMF_PUBLIC);
-        if (!entry->lengths) {
-            FreeVec(entry);
-            continue;
-        }
-        CopyMem(lengths, entry->lengths, sizeof(ULONG) * num_lengths);
-        SongDB_InsertEntry(db, entry);
+        SongDB_ParseLine(db, line);
     }
 
     Close(file);
@@ -447,10 +525,78 @@ SongDB_ParseText(struct ObjApp *obj, CONST_STRPTR filename)
     return db;
 }
 
+/* ------------------------------------------------------------------ */
+/* Streaming parser (fed chunk by chunk during the download)           */
+/* ------------------------------------------------------------------ */
+
+/* Lines longer than line[] keep their first 1023 characters, as FGets
+ * leaves them in SongDB_ParseText. */
+struct SongDBStream {
+    struct SongLengthDB *db;
+    ULONG  bytes;                   /* body bytes seen so far */
+    ULONG  line_len;
+    char   line[1024];              /* line carried over from the last chunk */
+};
+
+static BOOL
+SongDB_StreamData(const UBYTE *data, ULONG length, APTR userdata)
+{
+    struct SongDBStream *st = userdata;
+    const UBYTE *end = data + length;
+
+    st->bytes += length;
+    while (data < end) {
+        const UBYTE *nl = memchr(data, '\n', end - data);
+        ULONG take = (ULONG)((nl ? nl : end) - data);
+        ULONG room = sizeof(st->line) - 1 - st->line_len;
+
+        CopyMem((APTR)data, st->line + st->line_len, take < room ? take : room);
+        st->line_len += take < room ? take : room;
+        if (!nl) break;
+
+        st->line[st->line_len] = '\0';
+        SongDB_ParseLine(st->db, st->line);
+        st->line_len = 0;
+        data = nl + 1;
+    }
+
+    /* DownloadProgressCallback pumps events; stop if that saw Quit */
+    return !(objApp && objApp->quit_requested);
+}
+
+/* Parse a last line that had no newline. */
+static void
+SongDB_StreamFinish(struct SongDBStream *st)
+{
+    if (st->line_len > 0) {
+        st->line[st->line_len] = '\0';
+        SongDB_ParseLine(st->db, st->line);
+        st->line_len = 0;
+    }
+}
+
 /* ------------------------------------------------------------------ */
 /* Public loader                                                       */
 /* ------------------------------------------------------------------ */
 
+/* Make db the active database (freeing the old one) and write the binary
+ * cache for the source it came from. */
+static void
+SongDB_Install(struct ObjApp *obj, struct SongLengthDB *db, CONST_STRPTR filename)
+{
+    FreeSongLengthDB(obj);
+    obj->songlength_db = db;
+
+    /* Best-effort cache refresh — db is usable either way. */
+    ULONG src_size;
+    struct DateStamp src_mtime;
+    if (SongDB_SourceStat(filename, &src_size, &src_mtime)) {
+        char cache_path[512];
+        SongDB_CachePath(cache_path, sizeof(cache_path), filename);
+        SongDB_WriteCache(db, cache_path, src_size, &src_mtime);
+    }
+}
+
 /* Replace any existing DB with a freshly-parsed one from `filename`, then
  * write the binary cache. Warm startups bypass this via AutoLoadSongLengths.
  */
@@ -462,18 +608,50 @@ LoadSongLengthsWithProgress(struct ObjApp *obj, CONST_STRPTR filename)
     struct SongLengthDB *db = SongDB_ParseText(obj, filename);
     if (!db) return FALSE;
 
-    obj->songlength_db = db;
+    SongDB_Install(obj, db, filename);
+    return TRUE;
+}
 
-    /* Best-effort cache refresh — parse errors above already populated db. */
-    ULONG src_size;
-    struct DateStamp src_mtime;
-    if (SongDB_SourceStat(filename, &src_size, &src_mtime)) {
-        char cache_path[512];
-        SongDB_CachePath(cache_path, sizeof(cache_path), filename);
-        SongDB_WriteCache(db, cache_path, src_size, &src_mtime);
+/* Re-read durations (and subsong counts the DB knows better) for every
+ * playlist entry after the database changed. Returns how many entries
+ * gained subsongs. */
+static ULONG
+SongDB_RefreshPlaylist(struct ObjApp *obj)
+{
+    ULONG updated = 0;
+    ULONG entry_num = 0;
+
+    while (entry_num < obj->playlist_count) {
+        PlaylistEntry *entry = &obj->playlist[entry_num];
+
+        entry_num++;
+        if ((entry_num % 25) == 0) {
+            char progress_msg[128];
+            sprintf(progress_msg, "Updating playlist... %u/%u",
+                    (unsigned int)entry_num,
+                    (unsigned int)obj->playlist_count);
+            APP_UpdateStatus(progress_msg);
+            if (APP_PumpEvents(obj)) break;
+        }
+
+        SongLengthEntry *db_entry = SongDB_Find(obj->songlength_db, entry->md5);
+        if (db_entry) {
+            if (db_entry->num_subsongs > entry->subsongs
+                && db_entry->num_subsongs <= 256) {
+                entry->subsongs = db_entry->num_subsongs;
+                updated++;
+            }
+            entry->duration
+                = FindSongLength(obj, entry->md5, entry->current_subsong);
+        }
     }
 
-    return TRUE;
+    APP_UpdatePlaylistDisplay();
+    if (obj->current_entry) {
+        APP_UpdateCurrentSongCache();
+        APP_UpdateCurrentSongDisplay();
+    }
+    return updated;
 }
 
 void AutoLoadSongLengths(struct ObjApp *obj)
@@ -525,40 +703,7 @@ void AutoLoadSongLengths(struct ObjApp *obj)
     if (db && obj->playlist_count > 0) {
         /* Refresh existing playlist entries with whatever we just loaded. */
         APP_UpdateStatus("Updating playlist with song lengths...");
-        PlaylistEntry *entry = obj->playlist_head;
-        ULONG updated = 0;
-        ULONG entry_num = 0;
-
-        while (entry) {
-            entry_num++;
-            if ((entry_num % 25) == 0) {
-                char progress_msg[128];
-                sprintf(progress_msg, "Updating playlist... %u/%u",
-                        (unsigned int)entry_num,
-                        (unsigned int)obj->playlist_count);
-                APP_UpdateStatus(progress_msg);
-                if (SongDB_PumpEvents(obj)) break;
-            }
-
-            SongLengthEntry *db_entry = SongDB_Find(db, entry->md5);
-            if (db_entry) {
-                UWORD old_subsongs = entry->subsongs;
-                if (db_entry->num_subsongs > old_subsongs
-                    && db_entry->num_subsongs <= 256) {
-                    entry->subsongs = db_entry->num_subsongs;
-                    updated++;
-                }
-                entry->duration
-                    = FindSongLength(obj, entry->md5, entry->current_subsong);
-            }
-            entry = entry->next;
-        }
-
-        APP_UpdatePlaylistDisplay();
-        if (obj->current_entry) {
-            APP_UpdateCurrentSongCache();
-            APP_UpdateCurrentSongDisplay();
-        }
+        ULONG updated = SongDB_RefreshPlaylist(obj);
 
         char final_msg[128];
         sprintf(final_msg,
@@ -576,38 +721,52 @@ void AutoLoadSongLengths(struct ObjApp *obj)
 }
 
 /* ------------------------------------------------------------------ */
-/* Download (unchanged behaviour; cache is refreshed by Load*)         */
+/* Download (parsed while it is saved; cache written at the end)       */
 /* ------------------------------------------------------------------ */
 
 static void DownloadProgressCallback(ULONG bytes_downloaded, APTR userdata)
 {
-    (void)userdata;
+    struct SongDBStream *st = userdata;
     static char progress_msg[256];
     U64_DEBUG("Progress callback: %lu bytes", (unsigned long)bytes_downloaded);
 
     ULONG kb_downloaded = bytes_downloaded / 1024;
-    sprintf(progress_msg, "Downloaded %lu KB from HVSC server",
-        (unsigned long)kb_downloaded);
+    sprintf(progress_msg, "Downloaded %lu KB from HVSC server (%lu entries)",
+        (unsigned long)kb_downloaded,
+        (unsigned long)(st && st->db ? st->db->entry_count : 0));
     APP_UpdateStatus(progress_msg);
 
     if (objApp && objApp->App) {
-        /* Pump events; record a quit request if the user clicked close while
-         * the download is in progress. Download itself can't be aborted
-         * mid-flight, but recording the flag means we'll shut down cleanly
-         * afterwards instead of hanging. */
-        (void)SongDB_PumpEvents(objApp);
+        /* Pump events; a quit request makes SongDB_StreamData abort the
+         * transfer at the next chunk. */
+        (void)APP_PumpEvents(objApp);
     }
 }
 
+static void
+SongDB_DownloadFailed(CONST_STRPTR msg)
+{
+    APP_UpdateStatus(msg);
+    set(objApp->BTN_LoadSongLengths, MUIA_Disabled, FALSE);
+    set(objApp->BTN_LoadSongLengths, MUIA_Text_Contents, "Download Songlengths");
+}
+
 BOOL APP_DownloadSongLengths(void)
 {
     char local_filename[256];
     char progdir[256];
     BPTR lock;
     LONG result;
+    struct SongDBStream *stream;
 
     if (!objApp) return FALSE;
 
+    stream = AllocVec(sizeof(struct SongDBStream), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!stream) {
+        APP_UpdateStatus("Out of memory");
+        return FALSE;
+    }
+
     APP_UpdateStatus("Connecting to HVSC server...");
 
     set(objApp->BTN_LoadSongLengths, MUIA_Disabled, TRUE);
@@ -634,8 +793,20 @@ BOOL APP_DownloadSongLengths(void)
         sprintf(status_msg, "Trying download from URL %d...", i + 1);
         APP_UpdateStatus(status_msg);
 
+        /* Each attempt parses from scratch */
+        SongDB_FreeAll(stream->db);
+        stream->db = SongDB_Create();
+        stream->bytes = 0;
+        stream->line_len = 0;
+        if (!stream->db) {
+            result = U64_ERR_MEMORY;
+            break;
+        }
+
         U64_DEBUG("Attempting download from: %s", urls[i]);
-        result = U64_DownloadToFile(urls[i], local_filename, DownloadProgressCallback, NULL);
+        result = U64_DownloadToFileTee(urls[i], local_filename, NULL,
+                                       SongDB_StreamData,
+                                       DownloadProgressCallback, stream);
         if (result != U64_OK) {
             U64_DEBUG("Download attempt %d failed: %s", i + 1, U64_GetErrorString(result));
         }
@@ -650,100 +821,374 @@ BOOL APP_DownloadSongLengths(void)
             case U64_ERR_TIMEOUT:  sprintf(error_msg, "Download timeout - server may be busy"); break;
             default: sprintf(error_msg, "Download failed: %s", U64_GetErrorString(result)); break;
         }
-        APP_UpdateStatus(error_msg);
+        /* Once the body started the old file was replaced; don't leave a
+         * truncated copy to be loaded (and cached) at the next start. */
+        if (stream->bytes > 0) DeleteFile(local_filename);
         U64_DEBUG("All download attempts failed");
-        set(objApp->BTN_LoadSongLengths, MUIA_Disabled, FALSE);
-        set(objApp->BTN_LoadSongLengths, MUIA_Text_Contents, "Download Songlengths");
+        SongDB_FreeAll(stream->db);
+        FreeVec(stream);
+        SongDB_DownloadFailed(objApp->quit_requested ? "Download cancelled" : error_msg);
         return FALSE;
     }
 
-    APP_UpdateStatus("Download complete, verifying file...");
+    SongDB_StreamFinish(stream);
 
-    BPTR test_file = Open(local_filename, MODE_OLDFILE);
-    if (!test_file) {
-        APP_UpdateStatus("Error: Downloaded file not accessible");
-        set(objApp->BTN_LoadSongLengths, MUIA_Disabled, FALSE);
-        set(objApp->BTN_LoadSongLengths, MUIA_Text_Contents, "Download Songlengths");
-        return FALSE;
-    }
-
-    Seek(test_file, 0, OFFSET_END);
-    LONG file_size = Seek(test_file, 0, OFFSET_BEGINNING);
-    Close(test_file);
-
-    if (file_size < 10000) {
+    if (stream->bytes < 10000 || stream->db->entry_count == 0) {
         char error_msg[256];
-        sprintf(error_msg, "Downloaded file too small (%ld bytes) - may be error page", file_size);
-        APP_UpdateStatus(error_msg);
+        sprintf(error_msg, "Downloaded file not a song-length database (%lu bytes)",
+                (unsigned long)stream->bytes);
         DeleteFile(local_filename);
-        set(objApp->BTN_LoadSongLengths, MUIA_Disabled, FALSE);
-        set(objApp->BTN_LoadSongLengths, MUIA_Text_Contents, "Download Songlengths");
+        SongDB_FreeAll(stream->db);
+        FreeVec(stream);
+        SongDB_DownloadFailed(error_msg);
         return FALSE;
     }
 
     char verify_msg[256];
-    sprintf(verify_msg, "File verified OK (%ld bytes), loading database...", file_size);
+    sprintf(verify_msg, "Downloaded %lu bytes, %lu entries - writing cache...",
+            (unsigned long)stream->bytes, (unsigned long)stream->db->entry_count);
     APP_UpdateStatus(verify_msg);
 
-    if (LoadSongLengthsWithProgress(objApp, local_filename)) {
-        /* Refresh any existing playlist entries. */
-        if (objApp->playlist_count > 0) {
-            PlaylistEntry *entry = objApp->playlist_head;
-            ULONG updated = 0;
-            ULONG entry_num = 0;
-
-            APP_UpdateStatus("Updating playlist with HVSC song lengths...");
-            while (entry) {
-                entry_num++;
-                if ((entry_num % 25) == 0) {
-                    char progress_msg[128];
-                    sprintf(progress_msg, "Updating playlist... %u/%u",
-                            (unsigned int)entry_num,
-                            (unsigned int)objApp->playlist_count);
-                    APP_UpdateStatus(progress_msg);
-                    if (SongDB_PumpEvents(objApp)) break;
-                }
+    SongDB_Install(objApp, stream->db, local_filename);
+    FreeVec(stream);
 
-                SongLengthEntry *db_entry
-                    = SongDB_Find(objApp->songlength_db, entry->md5);
-                if (db_entry) {
-                    if (db_entry->num_subsongs > entry->subsongs
-                        && db_entry->num_subsongs <= 256) {
-                        entry->subsongs = db_entry->num_subsongs;
-                        updated++;
-                    }
-                    entry->duration = FindSongLength(objApp, entry->md5,
-                                                     entry->current_subsong);
-                }
-                entry = entry->next;
+    /* Refresh any existing playlist entries. */
+    if (objApp->playlist_count > 0) {
+        APP_UpdateStatus("Updating playlist with HVSC song lengths...");
+        ULONG updated = SongDB_RefreshPlaylist(objApp);
+
+        char final_msg[128];
+        sprintf(final_msg,
+                "HVSC database loaded! Updated %u of %u playlist entries",
+                (unsigned int)updated,
+                (unsigned int)objApp->playlist_count);
+        APP_UpdateStatus(final_msg);
+    } else {
+        APP_UpdateStatus("HVSC Songlengths database downloaded and loaded!");
+    }
+
+    set(objApp->BTN_LoadSongLengths, MUIA_Disabled, FALSE);
+    set(objApp->BTN_LoadSongLengths, MUIA_Text_Contents, "Download Songlengths");
+
+    return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+/* Release updates (patched into the binary cache)                     */
+/* ------------------------------------------------------------------ */
+
+/* An update being applied. cache is the open cache file, or 0 when there
+ * is none or a write to it failed — the cache is then written whole at the
+ * end instead. */
+struct SongDBPatch {
+    struct SongLengthDB *db;
+    BPTR   cache;
+    ULONG  changed, added, removed;
+};
+
+static void
+SongDB_PatchFailed(struct SongDBPatch *p)
+{
+    U64_DEBUG("songdb: in-place cache write failed, will rewrite it");
+    Close(p->cache);
+    p->cache = 0;
+}
+
+static void
+SongDB_MarkDead(struct SongDBPatch *p, SongLengthEntry *e)
+{
+    UWORD flags = SONGDB_RECORD_DEAD;
+
+    if (p->cache && e->cache_offset) {
+        if (Seek(p->cache, e->cache_offset + MD5_HASH_SIZE + 2, OFFSET_BEGINNING) < 0
+            || Write(p->cache, &flags, 2) != 2) {
+            SongDB_PatchFailed(p);
+        }
+    }
+    e->cache_offset = 0;
+}
+
+static void
+SongDB_AppendRecord(struct SongDBPatch *p, SongLengthEntry *e)
+{
+    UWORD flags = 0;
+    LONG want = (LONG)(sizeof(ULONG) * e->num_subsongs);
+    LONG end;
+
+    if (!p->cache) return;
+
+    Seek(p->cache, 0, OFFSET_END);
+    end = Seek(p->cache, 0, OFFSET_CURRENT);
+    if (end < 0
+        || Write(p->cache, e->md5, MD5_HASH_SIZE) != MD5_HASH_SIZE
+        || Write(p->cache, &e->num_subsongs, 2) != 2
+        || Write(p->cache, &flags, 2) != 2
+        || Write(p->cache, e->lengths, want) != want) {
+        SongDB_PatchFailed(p);
+        return;
+    }
+    e->cache_offset = (ULONG)end;
+    p->db->record_count++;
+}
+
+/* Add or change one entry, in memory and in the cache. */
+static void
+SongDB_PatchEntry(struct SongDBPatch *p, const UBYTE md5[MD5_HASH_SIZE],
+                  const ULONG *lengths, UWORD num_lengths)
+{
+    SongLengthEntry *e = SongDB_Find(p->db, md5);
+    LONG want = (LONG)(sizeof(ULONG) * num_lengths);
+    ULONG *copy;
+
+    if (e && e->num_subsongs == num_lengths) {
+        /* Same size: rewrite the lengths where they are */
+        CopyMem((APTR)lengths, e->lengths, want);
+        p->changed++;
+        if (!p->cache) return;
+        if (!e->cache_offset) {
+            SongDB_AppendRecord(p, e);
+        } else if (Seek(p->cache, e->cache_offset + SONGDB_RECORD_HEAD, OFFSET_BEGINNING) < 0
+                   || Write(p->cache, e->lengths, want) != want) {
+            SongDB_PatchFailed(p);
+        }
+        return;
+    }
+
+    copy = AllocVec(want, MEMF_PUBLIC);
+    if (!copy) return;
+    CopyMem((APTR)lengths, copy, want);
+
+    if (e) {
+        SongDB_MarkDead(p, e);
+        FreeVec(e->lengths);
+        p->changed++;
+    } else {
+        e = AllocVec(sizeof(SongLengthEntry), MEMF_PUBLIC | MEMF_CLEAR);
+        if (!e) {
+            FreeVec(copy);
+            return;
+        }
+        CopyMem((APTR)md5, e->md5, MD5_HASH_SIZE);
+        SongDB_InsertEntry(p->db, e);
+        p->added++;
+    }
+    e->lengths = copy;
+    e->num_subsongs = num_lengths;
+    SongDB_AppendRecord(p, e);
+}
+
+/* Copy the line starting at text into line[line_size] and return where the
+ * next one starts (end when there is none). */
+static const char *
+SongDB_NextLine(const char *text, const char *end, char *line, ULONG line_size)
+{
+    const char *nl = memchr(text, '\n', end - text);
+    ULONG len = (ULONG)((nl ? nl : end) - text);
+
+    if (len > line_size - 1) len = line_size - 1;
+    CopyMem((APTR)text, line, len);
+    line[len] = '\0';
+    return nl ? nl + 1 : end;
+}
+
+/* Apply the update in text[size] to obj->songlength_db and its cache. */
+static BOOL
+SongDB_ApplyUpdate(struct ObjApp *obj, const char *text, ULONG size)
+{
+    struct SongLengthDB *db = obj->songlength_db;
+    const char *end = text + size;
+    const char *p;
+    struct SongDBCacheHeader hdr;
+    struct SongDBPatch patch;
+    ULONG from = 0, to = 0, lines = 0;
+    BOOL have_source = FALSE;
+    char cache_path[512];
+    char line[1024];
+    char msg[160];
+
+    if (!db) {
+        APP_UpdateStatus("Load or download the song-length database first");
+        return FALSE;
+    }
+
+    /* Check the releases before touching anything */
+    for (p = text; p < end; ) {
+        p = SongDB_NextLine(p, end, line, sizeof(line));
+        if (SongDB_SkipLine(line)) continue;
+        if (strncmp(line, "from=", 5) == 0) from = (ULONG)atol(line + 5);
+        else if (strncmp(line, "to=", 3) == 0) to = (ULONG)atol(line + 3);
+    }
+    if (to == 0) {
+        APP_UpdateStatus("Not a song-length update (no to= line)");
+        return FALSE;
+    }
+    if (db->hvsc_version && to <= db->hvsc_version) {
+        sprintf(msg, "Song lengths already at release %lu", (unsigned long)db->hvsc_version);
+        APP_UpdateStatus(msg);
+        return FALSE;
+    }
+    if (from && db->hvsc_version && from != db->hvsc_version) {
+        sprintf(msg, "Update is for release %lu, database is release %lu",
+                (unsigned long)from, (unsigned long)db->hvsc_version);
+        APP_UpdateStatus(msg);
+        return FALSE;
+    }
+
+    /* Patch the cache in place only if it is the one db was loaded from */
+    memset(&patch, 0, sizeof(patch));
+    patch.db = db;
+    strcpy(cache_path, db->cache_path);
+    if (cache_path[0]) {
+        patch.cache = Open(cache_path, MODE_OLDFILE);
+        if (patch.cache) {
+            if (Read(patch.cache, &hdr, sizeof(hdr)) == sizeof(hdr)
+                && memcmp(hdr.magic, SONGDB_CACHE_MAGIC, 8) == 0
+                && hdr.version == SONGDB_CACHE_VERSION) {
+                have_source = TRUE;
             }
+            if (!have_source || hdr.entry_count != db->entry_count
+                || hdr.record_count != db->record_count) {
+                Close(patch.cache);
+                patch.cache = 0;
+            }
+        }
+    }
+    if (!have_source) {
+        char filepath[512];
+        if (CheckSongLengthsFile(filepath, sizeof(filepath))
+            && SongDB_SourceStat(filepath, &hdr.source_size, &hdr.source_mtime)) {
+            SongDB_CachePath(cache_path, sizeof(cache_path), filepath);
+            have_source = TRUE;
+        }
+    }
 
-            APP_UpdatePlaylistDisplay();
-            if (objApp->current_entry) {
-                APP_UpdateCurrentSongCache();
-                APP_UpdateCurrentSongDisplay();
+    APP_UpdateStatus("Applying song-length update...");
+    for (p = text; p < end; ) {
+        UBYTE md5[MD5_HASH_SIZE];
+        ULONG lengths[256];
+        UWORD num_lengths;
+
+        p = SongDB_NextLine(p, end, line, sizeof(line));
+        if ((++lines % 200) == 0) (void)APP_PumpEvents(obj);
+        if (SongDB_SkipLine(line)) continue;
+
+        if (line[0] == '-') {
+            SongLengthEntry *e;
+            if (strlen(line + 1) < 32) continue;
+            line[33] = '\0';
+            if (!HexStringToMD5(line + 1, md5)) continue;
+            e = SongDB_Find(db, md5);
+            if (e) {
+                SongDB_MarkDead(&patch, e);
+                SongDB_RemoveEntry(db, e);
+                patch.removed++;
             }
+            continue;
+        }
 
-            char final_msg[128];
-            sprintf(final_msg,
-                    "HVSC database loaded! Updated %u of %u playlist entries",
-                    (unsigned int)updated,
-                    (unsigned int)objApp->playlist_count);
-            APP_UpdateStatus(final_msg);
-        } else {
-            APP_UpdateStatus("HVSC Songlengths database downloaded and loaded!");
+        num_lengths = SongDB_ParseEntry(line, md5, lengths);
+        if (num_lengths > 0) SongDB_PatchEntry(&patch, md5, lengths, num_lengths);
+    }
+    db->hvsc_version = to;
+
+    /* Finish with the new header, or write the cache whole if patching
+     * failed or dead records have piled up. */
+    if (patch.cache && db->record_count - db->entry_count <= db->entry_count / 8) {
+        hdr.entry_count = db->entry_count;
+        hdr.record_count = db->record_count;
+        hdr.hvsc_version = db->hvsc_version;
+        if (Seek(patch.cache, 0, OFFSET_BEGINNING) < 0
+            || Write(patch.cache, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+            SongDB_PatchFailed(&patch);
         }
+    } else if (patch.cache) {
+        Close(patch.cache);
+        patch.cache = 0;
+    }
+    if (patch.cache) {
+        Close(patch.cache);
+    } else if (have_source) {
+        SongDB_WriteCache(db, cache_path, hdr.source_size, &hdr.source_mtime);
     } else {
-        APP_UpdateStatus("File downloaded but database loading failed");
-        set(objApp->BTN_LoadSongLengths, MUIA_Disabled, FALSE);
-        set(objApp->BTN_LoadSongLengths, MUIA_Text_Contents, "Download Songlengths");
+        db->cache_path[0] = '\0';
+    }
+
+    sprintf(msg, "Release %lu: %lu changed, %lu added, %lu removed%s",
+            (unsigned long)to, (unsigned long)patch.changed,
+            (unsigned long)patch.added, (unsigned long)patch.removed,
+            db->cache_path[0] ? "" : " (cache not saved)");
+    if (obj->playlist_count > 0) SongDB_RefreshPlaylist(obj);
+    APP_UpdateStatus(msg);
+    return TRUE;
+}
+
+BOOL APP_SongDBUpdateFile(void)
+{
+    struct FileRequester *req;
+    BOOL success = FALSE;
+
+    if (!objApp || !AslBase) return FALSE;
+
+    req = AllocAslRequestTags(ASL_FileRequest,
+        ASLFR_TitleText, "Apply Song-Length Update",
+        ASLFR_DoPatterns, TRUE,
+        ASLFR_InitialPattern, "#?.(md5|txt)",
+        ASLFR_RejectIcons, TRUE,
+        TAG_DONE);
+
+    if (req && AslRequest(req, NULL)) {
+        char filename[512];
+        ULONG size;
+        UBYTE *text;
+
+        strcpy(filename, req->rf_Dir);
+        AddPart(filename, req->rf_File, sizeof(filename));
+
+        text = U64_ReadFile(filename, &size);
+        if (text) {
+            success = SongDB_ApplyUpdate(objApp, (const char *)text, size);
+            FreeVec(text);
+        } else {
+            APP_UpdateStatus("Cannot read update file");
+        }
+    }
+
+    if (req) {
+        FreeAslRequest(req);
+    }
+    return success;
+}
+
+BOOL APP_SongDBUpdateFetch(void)
+{
+    STRPTR url;
+    UBYTE *text = NULL;
+    ULONG size = 0;
+    UWORD status = 0;
+    LONG result;
+    BOOL success = FALSE;
+
+    if (!objApp) return FALSE;
+
+    url = U64_ReadEnvVar(ENV_ULTIMATE64_SONGDB_UPDATE_URL);
+    if (!url) {
+        APP_UpdateStatus("Set ENV:" ENV_ULTIMATE64_SONGDB_UPDATE_URL " to the update's URL");
         return FALSE;
     }
 
-    set(objApp->BTN_LoadSongLengths, MUIA_Disabled, FALSE);
-    set(objApp->BTN_LoadSongLengths, MUIA_Text_Contents, "Download Songlengths");
+    APP_UpdateStatus("Fetching song-length update...");
+    result = U64_HttpGetURL(url, NULL, &text, &size, &status);
+    FreeVec(url);
 
-    return TRUE;
+    if (result == U64_OK && text) {
+        success = SongDB_ApplyUpdate(objApp, (const char *)text, size);
+    } else {
+        char msg[80];
+        sprintf(msg, "Update fetch failed (HTTP %u)", (unsigned int)status);
+        APP_UpdateStatus(msg);
+    }
+    if (text) FreeVec(text);
+    return success;
 }
 
 /* ------------------------------------------------------------------ */
@@ -764,3 +1209,47 @@ void FreeSongLengthDB(struct ObjApp *obj)
     SongDB_FreeAll(obj->songlength_db);
     obj->songlength_db = NULL;
 }
+
+/* ------------------------------------------------------------------ */
+/* Benchmark entry points (bench.c)                                    */
+/* ------------------------------------------------------------------ */
+
+/* The cold and warm start-up paths on their own: parse filename, or load
+ * the cache beside it, into a database the caller frees with
+ * SongDB_BenchFree. Nothing is installed and the UI is left alone. */
+struct SongLengthDB *
+SongDB_BenchParse(CONST_STRPTR filename)
+{
+    return SongDB_ParseText(NULL, filename);
+}
+
+BOOL
+SongDB_BenchWriteCache(struct SongLengthDB *db, CONST_STRPTR filename)
+{
+    ULONG src_size;
+    struct DateStamp src_mtime;
+    char cache_path[512];
+
+    if (!db || !SongDB_SourceStat(filename, &src_size, &src_mtime)) return FALSE;
+    SongDB_CachePath(cache_path, sizeof(cache_path), filename);
+    SongDB_WriteCache(db, cache_path, src_size, &src_mtime);
+    return db->cache_path[0] != '\0';
+}
+
+struct SongLengthDB *
+SongDB_BenchReadCache(CONST_STRPTR filename)
+{
+    ULONG src_size;
+    struct DateStamp src_mtime;
+    char cache_path[512];
+
+    if (!SongDB_SourceStat(filename, &src_size, &src_mtime)) return NULL;
+    SongDB_CachePath(cache_path, sizeof(cache_path), filename);
+    return SongDB_ReadCache(cache_path, src_size, &src_mtime);
+}
+
+void
+SongDB_BenchFree(struct SongLengthDB *db)
+{
+    SongDB_FreeAll(db);
+}
@@ -0,0 +1,462 @@
+/* Ultimate64 SID Player - STIL comments for the playing tune
+ * For Amiga OS 3.x by Marcin Spoczynski
+ *
+ * See stil.h for the index layout. STIL.txt is indexed once (and again
+ * only when its size or date changes); afterwards showing the entry of the
+ * tune being played costs one Seek and one Read.
+ */
+
+#include <dos/dos.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+#include <libraries/mui.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/intuition.h>
+#include <proto/muimaster.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "player.h"
+#include "stil.h"
+
+#define STIL_SOURCE_FILENAME  "STIL.txt"
+#define STIL_PUMP_EVERY       2000  /* lines between progress updates */
+
+/* HVSC's top-level drawers — what an HVSC path starts with */
+static const char *stil_top_dirs[] = { "MUSICIANS/", "GAMES/", "DEMOS/", NULL };
+
+static UBYTE
+STIL_Lower(UBYTE c)
+{
+    return (UBYTE)(c >= 'A' && c <= 'Z' ? c + 32 : c);
+}
+
+ULONG
+STIL_HashPath(CONST_STRPTR path, ULONG len)
+{
+    ULONG h = 2166136261UL;         /* FNV-1a */
+    while (len--) {
+        h ^= STIL_Lower((UBYTE)*path++);
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+/* Length of the first line of s without its CR/LF and trailing blanks. */
+static ULONG
+STIL_LineLength(CONST_STRPTR s)
+{
+    ULONG len = 0;
+    while (s[len] && s[len] != '\n') len++;
+    while (len > 0 && (s[len - 1] == '\r' || s[len - 1] == ' ' || s[len - 1] == '\t')) len--;
+    return len;
+}
+
+static BOOL
+STIL_SameNoCase(CONST_STRPTR a, CONST_STRPTR b, ULONG len)
+{
+    while (len--) {
+        if (STIL_Lower((UBYTE)*a++) != STIL_Lower((UBYTE)*b++)) return FALSE;
+    }
+    return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+/* Index                                                               */
+/* ------------------------------------------------------------------ */
+
+static int
+STIL_CompareSlots(const void *a, const void *b)
+{
+    const STILSlot *sa = a, *sb = b;
+    if (sa->hash != sb->hash) return sa->hash < sb->hash ? -1 : 1;
+    return sa->offset < sb->offset ? -1 : 1;
+}
+
+/* Walk STIL.txt once, recording where each path's block starts and how
+ * long it runs. Lines longer than the buffer arrive in pieces; only the
+ * first piece of a line can start or end a block. */
+static BOOL
+STIL_Build(struct ObjApp *obj, CONST_STRPTR source_path, struct STILIndex *stil)
+{
+    char line[512];
+    ULONG pos = 0, line_start, lines = 0;
+    ULONG capacity = 0;
+    LONG open_slot = -1;
+    BOOL at_line_start = TRUE;
+    BOOL ok = TRUE;
+    LONG total;
+    BPTR in;
+
+    in = Open(source_path, MODE_OLDFILE);
+    if (!in) return FALSE;
+
+    Seek(in, 0, OFFSET_END);
+    total = Seek(in, 0, OFFSET_BEGINNING);
+
+    while (FGets(in, line, sizeof(line))) {
+        ULONG len = strlen(line);
+        BOOL whole = len > 0 && line[len - 1] == '\n';
+
+        line_start = pos;
+        pos += len;
+
+        if (at_line_start) {
+            ULONG content = STIL_LineLength(line);
+
+            if (++lines % STIL_PUMP_EVERY == 0 && obj) {
+                char msg[80];
+                sprintf(msg, "Indexing STIL... %lu%%",
+                        (unsigned long)(total > 0 ? (line_start / ((ULONG)total / 100 + 1)) : 0));
+                APP_UpdateStatus(msg);
+                if (APP_PumpEvents(obj)) {
+                    ok = FALSE;
+                    break;
+                }
+            }
+
+            if (content == 0 && open_slot >= 0) {
+                stil->slots[open_slot].length = line_start - stil->slots[open_slot].offset;
+                open_slot = -1;
+            } else if (line[0] == '/') {
+                if (open_slot >= 0) {
+                    stil->slots[open_slot].length = line_start - stil->slots[open_slot].offset;
+                }
+                if (stil->count >= capacity) {
+                    ULONG new_capacity = capacity ? capacity * 2 : 4096;
+                    STILSlot *grown = AllocVec(new_capacity * sizeof(STILSlot), MEMF_PUBLIC);
+                    if (!grown) {
+                        ok = FALSE;
+                        break;
+                    }
+                    if (stil->slots) {
+                        CopyMem(stil->slots, grown, stil->count * sizeof(STILSlot));
+                        FreeVec(stil->slots);
+                    }
+                    stil->slots = grown;
+                    capacity = new_capacity;
+                }
+                open_slot = (LONG)stil->count++;
+                stil->slots[open_slot].hash = STIL_HashPath(line, content);
+                stil->slots[open_slot].offset = line_start;
+                stil->slots[open_slot].length = 0;
+            }
+        }
+        at_line_start = whole;
+    }
+    if (ok && open_slot >= 0) {
+        stil->slots[open_slot].length = pos - stil->slots[open_slot].offset;
+    }
+    Close(in);
+
+    if (!ok) return FALSE;
+    if (stil->count > 1) {
+        qsort(stil->slots, stil->count, sizeof(STILSlot), STIL_CompareSlots);
+    }
+    return TRUE;
+}
+
+static BOOL
+STIL_ReadIndex(CONST_STRPTR index_path, struct STILIndex *stil,
+               ULONG src_size, const struct DateStamp *src_mtime)
+{
+    struct STILIndexHeader hdr;
+    LONG bytes;
+    BPTR file;
+
+    file = Open(index_path, MODE_OLDFILE);
+    if (!file) return FALSE;
+
+    if (Read(file, &hdr, sizeof(hdr)) != sizeof(hdr)
+        || memcmp(hdr.magic, STIL_INDEX_MAGIC, 8) != 0
+        || hdr.version != STIL_INDEX_VERSION
+        || !SongDB_SameSource(hdr.source_size, &hdr.source_mtime, src_size, src_mtime)) {
+        U64_DEBUG("stil index is stale — rebuilding");
+        Close(file);
+        return FALSE;
+    }
+
+    bytes = (LONG)(hdr.entry_count * sizeof(STILSlot));
+    stil->slots = AllocVec(bytes ? bytes : 1, MEMF_PUBLIC);
+    if (!stil->slots || Read(file, stil->slots, bytes) != bytes) {
+        Close(file);
+        if (stil->slots) FreeVec(stil->slots);
+        stil->slots = NULL;
+        return FALSE;
+    }
+    stil->count = hdr.entry_count;
+    Close(file);
+    return TRUE;
+}
+
+/* Best-effort, like SongDB_WriteCache: a failed write only means the
+ * index is built again next time. */
+static void
+STIL_WriteIndex(CONST_STRPTR index_path, const struct STILIndex *stil,
+                ULONG src_size, const struct DateStamp *src_mtime)
+{
+    struct STILIndexHeader hdr;
+    LONG bytes = (LONG)(stil->count * sizeof(STILSlot));
+    BPTR file;
+
+    file = Open(index_path, MODE_NEWFILE);
+    if (!file) return;
+
+    memset(&hdr, 0, sizeof(hdr));
+    CopyMem((APTR)STIL_INDEX_MAGIC, hdr.magic, 8);
+    hdr.version = STIL_INDEX_VERSION;
+    hdr.source_size = src_size;
+    hdr.source_mtime = *src_mtime;
+    hdr.entry_count = stil->count;
+
+    if (Write(file, &hdr, sizeof(hdr)) != sizeof(hdr)
+        || Write(file, stil->slots, bytes) != bytes) {
+        Close(file);
+        DeleteFile(index_path);
+        return;
+    }
+    Close(file);
+}
+
+struct STILIndex *
+STIL_Open(struct ObjApp *obj, CONST_STRPTR source_path, CONST_STRPTR index_path)
+{
+    struct STILIndex *stil;
+    struct DateStamp src_mtime;
+    ULONG src_size;
+
+    if (!SongDB_SourceStat(source_path, &src_size, &src_mtime)) return NULL;
+
+    stil = AllocVec(sizeof(struct STILIndex), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!stil) return NULL;
+    stil->block = AllocVec(STIL_MAX_ENTRY + 1, MEMF_PUBLIC);
+    if (!stil->block) goto fail;
+
+    if (!STIL_ReadIndex(index_path, stil, src_size, &src_mtime)) {
+        if (obj) APP_UpdateStatus("Indexing STIL (first run)...");
+        if (!STIL_Build(obj, source_path, stil)) goto fail;
+        STIL_WriteIndex(index_path, stil, src_size, &src_mtime);
+    }
+
+    stil->source = Open(source_path, MODE_OLDFILE);
+    if (!stil->source) goto fail;
+
+    U64_DEBUG("stil: %lu entries", (unsigned long)stil->count);
+    return stil;
+
+fail:
+    STIL_Close(stil);
+    return NULL;
+}
+
+void
+STIL_Close(struct STILIndex *stil)
+{
+    if (!stil) return;
+    if (stil->source) Close(stil->source);
+    if (stil->slots) FreeVec(stil->slots);
+    if (stil->block) FreeVec(stil->block);
+    FreeVec(stil);
+}
+
+CONST_STRPTR
+STIL_Lookup(struct STILIndex *stil, CONST_STRPTR hvsc_path)
+{
+    ULONG len, hash, lo, hi;
+
+    if (!stil || !hvsc_path) return NULL;
+
+    /* Subsong changes ask for the same tune again */
+    len = strlen(hvsc_path);
+    if (len == strlen(stil->block_path) && STIL_SameNoCase(hvsc_path, stil->block_path, len)) {
+        return stil->block_found ? (CONST_STRPTR)stil->block : NULL;
+    }
+    if (len >= sizeof(stil->block_path)) return NULL;
+    strcpy(stil->block_path, hvsc_path);
+    stil->block_found = FALSE;
+
+    hash = STIL_HashPath(hvsc_path, len);
+    lo = 0;
+    hi = stil->count;
+    while (lo < hi) {
+        ULONG mid = (lo + hi) / 2;
+        if (stil->slots[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (; lo < stil->count && stil->slots[lo].hash == hash; lo++) {
+        const STILSlot *slot = &stil->slots[lo];
+        ULONG want = slot->length < STIL_MAX_ENTRY ? slot->length : STIL_MAX_ENTRY;
+        LONG got;
+
+        Seek(stil->source, slot->offset, OFFSET_BEGINNING);
+        got = Read(stil->source, stil->block, want);
+        if (got <= 0) continue;
+        stil->block[got] = '\0';
+
+        if (STIL_LineLength((CONST_STRPTR)stil->block) == len
+            && STIL_SameNoCase((CONST_STRPTR)stil->block, hvsc_path, len)) {
+            stil->block_found = TRUE;
+            return (CONST_STRPTR)stil->block;
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Display                                                             */
+/* ------------------------------------------------------------------ */
+
+/* "TITLE:", "COMMENT:" and friends start a field; anything else
+ * continues the one before. */
+static BOOL
+STIL_IsFieldLine(CONST_STRPTR s, CONST_STRPTR end)
+{
+    CONST_STRPTR p = s;
+    while (p < end && *p >= 'A' && *p <= 'Z') p++;
+    return p > s && p < end && *p == ':';
+}
+
+void
+STIL_Format(CONST_STRPTR block, UWORD subsong, char *out, ULONG out_size)
+{
+    CONST_STRPTR p = block;
+    ULONG used = 0;
+    LONG section = 0;               /* 0 = whole tune, n = "(#n)" */
+
+    out[0] = '\0';
+
+    /* The first line is the path itself */
+    while (*p && *p != '\n') p++;
+
+    while (*p) {
+        CONST_STRPTR s, e;
+        ULONG len;
+
+        if (*p == '\n') p++;
+        s = p;
+        while (*p && *p != '\n') p++;
+        e = p;
+
+        while (s < e && (*s == ' ' || *s == '\t')) s++;
+        while (e > s && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) e--;
+        if (s == e) continue;
+
+        if (s[0] == '(' && s[1] == '#') {
+            section = atol(s + 2);
+            continue;
+        }
+        if (section != 0 && section != (LONG)subsong + 1) continue;
+
+        if (used > 0 && used + 1 < out_size) {
+            out[used++] = STIL_IsFieldLine(s, e) ? '\n' : ' ';
+        }
+        len = (ULONG)(e - s);
+        if (used + len >= out_size) len = out_size - used - 1;
+        CopyMem((APTR)s, out + used, len);
+        used += len;
+        out[used] = '\0';
+        if (used + 1 >= out_size) break;
+    }
+}
+
+/* HVSC path ("/MUSICIANS/...") of a file under the HVSC root, or under
+ * any drawer that holds HVSC's top-level drawers. */
+static BOOL
+STIL_PathFromFile(struct ObjApp *obj, CONST_STRPTR filename, char *out, ULONG out_size)
+{
+    CONST_STRPTR rel = NULL;
+    ULONG root_len = strlen(obj->hvsc_root);
+    CONST_STRPTR p;
+    ULONG i;
+
+    if (root_len > 0 && strlen(filename) > root_len
+        && STIL_SameNoCase(filename, obj->hvsc_root, root_len)) {
+        char last = obj->hvsc_root[root_len - 1];
+        if (last == '/' || last == ':' || filename[root_len] == '/') {
+            rel = filename + root_len;
+            while (*rel == '/') rel++;
+        }
+    }
+
+    for (p = filename; !rel && *p; p++) {
+        if (p != filename && p[-1] != '/' && p[-1] != ':') continue;
+        for (i = 0; stil_top_dirs[i]; i++) {
+            if (STIL_SameNoCase(p, stil_top_dirs[i], strlen(stil_top_dirs[i]))) {
+                rel = p;
+                break;
+            }
+        }
+    }
+
+    if (!rel || strlen(rel) + 2 > out_size) return FALSE;
+    out[0] = '/';
+    strcpy(out + 1, rel);
+    return TRUE;
+}
+
+void
+AutoLoadSTIL(struct ObjApp *obj)
+{
+    char source[512], index[512];
+    BPTR lock = 0;
+
+    if (obj->stil) return;
+    if (!build_progdir_path(index, sizeof(index), STIL_INDEX_FILENAME)) return;
+
+    if (build_progdir_path(source, sizeof(source), STIL_SOURCE_FILENAME)) {
+        lock = Lock(source, ACCESS_READ);
+    }
+    if (!lock && obj->hvsc_root[0]) {
+        strncpy(source, obj->hvsc_root, sizeof(source) - 1);
+        source[sizeof(source) - 1] = '\0';
+        AddPart(source, "DOCUMENTS", sizeof(source));
+        AddPart(source, STIL_SOURCE_FILENAME, sizeof(source));
+        lock = Lock(source, ACCESS_READ);
+    }
+    if (!lock) {
+        U64_DEBUG("No STIL.txt found");
+        return;
+    }
+    UnLock(lock);
+
+    obj->stil = STIL_Open(obj, source, index);
+    if (obj->stil) {
+        char msg[80];
+        sprintf(msg, "STIL ready (%lu entries)", (unsigned long)obj->stil->count);
+        APP_UpdateStatus(msg);
+    }
+}
+
+void
+APP_UpdateSTILDisplay(struct ObjApp *obj)
+{
+    static char text[STIL_MAX_TEXT];
+    CONST_STRPTR block = NULL;
+    char path[512];
+
+    if (!obj->FLT_STILInfo) return;
+
+    if (obj->stil && obj->current_entry
+        && STIL_PathFromFile(obj, obj->current_entry->filename, path, sizeof(path))) {
+        block = STIL_Lookup(obj->stil, path);
+    }
+
+    if (block) {
+        STIL_Format(block, obj->current_entry->current_subsong, text, sizeof(text));
+    } else {
+        text[0] = '\0';
+    }
+    set(obj->FLT_STILInfo, MUIA_Floattext_Text, text);
+}
+
+void
+FreeSTIL(struct ObjApp *obj)
+{
+    STIL_Close(obj->stil);
+    obj->stil = NULL;
+}
@@ -0,0 +1,89 @@
+/* HVSC STIL.txt index: per-tune comments without parsing STIL per lookup.
+ *
+ * STIL.txt (~5 MB) holds blocks of the form
+ *
+ *     /MUSICIANS/H/Hubbard_Rob/Commando.sid
+ *       TITLE: ...
+ *     (#2)
+ *      COMMENT: ...
+ *
+ * each running to the next blank line. STIL_Build walks the file once and
+ * writes stil.idx in PROGDIR:
+ *
+ *     STILIndexHeader              source size and date, as in the
+ *                                  song-length cache (SongDB_SameSource)
+ *     STILSlot[entry_count]        sorted by hash of the lowercase path
+ *
+ * The slot table is read into memory in one go; a lookup is a binary
+ * search, then a single Seek and Read of the block from STIL.txt. The
+ * block's first line is compared with the path, so hash collisions only
+ * cost an extra read.
+ */
+
+#ifndef U64_STIL_H
+#define U64_STIL_H
+
+#include <dos/dos.h>
+#include <exec/types.h>
+
+#define STIL_INDEX_FILENAME  "stil.idx"
+#define STIL_INDEX_MAGIC     "U64STIL1"
+#define STIL_INDEX_VERSION   1
+#define STIL_MAX_ENTRY       16384  /* longest block read back */
+#define STIL_MAX_TEXT        4096   /* formatted text for one subsong */
+
+struct STILIndexHeader {
+    char   magic[8];
+    ULONG  version;
+    ULONG  source_size;
+    struct DateStamp source_mtime;
+    ULONG  entry_count;
+};
+
+typedef struct STILSlot {
+    ULONG  hash;                    /* STIL_HashPath of the block's path */
+    ULONG  offset;                  /* of the path line in STIL.txt */
+    ULONG  length;                  /* up to the blank line after it */
+} STILSlot;
+
+struct STILIndex {
+    BPTR   source;                  /* STIL.txt, kept open for lookups */
+    STILSlot *slots;
+    ULONG  count;
+    UBYTE *block;                   /* STIL_MAX_ENTRY + 1 bytes */
+    char   block_path[512];         /* path of the block held in block[] */
+    BOOL   block_found;
+};
+
+/* Hash of an HVSC path such as "/MUSICIANS/H/Hubbard_Rob/Commando.sid",
+ * ignoring case (Amiga file systems do too). */
+ULONG STIL_HashPath(CONST_STRPTR path, ULONG len);
+
+/* Open STIL.txt at source_path through the index at index_path, building
+ * (and writing) the index first if it is missing or stale. obj is used for
+ * progress and to notice Quit while building; it may be NULL. */
+struct STILIndex *STIL_Open(struct ObjApp *obj, CONST_STRPTR source_path,
+                            CONST_STRPTR index_path);
+
+/* Close the source file and free the index; NULL is safe. */
+void STIL_Close(struct STILIndex *stil);
+
+/* Raw block for an HVSC path, NUL-terminated and owned by stil (valid
+ * until the next lookup of another path). NULL if STIL has no entry. */
+CONST_STRPTR STIL_Lookup(struct STILIndex *stil, CONST_STRPTR hvsc_path);
+
+/* Render block for display: the tune-wide fields, then those of subsong
+ * (0-based), one field per line with wrapped lines joined. */
+void STIL_Format(CONST_STRPTR block, UWORD subsong, char *out, ULONG out_size);
+
+/* Find STIL.txt (PROGDIR or the HVSC DOCUMENTS drawer) and open it into
+ * obj->stil. Quietly does nothing if there is none. */
+void AutoLoadSTIL(struct ObjApp *obj);
+
+/* Show the playing tune's STIL entry under Now Playing. */
+void APP_UpdateSTILDisplay(struct ObjApp *obj);
+
+/* Release obj->stil (called from DisposeApp). */
+void FreeSTIL(struct ObjApp *obj);
+
+#endif
@@ -0,0 +1,110 @@
+#include <exec/memory.h>
+#include <exec/types.h>
+
+#include <proto/exec.h>
+
+#include <string.h>
+
+#include "strpool.h"
+
+static StrPoolChunk *
+strpool_new_chunk(ULONG size)
+{
+    StrPoolChunk *c = AllocVec(sizeof(StrPoolChunk) + size, MEMF_PUBLIC);
+    if (!c) return NULL;
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+struct StringPool *
+StrPool_Create(void)
+{
+    return AllocVec(sizeof(struct StringPool), MEMF_PUBLIC | MEMF_CLEAR);
+}
+
+void
+StrPool_Free(struct StringPool *pool)
+{
+    if (!pool) return;
+    StrPoolChunk *c = pool->chunks;
+    while (c) {
+        StrPoolChunk *next = c->next;
+        FreeVec(c);
+        c = next;
+    }
+    FreeVec(pool);
+}
+
+/* Claim need contiguous bytes, starting a new chunk if the current one
+ * can't hold them. */
+static char *
+strpool_claim(struct StringPool *pool, ULONG need)
+{
+    StrPoolChunk *c = pool->chunks;
+
+    if (!c || c->size - c->used < need) {
+        /* Oversized claims get a chunk of their own, linked behind the
+         * current one so the remaining space there isn't abandoned. */
+        if (need > STRPOOL_CHUNK_SIZE && c) {
+            StrPoolChunk *big = strpool_new_chunk(need);
+            if (!big) return NULL;
+            big->next = c->next;
+            c->next = big;
+            c = big;
+        } else {
+            c = strpool_new_chunk(need > STRPOOL_CHUNK_SIZE ? need : STRPOOL_CHUNK_SIZE);
+            if (!c) return NULL;
+            c->next = pool->chunks;
+            pool->chunks = c;
+        }
+    }
+
+    char *dst = c->data + c->used;
+    c->used += need;
+    pool->bytes += need;
+    return dst;
+}
+
+STRPTR
+StrPool_AddLen(struct StringPool *pool, CONST_STRPTR s, ULONG len)
+{
+    if (!pool) return NULL;
+
+    STRPTR dst = strpool_claim(pool, len + 1);
+    if (!dst) return NULL;
+    if (len) CopyMem((APTR)s, dst, len);
+    dst[len] = '\0';
+    return dst;
+}
+
+APTR
+StrPool_Reserve(struct StringPool *pool, ULONG size)
+{
+    if (!pool || size == 0) return NULL;
+    return strpool_claim(pool, size);
+}
+
+STRPTR
+StrPool_Add(struct StringPool *pool, CONST_STRPTR s)
+{
+    if (!s) return NULL;
+    return StrPool_AddLen(pool, s, strlen(s));
+}
+
+void
+StrPool_Reset(struct StringPool *pool)
+{
+    if (!pool || !pool->chunks) return;
+
+    StrPoolChunk *c = pool->chunks->next;
+    while (c) {
+        StrPoolChunk *next = c->next;
+        FreeVec(c);
+        c = next;
+    }
+    pool->chunks->next = NULL;
+    pool->chunks->used = 0;
+    pool->bytes = 0;
+}
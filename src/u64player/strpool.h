@@ -0,0 +1,51 @@
+/* Append-only string pool for playlist filenames and titles.
+ *
+ * Strings are packed back-to-back into large AllocVec'd chunks instead of
+ * one allocation each, so a 60,000-entry playlist costs a few dozen exec
+ * allocations rather than 120,000 — and clearing it is just as cheap.
+ * Individual strings are never freed; StrPool_Reset drops them all.
+ */
+
+#ifndef U64_STRPOOL_H
+#define U64_STRPOOL_H
+
+#include <exec/types.h>
+
+#define STRPOOL_CHUNK_SIZE  16384   /* bytes per chunk, excluding header */
+
+typedef struct StrPoolChunk
+{
+    struct StrPoolChunk *next;
+    ULONG size;                     /* usable bytes in data[] */
+    ULONG used;
+    char data[1];                   /* size bytes follow */
+} StrPoolChunk;
+
+struct StringPool
+{
+    StrPoolChunk *chunks;           /* newest first — the one being filled */
+    ULONG bytes;                    /* total string bytes stored, incl. NULs */
+};
+
+/* Allocate an empty pool. Caller frees with StrPool_Free. */
+struct StringPool *StrPool_Create(void);
+
+/* Destroy a pool and every string in it; NULL is safe. */
+void StrPool_Free(struct StringPool *pool);
+
+/* Copy len bytes of s plus a terminating NUL into the pool. Returns the
+ * pooled copy, or NULL when pool is NULL or out of memory. */
+STRPTR StrPool_AddLen(struct StringPool *pool, CONST_STRPTR s, ULONG len);
+
+/* StrPool_AddLen for a NUL-terminated string; NULL s is returned as NULL. */
+STRPTR StrPool_Add(struct StringPool *pool, CONST_STRPTR s);
+
+/* Claim size uninitialised bytes in one piece, for filling with a block of
+ * NUL-terminated strings directly (e.g. a Read from a binary playlist).
+ * Returns NULL when pool is NULL or out of memory. */
+APTR StrPool_Reserve(struct StringPool *pool, ULONG size);
+
+/* Forget every string, keeping only the newest chunk for reuse. */
+void StrPool_Reset(struct StringPool *pool);
+
+#endif
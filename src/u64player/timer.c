@@ -3,12 +3,14 @@
  */
 
 #include <devices/timer.h>
+#include <dos/dos.h>
 #include <exec/types.h>
 
 #include <proto/dos.h>
 #include <proto/exec.h>
 
 #include "player.h"
+#include "sidcache.h"
 
 /* Timer state is module-private; cross-TU access goes through TimerWaitMask()
  * so we never rely on -fbaserel-unfriendly extern globals for the hot loop. */
@@ -120,9 +122,12 @@ BOOL CheckTimerSignal(ULONG sigs)
             objApp->current_time++;
             APP_UpdateCurrentSongDisplay();
             if (objApp->current_time >= objApp->total_time) {
-                APP_Next();
+                APP_Advance();
             }
 
+            /* Give cached SID buffers back if the system runs short. */
+            SIDCache_CheckMemory(objApp->sid_cache);
+
             if (objApp->state == PLAYER_PLAYING) {
                 StartPeriodicTimer();
             }
@@ -131,3 +136,14 @@ BOOL CheckTimerSignal(ULONG sigs)
 
     return timer_fired;
 }
+
+/* Ticks (1/50 s) elapsed since start, for the benchmarks' timing loops */
+ULONG TicksSince(const struct DateStamp *start)
+{
+    struct DateStamp now;
+
+    DateStamp(&now);
+    return (now.ds_Days - start->ds_Days) * 24 * 60 * 60 * TICKS_PER_SECOND
+         + (now.ds_Minute - start->ds_Minute) * 60 * TICKS_PER_SECOND
+         + (now.ds_Tick - start->ds_Tick);
+}
@@ -0,0 +1,880 @@
+/* Ultimate64 SID Player - trigram index over the HVSC library catalogue
+ * For Amiga OS 3.x by Marcin Spoczynski
+ *
+ * Every record's path, title, author and released text is folded to a
+ * 37-letter alphabet (a-z, 0-9, one symbol for accented Latin-1) and cut
+ * into trigrams within words. library.idx holds, per trigram, the sorted
+ * record numbers containing it, delta-coded as 7-bit varints:
+ *
+ *     TrigramIndexHeader
+ *     TrigramSlot[TRIGRAM_COUNT]   offset/count/bytes of each posting list
+ *     posting lists
+ *
+ * A query intersects the lists of its trigrams, shortest first, then reads
+ * just the surviving records to verify and rank them.
+ *
+ * After a rescan the index isn't built again: each old list is renumbered
+ * through the rescan's LibraryDelta and merged with the lists of the few
+ * records that were read from disk, so only those records are tokenized.
+ */
+
+#include <dos/dos.h>
+#include <exec/memory.h>
+#include <exec/types.h>
+
+#include <proto/dos.h>
+#include <proto/exec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "player.h"
+#include "strpool.h"
+#include "library.h"
+
+#define TRIGRAM_MAGIC       "U64TRI01"
+#define TRIGRAM_VERSION     1
+#define TRIGRAM_SYMBOLS     37
+#define TRIGRAM_COUNT       (TRIGRAM_SYMBOLS * TRIGRAM_SYMBOLS * TRIGRAM_SYMBOLS)
+#define TRIGRAM_MAX_PER_REC 640     /* more than a full record can produce */
+#define TRIGRAM_MAX_QUERY   32      /* distinct trigrams used per query */
+#define TRIGRAM_MAX_WORDS   8
+#define TRIGRAM_MAX_VERIFY  4000    /* candidates read back per query */
+#define TRIGRAM_WRITE_FAILED ((ULONG)~0)
+#define TRIGRAM_UPDATE_SHARE 4      /* rebuild once over 1/4 of records were read */
+
+struct TrigramIndexHeader {
+    char   magic[8];
+    ULONG  version;
+    ULONG  record_count;
+    ULONG  cat_size;                /* catalogue this index was built from */
+    struct DateStamp cat_date;
+};
+
+typedef struct TrigramSlot {
+    ULONG  offset;
+    ULONG  count;
+    ULONG  bytes;
+} TrigramSlot;
+
+#define TRIGRAM_SLOTS_OFFSET  sizeof(struct TrigramIndexHeader)
+
+/* ------------------------------------------------------------------ */
+/* Trigram extraction                                                  */
+/* ------------------------------------------------------------------ */
+
+/* 1..37, or 0 for a word break. */
+static UBYTE
+Trigram_Symbol(UBYTE c)
+{
+    if (c >= 'a' && c <= 'z') return (UBYTE)(c - 'a' + 1);
+    if (c >= 'A' && c <= 'Z') return (UBYTE)(c - 'A' + 1);
+    if (c >= '0' && c <= '9') return (UBYTE)(c - '0' + 27);
+    if (c >= 0xC0 && c != 0xD7 && c != 0xF7) return 37;
+    return 0;
+}
+
+/* Collects the distinct trigrams of one record or query. */
+struct TrigramSet {
+    UBYTE *seen;                    /* TRIGRAM_COUNT bits */
+    UWORD  ids[TRIGRAM_MAX_PER_REC];
+    ULONG  count;
+    ULONG  limit;
+};
+
+static void
+Trigram_AddText(struct TrigramSet *set, CONST_STRPTR text)
+{
+    ULONG a = 0, b = 0;
+
+    for (; *text; text++) {
+        ULONG c = Trigram_Symbol((UBYTE)*text);
+        if (c == 0) {
+            a = b = 0;
+            continue;
+        }
+        if (a && b && set->count < set->limit) {
+            ULONG id = ((a - 1) * TRIGRAM_SYMBOLS + (b - 1)) * TRIGRAM_SYMBOLS + (c - 1);
+            if (!(set->seen[id >> 3] & (1 << (id & 7)))) {
+                set->seen[id >> 3] |= (UBYTE)(1 << (id & 7));
+                set->ids[set->count++] = (UWORD)id;
+            }
+        }
+        a = b;
+        b = c;
+    }
+}
+
+/* Forget the collected ids, leaving the bitmap all clear again. */
+static void
+Trigram_ClearSet(struct TrigramSet *set)
+{
+    ULONG i;
+    for (i = 0; i < set->count; i++) set->seen[set->ids[i] >> 3] = 0;
+    set->count = 0;
+}
+
+static void
+Trigram_AddRecord(struct TrigramSet *set, const LibraryRecord *rec)
+{
+    Trigram_AddText(set, rec->path);
+    Trigram_AddText(set, rec->title);
+    Trigram_AddText(set, rec->author);
+    Trigram_AddText(set, rec->released);
+}
+
+/* ------------------------------------------------------------------ */
+/* Building                                                            */
+/* ------------------------------------------------------------------ */
+
+struct BuildState {
+    struct ObjApp *obj;
+    struct TrigramSet set;
+    ULONG *counts;                  /* postings per trigram */
+    ULONG  lo, hi;                  /* trigram range of the current pass */
+    ULONG *fill;                    /* next free posting per trigram in range */
+    ULONG *postings;
+    ULONG  seen_records;
+    ULONG  record_count;
+};
+
+static BOOL
+Trigram_CountRecord(ULONG index, const LibraryRecord *rec, APTR user)
+{
+    struct BuildState *bs = user;
+    ULONG i;
+
+    Trigram_AddRecord(&bs->set, rec);
+    for (i = 0; i < bs->set.count; i++) bs->counts[bs->set.ids[i]]++;
+    Trigram_ClearSet(&bs->set);
+
+    if ((++bs->seen_records % 1024) == 0) {
+        char msg[96];
+        sprintf(msg, "Indexing library... %lu%%",
+                (unsigned long)(bs->seen_records * 50 / bs->record_count));
+        APP_UpdateStatus(msg);
+        if (APP_PumpEvents(bs->obj)) return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL
+Trigram_FillRecord(ULONG index, const LibraryRecord *rec, APTR user)
+{
+    struct BuildState *bs = user;
+    ULONG i;
+
+    Trigram_AddRecord(&bs->set, rec);
+    for (i = 0; i < bs->set.count; i++) {
+        ULONG id = bs->set.ids[i];
+        if (id >= bs->lo && id < bs->hi) {
+            bs->postings[bs->fill[id - bs->lo]++] = index;
+        }
+    }
+    Trigram_ClearSet(&bs->set);
+    return TRUE;
+}
+
+/* Append n delta-coded record numbers; returns bytes written or
+ * TRIGRAM_WRITE_FAILED. */
+static ULONG
+Trigram_WritePostings(BPTR out, const ULONG *docs, ULONG n)
+{
+    UBYTE buf[256];
+    ULONG used = 0, total = 0;
+    ULONG prev = 0;
+    ULONG i;
+
+    for (i = 0; i < n; i++) {
+        ULONG v = docs[i] - prev;
+        prev = docs[i];
+
+        if (used > sizeof(buf) - 5) {
+            if (FWrite(out, buf, 1, used) != used) return TRIGRAM_WRITE_FAILED;
+            total += used;
+            used = 0;
+        }
+        while (v >= 0x80) {
+            buf[used++] = (UBYTE)(v | 0x80);
+            v >>= 7;
+        }
+        buf[used++] = (UBYTE)v;
+    }
+    if (used && FWrite(out, buf, 1, used) != used) return TRIGRAM_WRITE_FAILED;
+    return total + used;
+}
+
+static BOOL
+Trigram_CatalogueStamp(CONST_STRPTR cat_path, ULONG *size, struct DateStamp *date)
+{
+    struct FileInfoBlock *fib;
+    BOOL ok = FALSE;
+    BPTR lock;
+
+    lock = Lock(cat_path, ACCESS_READ);
+    if (!lock) return FALSE;
+    fib = AllocVec(sizeof(struct FileInfoBlock), MEMF_PUBLIC | MEMF_CLEAR);
+    if (fib && Examine(lock, fib)) {
+        *size = fib->fib_Size;
+        *date = fib->fib_Date;
+        ok = TRUE;
+    }
+    if (fib) FreeVec(fib);
+    UnLock(lock);
+    return ok;
+}
+
+BOOL
+Trigram_IndexFresh(struct SIDLibrary *lib, CONST_STRPTR cat_path, CONST_STRPTR idx_path)
+{
+    struct TrigramIndexHeader hdr;
+    struct DateStamp date;
+    ULONG size;
+    BOOL fresh = FALSE;
+    BPTR file;
+
+    if (!lib || !Trigram_CatalogueStamp(cat_path, &size, &date)) return FALSE;
+
+    file = Open(idx_path, MODE_OLDFILE);
+    if (!file) return FALSE;
+    if (Read(file, &hdr, sizeof(hdr)) == sizeof(hdr)
+        && memcmp(hdr.magic, TRIGRAM_MAGIC, 8) == 0
+        && hdr.version == TRIGRAM_VERSION
+        && hdr.record_count == lib->hdr.record_count
+        && hdr.cat_size == size
+        && CompareDates(&hdr.cat_date, &date) == 0) {
+        fresh = TRUE;
+    }
+    Close(file);
+    return fresh;
+}
+
+/* Header for an index of lib as the catalogue file stands now. */
+static BOOL
+Trigram_InitHeader(struct SIDLibrary *lib, CONST_STRPTR cat_path,
+                   struct TrigramIndexHeader *hdr)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    CopyMem((APTR)TRIGRAM_MAGIC, hdr->magic, 8);
+    hdr->version = TRIGRAM_VERSION;
+    hdr->record_count = lib->hdr.record_count;
+    return Trigram_CatalogueStamp(cat_path, &hdr->cat_size, &hdr->cat_date);
+}
+
+/* Write the real slot table and header over the placeholders. */
+static BOOL
+Trigram_FinishIndex(BPTR out, const TrigramSlot *slots,
+                    const struct TrigramIndexHeader *hdr)
+{
+    if (Flush(out) == DOSFALSE) return FALSE;
+    Seek(out, TRIGRAM_SLOTS_OFFSET, OFFSET_BEGINNING);
+    if (Write(out, (APTR)slots, TRIGRAM_COUNT * sizeof(TrigramSlot))
+        != (LONG)(TRIGRAM_COUNT * sizeof(TrigramSlot))) {
+        return FALSE;
+    }
+    Seek(out, 0, OFFSET_BEGINNING);
+    return Write(out, (APTR)hdr, sizeof(*hdr)) == sizeof(*hdr);
+}
+
+BOOL
+Trigram_BuildIndex(struct ObjApp *obj, struct SIDLibrary *lib,
+                   CONST_STRPTR cat_path, CONST_STRPTR idx_path)
+{
+    struct TrigramIndexHeader hdr;
+    struct BuildState *bs;
+    TrigramSlot *slots = NULL;
+    char tmp_path[512];
+    BPTR out = 0;
+    ULONG budget, pos;
+    BOOL ok = FALSE;
+
+    if (!lib) return FALSE;
+
+    bs = AllocVec(sizeof(struct BuildState), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!bs) return FALSE;
+    bs->obj = obj;
+    bs->record_count = lib->hdr.record_count ? lib->hdr.record_count : 1;
+    bs->set.limit = TRIGRAM_MAX_PER_REC;
+    bs->set.seen = AllocVec((TRIGRAM_COUNT + 7) / 8, MEMF_PUBLIC | MEMF_CLEAR);
+    bs->counts = AllocVec(TRIGRAM_COUNT * sizeof(ULONG), MEMF_PUBLIC | MEMF_CLEAR);
+    slots = AllocVec(TRIGRAM_COUNT * sizeof(TrigramSlot), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!bs->set.seen || !bs->counts || !slots) goto done;
+
+    /* Pass 1: size every posting list */
+    if (!Library_ForEach(lib, Trigram_CountRecord, bs)) goto done;
+
+    if (!Trigram_InitHeader(lib, cat_path, &hdr)) goto done;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.new", idx_path);
+    out = Open(tmp_path, MODE_NEWFILE);
+    if (!out) goto done;
+
+    /* Placeholders; the real slot table and header go in at the end */
+    if (FWrite(out, &hdr, sizeof(hdr), 1) != 1
+        || FWrite(out, slots, sizeof(TrigramSlot), TRIGRAM_COUNT) != TRIGRAM_COUNT) {
+        goto done;
+    }
+    pos = TRIGRAM_SLOTS_OFFSET + TRIGRAM_COUNT * sizeof(TrigramSlot);
+
+    /* Postings for the whole of HVSC don't fit in a small Amiga, so fill
+     * them a trigram range at a time, each range sized to half the largest
+     * free block. */
+    budget = AvailMem(MEMF_ANY | MEMF_LARGEST) / 2 / sizeof(ULONG);
+    if (budget < 16384) budget = 16384;
+    if (budget > 1048576) budget = 1048576;
+
+    bs->lo = 0;
+    while (bs->lo < TRIGRAM_COUNT) {
+        ULONG sum = 0, k, start;
+
+        bs->hi = bs->lo;
+        while (bs->hi < TRIGRAM_COUNT
+               && (sum == 0 || sum + bs->counts[bs->hi] <= budget)) {
+            sum += bs->counts[bs->hi++];
+        }
+        if (sum == 0) {
+            bs->lo = bs->hi;
+            continue;
+        }
+
+        bs->postings = AllocVec(sum * sizeof(ULONG), MEMF_PUBLIC);
+        bs->fill = AllocVec((bs->hi - bs->lo) * sizeof(ULONG), MEMF_PUBLIC);
+        if (!bs->postings || !bs->fill) goto done;
+
+        for (start = 0, k = bs->lo; k < bs->hi; k++) {
+            bs->fill[k - bs->lo] = start;
+            start += bs->counts[k];
+        }
+
+        {
+            char msg[96];
+            sprintf(msg, "Indexing library... %lu%%",
+                    (unsigned long)(50 + bs->lo * 50 / TRIGRAM_COUNT));
+            APP_UpdateStatus(msg);
+            if (APP_PumpEvents(obj)) goto done;
+        }
+
+        if (!Library_ForEach(lib, Trigram_FillRecord, bs)) goto done;
+
+        /* Records are visited in order, so each list is already sorted */
+        for (start = 0, k = bs->lo; k < bs->hi; k++) {
+            ULONG n = bs->counts[k];
+            ULONG bytes;
+
+            if (n == 0) continue;
+            bytes = Trigram_WritePostings(out, bs->postings + start, n);
+            if (bytes == TRIGRAM_WRITE_FAILED) goto done;
+            slots[k].offset = pos;
+            slots[k].count = n;
+            slots[k].bytes = bytes;
+            pos += bytes;
+            start += n;
+        }
+
+        FreeVec(bs->postings);
+        FreeVec(bs->fill);
+        bs->postings = NULL;
+        bs->fill = NULL;
+        bs->lo = bs->hi;
+    }
+
+    if (!Trigram_FinishIndex(out, slots, &hdr)) goto done;
+    ok = TRUE;
+
+done:
+    if (out) Close(out);
+    if (ok) {
+        DeleteFile((STRPTR)idx_path);
+        ok = Rename(tmp_path, (STRPTR)idx_path) != DOSFALSE;
+    } else if (out) {
+        DeleteFile(tmp_path);
+    }
+    U64_DEBUG("trigram: index build %s", ok ? "done" : "failed");
+
+    if (bs->postings) FreeVec(bs->postings);
+    if (bs->fill) FreeVec(bs->fill);
+    if (bs->set.seen) FreeVec(bs->set.seen);
+    if (bs->counts) FreeVec(bs->counts);
+    if (slots) FreeVec(slots);
+    FreeVec(bs);
+    return ok;
+}
+
+/* Read and decode one posting list into an AllocVec'd array. */
+static ULONG *
+Trigram_ReadPostings(BPTR idx, const TrigramSlot *slot)
+{
+    UBYTE *raw;
+    ULONG *docs;
+    ULONG i, n = 0, prev = 0;
+
+    raw = AllocVec(slot->bytes, MEMF_PUBLIC);
+    docs = AllocVec(slot->count * sizeof(ULONG), MEMF_PUBLIC);
+    if (!raw || !docs) goto fail;
+
+    Seek(idx, slot->offset, OFFSET_BEGINNING);
+    if (Read(idx, raw, slot->bytes) != (LONG)slot->bytes) goto fail;
+
+    for (i = 0; i < slot->bytes && n < slot->count; ) {
+        ULONG v = 0, shift = 0;
+        while (i < slot->bytes) {
+            UBYTE b = raw[i++];
+            v |= (ULONG)(b & 0x7F) << shift;
+            shift += 7;
+            if (!(b & 0x80)) break;
+        }
+        prev += v;
+        docs[n++] = prev;
+    }
+    FreeVec(raw);
+    return docs;
+
+fail:
+    if (raw) FreeVec(raw);
+    if (docs) FreeVec(docs);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Updating after a rescan                                             */
+/* ------------------------------------------------------------------ */
+
+static int
+Trigram_CompareRecords(const void *a, const void *b)
+{
+    ULONG x = *(const ULONG *)a;
+    ULONG y = *(const ULONG *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* Posting lists for just the records in delta->added, grouped by trigram:
+ * trigram k's list ends at ends[k] and starts where k - 1's ends. Each
+ * record is read twice, to size the lists and then to fill them; both
+ * passes visit records in order, so every list comes out sorted. */
+static ULONG *
+Trigram_AddedPostings(struct SIDLibrary *lib, const struct LibraryDelta *delta,
+                      struct TrigramSet *set, ULONG *ends)
+{
+    LibraryRecord rec;
+    ULONG *postings = NULL;
+    ULONG pass, i, j, total = 0;
+
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < delta->added_count; i++) {
+            ULONG record = delta->added[i];
+
+            if (!Library_ReadRecord(lib, record, &rec)) {
+                if (postings) FreeVec(postings);
+                return NULL;
+            }
+            Trigram_AddRecord(set, &rec);
+            for (j = 0; j < set->count; j++) {
+                if (pass == 0) ends[set->ids[j]]++;
+                else postings[ends[set->ids[j]]++] = record;
+            }
+            Trigram_ClearSet(set);
+        }
+
+        if (pass == 0) {
+            /* Counts become starts; filling then moves each to its end */
+            for (i = 0; i < TRIGRAM_COUNT; i++) {
+                ULONG n = ends[i];
+                ends[i] = total;
+                total += n;
+            }
+            postings = AllocVec((total ? total : 1) * sizeof(ULONG), MEMF_PUBLIC);
+            if (!postings) return NULL;
+        }
+    }
+    return postings;
+}
+
+BOOL
+Trigram_UpdateIndex(struct ObjApp *obj, struct SIDLibrary *lib,
+                    const struct LibraryDelta *delta,
+                    CONST_STRPTR cat_path, CONST_STRPTR idx_path)
+{
+    struct TrigramIndexHeader hdr, old_hdr;
+    struct TrigramSet set;
+    TrigramSlot *slots = NULL;
+    ULONG *ends = NULL, *added = NULL, *merged = NULL;
+    ULONG merged_capacity = 0;
+    char tmp_path[512];
+    BPTR old, out = 0;
+    ULONG k, pos;
+    BOOL ok = FALSE;
+
+    if (!lib || !delta || !delta->old_to_new) return FALSE;
+
+    /* Past this a full build, which reads the catalogue sequentially, is
+     * cheaper than reading every changed record on its own. */
+    if (delta->added_count > lib->hdr.record_count / TRIGRAM_UPDATE_SHARE) return FALSE;
+
+    old = Open(idx_path, MODE_OLDFILE);
+    if (!old) return FALSE;
+
+    memset(&set, 0, sizeof(set));
+    set.limit = TRIGRAM_MAX_PER_REC;
+    set.seen = AllocVec((TRIGRAM_COUNT + 7) / 8, MEMF_PUBLIC | MEMF_CLEAR);
+    ends = AllocVec(TRIGRAM_COUNT * sizeof(ULONG), MEMF_PUBLIC | MEMF_CLEAR);
+    slots = AllocVec(TRIGRAM_COUNT * sizeof(TrigramSlot), MEMF_PUBLIC);
+    if (!set.seen || !ends || !slots) goto done;
+
+    /* The old index must describe exactly the catalogue delta came from */
+    if (Read(old, &old_hdr, sizeof(old_hdr)) != sizeof(old_hdr)
+        || memcmp(old_hdr.magic, TRIGRAM_MAGIC, 8) != 0
+        || old_hdr.version != TRIGRAM_VERSION
+        || old_hdr.record_count != delta->old_count
+        || Read(old, slots, TRIGRAM_COUNT * sizeof(TrigramSlot))
+           != (LONG)(TRIGRAM_COUNT * sizeof(TrigramSlot))) {
+        goto done;
+    }
+
+    added = Trigram_AddedPostings(lib, delta, &set, ends);
+    if (!added) goto done;
+
+    if (!Trigram_InitHeader(lib, cat_path, &hdr)) goto done;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.new", idx_path);
+    out = Open(tmp_path, MODE_NEWFILE);
+    if (!out) goto done;
+
+    /* Placeholders, as in a full build; slots[k] is redone as list k goes out */
+    if (FWrite(out, &hdr, sizeof(hdr), 1) != 1
+        || FWrite(out, slots, sizeof(TrigramSlot), TRIGRAM_COUNT) != TRIGRAM_COUNT) {
+        goto done;
+    }
+    pos = TRIGRAM_SLOTS_OFFSET + TRIGRAM_COUNT * sizeof(TrigramSlot);
+
+    for (k = 0; k < TRIGRAM_COUNT; k++) {
+        ULONG first = k ? ends[k - 1] : 0;
+        ULONG extra = ends[k] - first;
+        ULONG n = 0, i, j, m;
+        BOOL sorted = TRUE;
+
+        if (slots[k].count + extra > merged_capacity) {
+            if (merged) FreeVec(merged);
+            merged_capacity = slots[k].count + extra;
+            merged = AllocVec(merged_capacity * sizeof(ULONG), MEMF_PUBLIC);
+            if (!merged) goto done;
+        }
+
+        /* Renumber the old list, dropping records that are gone or were
+         * read again. Enumerated folders may list their files in a new
+         * order, so the result is only usually still sorted. */
+        if (slots[k].count) {
+            ULONG *docs = Trigram_ReadPostings(old, &slots[k]);
+
+            if (!docs) goto done;
+            for (i = 0; i < slots[k].count; i++) {
+                ULONG r = docs[i] < delta->old_count
+                          ? delta->old_to_new[docs[i]] : LIBRARY_NO_RECORD;
+                if (r == LIBRARY_NO_RECORD) continue;
+                if (n && merged[n - 1] > r) sorted = FALSE;
+                merged[n++] = r;
+            }
+            FreeVec(docs);
+            if (!sorted) qsort(merged, n, sizeof(ULONG), Trigram_CompareRecords);
+        }
+
+        /* Merge in the records that were read, from the back */
+        i = n;
+        j = extra;
+        n += extra;
+        for (m = n; j > 0; ) {
+            if (i > 0 && merged[i - 1] > added[first + j - 1]) merged[--m] = merged[--i];
+            else merged[--m] = added[first + --j];
+        }
+
+        slots[k].offset = pos;
+        slots[k].count = n;
+        slots[k].bytes = 0;
+        if (n) {
+            ULONG bytes = Trigram_WritePostings(out, merged, n);
+            if (bytes == TRIGRAM_WRITE_FAILED) goto done;
+            slots[k].bytes = bytes;
+            pos += bytes;
+        } else {
+            slots[k].offset = 0;
+        }
+
+        if ((k % 2048) == 0) {
+            char msg[96];
+            sprintf(msg, "Updating search index... %lu%%",
+                    (unsigned long)(k * 100 / TRIGRAM_COUNT));
+            APP_UpdateStatus(msg);
+            if (APP_PumpEvents(obj)) goto done;
+        }
+    }
+
+    if (!Trigram_FinishIndex(out, slots, &hdr)) goto done;
+    ok = TRUE;
+
+done:
+    Close(old);
+    if (out) Close(out);
+    if (ok) {
+        DeleteFile((STRPTR)idx_path);
+        ok = Rename(tmp_path, (STRPTR)idx_path) != DOSFALSE;
+    } else if (out) {
+        DeleteFile(tmp_path);
+    }
+    U64_DEBUG("trigram: index update %s, %lu records read",
+              ok ? "done" : "failed", (unsigned long)delta->added_count);
+
+    if (merged) FreeVec(merged);
+    if (added) FreeVec(added);
+    if (set.seen) FreeVec(set.seen);
+    if (ends) FreeVec(ends);
+    if (slots) FreeVec(slots);
+    return ok;
+}
+
+BOOL
+Trigram_OpenIndex(struct SIDLibrary *lib, CONST_STRPTR idx_path)
+{
+    struct TrigramIndexHeader hdr;
+
+    if (!lib) return FALSE;
+    if (lib->idx) {
+        Close(lib->idx);
+        lib->idx = 0;
+    }
+
+    lib->idx = Open(idx_path, MODE_OLDFILE);
+    if (!lib->idx) return FALSE;
+    if (Read(lib->idx, &hdr, sizeof(hdr)) != sizeof(hdr)
+        || memcmp(hdr.magic, TRIGRAM_MAGIC, 8) != 0
+        || hdr.record_count != lib->hdr.record_count) {
+        Close(lib->idx);
+        lib->idx = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+/* Query                                                               */
+/* ------------------------------------------------------------------ */
+
+static void
+Trigram_Lower(char *out, const char *in, ULONG size)
+{
+    ULONG i;
+    for (i = 0; in[i] && i < size - 1; i++) {
+        UBYTE c = (UBYTE)in[i];
+        out[i] = (char)((c >= 'A' && c <= 'Z') || (c >= 0xC0 && c <= 0xDE && c != 0xD7)
+                        ? c + 32 : c);
+    }
+    out[i] = '\0';
+}
+
+/* Points for one query word against one record; 0 means no match. */
+static ULONG
+Trigram_ScoreWord(const char *word, const char *title, const char *author,
+                  const char *path, const char *released)
+{
+    ULONG best = 0;
+    const char *hit;
+
+    if ((hit = strstr(title, word)) != NULL) best = hit == title ? 12 : 8;
+    if ((hit = strstr(author, word)) != NULL) {
+        ULONG s = hit == author ? 8 : 6;
+        if (s > best) best = s;
+    }
+    if (best < 3 && strstr(path, word)) best = 3;
+    if (best < 2 && strstr(released, word)) best = 2;
+    return best;
+}
+
+/* Sorted record numbers whose text holds every trigram collected in set,
+ * shortest posting list first so every intersection step stays small.
+ * Returns NULL (count 0) when nothing can match; caller FreeVecs. */
+static ULONG *
+Trigram_Intersect(struct SIDLibrary *lib, struct TrigramSet *set, ULONG *count)
+{
+    TrigramSlot slots[TRIGRAM_MAX_QUERY];
+    ULONG *cand;
+    ULONG ncand;
+    ULONG i, j;
+
+    *count = 0;
+    for (i = 0; i < set->count; i++) {
+        Seek(lib->idx, TRIGRAM_SLOTS_OFFSET + set->ids[i] * sizeof(TrigramSlot),
+             OFFSET_BEGINNING);
+        if (Read(lib->idx, &slots[i], sizeof(TrigramSlot)) != sizeof(TrigramSlot)) {
+            return NULL;
+        }
+        if (slots[i].count == 0) return NULL;
+    }
+
+    for (i = 1; i < set->count; i++) {
+        TrigramSlot s = slots[i];
+        for (j = i; j > 0 && slots[j - 1].count > s.count; j--) slots[j] = slots[j - 1];
+        slots[j] = s;
+    }
+
+    cand = Trigram_ReadPostings(lib->idx, &slots[0]);
+    if (!cand) return NULL;
+    ncand = slots[0].count;
+
+    for (i = 1; i < set->count && ncand > 0; i++) {
+        ULONG *docs = Trigram_ReadPostings(lib->idx, &slots[i]);
+        ULONG a = 0, b = 0, out = 0;
+
+        if (!docs) break;
+        while (a < ncand && b < slots[i].count) {
+            if (cand[a] < docs[b]) a++;
+            else if (cand[a] > docs[b]) b++;
+            else {
+                cand[out++] = cand[a++];
+                b++;
+            }
+        }
+        ncand = out;
+        FreeVec(docs);
+    }
+
+    *count = ncand;
+    return cand;
+}
+
+LONG
+Trigram_Candidates(struct SIDLibrary *lib, CONST_STRPTR text, ULONG **records)
+{
+    UBYTE seen[(TRIGRAM_COUNT + 7) / 8];
+    struct TrigramSet set;
+    ULONG count;
+
+    *records = NULL;
+    if (!lib || !lib->idx) return -1;
+
+    memset(seen, 0, sizeof(seen));
+    set.seen = seen;
+    set.count = 0;
+    set.limit = TRIGRAM_MAX_QUERY;
+    Trigram_AddText(&set, text);
+    if (set.count == 0) return -1;
+
+    *records = Trigram_Intersect(lib, &set, &count);
+    return (LONG)count;
+}
+
+LONG
+Trigram_Query(struct SIDLibrary *lib, CONST_STRPTR query,
+              struct LibraryResults *results)
+{
+    char words[TRIGRAM_MAX_WORDS][64];
+    ULONG word_count = 0;
+    UBYTE seen[(TRIGRAM_COUNT + 7) / 8];
+    struct TrigramSet set;
+    ULONG *cand = NULL;
+    ULONG ncand = 0;
+    LibraryRecord rec;
+    ULONG i, j;
+
+    results->count = 0;
+    results->candidates = 0;
+    if (results->strings) StrPool_Reset(results->strings);
+
+    if (!lib || !lib->idx) return -1;
+
+    /* Split into lowercase words at the same breaks the index uses */
+    {
+        CONST_STRPTR p = query;
+        while (*p && word_count < TRIGRAM_MAX_WORDS) {
+            ULONG len = 0;
+            while (*p && !Trigram_Symbol((UBYTE)*p)) p++;
+            while (*p && Trigram_Symbol((UBYTE)*p)) {
+                if (len < sizeof(words[0]) - 1) words[word_count][len++] = *p;
+                p++;
+            }
+            if (len) {
+                words[word_count][len] = '\0';
+                Trigram_Lower(words[word_count], words[word_count], sizeof(words[0]));
+                word_count++;
+            }
+        }
+    }
+
+    memset(seen, 0, sizeof(seen));
+    set.seen = seen;
+    set.count = 0;
+    set.limit = TRIGRAM_MAX_QUERY;
+    for (i = 0; i < word_count; i++) Trigram_AddText(&set, words[i]);
+    if (set.count == 0) return -1;
+
+    cand = Trigram_Intersect(lib, &set, &ncand);
+    if (!cand) return 0;
+
+    /* Verify against the real text and keep the best scores, ranked */
+    for (i = 0; i < ncand && i < TRIGRAM_MAX_VERIFY; i++) {
+        char title[33], author[33], released[33], path[512];
+        ULONG score = 0;
+        ULONG w;
+
+        if (!Library_ReadRecord(lib, cand[i], &rec)) continue;
+        Trigram_Lower(title, rec.title, sizeof(title));
+        Trigram_Lower(author, rec.author, sizeof(author));
+        Trigram_Lower(released, rec.released, sizeof(released));
+        Trigram_Lower(path, rec.path, sizeof(path));
+
+        for (w = 0; w < word_count; w++) {
+            ULONG s = Trigram_ScoreWord(words[w], title, author, path, released);
+            if (s == 0) break;
+            score += s;
+        }
+        if (w < word_count) continue;
+        results->candidates++;
+
+        if (results->count == LIBRARY_MAX_RESULTS
+            && score <= results->items[LIBRARY_MAX_RESULTS - 1].score) {
+            continue;
+        }
+        j = results->count < LIBRARY_MAX_RESULTS ? results->count++ : LIBRARY_MAX_RESULTS - 1;
+        while (j > 0 && results->items[j - 1].score < score) {
+            results->items[j] = results->items[j - 1];
+            j--;
+        }
+        results->items[j].record = cand[i];
+        results->items[j].score = score;
+    }
+    FreeVec(cand);
+
+    /* Only now fetch the strings, for the hits that made the cut */
+    if (results->count > 0 && !results->strings) {
+        results->strings = StrPool_Create();
+        if (!results->strings) {
+            results->count = 0;
+            return 0;
+        }
+    }
+    for (i = 0; i < results->count; i++) {
+        LibraryResult *r = &results->items[i];
+        char full[768];
+
+        if (!Library_ReadRecord(lib, r->record, &rec)) memset(&rec, 0, sizeof(rec));
+        strncpy(full, lib->hdr.root, sizeof(full) - 1);
+        full[sizeof(full) - 1] = '\0';
+        AddPart(full, rec.path, sizeof(full));
+
+        r->info = rec.info;
+        r->path = StrPool_Add(results->strings, full);
+        r->title = StrPool_Add(results->strings, rec.title[0] ? (STRPTR)rec.title : FilePart(rec.path));
+        r->author = StrPool_Add(results->strings, rec.author);
+        r->released = StrPool_Add(results->strings, rec.released);
+    }
+
+    return (LONG)results->count;
+}
+
+void
+Trigram_FreeResults(struct LibraryResults *results)
+{
+    if (!results) return;
+    StrPool_Free(results->strings);
+    results->strings = NULL;
+    results->count = 0;
+    results->candidates = 0;
+}
@@ -30,6 +30,19 @@ void CreateMenu(struct ObjApp *obj)
         MUIA_Menuitem_Shortcut, "C",
     End;
 
+    obj->MN_Project_Library = MenuitemObject,
+        MUIA_Menuitem_Title, "Search Library...",
+        MUIA_Menuitem_Shortcut, "F",
+    End;
+
+    obj->MN_Project_SongDBUpdate = MenuitemObject,
+        MUIA_Menuitem_Title, "Apply Song-Length Update...",
+    End;
+
+    obj->MN_Project_SongDBFetch = MenuitemObject,
+        MUIA_Menuitem_Title, "Fetch Song-Length Update",
+    End;
+
     obj->MN_Project_Quit = MenuitemObject,
         MUIA_Menuitem_Title, "Quit",
         MUIA_Menuitem_Shortcut, "Q",
@@ -51,11 +64,33 @@ void CreateMenu(struct ObjApp *obj)
         MUIA_Menuitem_Shortcut, "A",
     End;
 
+    /* Views from the play statistics: reorder the playlist, until
+     * Original Order puts it back the way it was added */
+    obj->MN_Playlist_SortPlayed = MenuitemObject,
+        MUIA_Menuitem_Title, "Sort by Most Played",
+    End;
+
+    obj->MN_Playlist_SortRecent = MenuitemObject,
+        MUIA_Menuitem_Title, "Sort by Recently Played",
+    End;
+
+    obj->MN_Playlist_SortUnfinished = MenuitemObject,
+        MUIA_Menuitem_Title, "Sort by Never Finished",
+    End;
+
+    obj->MN_Playlist_SortOriginal = MenuitemObject,
+        MUIA_Menuitem_Title, "Original Order",
+    End;
+
     Object *menu1 = MenuitemObject,
         MUIA_Menuitem_Title, "Project",
         MUIA_Family_Child, obj->MN_Project_About,
         MUIA_Family_Child, MenuitemObject, MUIA_Menuitem_Title, "", End,
         MUIA_Family_Child, obj->MN_Project_Config,
+        MUIA_Family_Child, obj->MN_Project_Library,
+        MUIA_Family_Child, MenuitemObject, MUIA_Menuitem_Title, "", End,
+        MUIA_Family_Child, obj->MN_Project_SongDBUpdate,
+        MUIA_Family_Child, obj->MN_Project_SongDBFetch,
         MUIA_Family_Child, MenuitemObject, MUIA_Menuitem_Title, "", End,
         MUIA_Family_Child, obj->MN_Project_Quit,
     End;
@@ -67,6 +102,11 @@ void CreateMenu(struct ObjApp *obj)
         MUIA_Family_Child, MenuitemObject, MUIA_Menuitem_Title, "", End,
         MUIA_Family_Child, obj->MN_Playlist_Save,
         MUIA_Family_Child, obj->MN_Playlist_SaveAs,
+        MUIA_Family_Child, MenuitemObject, MUIA_Menuitem_Title, "", End,
+        MUIA_Family_Child, obj->MN_Playlist_SortPlayed,
+        MUIA_Family_Child, obj->MN_Playlist_SortRecent,
+        MUIA_Family_Child, obj->MN_Playlist_SortUnfinished,
+        MUIA_Family_Child, obj->MN_Playlist_SortOriginal,
     End;
 
     obj->MN_Main = MenustripObject,
@@ -84,6 +124,15 @@ void CreateMenuEvents(struct ObjApp *obj)
     DoMethod(obj->MN_Project_Config, MUIM_Notify, MUIA_Menuitem_Trigger,
              MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_CONFIG_OPEN);
 
+    DoMethod(obj->MN_Project_Library, MUIM_Notify, MUIA_Menuitem_Trigger,
+             MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_LIBRARY_OPEN);
+
+    DoMethod(obj->MN_Project_SongDBUpdate, MUIM_Notify, MUIA_Menuitem_Trigger,
+             MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_SONGDB_UPDATE_FILE);
+
+    DoMethod(obj->MN_Project_SongDBFetch, MUIM_Notify, MUIA_Menuitem_Trigger,
+             MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_SONGDB_UPDATE_FETCH);
+
     DoMethod(obj->MN_Project_Quit, MUIM_Notify, MUIA_Menuitem_Trigger,
              MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, MUIV_Application_ReturnID_Quit);
 
@@ -96,6 +145,18 @@ void CreateMenuEvents(struct ObjApp *obj)
 
     DoMethod(obj->MN_Playlist_SaveAs, MUIM_Notify, MUIA_Menuitem_Trigger,
              MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_PLAYLIST_SAVE_AS);
+
+    DoMethod(obj->MN_Playlist_SortPlayed, MUIM_Notify, MUIA_Menuitem_Trigger,
+             MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_PLAYLIST_SORT_PLAYED);
+
+    DoMethod(obj->MN_Playlist_SortRecent, MUIM_Notify, MUIA_Menuitem_Trigger,
+             MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_PLAYLIST_SORT_RECENT);
+
+    DoMethod(obj->MN_Playlist_SortUnfinished, MUIM_Notify, MUIA_Menuitem_Trigger,
+             MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_PLAYLIST_SORT_UNFINISHED);
+
+    DoMethod(obj->MN_Playlist_SortOriginal, MUIM_Notify, MUIA_Menuitem_Trigger,
+             MUIV_EveryTime, obj->App, 2, MUIM_Application_ReturnID, EVENT_PLAYLIST_SORT_ORIGINAL);
 }
 
 void CreateWindowMain(struct ObjApp *obj)
@@ -133,6 +194,7 @@ void CreateWindowMain(struct ObjApp *obj)
             MUIA_List_Active, MUIV_List_Active_Top,
             MUIA_List_Format, "",
             MUIA_List_Title, FALSE,
+            MUIA_List_DisplayHook, &PlaylistDisplayHook,
             TAG_DONE),
         MUIA_Listview_Input, TRUE,
         MUIA_Listview_DoubleClick, TRUE,
@@ -251,6 +313,7 @@ void CreateWindowMain(struct ObjApp *obj)
 
     obj->CHK_Shuffle = U64CheckMark(FALSE);
     obj->CHK_Repeat = U64CheckMark(FALSE);
+    obj->CHK_SkipSilence = U64CheckMark(FALSE);
 
     /* Create current song info displays */
     obj->TXT_CurrentSong = MUI_NewObject(MUIC_Text,
@@ -278,6 +341,12 @@ void CreateWindowMain(struct ObjApp *obj)
         MUIA_Text_PreParse, "\33c",
         TAG_DONE);
 
+    /* STIL comment (stil.c); a read-only list so long entries scroll */
+    obj->FLT_STILInfo = MUI_NewObject(MUIC_Floattext,
+        MUIA_Frame, MUIV_Frame_ReadList,
+        MUIA_Floattext_Text, "",
+        TAG_DONE);
+
     /* Create groups */
 
     /* Group 1: Connection & SID Status */
@@ -307,6 +376,11 @@ void CreateWindowMain(struct ObjApp *obj)
         MUIA_FrameTitle, "Now Playing",
         Child, obj->TXT_CurrentSong,
         Child, obj->TXT_SubsongInfo,
+        Child, MUI_NewObject(MUIC_Listview,
+            MUIA_Listview_List, obj->FLT_STILInfo,
+            MUIA_Listview_Input, FALSE,
+            MUIA_VertWeight, 30,
+            TAG_DONE),
         Child, MUI_NewObject(MUIC_Group,
             MUIA_Group_Horiz, TRUE,
             Child, obj->TXT_CurrentTime,
@@ -330,6 +404,8 @@ void CreateWindowMain(struct ObjApp *obj)
         Child, U64Label("Shuffle"),
         Child, obj->CHK_Repeat,
         Child, U64Label("Repeat"),
+        Child, obj->CHK_SkipSilence,
+        Child, U64Label("Skip silence"),
         TAG_DONE);
 
     /* Playlist management buttons row with logical grouping */
@@ -443,6 +519,9 @@ void CreateWindowMainEvents(struct ObjApp *obj)
     DoMethod(obj->CHK_Repeat, MUIM_Notify, MUIA_Selected, MUIV_EveryTime,
              obj->App, 2, MUIM_Application_ReturnID, EVENT_REPEAT);
 
+    DoMethod(obj->CHK_SkipSilence, MUIM_Notify, MUIA_Selected, MUIV_EveryTime,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_SKIP_SILENCE);
+
     /* Playlist events */
     DoMethod(obj->LSV_PlaylistList, MUIM_Notify, MUIA_List_Active, MUIV_EveryTime,
              obj->App, 2, MUIM_Application_ReturnID, EVENT_PLAYLIST_ACTIVE);
@@ -541,3 +620,121 @@ void CreateWindowConfigEvents(struct ObjApp *obj)
     DoMethod(obj->BTN_ConfigCancel, MUIM_Notify, MUIA_Pressed, FALSE,
              obj->App, 2, MUIM_Application_ReturnID, EVENT_CONFIG_CANCEL);
 }
+
+/* Library search window: queries the HVSC trigram index (library.c) */
+void CreateWindowLibrary(struct ObjApp *obj)
+{
+    Object *group0, *group1, *group2, *group3;
+
+    obj->STR_LibrarySearch = MUI_NewObject(MUIC_String,
+        MUIA_Frame, MUIV_Frame_String,
+        MUIA_Background, MUII_StringBack,
+        MUIA_CycleChain, TRUE,
+        MUIA_String_MaxLen, 255,
+        MUIA_String_Contents, "",
+        TAG_DONE);
+
+    obj->LSV_LibraryResults = MUI_NewObject(MUIC_Listview,
+        MUIA_Listview_List, MUI_NewObject(MUIC_List,
+            MUIA_Frame, MUIV_Frame_InputList,
+            MUIA_List_ConstructHook, MUIV_List_ConstructHook_String,
+            MUIA_List_DestructHook, MUIV_List_DestructHook_String,
+            MUIA_List_Format, "",
+            MUIA_List_Title, FALSE,
+            TAG_DONE),
+        MUIA_Listview_Input, TRUE,
+        MUIA_Listview_DoubleClick, TRUE,
+        MUIA_Listview_MultiSelect, MUIV_Listview_MultiSelect_Default,
+        TAG_DONE);
+
+    obj->BTN_LibraryAdd = U64SimpleButton("Add Selected");
+    obj->BTN_LibraryAddAll = U64SimpleButton("Add All");
+    obj->BTN_LibraryRescan = U64SimpleButton("Rescan HVSC");
+
+    /* Smart playlist query (smartpl.c), e.g. author ~ "Hubbard" AND NOT heard */
+    obj->STR_SmartQuery = MUI_NewObject(MUIC_String,
+        MUIA_Frame, MUIV_Frame_String,
+        MUIA_Background, MUII_StringBack,
+        MUIA_CycleChain, TRUE,
+        MUIA_String_MaxLen, 255,
+        MUIA_String_Contents, "",
+        TAG_DONE);
+    obj->BTN_SmartStart = U64SimpleButton("Play Query");
+    obj->BTN_SmartStop = U64SimpleButton("Stop Query");
+
+    obj->TXT_LibraryStatus = MUI_NewObject(MUIC_Text,
+        MUIA_Frame, MUIV_Frame_Text,
+        MUIA_Background, MUII_TextBack,
+        MUIA_Text_Contents, "",
+        TAG_DONE);
+
+    group1 = MUI_NewObject(MUIC_Group,
+        MUIA_Group_Horiz, TRUE,
+        Child, U64Label("Find:"),
+        Child, obj->STR_LibrarySearch,
+        TAG_DONE);
+
+    group2 = MUI_NewObject(MUIC_Group,
+        MUIA_Group_Horiz, TRUE,
+        Child, obj->BTN_LibraryAdd,
+        Child, obj->BTN_LibraryAddAll,
+        Child, MUI_NewObject(MUIC_Rectangle, TAG_DONE), /* spacer */
+        Child, obj->BTN_LibraryRescan,
+        TAG_DONE);
+
+    group3 = MUI_NewObject(MUIC_Group,
+        MUIA_Group_Horiz, TRUE,
+        Child, U64Label("Smart:"),
+        Child, obj->STR_SmartQuery,
+        Child, obj->BTN_SmartStart,
+        Child, obj->BTN_SmartStop,
+        TAG_DONE);
+
+    group0 = MUI_NewObject(MUIC_Group,
+        Child, group1,
+        Child, obj->LSV_LibraryResults,
+        Child, group2,
+        Child, group3,
+        Child, obj->TXT_LibraryStatus,
+        TAG_DONE);
+
+    obj->WIN_Library = MUI_NewObject(MUIC_Window,
+        MUIA_Window_Title, "Search Library",
+        MUIA_Window_ID, APP_ID_WIN_LIBRARY,
+        MUIA_Window_Width, 480,
+        MUIA_Window_Height, 300,
+        MUIA_Window_SizeGadget, TRUE,
+        WindowContents, group0,
+        TAG_DONE);
+}
+
+void CreateWindowLibraryEvents(struct ObjApp *obj)
+{
+    /* Queries hit the disk, so search on Return rather than per keystroke */
+    DoMethod(obj->STR_LibrarySearch, MUIM_Notify, MUIA_String_Acknowledge, MUIV_EveryTime,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_LIBRARY_SEARCH);
+
+    DoMethod(obj->LSV_LibraryResults, MUIM_Notify, MUIA_Listview_DoubleClick, TRUE,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_LIBRARY_ADD);
+
+    DoMethod(obj->BTN_LibraryAdd, MUIM_Notify, MUIA_Pressed, FALSE,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_LIBRARY_ADD);
+
+    DoMethod(obj->BTN_LibraryAddAll, MUIM_Notify, MUIA_Pressed, FALSE,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_LIBRARY_ADD_ALL);
+
+    DoMethod(obj->BTN_LibraryRescan, MUIM_Notify, MUIA_Pressed, FALSE,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_LIBRARY_RESCAN);
+
+    DoMethod(obj->STR_SmartQuery, MUIM_Notify, MUIA_String_Acknowledge, MUIV_EveryTime,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_SMART_START);
+
+    DoMethod(obj->BTN_SmartStart, MUIM_Notify, MUIA_Pressed, FALSE,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_SMART_START);
+
+    DoMethod(obj->BTN_SmartStop, MUIM_Notify, MUIA_Pressed, FALSE,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_SMART_STOP);
+
+    DoMethod(obj->WIN_Library, MUIM_Notify, MUIA_Window_CloseRequest, TRUE,
+             obj->App, 2, MUIM_Application_ReturnID, EVENT_LIBRARY_CLOSE);
+}
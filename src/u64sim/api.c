@@ -0,0 +1,931 @@
+/* Ultimate64 Control - REST stand-in server
+ * The simulated device: 64 KB of C64 memory, two drives and a
+ * configuration tree, and the /v1 endpoints that act on them.
+ *
+ * Replies copy the firmware's shapes closely enough for the library's
+ * parsers; values are plausible rather than exhaustive.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "u64sim.h"
+
+typedef struct
+{
+  const char *letter;
+  int bus_id;
+  const char *type;
+  const char *rom;
+  int enabled;
+  char image_file[256];
+  char image_path[256];
+} SimDrive;
+
+typedef struct
+{
+  const char *category;
+  const char *name;
+  const char *values; /* '|'-separated choices; NULL for a number */
+  long min, max;
+  const char *format; /* numbers only */
+  const char *def;
+  char current[64];
+  char flash[64];
+} SimConfigItem;
+
+static unsigned char memory[SIM_MEMORY_SIZE];
+static SimDrive drives[SIM_DRIVES] = {
+  { "a", 8, "1541", "1541.rom", 1, "", "" },
+  { "b", 9, "1541", "1541.rom", 0, "", "" },
+};
+static int paused = 0;
+static char last_runner[64] = "";
+
+static SimConfigItem config[] = {
+  { "Audio Mixer", "Vol UltiSid 1", "OFF|-6 dB|-3 dB|0 dB|+3 dB|+6 dB", 0, 0,
+    NULL, "0 dB", "", "" },
+  { "Audio Mixer", "Vol UltiSid 2", "OFF|-6 dB|-3 dB|0 dB|+3 dB|+6 dB", 0, 0,
+    NULL, "0 dB", "", "" },
+  { "Audio Mixer", "Vol Socket 1", "OFF|-6 dB|-3 dB|0 dB|+3 dB|+6 dB", 0, 0,
+    NULL, "0 dB", "", "" },
+  { "Audio Mixer", "Vol Socket 2", "OFF|-6 dB|-3 dB|0 dB|+3 dB|+6 dB", 0, 0,
+    NULL, "0 dB", "", "" },
+  { "SID Sockets Configuration", "SID Socket 1", "Disabled|Enabled", 0, 0,
+    NULL, "Enabled", "", "" },
+  { "SID Sockets Configuration", "SID Socket 2", "Disabled|Enabled", 0, 0,
+    NULL, "Enabled", "", "" },
+  { "SID Sockets Configuration", "SID Detected Socket 1",
+    "None|6581|8580|Unknown", 0, 0, NULL, "6581", "", "" },
+  { "SID Sockets Configuration", "SID Detected Socket 2",
+    "None|6581|8580|Unknown", 0, 0, NULL, "8580", "", "" },
+  { "SID Sockets Configuration", "SID Socket 1 Address",
+    "$D400|$D420|$D500|$DE00", 0, 0, NULL, "$D400", "", "" },
+  { "SID Sockets Configuration", "SID Socket 2 Address",
+    "$D400|$D420|$D500|$DE00", 0, 0, NULL, "$D420", "", "" },
+  { "U64 Specific Settings", "System Mode", "PAL|NTSC", 0, 0, NULL, "PAL",
+    "", "" },
+  { "U64 Specific Settings", "CPU Speed", NULL, 1, 48, "%d MHz", "1", "",
+    "" },
+  { "Drive A Settings", "Drive", "Disabled|Enabled", 0, 0, NULL, "Enabled",
+    "", "" },
+  { "Drive A Settings", "Drive Bus ID", NULL, 8, 11, "%d", "8", "", "" },
+  { "Drive B Settings", "Drive", "Disabled|Enabled", 0, 0, NULL, "Disabled",
+    "", "" },
+  { "Drive B Settings", "Drive Bus ID", NULL, 8, 11, "%d", "9", "", "" },
+};
+#define CONFIG_COUNT (sizeof (config) / sizeof (config[0]))
+
+/* Memory as the C64 powers up: alternating 64-byte runs of $00 and $FF,
+   and a blank screen */
+static void
+PowerOn (void)
+{
+  size_t i;
+
+  for (i = 0; i < SIM_MEMORY_SIZE; i++)
+    {
+      memory[i] = (i & 0x40) ? 0xFF : 0x00;
+    }
+  memset (memory + 0x0400, 0x20, 1000);
+  paused = 0;
+}
+
+void
+SimDeviceInit (void)
+{
+  size_t i;
+
+  PowerOn ();
+  for (i = 0; i < CONFIG_COUNT; i++)
+    {
+      strcpy (config[i].current, config[i].def);
+      strcpy (config[i].flash, config[i].def);
+    }
+}
+
+/* Query strings and paths */
+
+static int
+HexDigit (int c)
+{
+  if (c >= '0' && c <= '9')
+    {
+      return c - '0';
+    }
+  c = tolower (c);
+  return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+void
+SimUrlDecode (char *s)
+{
+  char *out = s;
+
+  for (; *s; s++)
+    {
+      if (*s == '%' && HexDigit (s[1]) >= 0 && HexDigit (s[2]) >= 0)
+        {
+          *out++ = (char)(HexDigit (s[1]) * 16 + HexDigit (s[2]));
+          s += 2;
+        }
+      else if (*s == '+')
+        {
+          *out++ = ' ';
+        }
+      else
+        {
+          *out++ = *s;
+        }
+    }
+  *out = '\0';
+}
+
+/* Copy the decoded value of key out of query. Returns 0 if absent. */
+int
+SimQueryValue (const char *query, const char *key, char *value,
+               size_t value_size)
+{
+  size_t key_len = strlen (key);
+  const char *p = query;
+
+  while (p && *p)
+    {
+      const char *end = strchr (p, '&');
+      size_t len = end ? (size_t)(end - p) : strlen (p);
+
+      if (len > key_len && strncmp (p, key, key_len) == 0 && p[key_len] == '=')
+        {
+          len -= key_len + 1;
+          if (len >= value_size)
+            {
+              len = value_size - 1;
+            }
+          memcpy (value, p + key_len + 1, len);
+          value[len] = '\0';
+          SimUrlDecode (value);
+          return 1;
+        }
+      p = end ? end + 1 : NULL;
+    }
+  return 0;
+}
+
+static void
+ReplyOk (SimResponse *resp)
+{
+  SimJsonErrors (resp, 200, NULL);
+}
+
+/* /v1/version and /v1/info */
+
+static void
+HandleVersion (SimResponse *resp)
+{
+  SimRespond (resp, 200, "application/json");
+  SimPrintf (resp, "{\n  \"version\": \"0.1\",\n  \"errors\": []\n}\n");
+}
+
+static void
+HandleInfo (SimResponse *resp)
+{
+  SimRespond (resp, 200, "application/json");
+  SimPrintf (resp,
+             "{\n"
+             "  \"product\": \"Ultimate 64\",\n"
+             "  \"firmware_version\": \"3.11\",\n"
+             "  \"fpga_version\": \"11F\",\n"
+             "  \"core_version\": \"1.44\",\n"
+             "  \"hostname\": \"u64sim\",\n"
+             "  \"unique_id\": \"5D4E12\",\n"
+             "  \"errors\": []\n"
+             "}\n");
+}
+
+/* /v1/machine:<action> */
+
+static void
+HandleReadMem (const SimRequest *req, SimResponse *resp)
+{
+  char value[16];
+  unsigned long address, length = 256;
+
+  if (!SimQueryValue (req->query, "address", value, sizeof (value)))
+    {
+      SimJsonErrors (resp, 400, "Missing address");
+      return;
+    }
+  address = strtoul (value, NULL, 16);
+  if (SimQueryValue (req->query, "length", value, sizeof (value)))
+    {
+      length = strtoul (value, NULL, 10);
+    }
+  if (address >= SIM_MEMORY_SIZE || length == 0
+      || length > SIM_MEMORY_SIZE - address)
+    {
+      SimJsonErrors (resp, 400, "Address range out of bounds");
+      return;
+    }
+
+  SimRespond (resp, 200, "application/octet-stream");
+  SimAppend (resp, memory + address, length);
+}
+
+static void
+HandleWriteMem (const SimRequest *req, SimResponse *resp)
+{
+  char value[16], *hex;
+  unsigned long address;
+  size_t i, len;
+
+  if (!SimQueryValue (req->query, "address", value, sizeof (value)))
+    {
+      SimJsonErrors (resp, 400, "Missing address");
+      return;
+    }
+  address = strtoul (value, NULL, 16);
+
+  if (strcmp (req->method, "POST") == 0)
+    {
+      /* Binary body */
+      if (address >= SIM_MEMORY_SIZE
+          || req->body_len > SIM_MEMORY_SIZE - address)
+        {
+          SimJsonErrors (resp, 400, "Address range out of bounds");
+          return;
+        }
+      memcpy (memory + address, req->body, req->body_len);
+      ReplyOk (resp);
+      return;
+    }
+
+  /* data=<hex>, as the library sends it; the firmware takes up to 128
+     bytes this way */
+  hex = strstr (req->query, "data=");
+  if (!hex)
+    {
+      SimJsonErrors (resp, 400, "Missing data");
+      return;
+    }
+  hex += 5;
+  len = strcspn (hex, "&");
+  if (len == 0 || len % 2 || len / 2 > 128)
+    {
+      SimJsonErrors (resp, 400, "Data must be 1 to 128 hex bytes");
+      return;
+    }
+  if (address >= SIM_MEMORY_SIZE || len / 2 > SIM_MEMORY_SIZE - address)
+    {
+      SimJsonErrors (resp, 400, "Address range out of bounds");
+      return;
+    }
+  for (i = 0; i < len; i += 2)
+    {
+      int hi = HexDigit (hex[i]), lo = HexDigit (hex[i + 1]);
+
+      if (hi < 0 || lo < 0)
+        {
+          SimJsonErrors (resp, 400, "Data is not hex");
+          return;
+        }
+      memory[address + i / 2] = (unsigned char)(hi * 16 + lo);
+    }
+  ReplyOk (resp);
+}
+
+static void
+HandleMachine (const SimRequest *req, SimResponse *resp, const char *action)
+{
+  if (strcmp (action, "readmem") == 0)
+    {
+      HandleReadMem (req, resp);
+    }
+  else if (strcmp (action, "writemem") == 0)
+    {
+      HandleWriteMem (req, resp);
+    }
+  else if (strcmp (action, "reset") == 0)
+    {
+      /* A reset keeps RAM, as on the real machine */
+      memset (memory + 0x0400, 0x20, 1000);
+      paused = 0;
+      ReplyOk (resp);
+    }
+  else if (strcmp (action, "reboot") == 0
+           || strcmp (action, "poweroff") == 0)
+    {
+      PowerOn ();
+      ReplyOk (resp);
+    }
+  else if (strcmp (action, "pause") == 0)
+    {
+      paused = 1;
+      ReplyOk (resp);
+    }
+  else if (strcmp (action, "resume") == 0)
+    {
+      paused = 0;
+      ReplyOk (resp);
+    }
+  else if (strcmp (action, "menu_button") == 0)
+    {
+      ReplyOk (resp);
+    }
+  else
+    {
+      SimJsonErrors (resp, 404, "Unknown machine command");
+    }
+}
+
+/* /v1/drives and /v1/drives/<letter>:<action> */
+
+static void
+HandleDriveList (SimResponse *resp)
+{
+  int i;
+
+  SimRespond (resp, 200, "application/json");
+  SimPrintf (resp, "{\n  \"drives\": [");
+  for (i = 0; i < SIM_DRIVES; i++)
+    {
+      const SimDrive *d = &drives[i];
+
+      SimPrintf (resp,
+                 "%s\n    {\n      \"%s\": {\n        \"enabled\": %s,\n"
+                 "        \"bus_id\": %d,\n        \"type\": \"%s\",\n"
+                 "        \"rom\": \"%s\",\n        \"image_file\": ",
+                 i ? "," : "", d->letter, d->enabled ? "true" : "false",
+                 d->bus_id, d->type, d->rom);
+      SimJsonString (resp, d->image_file);
+      SimPrintf (resp, ",\n        \"image_path\": ");
+      SimJsonString (resp, d->image_path);
+      SimPrintf (resp, "\n      }\n    }");
+    }
+  SimPrintf (resp, "\n  ],\n  \"errors\": []\n}\n");
+}
+
+/* Set a drive's image from a full path */
+static void
+MountImage (SimDrive *d, const char *image)
+{
+  const char *name = strrchr (image, '/');
+
+  name = name ? name + 1 : image;
+  snprintf (d->image_file, sizeof (d->image_file), "%s", name);
+  snprintf (d->image_path, sizeof (d->image_path), "%.*s",
+            (int)(name - image), image);
+}
+
+/* Pick the file name out of a multipart upload */
+static int
+MultipartFilename (const SimRequest *req, char *name, size_t size)
+{
+  const char *p, *end;
+  size_t scan = req->body_len < 4096 ? req->body_len : 4096;
+
+  for (p = (const char *)req->body; p + 10 < (const char *)req->body + scan;
+       p++)
+    {
+      if (memcmp (p, "filename=\"", 10) == 0)
+        {
+          p += 10;
+          end = memchr (p, '"', (size_t)((const char *)req->body + scan - p));
+          if (!end)
+            {
+              return 0;
+            }
+          snprintf (name, size, "%.*s", (int)(end - p), p);
+          return 1;
+        }
+    }
+  return 0;
+}
+
+static void
+HandleDrive (const SimRequest *req, SimResponse *resp, const char *target)
+{
+  const char *action = strchr (target, ':');
+  char image[256];
+  SimDrive *d = NULL;
+  int i;
+
+  for (i = 0; action && i < SIM_DRIVES; i++)
+    {
+      if (strncmp (drives[i].letter, target, (size_t)(action - target)) == 0
+          && strlen (drives[i].letter) == (size_t)(action - target))
+        {
+          d = &drives[i];
+        }
+    }
+  if (!d)
+    {
+      SimJsonErrors (resp, 404, "Unknown drive");
+      return;
+    }
+  action++;
+
+  if (strcmp (action, "mount") == 0)
+    {
+      if (strcmp (req->method, "POST") == 0)
+        {
+          if (!MultipartFilename (req, image, sizeof (image)))
+            {
+              snprintf (image, sizeof (image), "upload.d64");
+            }
+        }
+      else if (!SimQueryValue (req->query, "image", image, sizeof (image)))
+        {
+          SimJsonErrors (resp, 400, "Missing image");
+          return;
+        }
+      MountImage (d, image);
+      d->enabled = 1;
+      ReplyOk (resp);
+    }
+  else if (strcmp (action, "remove") == 0 || strcmp (action, "unlink") == 0)
+    {
+      d->image_file[0] = '\0';
+      d->image_path[0] = '\0';
+      ReplyOk (resp);
+    }
+  else if (strcmp (action, "on") == 0 || strcmp (action, "off") == 0)
+    {
+      d->enabled = action[1] == 'n';
+      ReplyOk (resp);
+    }
+  else if (strcmp (action, "reset") == 0)
+    {
+      ReplyOk (resp);
+    }
+  else
+    {
+      SimJsonErrors (resp, 404, "Unknown drive command");
+    }
+}
+
+/* /v1/runners:<action> */
+
+static void
+HandleRunner (const SimRequest *req, SimResponse *resp, const char *action)
+{
+  if (strcmp (action, "load_prg") == 0 || strcmp (action, "run_prg") == 0)
+    {
+      unsigned long address;
+
+      if (req->body_len < 3)
+        {
+          SimJsonErrors (resp, 400, "PRG too short");
+          return;
+        }
+      address = req->body[0] | (req->body[1] << 8);
+      if (req->body_len - 2 > SIM_MEMORY_SIZE - address)
+        {
+          SimJsonErrors (resp, 400, "PRG does not fit in memory");
+          return;
+        }
+      memcpy (memory + address, req->body + 2, req->body_len - 2);
+    }
+  else if (strcmp (action, "sidplay") != 0 && strcmp (action, "modplay") != 0
+           && strcmp (action, "run_crt") != 0)
+    {
+      SimJsonErrors (resp, 404, "Unknown runner");
+      return;
+    }
+
+  snprintf (last_runner, sizeof (last_runner), "%s", action);
+  SimLog ("Runner %s, %lu bytes", action, (unsigned long)req->body_len);
+  ReplyOk (resp);
+}
+
+/* /v1/configs... */
+
+static SimConfigItem *
+FindConfig (const char *category, const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < CONFIG_COUNT; i++)
+    {
+      if (strcasecmp (config[i].category, category) == 0
+          && strcasecmp (config[i].name, name) == 0)
+        {
+          return &config[i];
+        }
+    }
+  return NULL;
+}
+
+static int
+ConfigAccepts (const SimConfigItem *item, const char *value)
+{
+  const char *p;
+  size_t len = strlen (value);
+  char *end;
+  long n;
+
+  if (!item->values)
+    {
+      n = strtol (value, &end, 10);
+      return *value && *end == '\0' && n >= item->min && n <= item->max;
+    }
+  for (p = item->values; p; p = strchr (p, '|') ? strchr (p, '|') + 1 : NULL)
+    {
+      if (strncmp (p, value, len) == 0 && (p[len] == '|' || p[len] == '\0'))
+        {
+          return 1;
+        }
+    }
+  return 0;
+}
+
+static void
+ConfigValue (SimResponse *resp, const SimConfigItem *item, const char *v)
+{
+  if (item->values)
+    {
+      SimJsonString (resp, v);
+    }
+  else
+    {
+      SimPrintf (resp, "%ld", strtol (v, NULL, 10));
+    }
+}
+
+static void
+ListCategories (SimResponse *resp)
+{
+  size_t i;
+
+  SimRespond (resp, 200, "application/json");
+  SimPrintf (resp, "{\n  \"categories\": [");
+  for (i = 0; i < CONFIG_COUNT; i++)
+    {
+      if (i == 0 || strcmp (config[i].category, config[i - 1].category) != 0)
+        {
+          SimPrintf (resp, "%s\n    ", i ? "," : "");
+          SimJsonString (resp, config[i].category);
+        }
+    }
+  SimPrintf (resp, "\n  ],\n  \"errors\": []\n}\n");
+}
+
+static void
+ShowCategory (SimResponse *resp, const char *category)
+{
+  size_t i;
+  int found = 0;
+
+  SimRespond (resp, 200, "application/json");
+  for (i = 0; i < CONFIG_COUNT; i++)
+    {
+      if (strcasecmp (config[i].category, category) != 0)
+        {
+          continue;
+        }
+      if (!found++)
+        {
+          SimPrintf (resp, "{\n  ");
+          SimJsonString (resp, config[i].category);
+          SimPrintf (resp, ": {");
+        }
+      else
+        {
+          SimPrintf (resp, ",");
+        }
+      SimPrintf (resp, "\n    ");
+      SimJsonString (resp, config[i].name);
+      SimPrintf (resp, ": ");
+      ConfigValue (resp, &config[i], config[i].current);
+    }
+  if (!found)
+    {
+      SimJsonErrors (resp, 404, "Unknown category");
+      return;
+    }
+  SimPrintf (resp, "\n  },\n  \"errors\": []\n}\n");
+}
+
+static void
+ShowItem (SimResponse *resp, const SimConfigItem *item)
+{
+  const char *p;
+
+  SimRespond (resp, 200, "application/json");
+  SimPrintf (resp, "{\n  ");
+  SimJsonString (resp, item->category);
+  SimPrintf (resp, ": {\n    ");
+  SimJsonString (resp, item->name);
+  SimPrintf (resp, ": {\n      \"current\": ");
+  ConfigValue (resp, item, item->current);
+  if (item->values)
+    {
+      SimPrintf (resp, ",\n      \"values\": [");
+      for (p = item->values; p;)
+        {
+          const char *bar = strchr (p, '|');
+          char choice[64];
+
+          snprintf (choice, sizeof (choice), "%.*s",
+                    bar ? (int)(bar - p) : (int)strlen (p), p);
+          SimPrintf (resp, "%s", p == item->values ? "" : ", ");
+          SimJsonString (resp, choice);
+          p = bar ? bar + 1 : NULL;
+        }
+      SimPrintf (resp, "]");
+    }
+  else
+    {
+      SimPrintf (resp, ",\n      \"min\": %ld,\n      \"max\": %ld,\n"
+                       "      \"format\": ",
+                 item->min, item->max);
+      SimJsonString (resp, item->format);
+    }
+  SimPrintf (resp, ",\n      \"default\": ");
+  ConfigValue (resp, item, item->def);
+  SimPrintf (resp, "\n    }\n  },\n  \"errors\": []\n}\n");
+}
+
+/* Read one JSON string or bare number at *p into out */
+static int
+JsonScalar (const char **p, char *out, size_t size)
+{
+  const char *s = *p;
+  size_t len = 0;
+
+  while (isspace ((unsigned char)*s))
+    {
+      s++;
+    }
+  if (*s == '"')
+    {
+      for (s++; *s && *s != '"'; s++)
+        {
+          if (*s == '\\' && s[1])
+            {
+              s++;
+            }
+          if (len + 1 < size)
+            {
+              out[len++] = *s;
+            }
+        }
+      if (*s != '"')
+        {
+          return 0;
+        }
+      s++;
+    }
+  else
+    {
+      while (*s == '-' || isdigit ((unsigned char)*s))
+        {
+          if (len + 1 < size)
+            {
+              out[len++] = *s;
+            }
+          s++;
+        }
+      if (len == 0)
+        {
+          return 0;
+        }
+    }
+  out[len] = '\0';
+  *p = s;
+  return 1;
+}
+
+static int
+JsonExpect (const char **p, char c)
+{
+  while (isspace ((unsigned char)**p))
+    {
+      (*p)++;
+    }
+  if (**p != c)
+    {
+      return 0;
+    }
+  (*p)++;
+  return 1;
+}
+
+/* POST /v1/configs: {"Category": {"Item": value, ...}, ...}. Everything is
+   checked before anything is changed. */
+static void
+SetConfigs (const SimRequest *req, SimResponse *resp)
+{
+  char *json = malloc (req->body_len + 1);
+  int pass;
+
+  if (!json)
+    {
+      SimJsonErrors (resp, 500, "Out of memory");
+      return;
+    }
+  memcpy (json, req->body, req->body_len);
+  json[req->body_len] = '\0';
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      const char *p = json;
+      char category[64], name[64], value[64];
+
+      if (!JsonExpect (&p, '{'))
+        {
+          goto bad;
+        }
+      if (JsonExpect (&p, '}'))
+        {
+          continue;
+        }
+      do
+        {
+          if (!JsonScalar (&p, category, sizeof (category))
+              || !JsonExpect (&p, ':') || !JsonExpect (&p, '{'))
+            {
+              goto bad;
+            }
+          if (JsonExpect (&p, '}'))
+            {
+              continue;
+            }
+          do
+            {
+              SimConfigItem *item;
+
+              if (!JsonScalar (&p, name, sizeof (name))
+                  || !JsonExpect (&p, ':')
+                  || !JsonScalar (&p, value, sizeof (value)))
+                {
+                  goto bad;
+                }
+              item = FindConfig (category, name);
+              if (!item || !ConfigAccepts (item, value))
+                {
+                  free (json);
+                  SimJsonErrors (resp, 400, item ? "Invalid value"
+                                                 : "Unknown configuration "
+                                                   "item");
+                  return;
+                }
+              if (pass == 1)
+                {
+                  snprintf (item->current, sizeof (item->current), "%s",
+                            value);
+                }
+            }
+          while (JsonExpect (&p, ','));
+          if (!JsonExpect (&p, '}'))
+            {
+              goto bad;
+            }
+        }
+      while (JsonExpect (&p, ','));
+      if (!JsonExpect (&p, '}'))
+        {
+          goto bad;
+        }
+    }
+
+  free (json);
+  ReplyOk (resp);
+  return;
+
+bad:
+  free (json);
+  SimJsonErrors (resp, 400, "Malformed JSON");
+}
+
+static void
+HandleConfigs (const SimRequest *req, SimResponse *resp, const char *rest)
+{
+  int is_get = strcmp (req->method, "GET") == 0;
+  char category[64], value[64];
+  const char *slash;
+  SimConfigItem *item;
+  size_t i;
+
+  if (*rest == ':')
+    {
+      int load = strcmp (rest, ":load_from_flash") == 0;
+      int save = strcmp (rest, ":save_to_flash") == 0;
+
+      if (!load && !save && strcmp (rest, ":reset_to_default") != 0)
+        {
+          SimJsonErrors (resp, 404, "Unknown configuration command");
+          return;
+        }
+      for (i = 0; i < CONFIG_COUNT; i++)
+        {
+          if (save)
+            {
+              strcpy (config[i].flash, config[i].current);
+            }
+          else
+            {
+              strcpy (config[i].current,
+                      load ? config[i].flash : config[i].def);
+            }
+        }
+      ReplyOk (resp);
+      return;
+    }
+
+  if (*rest == '\0')
+    {
+      if (is_get)
+        {
+          ListCategories (resp);
+        }
+      else
+        {
+          SetConfigs (req, resp);
+        }
+      return;
+    }
+
+  /* "/<category>" or "/<category>/<item>" */
+  rest++;
+  slash = strchr (rest, '/');
+  if (!slash)
+    {
+      ShowCategory (resp, rest);
+      return;
+    }
+  snprintf (category, sizeof (category), "%.*s", (int)(slash - rest), rest);
+  item = FindConfig (category, slash + 1);
+  if (!item)
+    {
+      SimJsonErrors (resp, 404, "Unknown configuration item");
+      return;
+    }
+  if (is_get)
+    {
+      ShowItem (resp, item);
+      return;
+    }
+  if (!SimQueryValue (req->query, "value", value, sizeof (value)))
+    {
+      SimJsonErrors (resp, 400, "Missing value");
+      return;
+    }
+  if (!ConfigAccepts (item, value))
+    {
+      SimJsonErrors (resp, 400, "Invalid value");
+      return;
+    }
+  strcpy (item->current, value);
+  ReplyOk (resp);
+}
+
+/* Route one request */
+void
+SimHandle (const SimRequest *req, SimResponse *resp)
+{
+  const char *path = req->path;
+
+  if (strncmp (path, "/v1/", 4) != 0)
+    {
+      SimJsonErrors (resp, 404, "Not found");
+      return;
+    }
+  path += 4;
+
+  if (strcmp (path, "version") == 0)
+    {
+      HandleVersion (resp);
+    }
+  else if (strcmp (path, "info") == 0)
+    {
+      HandleInfo (resp);
+    }
+  else if (strncmp (path, "machine:", 8) == 0)
+    {
+      HandleMachine (req, resp, path + 8);
+    }
+  else if (strcmp (path, "drives") == 0)
+    {
+      HandleDriveList (resp);
+    }
+  else if (strncmp (path, "drives/", 7) == 0)
+    {
+      HandleDrive (req, resp, path + 7);
+    }
+  else if (strncmp (path, "runners:", 8) == 0)
+    {
+      HandleRunner (req, resp, path + 8);
+    }
+  else if (strncmp (path, "configs", 7) == 0
+           && (path[7] == '\0' || path[7] == '/' || path[7] == ':'))
+    {
+      HandleConfigs (req, resp, path + 7);
+    }
+  else
+    {
+      SimJsonErrors (resp, 404, "Not found");
+    }
+}
@@ -0,0 +1,155 @@
+/* Ultimate64 Control - REST stand-in server
+ * Entry point: u64sim [options]
+ *
+ * Answers the Ultimate REST API on a Linux or other POSIX host, so the
+ * library and tools can be load- and latency-tested without hardware.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "u64sim.h"
+
+static void
+Usage (const char *name)
+{
+  fprintf (stderr,
+           "Usage: %s [options]\n"
+           "  -p port      listen on port (default 6464)\n"
+           "  -P password  require this X-password\n"
+           "  -l ms        latency added to every reply\n"
+           "  -j ms        random extra latency, 0..ms\n"
+           "  -b bytes     reply bandwidth in bytes per second\n"
+           "  -f percent   share of requests that fail\n"
+           "  -k kinds     faults to pick from: drop,error,stall,short "
+           "(default all)\n"
+           "  -s ms        how long a stall lasts (default 30000)\n"
+           "  -i seconds   close idle connections (default 60, 0 = never)\n"
+           "  -c           close after each reply instead of keeping the "
+           "connection\n"
+           "  -r seed      random seed, for repeatable fault runs\n"
+           "  -v           log every request\n",
+           name);
+}
+
+static int
+ParseFaultKinds (const char *list, unsigned int *kinds)
+{
+  char copy[64], *word;
+
+  snprintf (copy, sizeof (copy), "%s", list);
+  *kinds = 0;
+  for (word = strtok (copy, ","); word; word = strtok (NULL, ","))
+    {
+      if (strcmp (word, "drop") == 0)
+        {
+          *kinds |= SIM_FAULT_DROP;
+        }
+      else if (strcmp (word, "error") == 0)
+        {
+          *kinds |= SIM_FAULT_ERROR;
+        }
+      else if (strcmp (word, "stall") == 0)
+        {
+          *kinds |= SIM_FAULT_STALL;
+        }
+      else if (strcmp (word, "short") == 0)
+        {
+          *kinds |= SIM_FAULT_SHORT;
+        }
+      else
+        {
+          return -1;
+        }
+    }
+  return *kinds ? 0 : -1;
+}
+
+static void
+OnSignal (int sig)
+{
+  (void)sig;
+  SimStop ();
+}
+
+int
+main (int argc, char **argv)
+{
+  SimOptions opts;
+  struct sigaction sa;
+  int c;
+
+  memset (&opts, 0, sizeof (opts));
+  opts.port = 6464;
+  opts.fault_kinds = SIM_FAULT_ALL;
+  opts.stall_ms = 30000;
+  opts.idle_s = 60;
+  opts.seed = (unsigned int)time (NULL);
+
+  while ((c = getopt (argc, argv, "p:P:l:j:b:f:k:s:i:cr:vh")) != -1)
+    {
+      switch (c)
+        {
+        case 'p':
+          opts.port = (unsigned short)atoi (optarg);
+          break;
+        case 'P':
+          opts.password = optarg;
+          break;
+        case 'l':
+          opts.latency_ms = strtoul (optarg, NULL, 10);
+          break;
+        case 'j':
+          opts.jitter_ms = strtoul (optarg, NULL, 10);
+          break;
+        case 'b':
+          opts.bandwidth = strtoul (optarg, NULL, 10);
+          break;
+        case 'f':
+          opts.fault_percent = (unsigned int)atoi (optarg);
+          if (opts.fault_percent > 100)
+            {
+              opts.fault_percent = 100;
+            }
+          break;
+        case 'k':
+          if (ParseFaultKinds (optarg, &opts.fault_kinds) < 0)
+            {
+              fprintf (stderr, "Unknown fault kind in '%s'\n", optarg);
+              return 5;
+            }
+          break;
+        case 's':
+          opts.stall_ms = strtoul (optarg, NULL, 10);
+          break;
+        case 'i':
+          opts.idle_s = strtoul (optarg, NULL, 10);
+          break;
+        case 'c':
+          opts.close_after_reply = 1;
+          break;
+        case 'r':
+          opts.seed = (unsigned int)strtoul (optarg, NULL, 10);
+          break;
+        case 'v':
+          opts.verbose = 1;
+          break;
+        default:
+          Usage (argv[0]);
+          return c == 'h' ? 0 : 5;
+        }
+    }
+
+  /* No SA_RESTART, so poll() returns and the loop sees the stop */
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = OnSignal;
+  sigaction (SIGINT, &sa, NULL);
+  sigaction (SIGTERM, &sa, NULL);
+
+  SimDeviceInit ();
+  return SimServe (&opts) < 0 ? 10 : 0;
+}
@@ -0,0 +1,652 @@
+/* Ultimate64 Control - REST stand-in server
+ * Connections, HTTP framing, and injected latency, bandwidth and faults.
+ *
+ * Like the firmware, one request is served at a time and connections are
+ * kept open after a reply whatever the client's Connection header says;
+ * every reply carries Content-Length, which is how the library knows it
+ * has the whole body. -c makes it close after each reply instead.
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "u64sim.h"
+
+typedef struct
+{
+  int fd;
+  char *buf;
+  size_t len;
+  size_t size;
+  time_t last_active;
+} SimClient;
+
+static const SimOptions *options;
+static volatile sig_atomic_t stop_requested = 0;
+
+static unsigned long served = 0;
+static unsigned long faults = 0;
+static unsigned long long bytes_in = 0;
+static unsigned long long bytes_out = 0;
+
+void
+SimStop (void)
+{
+  stop_requested = 1;
+}
+
+void
+SimLog (const char *format, ...)
+{
+  va_list ap;
+
+  if (!options || !options->verbose)
+    {
+      return;
+    }
+  va_start (ap, format);
+  vfprintf (stderr, format, ap);
+  va_end (ap);
+  fputc ('\n', stderr);
+}
+
+static void
+SimSleep (unsigned long ms)
+{
+  struct timespec ts;
+
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+  while (nanosleep (&ts, &ts) < 0 && errno == EINTR && !stop_requested)
+    ;
+}
+
+/* Response buffer */
+
+void
+SimAppend (SimResponse *resp, const void *data, size_t len)
+{
+  if (resp->len + len + 1 > resp->size)
+    {
+      size_t size = resp->size ? resp->size : 1024;
+      char *grown;
+
+      while (resp->len + len + 1 > size)
+        {
+          size *= 2;
+        }
+      grown = realloc (resp->data, size);
+      if (!grown)
+        {
+          return;
+        }
+      resp->data = grown;
+      resp->size = size;
+    }
+  memcpy (resp->data + resp->len, data, len);
+  resp->len += len;
+  resp->data[resp->len] = '\0';
+}
+
+void
+SimPrintf (SimResponse *resp, const char *format, ...)
+{
+  char line[1024];
+  va_list ap;
+  int len;
+
+  va_start (ap, format);
+  len = vsnprintf (line, sizeof (line), format, ap);
+  va_end (ap);
+  if (len > 0)
+    {
+      SimAppend (resp, line,
+                 (size_t)len < sizeof (line) ? (size_t)len
+                                             : sizeof (line) - 1);
+    }
+}
+
+void
+SimJsonString (SimResponse *resp, const char *s)
+{
+  SimAppend (resp, "\"", 1);
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        {
+          SimAppend (resp, "\\", 1);
+          SimAppend (resp, s, 1);
+        }
+      else if ((unsigned char)*s < 0x20)
+        {
+          SimPrintf (resp, "\\u%04x", (unsigned char)*s);
+        }
+      else
+        {
+          SimAppend (resp, s, 1);
+        }
+    }
+  SimAppend (resp, "\"", 1);
+}
+
+/* Start a reply over, discarding anything already written */
+void
+SimRespond (SimResponse *resp, int status, const char *content_type)
+{
+  resp->status = status;
+  resp->content_type = content_type;
+  resp->len = 0;
+  if (resp->data)
+    {
+      resp->data[0] = '\0';
+    }
+}
+
+/* The whole reply as the firmware words failures: an errors array */
+void
+SimJsonErrors (SimResponse *resp, int status, const char *error)
+{
+  SimRespond (resp, status, "application/json");
+  SimAppend (resp, "{\n  \"errors\": [", 15);
+  if (error)
+    {
+      SimJsonString (resp, error);
+    }
+  SimAppend (resp, "]\n}\n", 4);
+}
+
+static const char *
+StatusText (int status)
+{
+  switch (status)
+    {
+    case 200:
+      return "OK";
+    case 400:
+      return "Bad Request";
+    case 403:
+      return "Forbidden";
+    case 404:
+      return "Not Found";
+    case 413:
+      return "Payload Too Large";
+    case 500:
+      return "Internal Server Error";
+    case 501:
+      return "Not Implemented";
+    default:
+      return "Unknown";
+    }
+}
+
+/* Send everything, paced to the configured bandwidth */
+static int
+SendAll (int fd, const char *data, size_t len)
+{
+  size_t chunk = options->bandwidth ? 1460 : len;
+
+  while (len > 0)
+    {
+      size_t n = len < chunk ? len : chunk;
+      ssize_t sent = send (fd, data, n, MSG_NOSIGNAL);
+
+      if (sent < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          return -1;
+        }
+      data += sent;
+      len -= (size_t)sent;
+      bytes_out += (unsigned long long)sent;
+      if (options->bandwidth && len > 0)
+        {
+          SimSleep ((unsigned long)sent * 1000 / options->bandwidth);
+        }
+    }
+  return 0;
+}
+
+/* Pick a fault for this request, or 0 */
+static unsigned int
+PickFault (void)
+{
+  unsigned int kinds[4];
+  unsigned int count = 0, bit;
+
+  if (!options->fault_percent
+      || (unsigned int)(rand () % 100) >= options->fault_percent)
+    {
+      return 0;
+    }
+  for (bit = SIM_FAULT_DROP; bit <= SIM_FAULT_SHORT; bit <<= 1)
+    {
+      if (options->fault_kinds & bit)
+        {
+          kinds[count++] = bit;
+        }
+    }
+  return count ? kinds[rand () % count] : 0;
+}
+
+/* Find the end of the header block and the declared body length. Returns
+   the full request length once it has all arrived, 0 while incomplete,
+   -1 if it can never be served. */
+static long
+RequestLength (const SimClient *client, size_t *header_len,
+               size_t *body_len)
+{
+  const char *end, *p;
+  size_t scan = client->len < SIM_MAX_HEADER ? client->len : SIM_MAX_HEADER;
+  size_t content_length = 0;
+
+  end = NULL;
+  for (p = client->buf; p + 4 <= client->buf + scan; p++)
+    {
+      if (memcmp (p, "\r\n\r\n", 4) == 0)
+        {
+          end = p + 4;
+          break;
+        }
+    }
+  if (!end)
+    {
+      return client->len >= SIM_MAX_HEADER ? -1 : 0;
+    }
+
+  for (p = client->buf; p < end; p = strchr (p, '\n') + 1)
+    {
+      if (strncasecmp (p, "Content-Length:", 15) == 0)
+        {
+          content_length = strtoul (p + 15, NULL, 10);
+        }
+      if (!memchr (p, '\n', (size_t)(end - p)))
+        {
+          break;
+        }
+    }
+  if (content_length > SIM_MAX_BODY)
+    {
+      return -1;
+    }
+
+  *header_len = (size_t)(end - client->buf);
+  *body_len = content_length;
+  if (client->len < *header_len + content_length)
+    {
+      return 0;
+    }
+  return (long)(*header_len + content_length);
+}
+
+/* Split the header block in place into req */
+static int
+ParseRequest (char *header, size_t header_len, SimRequest *req)
+{
+  char *line, *next, *space;
+
+  memset (req, 0, sizeof (*req));
+  header[header_len - 2] = '\0';
+
+  line = header;
+  next = strstr (line, "\r\n");
+  if (next)
+    {
+      *next = '\0';
+      next += 2;
+    }
+
+  req->method = line;
+  space = strchr (line, ' ');
+  if (!space)
+    {
+      return -1;
+    }
+  *space = '\0';
+  req->path = space + 1;
+  space = strchr (req->path, ' ');
+  if (space)
+    {
+      *space = '\0';
+    }
+  req->query = strchr (req->path, '?');
+  if (req->query)
+    {
+      *req->query++ = '\0';
+    }
+  SimUrlDecode (req->path);
+
+  for (line = next; line && *line; line = next)
+    {
+      char *value;
+
+      next = strstr (line, "\r\n");
+      if (next)
+        {
+          *next = '\0';
+          next += 2;
+        }
+      value = strchr (line, ':');
+      if (!value)
+        {
+          continue;
+        }
+      *value++ = '\0';
+      while (*value == ' ')
+        {
+          value++;
+        }
+      if (strcasecmp (line, "Content-Type") == 0)
+        {
+          req->content_type = value;
+        }
+      else if (strcasecmp (line, "X-password") == 0)
+        {
+          req->password = value;
+        }
+    }
+  return 0;
+}
+
+/* Serve one complete request. Returns 0 to keep the connection, -1 to
+   close it. */
+static int
+Serve (SimClient *client, size_t header_len, size_t body_len)
+{
+  SimRequest req;
+  SimResponse resp;
+  char head[256];
+  unsigned int fault;
+  unsigned long wait;
+  int head_len, keep = !options->close_after_reply;
+
+  memset (&resp, 0, sizeof (resp));
+  if (ParseRequest (client->buf, header_len, &req) < 0)
+    {
+      SimJsonErrors (&resp, 400, "Malformed request line");
+      req.method = "?";
+      req.path = "?";
+    }
+  else
+    {
+      req.body = (const unsigned char *)client->buf + header_len;
+      req.body_len = body_len;
+
+      if (options->password
+          && (!req.password || strcmp (req.password, options->password) != 0))
+        {
+          SimJsonErrors (&resp, 403, "Wrong or missing X-password");
+        }
+      else
+        {
+          SimHandle (&req, &resp);
+        }
+    }
+
+  fault = PickFault ();
+  if (fault)
+    {
+      faults++;
+    }
+  if (fault == SIM_FAULT_ERROR)
+    {
+      SimJsonErrors (&resp, 500, "Simulated fault");
+    }
+
+  wait = options->latency_ms;
+  if (options->jitter_ms)
+    {
+      wait += (unsigned long)rand () % (options->jitter_ms + 1);
+    }
+  if (fault == SIM_FAULT_STALL)
+    {
+      wait += options->stall_ms;
+    }
+  if (wait)
+    {
+      SimSleep (wait);
+    }
+
+  served++;
+  SimLog ("%s %s%s%s -> %d, %lu bytes%s", req.method, req.path,
+          req.query ? "?" : "", req.query ? req.query : "", resp.status,
+          (unsigned long)resp.len,
+          fault == SIM_FAULT_DROP    ? " [dropped]"
+          : fault == SIM_FAULT_ERROR ? " [error]"
+          : fault == SIM_FAULT_STALL ? " [stalled]"
+          : fault == SIM_FAULT_SHORT ? " [short]"
+                                     : "");
+
+  if (fault == SIM_FAULT_DROP)
+    {
+      free (resp.data);
+      return -1;
+    }
+  head_len = snprintf (head, sizeof (head),
+                       "HTTP/1.1 %d %s\r\n"
+                       "Content-Type: %s\r\n"
+                       "Content-Length: %lu\r\n"
+                       "Connection: %s\r\n"
+                       "\r\n",
+                       resp.status, StatusText (resp.status),
+                       resp.content_type ? resp.content_type
+                                         : "application/json",
+                       (unsigned long)resp.len,
+                       keep ? "keep-alive" : "close");
+
+  if (SendAll (client->fd, head, (size_t)head_len) < 0
+      || SendAll (client->fd, resp.data ? resp.data : "",
+                  fault == SIM_FAULT_SHORT ? resp.len / 2 : resp.len)
+             < 0
+      || fault == SIM_FAULT_SHORT)
+    {
+      keep = 0;
+    }
+
+  free (resp.data);
+  return keep ? 0 : -1;
+}
+
+static void
+CloseClient (SimClient *client)
+{
+  close (client->fd);
+  free (client->buf);
+  memset (client, 0, sizeof (*client));
+  client->fd = -1;
+}
+
+/* Read what has arrived and serve every request it completes */
+static void
+ReadClient (SimClient *client)
+{
+  ssize_t got;
+  size_t header_len = 0, body_len = 0;
+  long length;
+
+  if (client->size - client->len < 4096)
+    {
+      size_t size = client->size ? client->size * 2 : 16384;
+      char *grown = realloc (client->buf, size);
+
+      if (!grown)
+        {
+          CloseClient (client);
+          return;
+        }
+      client->buf = grown;
+      client->size = size;
+    }
+
+  got = recv (client->fd, client->buf + client->len,
+              client->size - client->len - 1, 0);
+  if (got <= 0)
+    {
+      if (got < 0 && errno == EINTR)
+        {
+          return;
+        }
+      CloseClient (client);
+      return;
+    }
+  client->len += (size_t)got;
+  client->last_active = time (NULL);
+  bytes_in += (unsigned long long)got;
+
+  while ((length = RequestLength (client, &header_len, &body_len)) != 0)
+    {
+      if (length < 0)
+        {
+          SimResponse resp;
+          char head[128];
+          int head_len;
+
+          memset (&resp, 0, sizeof (resp));
+          SimJsonErrors (&resp, 413, "Request too large");
+          head_len = snprintf (head, sizeof (head),
+                               "HTTP/1.1 413 %s\r\nContent-Type: "
+                               "application/json\r\nContent-Length: %lu\r\n"
+                               "Connection: close\r\n\r\n",
+                               StatusText (413), (unsigned long)resp.len);
+          SendAll (client->fd, head, (size_t)head_len);
+          SendAll (client->fd, resp.data, resp.len);
+          free (resp.data);
+          CloseClient (client);
+          return;
+        }
+
+      if (Serve (client, header_len, body_len) < 0)
+        {
+          CloseClient (client);
+          return;
+        }
+      memmove (client->buf, client->buf + length,
+               client->len - (size_t)length);
+      client->len -= (size_t)length;
+    }
+}
+
+int
+SimServe (const SimOptions *opts)
+{
+  SimClient clients[SIM_MAX_CLIENTS];
+  struct pollfd fds[SIM_MAX_CLIENTS + 1];
+  struct sockaddr_in addr;
+  int listener, one = 1, i;
+
+  options = opts;
+  srand (opts->seed);
+  signal (SIGPIPE, SIG_IGN);
+
+  listener = socket (AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+    {
+      perror ("socket");
+      return -1;
+    }
+  setsockopt (listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_ANY);
+  addr.sin_port = htons (opts->port);
+  if (bind (listener, (struct sockaddr *)&addr, sizeof (addr)) < 0
+      || listen (listener, SIM_MAX_CLIENTS) < 0)
+    {
+      perror ("bind");
+      close (listener);
+      return -1;
+    }
+
+  for (i = 0; i < SIM_MAX_CLIENTS; i++)
+    {
+      memset (&clients[i], 0, sizeof (clients[i]));
+      clients[i].fd = -1;
+    }
+
+  fprintf (stderr, "u64sim listening on port %u\n", (unsigned)opts->port);
+
+  while (!stop_requested)
+    {
+      int count = 0, ready;
+      time_t now = time (NULL);
+
+      fds[count].fd = listener;
+      fds[count++].events = POLLIN;
+      for (i = 0; i < SIM_MAX_CLIENTS; i++)
+        {
+          if (clients[i].fd >= 0 && opts->idle_s
+              && now - clients[i].last_active >= (time_t)opts->idle_s)
+            {
+              SimLog ("Closing idle connection");
+              CloseClient (&clients[i]);
+            }
+          fds[count].fd = clients[i].fd; /* -1 entries are ignored */
+          fds[count++].events = POLLIN;
+        }
+
+      ready = poll (fds, (nfds_t)count, 1000);
+      if (ready <= 0)
+        {
+          continue;
+        }
+
+      if (fds[0].revents & POLLIN)
+        {
+          int fd = accept (listener, NULL, NULL);
+
+          for (i = 0; fd >= 0 && i < SIM_MAX_CLIENTS; i++)
+            {
+              if (clients[i].fd < 0)
+                {
+                  setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one,
+                              sizeof (one));
+                  clients[i].fd = fd;
+                  clients[i].last_active = now;
+                  fd = -1;
+                }
+            }
+          if (fd >= 0)
+            {
+              SimLog ("Too many connections, refusing one");
+              close (fd);
+            }
+        }
+
+      for (i = 0; i < SIM_MAX_CLIENTS; i++)
+        {
+          if (clients[i].fd >= 0 && fds[i + 1].fd == clients[i].fd
+              && (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+              ReadClient (&clients[i]);
+            }
+        }
+    }
+
+  for (i = 0; i < SIM_MAX_CLIENTS; i++)
+    {
+      if (clients[i].fd >= 0)
+        {
+          CloseClient (&clients[i]);
+        }
+    }
+  close (listener);
+
+  fprintf (stderr,
+           "u64sim: %lu requests, %lu faults, %llu bytes in, %llu bytes "
+           "out\n",
+           served, faults, bytes_in, bytes_out);
+  return 0;
+}
@@ -0,0 +1,82 @@
+/* Ultimate64 Control - REST stand-in server
+ * Shared definitions for u64sim, a host program that answers the
+ * Ultimate REST API the library uses so it can be exercised without
+ * hardware. Built with the host compiler (make sim), not for the Amiga.
+ */
+
+#ifndef U64_SIM_H
+#define U64_SIM_H
+
+#include <stddef.h>
+
+/* Limits */
+#define SIM_MAX_CLIENTS 16
+#define SIM_MAX_HEADER 8192
+#define SIM_MAX_BODY (4UL * 1024 * 1024) /* largest CRT plus multipart */
+#define SIM_MEMORY_SIZE 65536
+#define SIM_MAX_READMEM 65536
+#define SIM_DRIVES 2
+
+/* Fault kinds (SimOptions.fault_kinds) */
+#define SIM_FAULT_DROP 0x01  /* close without replying */
+#define SIM_FAULT_ERROR 0x02 /* 500 with an errors array */
+#define SIM_FAULT_STALL 0x04 /* reply after stall_ms */
+#define SIM_FAULT_SHORT 0x08 /* send half the body, then close */
+#define SIM_FAULT_ALL 0x0F
+
+typedef struct
+{
+  unsigned short port;
+  const char *password;     /* NULL = no X-password required */
+  unsigned long latency_ms; /* before every reply */
+  unsigned long jitter_ms;  /* plus 0..jitter_ms at random */
+  unsigned long bandwidth;  /* reply bytes per second, 0 = unlimited */
+  unsigned int fault_percent;
+  unsigned int fault_kinds;
+  unsigned long stall_ms;
+  unsigned long idle_s;     /* close keep-alive connections idle this long */
+  int close_after_reply;    /* act like a plain HTTP/1.0 server */
+  int verbose;
+  unsigned int seed;
+} SimOptions;
+
+/* One parsed request. Strings point into the connection's buffer. */
+typedef struct
+{
+  char *method;
+  char *path;  /* without the query, percent-decoded */
+  char *query; /* raw, NULL if none */
+  const char *content_type;
+  const char *password;
+  const unsigned char *body;
+  size_t body_len;
+} SimRequest;
+
+typedef struct
+{
+  int status;
+  const char *content_type;
+  char *data;
+  size_t len;
+  size_t size;
+} SimResponse;
+
+/* server.c */
+int SimServe (const SimOptions *opts);
+void SimStop (void);
+void SimRespond (SimResponse *resp, int status, const char *content_type);
+void SimAppend (SimResponse *resp, const void *data, size_t len);
+void SimPrintf (SimResponse *resp, const char *format, ...)
+    __attribute__ ((format (printf, 2, 3)));
+void SimJsonString (SimResponse *resp, const char *s);
+void SimJsonErrors (SimResponse *resp, int status, const char *error);
+void SimLog (const char *format, ...) __attribute__ ((format (printf, 1, 2)));
+
+/* api.c */
+void SimDeviceInit (void);
+void SimHandle (const SimRequest *req, SimResponse *resp);
+int SimQueryValue (const char *query, const char *key, char *value,
+                   size_t value_size);
+void SimUrlDecode (char *s);
+
+#endif /* U64_SIM_H */
@@ -0,0 +1,76 @@
+/* Ultimate64/Ultimate-II Control Library - host tests for the request
+ * statistics (make test). Builds on the exec/dos shims in src/host.
+ */
+
+#include <exec/types.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ultimate64_amiga.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                           \
+  do                                                                          \
+    {                                                                         \
+      if (!(cond))                                                            \
+        {                                                                     \
+          printf ("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);             \
+          failures++;                                                         \
+        }                                                                     \
+    }                                                                         \
+  while (0)
+
+/* Samples all well inside the first bucket must not report that bucket's
+   10 ms bound as a percentile */
+static void
+TestPercentileWithinMax (void)
+{
+  U64Histogram hist;
+
+  memset (&hist, 0, sizeof (hist));
+  hist.count = 5;
+  hist.buckets[0] = 5;
+  hist.max_ms = 3;
+  CHECK (U64_StatsPercentile (&hist, 50) <= hist.max_ms);
+  CHECK (U64_StatsPercentile (&hist, 90) <= hist.max_ms);
+  CHECK (U64_StatsPercentile (&hist, 90) == 3);
+
+  hist.max_ms = 0;
+  CHECK (U64_StatsPercentile (&hist, 90) == 0);
+}
+
+/* Spread over buckets, the percentile is still the bucket bound */
+static void
+TestPercentileBuckets (void)
+{
+  U64Histogram hist;
+
+  memset (&hist, 0, sizeof (hist));
+  hist.count = 10;
+  hist.buckets[0] = 8; /* <= 10 ms */
+  hist.buckets[3] = 2; /* <= 100 ms */
+  hist.max_ms = 95;
+  CHECK (U64_StatsPercentile (&hist, 50) == U64_StatsBucketLimit (0));
+  CHECK (U64_StatsPercentile (&hist, 90) == 95);
+  CHECK (U64_StatsPercentile (&hist, 90) <= hist.max_ms);
+
+  memset (&hist, 0, sizeof (hist));
+  CHECK (U64_StatsPercentile (&hist, 90) == 0);
+}
+
+int
+main (void)
+{
+  TestPercentileWithinMax ();
+  TestPercentileBuckets ();
+
+  if (failures)
+    {
+      printf ("%d check(s) failed\n", failures);
+      return 1;
+    }
+  printf ("stats: all checks passed\n");
+  return 0;
+}